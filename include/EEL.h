@@ -151,6 +151,34 @@ EELAPI(EEL_object *)eel_new_indexable(EEL_vm *vm, EEL_classes cid, int length);
  */
 EELAPI(EEL_object *)eel_cv_new_noinit(EEL_vm *vm, EEL_classes cid, unsigned size);
 
+/*
+ * Create a view of 'length' items of vector 'v', starting at item 'start'.
+ * The view shares the buffer of 'v' rather than copying the items, and keeps
+ * 'v' alive. Neither can be resized while the view exists. The range is NOT
+ * checked!
+ */
+EELAPI(EEL_object *)eel_cv_new_view(EEL_object *v, int start, int length);
+
+/*
+ * Read or write 'count' items of vector 'v', starting at item 'start', and
+ * stepping 'vstride' items in the vector and 'bstride' items in 'buf' for
+ * each item. Items are converted as needed, the same way as by indexing.
+ * Returns EEL_XWRONGTYPE if 'v' is not a vector, or an index exception if
+ * any of the items are out of range, in which case nothing is transferred.
+ */
+EELAPI(EEL_xno)eel_vector_read_i(EEL_object *v, int start, int vstride,
+		int *buf, int count, int bstride);
+EELAPI(EEL_xno)eel_vector_read_f(EEL_object *v, int start, int vstride,
+		float *buf, int count, int bstride);
+EELAPI(EEL_xno)eel_vector_read_d(EEL_object *v, int start, int vstride,
+		double *buf, int count, int bstride);
+EELAPI(EEL_xno)eel_vector_write_i(EEL_object *v, int start, int vstride,
+		const int *buf, int count, int bstride);
+EELAPI(EEL_xno)eel_vector_write_f(EEL_object *v, int start, int vstride,
+		const float *buf, int count, int bstride);
+EELAPI(EEL_xno)eel_vector_write_d(EEL_object *v, int start, int vstride,
+		const double *buf, int count, int bstride);
+
 #ifdef __cplusplus
 };
 #endif
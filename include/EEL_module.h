@@ -61,6 +61,8 @@ typedef enum
 	EEL_SF_WERROR =		0x00000400,
 	/* Disable the operator precedence warning introduced in 0.3.7 */
 	EEL_SF_NOPRECEDENCE =	0x00000800,
+	/* Disable function inlining and constant propagation */
+	EEL_SF_NOOPTIMIZE =	0x00001000,
 } EEL_sflags;
 
 EELAPI(EEL_object *)eel_load_buffer(EEL_vm *vm,
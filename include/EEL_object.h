@@ -88,7 +88,6 @@ typedef enum
 				 * three variants, but *must* be aware of them,
 				 * and throw exceptions when appropriate!
 				 */
-#if 0
 	EEL_MM_SLICE,		/* Create an object that represents the
 				 * specified range of elements, without
 				 * copying the data.
@@ -96,7 +95,6 @@ typedef enum
 				 *	op2 = number of elements (integer)
 				 * Out:	*op2 = value (any EEL type)
 				 */
-#endif
 	EEL_MM_LENGTH,		/* Get current number of elements.
 				 * In:	Nothing
 				 * Out:	*op2 = length (integer)
@@ -435,6 +433,16 @@ EELAPI(void)eel_own(EEL_object *o);
 EELAPI(void)eel_disown(EEL_object *o);
 
 
+/*
+ * Free tables and arrays that are kept alive only by circular references.
+ * Runs for approximately 'budget' microseconds, or until all candidates have
+ * been checked if 'budget' is negative.
+ *
+ * Returns the number of objects freed.
+ */
+EELAPI(int)eel_collect_cycles(EEL_vm *vm, int budget);
+
+
 /*
  * If 'value' is a (strong) reference to an object, increment that objects
  * refcount. Weak references are ignored!
@@ -85,6 +85,13 @@ int	argc;		/* Argument count */
 /*FIXME:*/
 };
 
+/*
+ * Returns non-zero if the result of the current C function call is going to
+ * be discarded. The function may then leave 'resv' alone, and skip any work
+ * that only serves to produce the result.
+ */
+#define	eel_result_ignored(vm)	((vm)->resv == (vm)->base)
+
 /* Get currently executing function object. */
 EELAPI(EEL_object *)eel_current_function(EEL_vm *vm);
 
@@ -178,6 +185,34 @@ EELAPI(EEL_xno)eel_callnf(EEL_vm *vm, EEL_object *m, const char *fn,
  */
 EELAPI(EEL_xno)eel_run(EEL_vm *vm);
 
+/*
+ * Limit the number of VM instructions that may be executed before eel_call()
+ * (or any of its variants) returns EEL_XCOUNTER. The call is then suspended,
+ * and can be continued from where it stopped with eel_resume(), typically
+ * after setting a new budget. A budget of -1 (the default) means no limit.
+ *
+ * The budget is shared by all code running in the VM, including any green
+ * threads, and remains used up until a new budget is set.
+ *
+ * NOTE:
+ *	Budgets are only checked between VM instructions, so time spent in C
+ *	functions is not accounted for. Also, only calls made from outside the
+ *	VM are suspended. Calls from within the VM (callbacks from C functions,
+ *	for example) always run to completion, as there is C code waiting for
+ *	them to return.
+ */
+EELAPI(void)eel_set_budget(EEL_vm *vm, int instructions);
+
+/* Returns what's left of the budget, or -1 if there is no limit. */
+EELAPI(int)eel_get_budget(EEL_vm *vm);
+
+/*
+ * Continue a call that was suspended as the budget ran out. Returns like
+ * eel_call(), which includes EEL_XCOUNTER if the new budget runs out as well,
+ * or EEL_XBADCONTEXT if there is no suspended call.
+ */
+EELAPI(EEL_xno)eel_resume(EEL_vm *vm);
+
 
 /*----------------------------------------------------------
 	Memory management
@@ -197,6 +232,12 @@ static inline void eel_free(EEL_vm *vm, void *block)
 	return vm->free(vm, block);
 }
 
+/*
+ * Release unused memory held by the object memory pools of the state that
+ * 'vm' belongs to. Returns the number of bytes released.
+ */
+EELAPI(int)eel_trim_pools(EEL_vm *vm);
+
 /* Get scratch buffer, ensuring it is at least the specified size. */
 static inline void *eel_scratch(EEL_vm *vm, int size)
 {
@@ -5,9 +5,12 @@
  */
 
 #include <math.h>
+#include <string.h>
+#include <stdlib.h>
 #include "eel_dsp.h"
 #include "kfc.h"
 #include "e_vector.h"		/* For 'vector' internals */
+#include "e_vkernel.h"
 #include "e_operate.h"		/* For inline metamethod calling */
 
 
@@ -486,15 +489,254 @@ static EEL_xno dsp_add_polynomial_i(EEL_vm *vm)
 	FFT
 -------------------------------------------------------------------*/
 
+/*
+ * Complex transforms work on interleaved (re, im) vector_d or vector_f data.
+ * Like fft_real(), forward transforms are scaled by 1/N, so that the inverse
+ * transform of the result restores the input.
+ *
+ * The output can be a separate vector (of either type) or the input vector
+ * itself. Transforms that need intermediate buffers (in-place or vector_f)
+ * use the scratch space of the plan, so there are no allocations per call,
+ * except for the output vector, when none is supplied.
+ */
+
+/* Module wide scratch space for the plan cached transforms */
+static kiss_fft_cpx *dsp_scratch = NULL;
+static int dsp_nscratch = 0;
+
+/* Class ID of 'fftplan' */
+static EEL_classes dsp_fftplan_cid;
+
+
+static inline int is_fftvector(EEL_classes cid)
+{
+	return (cid == EEL_CVECTOR_D) || (cid == EEL_CVECTOR_F);
+}
+
+
+/*
+ * Transform 'count' consecutive blocks of plan->nfft complex values from 'in'
+ * to 'out'.
+ */
+static void do_fft(EDSP_fftplan *plan, EEL_object *in, EEL_object *out,
+		int count)
+{
+	EEL_vector *iv = o2EEL_vector(in);
+	EEL_vector *ov = o2EEL_vector(out);
+	int n2 = plan->nfft * 2;
+	int b;
+	for(b = 0; b < count; ++b)
+	{
+		int offs = b * n2;
+		const kiss_fft_cpx *src;
+		kiss_fft_cpx *dst;
+		if(in->classid == EEL_CVECTOR_F)
+		{
+			eel_vk->f2d((double *)plan->work, iv->buffer.f + offs,
+					n2);
+			src = plan->work;
+		}
+		else
+			src = (kiss_fft_cpx *)(iv->buffer.d + offs);
+		if((out->classid == EEL_CVECTOR_D) &&
+				((double *)src != ov->buffer.d + offs))
+			dst = (kiss_fft_cpx *)(ov->buffer.d + offs);
+		else
+			dst = plan->work + plan->nfft;
+		kiss_fft(plan->cfg, src, dst);
+		if(!plan->inverse)
+			eel_vk->vs[EEL_VK_MUL][EEL_VK_D](dst, dst,
+					1.0 / plan->nfft, n2);
+		if(dst != plan->work + plan->nfft)
+			continue;
+		if(out->classid == EEL_CVECTOR_F)
+			eel_vk->d2f(ov->buffer.f + offs, (double *)dst, n2);
+		else
+			memcpy(ov->buffer.d + offs, dst, n2 * sizeof(double));
+	}
+}
+
+
+/*
+ * Check arguments, set up the output vector, and run 'count' transforms.
+ * 'count' 0 means as many as there are in the input. The output vector is
+ * returned in vm->heap[vm->resv].
+ */
+static EEL_xno do_transform(EEL_vm *vm, EDSP_fftplan *plan, EEL_value *in,
+		EEL_value *out, int count)
+{
+	EEL_object *io, *oo;
+	int len;
+	if(!is_fftvector(EEL_CLASS(in)))
+		return EEL_XWRONGTYPE;
+	io = eel_v2o(in);
+	len = o2EEL_vector(io)->length;
+	if(len & 1)
+		return EEL_XNEEDEVEN;
+	if(count)
+	{
+		if(len != plan->nfft * 2 * count)
+			return EEL_XWRONGINDEX;
+	}
+	else
+	{
+		if(len % (plan->nfft * 2))
+			return EEL_XWRONGINDEX;
+		count = len / (plan->nfft * 2);
+	}
+	if(out)
+	{
+		if(!is_fftvector(EEL_CLASS(out)))
+			return EEL_XWRONGTYPE;
+		oo = eel_v2o(out);
+		if(o2EEL_vector(oo)->length < len)
+			return EEL_XFEWITEMS;
+		eel_o_own(oo);
+	}
+	else
+	{
+		oo = eel_new_indexable(vm, io->classid, len);
+		if(!oo)
+			return EEL_XCONSTRUCTOR;
+	}
+	do_fft(plan, io, oo, count);
+	eel_o2v(vm->heap + vm->resv, oo);
+	return EEL_XOK;
+}
+
+
+/* Transform using a cached plan of the size of the input */
+static EEL_xno do_cached_fft(EEL_vm *vm, int inverse)
+{
+	EEL_value *args = vm->heap + vm->argv;
+	EDSP_fftplan plan;
+	int len;
+	if(!is_fftvector(EEL_CLASS(args)))
+		return EEL_XWRONGTYPE;
+	len = o2EEL_vector(eel_v2o(args))->length;
+	if(len & 1)
+		return EEL_XNEEDEVEN;
+	if(!len)
+		return EEL_XFEWITEMS;
+	plan.nfft = len / 2;
+	plan.inverse = inverse;
+	plan.cfg = kfc_plan(plan.nfft, inverse);
+	if(!plan.cfg)
+		return EEL_XMEMORY;
+	if(dsp_nscratch < plan.nfft)
+	{
+		kiss_fft_cpx *ns = realloc(dsp_scratch,
+				sizeof(kiss_fft_cpx) * 2 * plan.nfft);
+		if(!ns)
+			return EEL_XMEMORY;
+		dsp_scratch = ns;
+		dsp_nscratch = plan.nfft;
+	}
+	plan.work = dsp_scratch;
+	return do_transform(vm, &plan, args, vm->argc >= 2 ? args + 1 : NULL,
+			1);
+}
+
+
+static void dsp_free_scratch(void)
+{
+	free(dsp_scratch);
+	dsp_scratch = NULL;
+	dsp_nscratch = 0;
+}
+
+
+// function fft(v)[out];
 static EEL_xno dsp_fft(EEL_vm *vm)
 {
-	return EEL_XNOTIMPLEMENTED;
+	return do_cached_fft(vm, 0);
 }
 
 
+// function ifft(v)[out];
 static EEL_xno dsp_ifft(EEL_vm *vm)
 {
-	return EEL_XNOTIMPLEMENTED;
+	return do_cached_fft(vm, 1);
+}
+
+
+/* fftplan [nfft, inverse] */
+static EEL_xno plan_construct(EEL_vm *vm, EEL_classes cid,
+		EEL_value *initv, int initc, EEL_value *result)
+{
+	EDSP_fftplan *plan;
+	EEL_object *eo;
+	int nfft;
+	if((initc < 1) || (initc > 2))
+		return EEL_XARGUMENTS;
+	nfft = eel_v2l(initv);
+	if(nfft < 1)
+		return EEL_XLOWVALUE;
+	eo = eel_o_alloc(vm, sizeof(EDSP_fftplan), cid);
+	if(!eo)
+		return EEL_XMEMORY;
+	plan = o2EDSP_fftplan(eo);
+	plan->nfft = nfft;
+	plan->inverse = (initc >= 2) && eel_v2l(initv + 1);
+	plan->cfg = kiss_fft_alloc(nfft, plan->inverse, NULL, NULL);
+	plan->work = malloc(sizeof(kiss_fft_cpx) * 2 * nfft);
+	if(!plan->cfg || !plan->work)
+	{
+		kiss_fft_free(plan->cfg);
+		free(plan->work);
+		eel_o_free(eo);
+		return EEL_XMEMORY;
+	}
+	eel_o2v(result, eo);
+	return 0;
+}
+
+
+static EEL_xno plan_destruct(EEL_object *eo)
+{
+	EDSP_fftplan *plan = o2EDSP_fftplan(eo);
+	kiss_fft_free(plan->cfg);
+	free(plan->work);
+	return 0;
+}
+
+
+static EEL_xno plan_length(EEL_object *eo, EEL_value *op1, EEL_value *op2)
+{
+	eel_l2v(op2, o2EDSP_fftplan(eo)->nfft);
+	return 0;
+}
+
+
+static inline EDSP_fftplan *get_plan(EEL_value *v)
+{
+	if(EEL_CLASS(v) != dsp_fftplan_cid)
+		return NULL;
+	return o2EDSP_fftplan(eel_v2o(v));
+}
+
+
+// function fft_run(plan, v)[out];
+static EEL_xno dsp_fft_run(EEL_vm *vm)
+{
+	EEL_value *args = vm->heap + vm->argv;
+	EDSP_fftplan *plan = get_plan(args);
+	if(!plan)
+		return EEL_XWRONGTYPE;
+	return do_transform(vm, plan, args + 1,
+			vm->argc >= 3 ? args + 2 : NULL, 1);
+}
+
+
+// function fft_batch(plan, v)[out];
+static EEL_xno dsp_fft_batch(EEL_vm *vm)
+{
+	EEL_value *args = vm->heap + vm->argv;
+	EDSP_fftplan *plan = get_plan(args);
+	if(!plan)
+		return EEL_XWRONGTYPE;
+	return do_transform(vm, plan, args + 1,
+			vm->argc >= 3 ? args + 2 : NULL, 0);
 }
 
 
@@ -576,6 +818,7 @@ static EEL_xno dsp_fft_cleanup(EEL_vm *vm)
 {
 	kfc_cleanup();
 	kiss_fft_cleanup();
+	dsp_free_scratch();
 	return EEL_XOK;
 }
 
@@ -726,6 +969,829 @@ static EEL_xno dsp_c_add_polar_i(EEL_vm *vm)
 }
 
 
+/*-------------------------------------------------------------------
+	Block processing
+---------------------------------------------------------------------
+ * The block kernels operate on vector_f and vector_d data, calculating in
+ * double precision. vector_d buffers are used directly, while vector_f
+ * data is converted EEL_VK_CHUNK samples at a time through stack buffers.
+ * Output vectors supplied by the caller are written in place, so nothing
+ * is allocated per call, apart from output vectors that are not supplied.
+ * The output vector may be the input vector.
+ */
+
+/* Samples [start, start + n) of 'v' as doubles, using 'buf' if needed */
+static inline const double *blk_in(EEL_object *v, int start, int n,
+		double *buf)
+{
+	EEL_vector *vec = o2EEL_vector(v);
+	if(v->classid == EEL_CVECTOR_D)
+		return vec->buffer.d + start;
+	eel_vk->f2d(buf, vec->buffer.f + start, n);
+	return buf;
+}
+
+/* Where to render samples [start, start + n) of 'v'. Finish with blk_out()! */
+static inline double *blk_dst(EEL_object *v, int start, double *buf)
+{
+	if(v->classid == EEL_CVECTOR_D)
+		return o2EEL_vector(v)->buffer.d + start;
+	return buf;
+}
+
+static inline void blk_out(EEL_object *v, int start, int n, double *buf)
+{
+	if(v->classid == EEL_CVECTOR_F)
+		eel_vk->d2f(o2EEL_vector(v)->buffer.f + start, buf, n);
+}
+
+
+/*
+ * Set up the output vector for 'n' samples; 'out' if specified, or a new
+ * vector of class 'cid'. The object is returned with a reference for the
+ * caller, as for eel_o2v().
+ */
+static EEL_xno blk_output(EEL_vm *vm, EEL_value *out, EEL_classes cid, int n,
+		EEL_object **o)
+{
+	if(out)
+	{
+		if(!is_fftvector(EEL_CLASS(out)))
+			return EEL_XWRONGTYPE;
+		*o = eel_v2o(out);
+		if(o2EEL_vector(*o)->length < n)
+			return EEL_XFEWITEMS;
+		eel_o_own(*o);
+		return 0;
+	}
+	if(!(*o = eel_new_indexable(vm, cid, n)))
+		return EEL_XCONSTRUCTOR;
+	return 0;
+}
+
+
+/*-------------------------------------------------------------------
+	Biquad filters
+-------------------------------------------------------------------*/
+
+/* Class ID of 'biquad' */
+static EEL_classes dsp_biquad_cid;
+
+static inline void bq_passthrough(EDSP_bqsection *s)
+{
+	s->b0 = 1.0f;
+	s->b1 = s->b2 = s->a1 = s->a2 = 0.0f;
+	s->s1 = s->s2 = 0.0f;
+}
+
+
+/* biquad [sections] */
+static EEL_xno bq_construct(EEL_vm *vm, EEL_classes cid,
+		EEL_value *initv, int initc, EEL_value *result)
+{
+	EDSP_biquad *bq;
+	EEL_object *eo;
+	int i, n = 1;
+	if(initc > 1)
+		return EEL_XARGUMENTS;
+	if(initc)
+		n = eel_v2l(initv);
+	if(n < 1)
+		return EEL_XLOWVALUE;
+	eo = eel_o_alloc(vm, sizeof(EDSP_biquad), cid);
+	if(!eo)
+		return EEL_XMEMORY;
+	bq = o2EDSP_biquad(eo);
+	bq->nsections = n;
+	bq->sections = malloc(sizeof(EDSP_bqsection) * n);
+	if(!bq->sections)
+	{
+		eel_o_free(eo);
+		return EEL_XMEMORY;
+	}
+	for(i = 0; i < n; ++i)
+		bq_passthrough(&bq->sections[i]);
+	eel_o2v(result, eo);
+	return 0;
+}
+
+
+static EEL_xno bq_destruct(EEL_object *eo)
+{
+	free(o2EDSP_biquad(eo)->sections);
+	return 0;
+}
+
+
+static EEL_xno bq_length(EEL_object *eo, EEL_value *op1, EEL_value *op2)
+{
+	eel_l2v(op2, o2EDSP_biquad(eo)->nsections);
+	return 0;
+}
+
+
+/* Get section 'v' of biquad 'bqv' */
+static EEL_xno bq_section(EEL_value *bqv, EEL_value *v, EDSP_bqsection **s)
+{
+	EDSP_biquad *bq;
+	int i;
+	if(EEL_CLASS(bqv) != dsp_biquad_cid)
+		return EEL_XWRONGTYPE;
+	bq = o2EDSP_biquad(eel_v2o(bqv));
+	i = eel_v2l(v);
+	if(i < 0)
+		return EEL_XLOWINDEX;
+	else if(i >= bq->nsections)
+		return EEL_XHIGHINDEX;
+	*s = &bq->sections[i];
+	return 0;
+}
+
+
+// procedure biquad_set(bq, section, b0, b1, b2, a1, a2);
+static EEL_xno dsp_biquad_set(EEL_vm *vm)
+{
+	EEL_value *args = vm->heap + vm->argv;
+	EDSP_bqsection *s;
+	EEL_xno x = bq_section(args, args + 1, &s);
+	if(x)
+		return x;
+	s->b0 = eel_v2d(args + 2);
+	s->b1 = eel_v2d(args + 3);
+	s->b2 = eel_v2d(args + 4);
+	s->a1 = eel_v2d(args + 5);
+	s->a2 = eel_v2d(args + 6);
+	return 0;
+}
+
+
+/*
+ * procedure biquad_design(bq, section, type, f, q)[gain];
+ *
+ * Filter designs from Robert Bristow-Johnson's "Audio EQ Cookbook".
+ */
+static EEL_xno dsp_biquad_design(EEL_vm *vm)
+{
+	EEL_value *args = vm->heap + vm->argv;
+	EDSP_bqsection *s;
+	double f, q, w0, cw, alpha, a, sqa, a0;
+	double b0, b1, b2, a1, a2;
+	EEL_xno x = bq_section(args, args + 1, &s);
+	if(x)
+		return x;
+	f = eel_v2d(args + 3);
+	q = eel_v2d(args + 4);
+	if((f <= 0.0f) || (f >= 0.5f) || (q <= 0.0f))
+		return EEL_XBADVALUE;
+	a = pow(10.0f, (vm->argc >= 6 ? eel_v2d(args + 5) : 0.0f) / 40.0f);
+	w0 = 2.0f * M_PI * f;
+	cw = cos(w0);
+	alpha = sin(w0) / (2.0f * q);
+	sqa = 2.0f * sqrt(a) * alpha;
+	switch(eel_v2l(args + 2))
+	{
+	  case EDSP_BQ_LOWPASS:
+		b0 = b2 = (1.0f - cw) * 0.5f;
+		b1 = 1.0f - cw;
+		a0 = 1.0f + alpha;
+		a1 = -2.0f * cw;
+		a2 = 1.0f - alpha;
+		break;
+	  case EDSP_BQ_HIGHPASS:
+		b0 = b2 = (1.0f + cw) * 0.5f;
+		b1 = -(1.0f + cw);
+		a0 = 1.0f + alpha;
+		a1 = -2.0f * cw;
+		a2 = 1.0f - alpha;
+		break;
+	  case EDSP_BQ_BANDPASS:
+		b0 = alpha;
+		b1 = 0.0f;
+		b2 = -alpha;
+		a0 = 1.0f + alpha;
+		a1 = -2.0f * cw;
+		a2 = 1.0f - alpha;
+		break;
+	  case EDSP_BQ_NOTCH:
+		b0 = b2 = 1.0f;
+		b1 = -2.0f * cw;
+		a0 = 1.0f + alpha;
+		a1 = -2.0f * cw;
+		a2 = 1.0f - alpha;
+		break;
+	  case EDSP_BQ_ALLPASS:
+		b0 = a2 = 1.0f - alpha;
+		b1 = a1 = -2.0f * cw;
+		b2 = a0 = 1.0f + alpha;
+		break;
+	  case EDSP_BQ_PEAK:
+		b0 = 1.0f + alpha * a;
+		b1 = a1 = -2.0f * cw;
+		b2 = 1.0f - alpha * a;
+		a0 = 1.0f + alpha / a;
+		a2 = 1.0f - alpha / a;
+		break;
+	  case EDSP_BQ_LOWSHELF:
+		b0 = a * ((a + 1.0f) - (a - 1.0f) * cw + sqa);
+		b1 = 2.0f * a * ((a - 1.0f) - (a + 1.0f) * cw);
+		b2 = a * ((a + 1.0f) - (a - 1.0f) * cw - sqa);
+		a0 = (a + 1.0f) + (a - 1.0f) * cw + sqa;
+		a1 = -2.0f * ((a - 1.0f) + (a + 1.0f) * cw);
+		a2 = (a + 1.0f) + (a - 1.0f) * cw - sqa;
+		break;
+	  case EDSP_BQ_HIGHSHELF:
+		b0 = a * ((a + 1.0f) + (a - 1.0f) * cw + sqa);
+		b1 = -2.0f * a * ((a - 1.0f) + (a + 1.0f) * cw);
+		b2 = a * ((a + 1.0f) + (a - 1.0f) * cw - sqa);
+		a0 = (a + 1.0f) - (a - 1.0f) * cw + sqa;
+		a1 = 2.0f * ((a - 1.0f) - (a + 1.0f) * cw);
+		a2 = (a + 1.0f) - (a - 1.0f) * cw - sqa;
+		break;
+	  default:
+		return EEL_XBADVALUE;
+	}
+	s->b0 = b0 / a0;
+	s->b1 = b1 / a0;
+	s->b2 = b2 / a0;
+	s->a1 = a1 / a0;
+	s->a2 = a2 / a0;
+	return 0;
+}
+
+
+// procedure biquad_reset(bq);
+static EEL_xno dsp_biquad_reset(EEL_vm *vm)
+{
+	EEL_value *args = vm->heap + vm->argv;
+	EDSP_biquad *bq;
+	int i;
+	if(EEL_CLASS(args) != dsp_biquad_cid)
+		return EEL_XWRONGTYPE;
+	bq = o2EDSP_biquad(eel_v2o(args));
+	for(i = 0; i < bq->nsections; ++i)
+		bq->sections[i].s1 = bq->sections[i].s2 = 0.0f;
+	return 0;
+}
+
+
+static inline void bq_process(EDSP_bqsection *s, const double *in,
+		double *out, int n)
+{
+	double b0 = s->b0, b1 = s->b1, b2 = s->b2, a1 = s->a1, a2 = s->a2;
+	double s1 = s->s1, s2 = s->s2;
+	int i;
+	for(i = 0; i < n; ++i)
+	{
+		double x = in[i];
+		double y = b0 * x + s1;
+		s1 = b1 * x - a1 * y + s2;
+		s2 = b2 * x - a2 * y;
+		out[i] = y;
+	}
+	s->s1 = s1;
+	s->s2 = s2;
+}
+
+
+// function biquad_run(bq, v)[out];
+static EEL_xno dsp_biquad_run(EEL_vm *vm)
+{
+	EEL_value *args = vm->heap + vm->argv;
+	double ibuf[EEL_VK_CHUNK], obuf[EEL_VK_CHUNK];
+	EDSP_biquad *bq;
+	EEL_object *io, *oo;
+	EEL_xno x;
+	int len, i, c;
+	if((EEL_CLASS(args) != dsp_biquad_cid) ||
+			!is_fftvector(EEL_CLASS(args + 1)))
+		return EEL_XWRONGTYPE;
+	bq = o2EDSP_biquad(eel_v2o(args));
+	io = eel_v2o(args + 1);
+	len = o2EEL_vector(io)->length;
+	x = blk_output(vm, vm->argc >= 3 ? args + 2 : NULL, io->classid, len,
+			&oo);
+	if(x)
+		return x;
+	for(i = 0; i < len; i += c)
+	{
+		const double *in;
+		double *out;
+		int s;
+		c = len - i < EEL_VK_CHUNK ? len - i : EEL_VK_CHUNK;
+		in = blk_in(io, i, c, ibuf);
+		out = blk_dst(oo, i, obuf);
+		for(s = 0; s < bq->nsections; ++s, in = out)
+			bq_process(&bq->sections[s], in, out, c);
+		blk_out(oo, i, c, obuf);
+	}
+	eel_o2v(vm->heap + vm->resv, oo);
+	return 0;
+}
+
+
+/*-------------------------------------------------------------------
+	FIR filters
+---------------------------------------------------------------------
+ * Direct convolution keeps the last ntaps - 1 inputs in front of the
+ * current chunk in 'history'. The FFT version does overlap-add over segments
+ * of nfft - ntaps + 1 samples, with nfft being a power of two of at least
+ * twice the number of taps. Both produce the output for each input sample
+ * as it is processed, so they are interchangeable, save for rounding errors.
+ */
+
+/* Class ID of 'fir' */
+static EEL_classes dsp_fir_cid;
+
+static void fir_free(EDSP_fir *f)
+{
+	free(f->taps);
+	free(f->history);
+	kiss_fftr_free(f->fwd);
+	kiss_fftr_free(f->inv);
+	free(f->h);
+	free(f->spec);
+	free(f->work);
+	free(f->acc);
+}
+
+
+static int fir_init_fft(EDSP_fir *f)
+{
+	int i;
+	f->nfft = 2;
+	while(f->nfft < f->ntaps * 2)
+		f->nfft <<= 1;
+	f->fwd = kiss_fftr_alloc(f->nfft, 0, NULL, NULL);
+	f->inv = kiss_fftr_alloc(f->nfft, 1, NULL, NULL);
+	f->h = malloc(sizeof(kiss_fft_cpx) * (f->nfft / 2 + 1));
+	f->spec = malloc(sizeof(kiss_fft_cpx) * (f->nfft / 2 + 1));
+	f->work = calloc(f->nfft, sizeof(double));
+	f->acc = calloc(f->nfft, sizeof(double));
+	if(!f->fwd || !f->inv || !f->h || !f->spec || !f->work || !f->acc)
+		return -1;
+
+	/* Spectrum of the taps, with the 1 / nfft of the inverse FFT */
+	memcpy(f->work, f->taps, f->ntaps * sizeof(double));
+	kiss_fftr(f->fwd, f->work, f->h);
+	for(i = 0; i <= f->nfft / 2; ++i)
+	{
+		f->h[i].r /= f->nfft;
+		f->h[i].i /= f->nfft;
+	}
+	memset(f->work, 0, f->nfft * sizeof(double));
+	return 0;
+}
+
+
+/* fir [taps, mode] */
+static EEL_xno fir_construct(EEL_vm *vm, EEL_classes cid,
+		EEL_value *initv, int initc, EEL_value *result)
+{
+	EDSP_fir *f;
+	EEL_object *eo, *to;
+	int mode = EDSP_FIR_AUTO;
+	if((initc < 1) || (initc > 2))
+		return EEL_XARGUMENTS;
+	if(!is_fftvector(EEL_CLASS(initv)))
+		return EEL_XWRONGTYPE;
+	to = eel_v2o(initv);
+	if(!o2EEL_vector(to)->length)
+		return EEL_XFEWITEMS;
+	if(initc >= 2)
+		mode = eel_v2l(initv + 1);
+	eo = eel_o_alloc(vm, sizeof(EDSP_fir), cid);
+	if(!eo)
+		return EEL_XMEMORY;
+	f = o2EDSP_fir(eo);
+	memset(f, 0, sizeof(EDSP_fir));
+	f->ntaps = o2EEL_vector(to)->length;
+	f->taps = malloc(f->ntaps * sizeof(double));
+	if(f->taps && (to->classid == EEL_CVECTOR_D))
+		memcpy(f->taps, o2EEL_vector(to)->buffer.d,
+				f->ntaps * sizeof(double));
+	else if(f->taps)
+		eel_vk->f2d(f->taps, o2EEL_vector(to)->buffer.f, f->ntaps);
+	if((mode == EDSP_FIR_FFT) || ((mode == EDSP_FIR_AUTO) &&
+			(f->ntaps > EDSP_FIR_FFTTAPS)))
+	{
+		if(!f->taps || (fir_init_fft(f) < 0))
+		{
+			fir_free(f);
+			eel_o_free(eo);
+			return EEL_XMEMORY;
+		}
+	}
+	else
+	{
+		f->history = calloc(f->ntaps - 1 + EEL_VK_CHUNK,
+				sizeof(double));
+		if(!f->taps || !f->history)
+		{
+			fir_free(f);
+			eel_o_free(eo);
+			return EEL_XMEMORY;
+		}
+	}
+	eel_o2v(result, eo);
+	return 0;
+}
+
+
+static EEL_xno fir_destruct(EEL_object *eo)
+{
+	fir_free(o2EDSP_fir(eo));
+	return 0;
+}
+
+
+static EEL_xno fir_length(EEL_object *eo, EEL_value *op1, EEL_value *op2)
+{
+	eel_l2v(op2, o2EDSP_fir(eo)->ntaps);
+	return 0;
+}
+
+
+// procedure fir_reset(f);
+static EEL_xno dsp_fir_reset(EEL_vm *vm)
+{
+	EEL_value *args = vm->heap + vm->argv;
+	EDSP_fir *f;
+	if(EEL_CLASS(args) != dsp_fir_cid)
+		return EEL_XWRONGTYPE;
+	f = o2EDSP_fir(eel_v2o(args));
+	if(f->nfft)
+		memset(f->acc, 0, f->nfft * sizeof(double));
+	else
+		memset(f->history, 0, (f->ntaps - 1) * sizeof(double));
+	return 0;
+}
+
+
+/* Direct convolution of 'n' (<= EEL_VK_CHUNK) samples */
+static void fir_direct(EDSP_fir *f, const double *in, double *out, int n)
+{
+	double *h = f->history;
+	int nh = f->ntaps - 1;
+	int i, k;
+	memcpy(h + nh, in, n * sizeof(double));
+	for(i = 0; i < n; ++i)
+	{
+		const double *x = h + nh + i;
+		double y = 0.0f;
+		for(k = 0; k < f->ntaps; ++k)
+			y += f->taps[k] * x[-k];
+		out[i] = y;
+	}
+	memmove(h, h + n, nh * sizeof(double));
+}
+
+
+/* Overlap-add of one segment of 'n' (<= nfft - ntaps + 1) samples */
+static void fir_segment(EDSP_fir *f, EEL_object *io, int start,
+		EEL_object *oo, int n)
+{
+	int i;
+	EEL_vector *iv = o2EEL_vector(io);
+	EEL_vector *ov = o2EEL_vector(oo);
+	if(io->classid == EEL_CVECTOR_D)
+		memcpy(f->work, iv->buffer.d + start, n * sizeof(double));
+	else
+		eel_vk->f2d(f->work, iv->buffer.f + start, n);
+	memset(f->work + n, 0, (f->nfft - n) * sizeof(double));
+	kiss_fftr(f->fwd, f->work, f->spec);
+	for(i = 0; i <= f->nfft / 2; ++i)
+	{
+		kiss_fft_cpx a = f->spec[i];
+		kiss_fft_cpx b = f->h[i];
+		f->spec[i].r = a.r * b.r - a.i * b.i;
+		f->spec[i].i = a.r * b.i + a.i * b.r;
+	}
+	kiss_fftri(f->inv, f->spec, f->work);
+	eel_vk->vv[EEL_VK_ADD][EEL_VK_D](f->acc, f->acc, f->work, f->nfft);
+	if(oo->classid == EEL_CVECTOR_D)
+		memcpy(ov->buffer.d + start, f->acc, n * sizeof(double));
+	else
+		eel_vk->d2f(ov->buffer.f + start, f->acc, n);
+	memmove(f->acc, f->acc + n, (f->nfft - n) * sizeof(double));
+	memset(f->acc + f->nfft - n, 0, n * sizeof(double));
+}
+
+
+// function fir_run(f, v)[out];
+static EEL_xno dsp_fir_run(EEL_vm *vm)
+{
+	EEL_value *args = vm->heap + vm->argv;
+	EDSP_fir *f;
+	EEL_object *io, *oo;
+	EEL_xno x;
+	int len, i, c;
+	if((EEL_CLASS(args) != dsp_fir_cid) ||
+			!is_fftvector(EEL_CLASS(args + 1)))
+		return EEL_XWRONGTYPE;
+	f = o2EDSP_fir(eel_v2o(args));
+	io = eel_v2o(args + 1);
+	len = o2EEL_vector(io)->length;
+	x = blk_output(vm, vm->argc >= 3 ? args + 2 : NULL, io->classid, len,
+			&oo);
+	if(x)
+		return x;
+	if(f->nfft)
+	{
+		int seg = f->nfft - f->ntaps + 1;
+		for(i = 0; i < len; i += c)
+		{
+			c = len - i < seg ? len - i : seg;
+			fir_segment(f, io, i, oo, c);
+		}
+	}
+	else
+	{
+		double ibuf[EEL_VK_CHUNK], obuf[EEL_VK_CHUNK];
+		for(i = 0; i < len; i += c)
+		{
+			double *out;
+			c = len - i < EEL_VK_CHUNK ? len - i : EEL_VK_CHUNK;
+			out = blk_dst(oo, i, obuf);
+			fir_direct(f, blk_in(io, i, c, ibuf), out, c);
+			blk_out(oo, i, c, obuf);
+		}
+	}
+	eel_o2v(vm->heap + vm->resv, oo);
+	return 0;
+}
+
+
+/*-------------------------------------------------------------------
+	Windows, resampling and mixing
+-------------------------------------------------------------------*/
+
+typedef enum
+{
+	EDSP_WIN_RECTANGULAR = 0,
+	EDSP_WIN_TRIANGULAR,
+	EDSP_WIN_HANN,
+	EDSP_WIN_HAMMING,
+	EDSP_WIN_BLACKMAN,
+	EDSP_WIN_BLACKMAN_HARRIS
+} EDSP_windows;
+
+typedef enum
+{
+	EDSP_RS_LINEAR = 0,
+	EDSP_RS_CUBIC
+} EDSP_resamplers;
+
+
+// function window(type, size)[out];
+static EEL_xno dsp_window(EEL_vm *vm)
+{
+	EEL_value *args = vm->heap + vm->argv;
+	double buf[EEL_VK_CHUNK];
+	EEL_object *oo;
+	EEL_xno x;
+	int type = eel_v2l(args);
+	int size = eel_v2l(args + 1);
+	int i, c;
+	double scale;
+	if(size < 0)
+		return EEL_XLOWVALUE;
+	if((type < EDSP_WIN_RECTANGULAR) || (type > EDSP_WIN_BLACKMAN_HARRIS))
+		return EEL_XBADVALUE;
+	x = blk_output(vm, vm->argc >= 3 ? args + 2 : NULL, EEL_CVECTOR_D,
+			size, &oo);
+	if(x)
+		return x;
+	scale = size > 1 ? 2.0f * M_PI / (size - 1) : 0.0f;
+	for(i = 0; i < size; i += c)
+	{
+		double *out = blk_dst(oo, i, buf);
+		int j;
+		c = size - i < EEL_VK_CHUNK ? size - i : EEL_VK_CHUNK;
+		for(j = 0; j < c; ++j)
+		{
+			double w = scale * (i + j);
+			switch(type)
+			{
+			  case EDSP_WIN_RECTANGULAR:
+				out[j] = 1.0f;
+				break;
+			  case EDSP_WIN_TRIANGULAR:
+				out[j] = 1.0f - fabs(w / M_PI - 1.0f);
+				break;
+			  case EDSP_WIN_HANN:
+				out[j] = 0.5f - 0.5f * cos(w);
+				break;
+			  case EDSP_WIN_HAMMING:
+				out[j] = 0.54f - 0.46f * cos(w);
+				break;
+			  case EDSP_WIN_BLACKMAN:
+				out[j] = 0.42f - 0.5f * cos(w) +
+						0.08f * cos(2.0f * w);
+				break;
+			  case EDSP_WIN_BLACKMAN_HARRIS:
+				out[j] = 0.35875f - 0.48829f * cos(w) +
+						0.14128f * cos(2.0f * w) -
+						0.01168f * cos(3.0f * w);
+				break;
+			}
+		}
+		blk_out(oo, i, c, buf);
+	}
+	eel_o2v(vm->heap + vm->resv, oo);
+	return 0;
+}
+
+
+/* Sample 'i' of 'v', with indices outside the vector clamped */
+static inline double rs_get(EEL_vector *v, int isf, int i)
+{
+	if(i < 0)
+		i = 0;
+	else if(i >= v->length)
+		i = v->length - 1;
+	return isf ? v->buffer.f[i] : v->buffer.d[i];
+}
+
+
+// function resample(v, size)[mode, out];
+static EEL_xno dsp_resample(EEL_vm *vm)
+{
+	EEL_value *args = vm->heap + vm->argv;
+	double buf[EEL_VK_CHUNK];
+	EEL_object *io, *oo;
+	EEL_vector *iv;
+	EEL_xno x;
+	int size, mode, isf, i, c;
+	double step;
+	if(!is_fftvector(EEL_CLASS(args)))
+		return EEL_XWRONGTYPE;
+	io = eel_v2o(args);
+	iv = o2EEL_vector(io);
+	if(!iv->length)
+		return EEL_XFEWITEMS;
+	size = eel_v2l(args + 1);
+	if(size < 0)
+		return EEL_XLOWVALUE;
+	mode = vm->argc >= 3 ? eel_v2l(args + 2) : EDSP_RS_LINEAR;
+	if((mode != EDSP_RS_LINEAR) && (mode != EDSP_RS_CUBIC))
+		return EEL_XBADVALUE;
+	x = blk_output(vm, vm->argc >= 4 ? args + 3 : NULL, io->classid,
+			size, &oo);
+	if(x)
+		return x;
+	if(oo == io)
+	{
+		eel_o_disown_nz(oo);
+		return EEL_XBADCONTEXT;
+	}
+	isf = io->classid == EEL_CVECTOR_F;
+	step = size ? (double)iv->length / size : 0.0f;
+	for(i = 0; i < size; i += c)
+	{
+		double *out = blk_dst(oo, i, buf);
+		int j;
+		c = size - i < EEL_VK_CHUNK ? size - i : EEL_VK_CHUNK;
+		for(j = 0; j < c; ++j)
+		{
+			double p = (i + j) * step;
+			int k = floor(p);
+			double t = p - k;
+			double x1 = rs_get(iv, isf, k);
+			double x2 = rs_get(iv, isf, k + 1);
+			if(mode == EDSP_RS_LINEAR)
+				out[j] = x1 + (x2 - x1) * t;
+			else
+			{
+				/* Catmull-Rom spline */
+				double x0 = rs_get(iv, isf, k - 1);
+				double x3 = rs_get(iv, isf, k + 2);
+				out[j] = x1 + 0.5f * t * (x2 - x0 + t *
+						(2.0f * x0 - 5.0f * x1 +
+						4.0f * x2 - x3 + t *
+						(3.0f * (x1 - x2) + x3 - x0)));
+			}
+		}
+		blk_out(oo, i, c, buf);
+	}
+	eel_o2v(vm->heap + vm->resv, oo);
+	return 0;
+}
+
+
+/*
+ * Multiply 'n' samples in 'buf' by a gain ramp from 'g0' to 'g1', where
+ * 'g1' is reached one sample past the end of the ramp, which starts at
+ * sample 'start' of 'total'.
+ */
+static inline void blk_ramp(double *buf, int n, double g0, double g1,
+		int start, int total)
+{
+	double dg = (g1 - g0) / total;
+	int i;
+	if(g0 == g1)
+	{
+		eel_vk->vs[EEL_VK_MUL][EEL_VK_D](buf, buf, g0, n);
+		return;
+	}
+	for(i = 0; i < n; ++i)
+		buf[i] *= g0 + dg * (start + i);
+}
+
+
+// procedure gain(v, g)[g1];
+static EEL_xno dsp_gain(EEL_vm *vm)
+{
+	EEL_value *args = vm->heap + vm->argv;
+	double buf[EEL_VK_CHUNK];
+	EEL_object *vo;
+	double g0, g1;
+	int len, i, c;
+	if(!is_fftvector(EEL_CLASS(args)))
+		return EEL_XWRONGTYPE;
+	vo = eel_v2o(args);
+	len = o2EEL_vector(vo)->length;
+	g0 = eel_v2d(args + 1);
+	g1 = vm->argc >= 3 ? eel_v2d(args + 2) : g0;
+	for(i = 0; i < len; i += c)
+	{
+		double *d;
+		c = len - i < EEL_VK_CHUNK ? len - i : EEL_VK_CHUNK;
+		d = (double *)blk_in(vo, i, c, buf);
+		blk_ramp(d, c, g0, g1, i, len);
+		blk_out(vo, i, c, buf);
+	}
+	return 0;
+}
+
+
+// procedure mix(dst, src, g)[g1];
+static EEL_xno dsp_mix(EEL_vm *vm)
+{
+	EEL_value *args = vm->heap + vm->argv;
+	double sbuf[EEL_VK_CHUNK], dbuf[EEL_VK_CHUNK];
+	EEL_object *dobj, *so;
+	double g0, g1;
+	int len, i, c;
+	if(!is_fftvector(EEL_CLASS(args)) || !is_fftvector(EEL_CLASS(args + 1)))
+		return EEL_XWRONGTYPE;
+	dobj = eel_v2o(args);
+	so = eel_v2o(args + 1);
+	len = o2EEL_vector(dobj)->length;
+	if(o2EEL_vector(so)->length < len)
+		len = o2EEL_vector(so)->length;
+	g0 = eel_v2d(args + 2);
+	g1 = vm->argc >= 4 ? eel_v2d(args + 3) : g0;
+	for(i = 0; i < len; i += c)
+	{
+		double *d;
+		c = len - i < EEL_VK_CHUNK ? len - i : EEL_VK_CHUNK;
+		if(so->classid == EEL_CVECTOR_D)
+			memcpy(sbuf, o2EEL_vector(so)->buffer.d + i,
+					c * sizeof(double));
+		else
+			eel_vk->f2d(sbuf, o2EEL_vector(so)->buffer.f + i, c);
+		blk_ramp(sbuf, c, g0, g1, i, len);
+		d = (double *)blk_in(dobj, i, c, dbuf);
+		eel_vk->vv[EEL_VK_ADD][EEL_VK_D](d, d, sbuf, c);
+		blk_out(dobj, i, c, dbuf);
+	}
+	return 0;
+}
+
+
+static const EEL_lconstexp dsp_constants[] =
+{
+	/* Biquad filter types */
+	{"BQ_LOWPASS",		EDSP_BQ_LOWPASS		},
+	{"BQ_HIGHPASS",		EDSP_BQ_HIGHPASS	},
+	{"BQ_BANDPASS",		EDSP_BQ_BANDPASS	},
+	{"BQ_NOTCH",		EDSP_BQ_NOTCH		},
+	{"BQ_ALLPASS",		EDSP_BQ_ALLPASS		},
+	{"BQ_PEAK",		EDSP_BQ_PEAK		},
+	{"BQ_LOWSHELF",		EDSP_BQ_LOWSHELF	},
+	{"BQ_HIGHSHELF",	EDSP_BQ_HIGHSHELF	},
+
+	/* FIR filter modes */
+	{"FIR_AUTO",		EDSP_FIR_AUTO		},
+	{"FIR_DIRECT",		EDSP_FIR_DIRECT		},
+	{"FIR_FFT",		EDSP_FIR_FFT		},
+
+	/* Window functions */
+	{"WIN_RECTANGULAR",	EDSP_WIN_RECTANGULAR	},
+	{"WIN_TRIANGULAR",	EDSP_WIN_TRIANGULAR	},
+	{"WIN_HANN",		EDSP_WIN_HANN		},
+	{"WIN_HAMMING",		EDSP_WIN_HAMMING	},
+	{"WIN_BLACKMAN",	EDSP_WIN_BLACKMAN	},
+	{"WIN_BLACKMAN_HARRIS",	EDSP_WIN_BLACKMAN_HARRIS},
+
+	/* Resampling modes */
+	{"RS_LINEAR",		EDSP_RS_LINEAR		},
+	{"RS_CUBIC",		EDSP_RS_CUBIC		},
+
+	{NULL,	0}
+};
+
+
 /*-------------------------------------------------------------------
 	Generators
 -------------------------------------------------------------------*/
@@ -783,6 +1849,7 @@ static EEL_xno dsp_unload(EEL_object *m, int closing)
 {
 	kfc_cleanup();
 	kiss_fft_cleanup();
+	dsp_free_scratch();
 	if(closing)
 		return 0;
 	else
@@ -792,10 +1859,7 @@ static EEL_xno dsp_unload(EEL_object *m, int closing)
 
 EEL_xno eel_dsp_init(EEL_vm *vm)
 {
-	EEL_object *m;
-#if 0
-	EEL_object *c;
-#endif
+	EEL_object *m, *c;
 
 	/* Create module */
 	m = eel_create_module(vm, "dsp", dsp_unload, NULL);
@@ -815,13 +1879,21 @@ EEL_xno eel_dsp_init(EEL_vm *vm)
 			dsp_add_polynomial_i);
 
 	/* FFT */
-	eel_export_cfunction(m, 1, "fft", 1, 0, 0, dsp_fft);
-	eel_export_cfunction(m, 1, "ifft", 1, 0, 0, dsp_ifft);
+	eel_export_cfunction(m, 1, "fft", 1, 1, 0, dsp_fft);
+	eel_export_cfunction(m, 1, "ifft", 1, 1, 0, dsp_ifft);
 	eel_export_cfunction(m, 1, "fft_real", 1, 0, 0, dsp_fft_real);
 	eel_export_cfunction(m, 1, "ifft_real", 1, 0, 0, dsp_ifft_real);
 	eel_export_cfunction(m, 0, "fft_cleanup", 0, 0, 0,
 			dsp_fft_cleanup);
 
+	/* FFT plans */
+	c = eel_export_class(m, "fftplan", -1, plan_construct, plan_destruct,
+			NULL);
+	eel_set_metamethod(c, EEL_MM_LENGTH, plan_length);
+	dsp_fftplan_cid = eel_class_cid(c);
+	eel_export_cfunction(m, 1, "fft_run", 2, 1, 0, dsp_fft_run);
+	eel_export_cfunction(m, 1, "fft_batch", 2, 1, 0, dsp_fft_batch);
+
 	/* FFT/complex number vector tools */
 	eel_export_cfunction(m, 1, "c_abs", 2, 0, 0, dsp_c_abs);
 	eel_export_cfunction(m, 1, "c_arg", 2, 0, 0, dsp_c_arg);
@@ -832,6 +1904,31 @@ EEL_xno eel_dsp_init(EEL_vm *vm)
 	eel_export_cfunction(m, 0, "c_add_i", 4, 0, 0, dsp_c_add_i);
 	eel_export_cfunction(m, 0, "c_add_polar_i", 4, 0, 0, dsp_c_add_polar_i);
 
+	/* Biquad filters */
+	c = eel_export_class(m, "biquad", -1, bq_construct, bq_destruct, NULL);
+	eel_set_metamethod(c, EEL_MM_LENGTH, bq_length);
+	dsp_biquad_cid = eel_class_cid(c);
+	eel_export_cfunction(m, 0, "biquad_set", 7, 0, 0, dsp_biquad_set);
+	eel_export_cfunction(m, 0, "biquad_design", 5, 1, 0,
+			dsp_biquad_design);
+	eel_export_cfunction(m, 0, "biquad_reset", 1, 0, 0, dsp_biquad_reset);
+	eel_export_cfunction(m, 1, "biquad_run", 2, 1, 0, dsp_biquad_run);
+
+	/* FIR filters */
+	c = eel_export_class(m, "fir", -1, fir_construct, fir_destruct, NULL);
+	eel_set_metamethod(c, EEL_MM_LENGTH, fir_length);
+	dsp_fir_cid = eel_class_cid(c);
+	eel_export_cfunction(m, 0, "fir_reset", 1, 0, 0, dsp_fir_reset);
+	eel_export_cfunction(m, 1, "fir_run", 2, 1, 0, dsp_fir_run);
+
+	/* Windows, resampling and mixing */
+	eel_export_cfunction(m, 1, "window", 2, 1, 0, dsp_window);
+	eel_export_cfunction(m, 1, "resample", 2, 2, 0, dsp_resample);
+	eel_export_cfunction(m, 0, "gain", 2, 1, 0, dsp_gain);
+	eel_export_cfunction(m, 0, "mix", 3, 1, 0, dsp_mix);
+
+	eel_export_lconstants(m, dsp_constants);
+
 #if 0
 	/* Register class 'generator' */
 	c = eel_export_class(m, "generator", -1, gen_construct, gen_destruct, NULL);
@@ -8,6 +8,76 @@
 #define EEL_DSP_H
 
 #include "EEL.h"
+#include "kiss_fft.h"
+#include "kiss_fftr.h"
+
+/*
+ * FFT plan
+ */
+typedef struct
+{
+	int		nfft;		/* Size, in complex values */
+	int		inverse;
+	kiss_fft_cfg	cfg;
+	kiss_fft_cpx	*work;		/* 2 * nfft values of scratch space */
+} EDSP_fftplan;
+EEL_MAKE_CAST(EDSP_fftplan)
+
+/*
+ * Biquad filter cascade
+ */
+typedef enum
+{
+	EDSP_BQ_LOWPASS = 0,
+	EDSP_BQ_HIGHPASS,
+	EDSP_BQ_BANDPASS,
+	EDSP_BQ_NOTCH,
+	EDSP_BQ_ALLPASS,
+	EDSP_BQ_PEAK,
+	EDSP_BQ_LOWSHELF,
+	EDSP_BQ_HIGHSHELF
+} EDSP_bqtypes;
+
+typedef struct
+{
+	double		b0, b1, b2, a1, a2;	/* Normalized; a0 == 1 */
+	double		s1, s2;		/* State; transposed direct form II */
+} EDSP_bqsection;
+
+typedef struct
+{
+	int		nsections;
+	EDSP_bqsection	*sections;
+} EDSP_biquad;
+EEL_MAKE_CAST(EDSP_biquad)
+
+/*
+ * FIR filter
+ */
+typedef enum
+{
+	EDSP_FIR_AUTO = 0,	/* FFT for more than EDSP_FIR_FFTTAPS taps */
+	EDSP_FIR_DIRECT,
+	EDSP_FIR_FFT
+} EDSP_firmodes;
+
+#define	EDSP_FIR_FFTTAPS	64
+
+typedef struct
+{
+	int		ntaps;
+	double		*taps;
+	/* Direct convolution */
+	double		*history;	/* ntaps - 1 + EEL_VK_CHUNK inputs */
+	/* FFT overlap-add; nfft == 0 for direct convolution */
+	int		nfft;
+	kiss_fftr_cfg	fwd, inv;
+	kiss_fft_cpx	*h;		/* Scaled spectrum of taps */
+	kiss_fft_cpx	*spec;		/* nfft / 2 + 1 bins of work space */
+	double		*work;		/* nfft samples of work space */
+	double		*acc;		/* nfft samples of overlap */
+} EDSP_fir;
+EEL_MAKE_CAST(EDSP_fir)
 
 /*
  * Generator
@@ -36,22 +36,25 @@ POSSIBILITY OF SUCH DAMAGE.
 /*
 TODO:
 	* Merge cached_fft and cached_fftr into one polymorphic struct.
-
-	* Remove the 'inverse' field and use separate caches instead,
-	  for quicker lookups.
 */
 
+/*
+ * Plans are kept in small hash tables, with separate tables for forward and
+ * inverse transforms. Hits are moved to the front of their chains.
+ */
+#define KFC_HASHSIZE	32
+#define KFC_HASH(nfft)	((unsigned)(nfft) * 2654435761u >> 27)
+
 typedef struct cached_fft cached_fft;
 
 struct cached_fft
 {
     int nfft;
-    int inverse;
     kiss_fft_cfg cfg;
     cached_fft *next;
 };
 
-static cached_fft *cache_root = NULL;
+static cached_fft *cache_root[2][KFC_HASHSIZE];
 static int ncached=0;
 
 
@@ -60,43 +63,44 @@ typedef struct cached_fftr cached_fftr;
 struct cached_fftr
 {
     int nfft;
-    int inverse;
     kiss_fftr_cfg cfg;
     cached_fftr *next;
 };
 
-static cached_fftr *r_cache_root = NULL;
+static cached_fftr *r_cache_root[2][KFC_HASHSIZE];
 static int r_ncached=0;
 
 
 static kiss_fft_cfg find_cached_fft(int nfft,int inverse)
 {
     size_t len = 0;
-    cached_fft *cur = cache_root;
+    cached_fft **root = &cache_root[inverse != 0][KFC_HASH(nfft)];
+    cached_fft *cur = *root;
     cached_fft *prev = NULL;
     while ( cur ) {
-        if ( cur->nfft == nfft && inverse == cur->inverse )
-            break;/*found the right node*/
+        if ( cur->nfft == nfft ) {
+            /*found the right node*/
+            if ( prev ) {
+                prev->next = cur->next;
+                cur->next = *root;
+                *root = cur;
+            }
+            return cur->cfg;
+        }
         prev = cur;
         cur = prev->next;
     }
-    if (cur== NULL) {
-        /* no cached node found, need to create a new one*/
-        kiss_fft_alloc(nfft,inverse,0,&len);
-        cur = (cached_fft *)KISS_FFT_MALLOC((sizeof(struct cached_fft) + len ));
-        if (cur == NULL)
-            return NULL;
-        cur->cfg = (kiss_fft_cfg)(cur+1);
-        kiss_fft_alloc(nfft,inverse,cur->cfg,&len);
-        cur->nfft=nfft;
-        cur->inverse=inverse;
-        cur->next = NULL;
-        if ( prev )
-            prev->next = cur;
-        else
-            cache_root = cur;
-        ++ncached;
-    }
+    /* no cached node found, need to create a new one*/
+    kiss_fft_alloc(nfft,inverse,0,&len);
+    cur = (cached_fft *)KISS_FFT_MALLOC((sizeof(struct cached_fft) + len ));
+    if (cur == NULL)
+        return NULL;
+    cur->cfg = (kiss_fft_cfg)(cur+1);
+    kiss_fft_alloc(nfft,inverse,cur->cfg,&len);
+    cur->nfft=nfft;
+    cur->next = *root;
+    *root = cur;
+    ++ncached;
     return cur->cfg;
 }
 
@@ -104,58 +108,66 @@ static kiss_fft_cfg find_cached_fft(int nfft,int inverse)
 static kiss_fftr_cfg find_cached_fftr(int nfft,int inverse)
 {
     size_t len = 0;
-    cached_fftr *cur = r_cache_root;
+    cached_fftr **root = &r_cache_root[inverse != 0][KFC_HASH(nfft)];
+    cached_fftr *cur = *root;
     cached_fftr *prev = NULL;
     while ( cur ) {
-        if ( cur->nfft == nfft && inverse == cur->inverse )
-            break;/*found the right node*/
+        if ( cur->nfft == nfft ) {
+            /*found the right node*/
+            if ( prev ) {
+                prev->next = cur->next;
+                cur->next = *root;
+                *root = cur;
+            }
+            return cur->cfg;
+        }
         prev = cur;
         cur = prev->next;
     }
-    if (cur== NULL) {
-        /* no cached node found, need to create a new one*/
-        kiss_fftr_alloc(nfft,inverse,0,&len);
-        cur = (cached_fftr *)KISS_FFT_MALLOC((sizeof(struct cached_fftr) + len ));
-        if (cur == NULL)
-            return NULL;
-        cur->cfg = (kiss_fftr_cfg)(cur+1);
-        kiss_fftr_alloc(nfft,inverse,cur->cfg,&len);
-        cur->nfft=nfft;
-        cur->inverse=inverse;
-        cur->next = NULL;
-        if ( prev )
-            prev->next = cur;
-        else
-            r_cache_root = cur;
-        ++ncached;
-    }
+    /* no cached node found, need to create a new one*/
+    kiss_fftr_alloc(nfft,inverse,0,&len);
+    cur = (cached_fftr *)KISS_FFT_MALLOC((sizeof(struct cached_fftr) + len ));
+    if (cur == NULL)
+        return NULL;
+    cur->cfg = (kiss_fftr_cfg)(cur+1);
+    kiss_fftr_alloc(nfft,inverse,cur->cfg,&len);
+    cur->nfft=nfft;
+    cur->next = *root;
+    *root = cur;
+    ++r_ncached;
     return cur->cfg;
 }
 
 
 void kfc_cleanup(void)
 {
-    cached_fft *cur = cache_root;
-    cached_fft *next = NULL;
-
-    cached_fftr *r_cur = r_cache_root;
-    cached_fftr *r_next = NULL;
-
-    while (cur){
-        next = cur->next;
-        free(cur);
-        cur=next;
+    int i, h;
+    for (i=0;i<2;++i) {
+        for (h=0;h<KFC_HASHSIZE;++h) {
+            cached_fft *cur = cache_root[i][h];
+            cached_fftr *r_cur = r_cache_root[i][h];
+            while (cur){
+                cached_fft *next = cur->next;
+                free(cur);
+                cur=next;
+            }
+            cache_root[i][h] = NULL;
+            while (r_cur){
+                cached_fftr *r_next = r_cur->next;
+                free(r_cur);
+                r_cur=r_next;
+            }
+            r_cache_root[i][h] = NULL;
+        }
     }
     ncached=0;
-    cache_root = NULL;
-
-    while (r_cur){
-        r_next = r_cur->next;
-        free(r_cur);
-        r_cur=r_next;
-    }
     r_ncached=0;
-    r_cache_root = NULL;
+}
+
+
+kiss_fft_cfg kfc_plan(int nfft, int inverse)
+{
+    return find_cached_fft(nfft,inverse);
 }
 
 
@@ -20,11 +20,8 @@ object is created for it.  All subsequent calls use the cached
 configuration object.
 
 NOTE:
-You should probably not use this if your program will be using a lot 
-of various sizes of FFTs.  There is a linear search through the
-cached objects.  If you are only using one or two FFT sizes, this
-will be negligible. Otherwise, you may want to use another method 
-of managing the cfg objects.
+The cached objects are found through small hash tables, so using many
+different sizes is fine, as far as lookups are concerned.
  
  There is no automated cleanup of the cached objects.  This could lead 
 to large memory usage in a program that uses a lot of *DIFFERENT* 
@@ -43,6 +40,13 @@ void kfc_fftr(int nfft, const kiss_fft_scalar *timedata, kiss_fft_cpx *fout);
 /*reverse real FFT */
 void kfc_ifftr(int nfft, const kiss_fft_cpx *fin, kiss_fft_scalar *timedata);
 
+/*
+get the cached cfg object for a complex FFT, for use with kiss_fft() and
+kiss_fft_stride(). It remains valid until kfc_cleanup is called. Returns NULL
+if the cfg could not be allocated.
+*/
+kiss_fft_cfg kfc_plan(int nfft, int inverse);
+
 /*free all cached objects*/
 void kfc_cleanup(void);
 
@@ -38,7 +38,7 @@ static inline int a_setsize(EEL_object *eo, int newsize)
 	int n = eel_calcresize(EEL_ARRAY_SIZEBASE, a->maxlength, newsize);
 	if(n == a->maxlength)
 		return 0;
-	nv = eel_realloc(eo->vm, a->values, n * sizeof(EEL_value));
+	nv = eel_mp_realloc(eo->vm, a->values, n * sizeof(EEL_value));
 	if(!nv)
 	{
 		if(newsize)
@@ -74,7 +74,7 @@ static EEL_xno a_construct(EEL_vm *vm, EEL_classes cid,
 	if(!initc)
 	{
 		/* Empty array! */
-		a->values = eel_malloc(vm, EEL_ARRAY_SIZEBASE * sizeof(EEL_value));
+		a->values = eel_mp_alloc(vm, EEL_ARRAY_SIZEBASE * sizeof(EEL_value));
 		if(!a->values)
 		{
 			eel_o_free(eo);
@@ -85,7 +85,7 @@ static EEL_xno a_construct(EEL_vm *vm, EEL_classes cid,
 		eel_o2v(result, eo);
 		return 0;
 	}
-	a->values = eel_malloc(vm, initc * sizeof(EEL_value));
+	a->values = eel_mp_alloc(vm, initc * sizeof(EEL_value));
 	if(!a->values)
 	{
 		eel_o_free(eo);
@@ -108,7 +108,7 @@ FIXME: If there are "many" items, any objects should be sent off to incremental
 */
 	for(i = 0; i < a->length; ++i)
 		eel_v_disown_nz(&a->values[i]);
-	eel_free(eo->vm, a->values);
+	eel_mp_free(eo->vm, a->values);
 	return 0;
 }
 
@@ -269,7 +269,7 @@ static inline EEL_object *a__clone(EEL_object *orig)
 	if(!clone)
 		return NULL;
 	clonea = o2EEL_array(clone);
-	clonea->values = (EEL_value *)eel_malloc(vm,
+	clonea->values = (EEL_value *)eel_mp_alloc(vm,
 			origa->length * sizeof(EEL_value));
 	if(!clonea->values)
 	{
@@ -344,7 +344,7 @@ static EEL_xno a_copy(EEL_object *eo, EEL_value *op1, EEL_value *op2)
 	if(!so)
 		return EEL_XCONSTRUCTOR;
 	sa = o2EEL_array(so);
-	sa->values = eel_malloc(vm, length * sizeof(EEL_value));
+	sa->values = eel_mp_alloc(vm, length * sizeof(EEL_value));
 	if(!sa->values)
 	{
 		eel_o_free(so);
@@ -27,9 +27,11 @@
 #include "EEL.h"
 #include "EEL_types.h"
 #include "e_config.h"
+#include "e_cycle.h"
 
 typedef struct
 {
+	EEL_ccnode	cc;		/* MUST be first! */
 	int		length;		/* # of items */
 	int		maxlength;	/* Buffer size */
 	EEL_value	*values;
@@ -36,11 +36,14 @@
 #include <errno.h>
 #include "e_builtin.h"
 #include "ec_symtab.h"
+#include "ec_bytecode.h"
+#include "ec_coder.h"
 #include "e_util.h"
 #include "e_string.h"
 #include "e_dstring.h"
 #include "e_object.h"
 #include "e_class.h"
+#include "e_vkernel.h"
 #include "e_state.h"
 #include "e_builtin.h"
 #include "e_function.h"
@@ -255,6 +258,19 @@ static EEL_xno bi__compile(EEL_vm *vm)
 }
 
 
+static EEL_xno bi_dump_module(EEL_vm *vm)
+{
+	EEL_value *args = vm->heap + vm->argv;
+	EEL_object *d;
+	if(EEL_CLASS(args + 0) != EEL_CMODULE)
+		return EEL_XNEEDMODULE;
+	if(!(d = eel_bc_dump(args[0].objref.v)))
+		return EEL_XNOTIMPLEMENTED;
+	eel_o2v(vm->heap + vm->resv, d);
+	return 0;
+}
+
+
 static EEL_xno bi__exports(EEL_vm *vm)
 {
 	EEL_value *arg = vm->heap + vm->argv;
@@ -376,12 +392,223 @@ static EEL_xno bi_getis(EEL_vm *vm)
 #if DBG6B(1)+0 == 1
 	vm->heap[vm->resv].integer.v = VMP->instructions;
 #else
-	vm->heap[vm->resv].integer.v = 0;
+	vm->heap[vm->resv].integer.v = eel_vm_icount(vm);
 #endif
 	return 0;
 }
 
 
+static EEL_xno bi_string_pool_stats(EEL_vm *vm)
+{
+	EEL_psstats st;
+	EEL_value v;
+	EEL_xno x;
+	EEL_lconstexp items[] = {
+		{ "strings",		0 },
+		{ "buckets",		0 },
+		{ "longest_chain",	0 },
+		{ "migrating",		0 },
+		{ "hits",		0 },
+		{ "misses",		0 },
+		{ "cache_size",		0 },
+		{ "cache_max",		0 },
+		{ "cache_hits",		0 },
+		{ NULL, 0 }
+	};
+	eel_ps_stats(vm, &st);
+	items[0].value = st.strings;
+	items[1].value = st.buckets;
+	items[2].value = st.longest;
+	items[3].value = st.migrating;
+	items[4].value = st.hits;
+	items[5].value = st.misses;
+	items[6].value = st.cache_size;
+	items[7].value = st.cache_max;
+	items[8].value = st.cache_hits;
+	if((x = eel_o_construct(vm, EEL_CTABLE, NULL, 0, &v)))
+		return x;
+	if((x = eel_insert_lconstants(v.objref.v, items)))
+	{
+		eel_v_disown(&v);
+		return x;
+	}
+	eel_v_move(vm->heap + vm->resv, &v);
+	return 0;
+}
+
+
+static EEL_xno bi_collect_cycles(EEL_vm *vm)
+{
+	int budget = -1;
+	if(vm->argc >= 1)
+		budget = eel_v2d(vm->heap + vm->argv) * 1000.0f;
+	vm->heap[vm->resv].classid = EEL_CINTEGER;
+	vm->heap[vm->resv].integer.v = eel_collect_cycles(vm, budget);
+	return 0;
+}
+
+
+static EEL_xno bi_cycle_collector_stats(EEL_vm *vm)
+{
+	EEL_ccstats st;
+	EEL_value v;
+	EEL_xno x;
+	EEL_lconstexp items[] = {
+		{ "roots",	0 },
+		{ "runs",	0 },
+		{ "visited",	0 },
+		{ "collected",	0 },
+		{ "modules",	0 },
+		{ "deferred",	0 },
+		{ NULL, 0 }
+	};
+	eel_cc_stats(vm, &st);
+	items[0].value = st.roots;
+	items[1].value = st.runs;
+	items[2].value = st.visited;
+	items[3].value = st.collected;
+	items[4].value = st.modules;
+	items[5].value = st.deferred;
+	if((x = eel_o_construct(vm, EEL_CTABLE, NULL, 0, &v)))
+		return x;
+	if((x = eel_insert_lconstants(v.objref.v, items)))
+	{
+		eel_v_disown(&v);
+		return x;
+	}
+	eel_v_move(vm->heap + vm->resv, &v);
+	return 0;
+}
+
+
+static EEL_xno bi_trim_memory_pools(EEL_vm *vm)
+{
+	vm->heap[vm->resv].classid = EEL_CINTEGER;
+	vm->heap[vm->resv].integer.v = eel_trim_pools(vm);
+	return 0;
+}
+
+
+static EEL_xno bi_memory_pool_stats(EEL_vm *vm)
+{
+	EEL_mpstats st;
+	EEL_value v;
+	EEL_xno x;
+	EEL_lconstexp items[] = {
+		{ "slabs",	0 },
+		{ "blocks",	0 },
+		{ "large",	0 },
+		{ "hits",	0 },
+		{ "misses",	0 },
+		{ "trimmed",	0 },
+		{ NULL, 0 }
+	};
+	eel_mp_stats(vm, &st);
+	items[0].value = st.slabs;
+	items[1].value = st.blocks;
+	items[2].value = st.large;
+	items[3].value = st.hits;
+	items[4].value = st.misses;
+	items[5].value = st.trimmed;
+	if((x = eel_o_construct(vm, EEL_CTABLE, NULL, 0, &v)))
+		return x;
+	if((x = eel_insert_lconstants(v.objref.v, items)))
+	{
+		eel_v_disown(&v);
+		return x;
+	}
+	eel_v_move(vm->heap + vm->resv, &v);
+	return 0;
+}
+
+
+static EEL_xno bi_inline_cache_stats(EEL_vm *vm)
+{
+	EEL_value *args = vm->heap + vm->argv;
+	EEL_function *f;
+	EEL_value v;
+	EEL_xno x;
+	EEL_lconstexp items[] = {
+		{ "sites",	0 },
+		{ "hits",	0 },
+		{ "misses",	0 },
+		{ NULL, 0 }
+	};
+	if(EEL_CLASS(args) != EEL_CFUNCTION)
+		return EEL_XWRONGTYPE;
+	f = o2EEL_function(args->objref.v);
+	if(f->common.flags & EEL_FF_CFUNC)
+		return EEL_XWRONGTYPE;
+	items[0].value = f->e.nicaches;
+	items[1].value = f->e.ichits;
+	items[2].value = f->e.icmisses;
+	if((x = eel_o_construct(vm, EEL_CTABLE, NULL, 0, &v)))
+		return x;
+	if((x = eel_insert_lconstants(v.objref.v, items)))
+	{
+		eel_v_disown(&v);
+		return x;
+	}
+	eel_v_move(vm->heap + vm->resv, &v);
+	return 0;
+}
+
+
+static EEL_xno bi_quickening_stats(EEL_vm *vm)
+{
+	EEL_value *args = vm->heap + vm->argv;
+	EEL_function *f;
+	EEL_value v;
+	EEL_xno x;
+	int pc;
+	EEL_lconstexp items[] = {
+		{ "specialized",	0 },
+		{ "quickens",		0 },
+		{ "dequickens",		0 },
+		{ NULL, 0 }
+	};
+	if(EEL_CLASS(args) != EEL_CFUNCTION)
+		return EEL_XWRONGTYPE;
+	f = o2EEL_function(args->objref.v);
+	if(f->common.flags & EEL_FF_CFUNC)
+		return EEL_XWRONGTYPE;
+	for(pc = 0; pc < f->e.codesize; pc += eel_i_size(f->e.code[pc]))
+		if(eel_i_generic(f->e.code[pc]) != f->e.code[pc])
+			++items[0].value;
+	items[1].value = f->e.quickens;
+	items[2].value = f->e.dequickens;
+	if((x = eel_o_construct(vm, EEL_CTABLE, NULL, 0, &v)))
+		return x;
+	if((x = eel_insert_lconstants(v.objref.v, items)))
+	{
+		eel_v_disown(&v);
+		return x;
+	}
+	eel_v_move(vm->heap + vm->resv, &v);
+	return 0;
+}
+
+
+static EEL_xno bi_vector_kernels(EEL_vm *vm)
+{
+	EEL_object *s;
+	if(vm->argc >= 1)
+	{
+		const char *name = eel_v2s(vm->heap + vm->argv);
+		if(!name)
+			return EEL_XNEEDSTRING;
+		if(eel_vk_select(name) < 0)
+			return EEL_XNOTIMPLEMENTED;
+	}
+	s = eel_ps_new(vm, eel_vk->name);
+	if(!s)
+		return EEL_XCONSTRUCTOR;
+	vm->heap[vm->resv].classid = EEL_COBJREF;
+	vm->heap[vm->resv].objref.v = s;
+	return 0;
+}
+
+
 static EEL_xno bi_getmt(EEL_vm *vm)
 {
 	vm->heap[vm->resv].classid = EEL_COBJREF;
@@ -544,6 +771,34 @@ static EEL_xno bi_copy(EEL_vm *vm)
 }
 
 
+static EEL_xno bi_slice(EEL_vm *vm)
+{
+	EEL_xno x;
+	EEL_object *o;
+	EEL_value start;
+	EEL_value len;
+	EEL_value *args = vm->heap + vm->argv;
+	if(!EEL_IS_OBJREF(args->classid))
+		return EEL_XNEEDOBJECT;
+	o = args->objref.v;
+	eel_l2v(&start, vm->argc >= 2 ? eel_v2l(args + 1) : 0);
+	if(vm->argc >= 3)
+		eel_l2v(&len, eel_v2l(args + 2));
+	else
+	{
+		x = eel_o__metamethod(o, EEL_MM_LENGTH, NULL, &len);
+		if(x)
+			return x;
+		len.integer.v -= start.integer.v;
+	}
+	x = eel_o__metamethod(o, EEL_MM_SLICE, &start, &len);
+	if(x)
+		return x;
+	eel_v_move(vm->heap + vm->resv, &len);
+	return x;
+}
+
+
 static EEL_xno bi_index(EEL_vm *vm)
 {
 	EEL_value *args = vm->heap + vm->argv;
@@ -687,6 +942,7 @@ static const EEL_lconstexp bi_constants[] =
 	{ "SF_LISTASM",		EEL_SF_LISTASM		},
 	{ "SF_WERROR",		EEL_SF_WERROR		},
 	{ "SF_NOPRECEDENCE",	EEL_SF_NOPRECEDENCE	},
+	{ "SF_NOOPTIMIZE",	EEL_SF_NOOPTIMIZE	},
 
 	{NULL, 0}
 };
@@ -727,6 +983,22 @@ EEL_xno eel_builtin_init(EEL_vm *vm)
 	eel_export_cfunction(m, 1, "getus", 0, 0, 0, bi_getus);
 	eel_export_cfunction(m, 1, "sleep", 1, 0, 0, bi_sleep);
 	eel_export_cfunction(m, 1, "get_instruction_count", 0, 0, 0, bi_getis);
+	eel_export_cfunction(m, 1, "string_pool_stats", 0, 0, 0,
+			bi_string_pool_stats);
+	eel_export_cfunction(m, 1, "inline_cache_stats", 1, 0, 0,
+			bi_inline_cache_stats);
+	eel_export_cfunction(m, 1, "quickening_stats", 1, 0, 0,
+			bi_quickening_stats);
+	eel_export_cfunction(m, 1, "vector_kernels", 0, 1, 0,
+			bi_vector_kernels);
+	eel_export_cfunction(m, 1, "collect_cycles", 0, 1, 0,
+			bi_collect_cycles);
+	eel_export_cfunction(m, 1, "cycle_collector_stats", 0, 0, 0,
+			bi_cycle_collector_stats);
+	eel_export_cfunction(m, 1, "trim_memory_pools", 0, 0, 0,
+			bi_trim_memory_pools);
+	eel_export_cfunction(m, 1, "memory_pool_stats", 0, 0, 0,
+			bi_memory_pool_stats);
 	eel_export_cfunction(m, 1, "__caller", 0, 0, 0, bi_caller);
 	eel_export_cfunction(m, 1, "system", 1, 0, 0, bi_system);
 
@@ -737,6 +1009,7 @@ EEL_xno eel_builtin_init(EEL_vm *vm)
 	eel_export_cfunction(m, 0, "insert", 3, 0, 0, bi_insert);
 	eel_export_cfunction(m, 0, "delete", 1, 2, 0, bi_delete);
 	eel_export_cfunction(m, 1, "copy", 1, 2, 0, bi_copy);
+	eel_export_cfunction(m, 1, "slice", 1, 2, 0, bi_slice);
 	eel_export_cfunction(m, 1, "index", 2, 0, 0, bi_index);
 	eel_export_cfunction(m, 1, "key", 2, 0, 0, bi_key);
 	eel_export_cfunction(m, 1, "tryindex", 2, 1, 0, bi_tryindex);
@@ -747,6 +1020,7 @@ EEL_xno eel_builtin_init(EEL_vm *vm)
 	eel_export_cfunction(m, 1, "__load_binary_module", 2, 0, 0,
 			bi__load_binary_module);
 	eel_export_cfunction(m, 0, "__compile", 2, 0, 0, bi__compile);
+	eel_export_cfunction(m, 1, "dump_module", 1, 0, 0, bi_dump_module);
 	eel_export_cfunction(m, 1, "__exports", 0, 1, 0, bi__exports);
 	eel_export_cfunction(m, 1, "__modules", 0, 0, 0, bi_getmt);
 	eel_export_cfunction(m, 0, "__clean_modules", 0, 0, 0,
@@ -65,12 +65,32 @@ FIXME: and of suitable types!
  */
 #define	EEL_MINSTACK	32
 
+/*
+ * Green threads. (See threads/eel_threads.h.) Initial heap size of a thread,
+ * and default time slice, in VM instructions.
+ */
+#define	EEL_THREAD_HEAP		64
+#define	EEL_THREAD_SLICE	10000
+
 /* Memory allocation parameters for dynamic sized types. */
 #define	EEL_DSTRING_SIZEBASE	32
 #define	EEL_TABLE_SIZEBASE	4
+#define	EEL_TABLE_INDEXMIN	8	/* Smaller tables are scanned linearly */
 #define	EEL_ARRAY_SIZEBASE	8
 #define	EEL_VECTOR_SIZEBASE	8
 
+/*
+ * Items converted per pass, when doing arithmetic on vectors of different
+ * types. (Uses a stack buffer of this many doubles.)
+ */
+#define	EEL_VK_CHUNK	256
+
+/*
+ * Max operands of a fused vector expression. (The evaluator uses a stack
+ * buffer of this many chunks for intermediate results.)
+ */
+#define	EEL_VEXPR_MAXOPERANDS	8
+
 /*
  * Define to have the '/' operator always generate real type results, Pascal
  * style.
@@ -99,6 +119,50 @@ FIXME: and of suitable types!
 /* Default size of string cache. (Number of string objects.) */
 #define	EEL_DEFAULT_STRING_CACHE 100
 
+/*
+ * Cycle collector. (See e_cycle.h.) A collection step is triggered after
+ * EEL_CC_TRIGGER table/array allocations, and runs for about EEL_CC_BUDGET
+ * microseconds, processing EEL_CC_BATCH roots at a time. Steps that find no
+ * garbage double the interval, up to EEL_CC_BACKOFF times EEL_CC_TRIGGER.
+ * The time is checked every EEL_CC_CHECK container items traced.
+ * Set EEL_CC_TRIGGER to 0 to only collect cycles when explicitly asked to.
+ */
+#define	EEL_CC_TRIGGER	4096
+#define	EEL_CC_BACKOFF	64
+#define	EEL_CC_BUDGET	1000
+#define	EEL_CC_BATCH	256
+#define	EEL_CC_CHECK	1024
+/*
+ * Containers with up to this many items are checked for references to other
+ * containers before being buffered as possible cycle roots.
+ */
+#define	EEL_CC_SCANMAX	8
+
+/*
+ * Memory pools. (See e_mpool.h.) Blocks of up to EEL_MP_MAXSIZE bytes are
+ * allocated from size classes in steps of EEL_MP_GRANULARITY bytes, carved
+ * out of slabs of EEL_MP_SLABSIZE bytes. EEL_MP_GRANULARITY must be a multiple
+ * of 8, and EEL_MP_SLABSIZE must fit at least one block of EEL_MP_MAXSIZE.
+ */
+#define	EEL_MP_GRANULARITY	16
+#define	EEL_MP_MAXSIZE		512
+#define	EEL_MP_SLABSIZE		16384
+
+/*
+ * Initial number of string pool hash buckets. (Must be a power of two!) The
+ * bucket table is doubled whenever there are more strings than buckets. Old
+ * buckets are migrated incrementally, EEL_STRING_POOL_MIGRATE buckets per
+ * pool lookup, to avoid stalling on large pools.
+ */
+#define	EEL_STRING_POOL_SIZE	256
+#define	EEL_STRING_POOL_MIGRATE	4
+
+/*
+ * Compiler symbol tables with at least this many symbols get a hash index on
+ * the symbol names. Smaller tables are scanned linearly.
+ */
+#define	EEL_SYMTAB_INDEXMIN	16
+
 /*
  * Define this to have eel_calcresize() (used for reallocating tables, arrays,
  * vectors etc) back off a little on the shrinking. Use this if realloc() is
@@ -149,6 +213,14 @@ FIXME: and of suitable types!
  */
 #undef	EEL_VM_PROFILING
 
+/*
+ * Enable VM instruction sequence profiling. This has the VM count pairs and
+ * triples of instructions that execute in sequence, without branching in
+ * between, printing the most frequent sequences to stdout when the VM is
+ * closed. These are the candidates for new superinstructions.
+ */
+#undef	EEL_VM_SEQUENCE_PROFILING
+
 /* Keep global count of objects and refcounts. */
 #ifdef DEBUG
 #  define	EEL_OBJECT_ACCOUNTING
@@ -173,6 +245,15 @@ FIXME: and of suitable types!
 /* Substitute recognized instruction sequences with faster equivalents */
 #define	EEL_PEEPHOLE_OPTIMIZER
 
+/* Remove dead registers and renumber temporaries after compiling functions */
+#define	EEL_LIVENESS_OPTIMIZER
+
+/* Inline calls to small EEL functions that just return an expression */
+#define	EEL_INLINE_FUNCTIONS
+
+/* Track and fold the values of local variables initialized from constants */
+#define	EEL_CONSTANT_PROPAGATION
+
 
 /*---------------------------------------------------------
 	Debug output and checking options
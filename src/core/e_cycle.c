@@ -0,0 +1,714 @@
+/*
+---------------------------------------------------------------------------
+	e_cycle.c - EEL Cycle Collector
+---------------------------------------------------------------------------
+ * Copyright 2026 David Olofson
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from the
+ * use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include <time.h>
+#include "e_cycle.h"
+#include "e_object.h"
+#include "e_operate.h"
+#include "e_state.h"
+#include "e_table.h"
+#include "e_array.h"
+#include "e_module.h"
+
+struct EEL_ccstate
+{
+	EEL_object_p_da	roots;		/* Buffered possible roots */
+	int		ndeferred;	/* Deferred roots, first in 'roots' */
+	EEL_object_p_da	batch;		/* Roots being processed */
+	EEL_object_p_da	gray;		/* Nodes processed by mark gray */
+	EEL_object_p_da	stack;		/* Traversal stack */
+	int		allrefs;	/* Count references to non-containers */
+	int		running;
+
+	/* Time budget of the current run */
+	clock_t		start;
+	clock_t		bstart;		/* Start of current batch */
+	int		budget;		/* us, or -1 for no limit */
+	int		work;		/* Items since last time check */
+	int		expired;
+	unsigned	traced;		/* Total items traced */
+
+	/* Node interrupted by the time budget, and items to restore */
+	EEL_object	*partial;
+	int		pfirst, plast;
+
+	EEL_ccstats	stats;
+};
+typedef struct EEL_ccstate EEL_ccstate;
+
+typedef enum
+{
+	CC_MARKGRAY = 0,	/* Subtract reference, gray target */
+	CC_SCANBLACK,		/* Restore reference, blacken target */
+	CC_RESTORE		/* Restore reference only */
+} CC_phases;
+
+
+static EEL_ccstate *cc_open(EEL_vm *vm)
+{
+	EEL_ccstate *cc = (EEL_ccstate *)eel_malloc(vm, sizeof(EEL_ccstate));
+	if(!cc)
+		return NULL;
+	memset(cc, 0, sizeof(EEL_ccstate));
+	VMP->cc = cc;
+	return cc;
+}
+
+
+void eel_cc_close(EEL_vm *vm)
+{
+	EEL_ccstate *cc = VMP->cc;
+	int i;
+	if(!cc)
+		return;
+	for(i = 0; i < cc->roots.size; ++i)
+		o2EEL_ccnode(cc->roots.array[i])->index = 0;
+	eel_free(vm, cc->roots.array);
+	eel_free(vm, cc->batch.array);
+	eel_free(vm, cc->gray.array);
+	eel_free(vm, cc->stack.array);
+	eel_free(vm, cc);
+	VMP->cc = NULL;
+}
+
+
+static inline int cc_is_container(EEL_value *v)
+{
+	return (v->classid == EEL_COBJREF) &&
+			eel_cc_container(v->objref.v->classid);
+}
+
+
+/* Make room for 'n' more items in 'a' */
+static inline int cc_reserve(EEL_vm *vm, EEL_object_p_da *a, int n)
+{
+	int size;
+	if(a->size + n <= a->maxsize)
+		return 0;
+	size = a->maxsize ? a->maxsize : 64;
+	while(size < a->size + n)
+		size *= 2;
+	return eel_objs_setsize(vm, a, size);
+}
+
+
+/*
+ * Returns 1 if 'o' is a small container that holds no references to other
+ * containers. Such a container cannot be part of a garbage cycle yet, and
+ * whatever completes a cycle through it has to release it again afterwards,
+ * so there is no need to buffer it now.
+ */
+static inline int cc_acyclic(EEL_object *o)
+{
+	int i;
+	if(o->classid == EEL_CTABLE)
+	{
+		EEL_table *t = o2EEL_table(o);
+		if(t->length > EEL_CC_SCANMAX)
+			return 0;
+		for(i = 0; i < t->length; ++i)
+			if(cc_is_container(&t->items[i].key) ||
+					cc_is_container(&t->items[i].value))
+				return 0;
+	}
+	else
+	{
+		EEL_array *a = o2EEL_array(o);
+		if(a->length > EEL_CC_SCANMAX)
+			return 0;
+		for(i = 0; i < a->length; ++i)
+			if(cc_is_container(&a->values[i]))
+				return 0;
+	}
+	return 1;
+}
+
+
+void eel_cc_buffer(EEL_object *o)
+{
+	EEL_vm *vm = o->vm;
+	EEL_ccstate *cc = VMP->cc;
+	if(o2EEL_ccnode(o)->index || cc_acyclic(o))
+		return;
+	if(!cc && !(cc = cc_open(vm)))
+		return;
+	if(cc_reserve(vm, &cc->roots, 1) < 0)
+		return;	/* Can't track it. Not fatal; it may just leak. */
+	cc->roots.array[cc->roots.size++] = o;
+	o2EEL_ccnode(o)->index = cc->roots.size;
+}
+
+
+/* Move root 'i' to position 'j' in the root buffer */
+static inline void cc_move_root(EEL_ccstate *cc, int i, int j)
+{
+	EEL_object *o = cc->roots.array[i];
+	cc->roots.array[j] = o;
+	o2EEL_ccnode(o)->index = j + 1;
+}
+
+
+void eel_cc__forget(EEL_object *o)
+{
+	EEL_vm *vm = o->vm;
+	EEL_ccstate *cc = VMP->cc;
+	int i = o2EEL_ccnode(o)->index - 1;
+	/* Keep the deferred roots together at the start of the buffer */
+	if(i < cc->ndeferred)
+	{
+		cc_move_root(cc, --cc->ndeferred, i);
+		i = cc->ndeferred;
+	}
+	if(i < --cc->roots.size)
+		cc_move_root(cc, cc->roots.size, i);
+	o2EEL_ccnode(o)->index = 0;
+}
+
+
+/*
+ * Put root 'o', which must not be buffered, back into the root buffer. If
+ * 'defer' is set, it is only processed by collections without a budget.
+ */
+static void cc_requeue(EEL_vm *vm, EEL_ccstate *cc, EEL_object *o, int defer)
+{
+	if(cc_reserve(vm, &cc->roots, 1) < 0)
+		return;
+	cc->roots.array[cc->roots.size] = o;
+	o2EEL_ccnode(o)->index = ++cc->roots.size;
+	if(defer)
+	{
+		cc_move_root(cc, cc->ndeferred, cc->roots.size - 1);
+		cc->roots.array[cc->ndeferred] = o;
+		o2EEL_ccnode(o)->index = ++cc->ndeferred;
+	}
+}
+
+
+/*----------------------------------------------------------
+	Graph traversal
+----------------------------------------------------------*/
+
+static inline double cc_elapsed(clock_t start)
+{
+	return (clock() - start) * 1000000.0 / CLOCKS_PER_SEC;
+}
+
+
+/* Returns 1 if the time budget of the current run is used up. */
+static int cc_expired(EEL_ccstate *cc)
+{
+	if(!cc->expired && (cc->budget >= 0) &&
+			(cc_elapsed(cc->start) >= cc->budget))
+		cc->expired = 1;
+	return cc->expired;
+}
+
+
+/*
+ * Account for traversing 'n' items, checking the time every EEL_CC_CHECK
+ * items. Returns 1 if the time budget is used up, leaving about as much time
+ * as the current batch has taken so far, for undoing it.
+ */
+static inline int cc_work(EEL_ccstate *cc, int n)
+{
+	cc->traced += n;
+	cc->work += n;
+	if(cc->work < EEL_CC_CHECK)
+		return 0;
+	cc->work = 0;
+	if(!cc->expired && (cc->budget >= 0) && (cc_elapsed(cc->start) +
+			cc_elapsed(cc->bstart) >= cc->budget))
+		cc->expired = 1;
+	return cc->expired;
+}
+
+
+/* Number of items in container 'o'. Table items have up to two edges. */
+static inline int cc_nitems(EEL_object *o)
+{
+	if(o->classid == EEL_CTABLE)
+		return o2EEL_table(o)->length;
+	else
+		return o2EEL_array(o)->length;
+}
+
+
+/* End of the next chunk of at most EEL_CC_CHECK items of 'o', from 'first' */
+static inline int cc_chunk(EEL_object *o, int first)
+{
+	int n = cc_nitems(o);
+	return n - first > EEL_CC_CHECK ? first + EEL_CC_CHECK : n;
+}
+
+
+/*
+ * Process one reference. When pushing onto the stack, the caller has already
+ * reserved the space needed.
+ */
+static inline void cc_edge(EEL_ccstate *cc, EEL_value *v, CC_phases phase)
+{
+	EEL_object *t;
+	EEL_ccnode *n;
+	if(v->classid != EEL_COBJREF)
+		return;		/* Weakrefs don't count! */
+	t = v->objref.v;
+	if(!eel_cc_container(t->classid))
+	{
+		if(cc->allrefs)
+			t->refcount += (phase == CC_MARKGRAY) ? -1 : 1;
+		return;
+	}
+	n = o2EEL_ccnode(t);
+	switch(phase)
+	{
+	  case CC_MARKGRAY:
+		--t->refcount;
+		if(n->color != EEL_CC_GRAY)
+			cc->stack.array[cc->stack.size++] = t;
+		break;
+	  case CC_SCANBLACK:
+		++t->refcount;
+		if(n->color != EEL_CC_BLACK)
+		{
+			n->color = EEL_CC_BLACK;
+			cc->stack.array[cc->stack.size++] = t;
+		}
+		break;
+	  case CC_RESTORE:
+		++t->refcount;
+		break;
+	}
+}
+
+
+/* Process the references from items 'first' through 'last' - 1 of 'o' */
+static void cc_items(EEL_ccstate *cc, EEL_object *o, int first, int last,
+		CC_phases phase)
+{
+	int i;
+	if(o->classid == EEL_CTABLE)
+	{
+		EEL_table *t = o2EEL_table(o);
+		for(i = first; i < last; ++i)
+		{
+			cc_edge(cc, &t->items[i].key, phase);
+			cc_edge(cc, &t->items[i].value, phase);
+		}
+	}
+	else
+	{
+		EEL_array *a = o2EEL_array(o);
+		for(i = first; i < last; ++i)
+			cc_edge(cc, &a->values[i], phase);
+	}
+}
+
+
+static inline void cc_edges(EEL_ccstate *cc, EEL_object *o, CC_phases phase)
+{
+	cc_items(cc, o, 0, cc_nitems(o), phase);
+}
+
+
+/*
+ * Subtract internal references from everything reachable from the nodes on
+ * the stack. Every node that has had the references from it subtracted is
+ * gray, and in the gray list.
+ *
+ * Returns -1 if we run out of memory, or 1 if we run out of time. Everything
+ * is still consistent then, so cc_abort() can restore the refcounts.
+ */
+static int cc_mark_gray(EEL_vm *vm, EEL_ccstate *cc)
+{
+	EEL_object_p_da *s = &cc->stack;
+	while(s->size)
+	{
+		EEL_object *o = s->array[s->size - 1];
+		int i, n;
+		if(o2EEL_ccnode(o)->color == EEL_CC_GRAY)
+		{
+			--s->size;
+			continue;
+		}
+		if(cc_reserve(vm, &cc->gray, 1) < 0)
+			return -1;
+		--s->size;
+		o2EEL_ccnode(o)->color = EEL_CC_GRAY;
+		cc->gray.array[cc->gray.size++] = o;
+		++cc->stats.visited;
+
+		/* Large containers are done in chunks, so we can stop anywhere */
+		n = cc_nitems(o);
+		for(i = 0; i < n; )
+		{
+			int j = cc_chunk(o, i);
+			int res = -1;
+			if(cc_reserve(vm, s, (j - i) * 2) >= 0)
+			{
+				cc_items(cc, o, i, j, CC_MARKGRAY);
+				res = cc_work(cc, j - i + 1);
+				i = j;
+			}
+			if(res)
+			{
+				/* Only the first 'i' items have been subtracted */
+				cc->partial = o;
+				cc->pfirst = 0;
+				cc->plast = i;
+				return res;
+			}
+		}
+	}
+	return 0;
+}
+
+
+/*
+ * Restore the references from the nodes that are still gray, and turn
+ * everything black again. If a node was interrupted by the time budget, only
+ * the items in cc->partial that still need it are restored.
+ */
+static void cc_abort(EEL_ccstate *cc)
+{
+	int i;
+	for(i = 0; i < cc->gray.size; ++i)
+	{
+		EEL_object *o = cc->gray.array[i];
+		if(o2EEL_ccnode(o)->color != EEL_CC_GRAY)
+			continue;
+		o2EEL_ccnode(o)->color = EEL_CC_BLACK;
+		if(o == cc->partial)
+			cc_items(cc, o, cc->pfirst, cc->plast, CC_RESTORE);
+		else
+			cc_edges(cc, o, CC_RESTORE);
+	}
+	cc->partial = NULL;
+	cc->gray.size = 0;
+	cc->stack.size = 0;
+}
+
+
+/*
+ * Restore anything that is referenced from outside the gray set, directly or
+ * indirectly. Whatever is left is garbage, and is turned white.
+ *
+ * Returns -1 if we run out of memory, or 1 if we run out of time. In the
+ * latter case, the black nodes have had their references restored, and the
+ * gray ones have not, except for any restored items of cc->partial, as
+ * cc_abort() expects.
+ */
+static int cc_scan(EEL_vm *vm, EEL_ccstate *cc)
+{
+	EEL_object_p_da *s = &cc->stack;
+	int i;
+	/* Each gray node is pushed at most once here */
+	if(cc_reserve(vm, s, cc->gray.size) < 0)
+		return -1;
+	for(i = 0; i < cc->gray.size; ++i)
+	{
+		EEL_object *o = cc->gray.array[i];
+		if((o2EEL_ccnode(o)->color != EEL_CC_GRAY) || (o->refcount <= 0))
+			continue;
+		o2EEL_ccnode(o)->color = EEL_CC_BLACK;
+		s->array[s->size++] = o;
+		while(s->size)
+		{
+			int k, n;
+			o = s->array[--s->size];
+			n = cc_nitems(o);
+			for(k = 0; k < n; )
+			{
+				int j = cc_chunk(o, k);
+				cc_items(cc, o, k, j, CC_SCANBLACK);
+				if(!cc_work(cc, j - k + 1))
+				{
+					k = j;
+					continue;
+				}
+
+				/* Not restored yet, so they're still gray */
+				while(s->size)
+					o2EEL_ccnode(s->array[--s->size])->color =
+							EEL_CC_GRAY;
+				if(j < n)
+				{
+					o2EEL_ccnode(o)->color = EEL_CC_GRAY;
+					cc->partial = o;
+					cc->pfirst = j;
+					cc->plast = n;
+				}
+				return 1;
+			}
+		}
+	}
+	for(i = 0; i < cc->gray.size; ++i)
+	{
+		EEL_ccnode *n = o2EEL_ccnode(cc->gray.array[i]);
+		if(n->color == EEL_CC_GRAY)
+			n->color = EEL_CC_WHITE;
+	}
+	return 0;
+}
+
+
+/*
+ * Move the white nodes to the start of the gray list, and restore the
+ * references from them. Returns the number of white nodes.
+ */
+static int cc_whites(EEL_ccstate *cc)
+{
+	int i, n = 0;
+	for(i = 0; i < cc->gray.size; ++i)
+	{
+		EEL_object *o = cc->gray.array[i];
+		if(o2EEL_ccnode(o)->color != EEL_CC_WHITE)
+			continue;
+		o2EEL_ccnode(o)->color = EEL_CC_BLACK;
+		cc_edges(cc, o, CC_RESTORE);
+		cc->gray.array[n++] = o;
+	}
+	cc->gray.size = n;
+	return n;
+}
+
+
+/*
+ * Free the white nodes, as found by cc_whites(). We hold on to all of them
+ * while clearing them, so that they can't be destroyed while we're still
+ * working on them.
+ */
+static void cc_free_whites(EEL_ccstate *cc, int n)
+{
+	int i;
+	for(i = 0; i < n; ++i)
+		eel_o_own(cc->gray.array[i]);
+	for(i = 0; i < n; ++i)
+		eel_o__metamethod(cc->gray.array[i], EEL_MM_DELETE,
+				NULL, NULL);
+	for(i = 0; i < n; ++i)
+		eel_o_disown_nz(cc->gray.array[i]);
+	cc->gray.size = 0;
+	cc->stats.collected += n;
+}
+
+
+/*
+ * Process the roots in cc->batch. Returns the number of containers freed.
+ *
+ * If the time budget runs out before the batch is done, the root that had
+ * the most items traced from it is deferred, and the others are put back in
+ * the root buffer, to be tried again by the next step.
+ */
+static int cc_batch(EEL_vm *vm, EEL_ccstate *cc)
+{
+	EEL_object_p_da *b = &cc->batch;
+	int i, n, res = 0, big = 0;
+	unsigned bigsize = 0;
+	cc->bstart = clock();
+	cc->gray.size = cc->stack.size = 0;
+	for(i = 0, n = 0; i < b->size; ++i)
+		if(b->array[i]->refcount > 0)
+			b->array[n++] = b->array[i];
+	b->size = 0;
+
+	/* One root at a time, so we know where the time went */
+	for(i = 0; (i < n) && !res; ++i)
+	{
+		unsigned traced = cc->traced;
+		if(cc_reserve(vm, &cc->stack, 1) < 0)
+		{
+			res = -1;
+			break;
+		}
+		cc->stack.array[cc->stack.size++] = b->array[i];
+		res = cc_mark_gray(vm, cc);
+		if(cc->traced - traced > bigsize)
+		{
+			bigsize = cc->traced - traced;
+			big = i;
+		}
+	}
+	if(!res)
+		res = cc_scan(vm, cc);
+	if(res)
+	{
+		cc_abort(cc);
+		if(res > 0)
+			for(i = 0; i < n; ++i)
+				cc_requeue(vm, cc, b->array[i], i == big);
+		return 0;
+	}
+	n = cc_whites(cc);
+	cc_free_whites(cc, n);
+	return n;
+}
+
+
+/*
+ * Check if the static variables of module 'mo' are what keeps the module
+ * from being unloaded. If they are, release them.
+ *
+ * Returns 1 if the statics were released, otherwise 0.
+ */
+static int cc_module(EEL_vm *vm, EEL_ccstate *cc, EEL_object *mo)
+{
+	EEL_module *m = o2EEL_module(mo);
+	unsigned i;
+	int dead, n;
+	if((m->refsum == (unsigned)-1) || m->unload || !m->nvariables)
+		return 0;
+	if((unsigned)eel_module_countref(mo) == m->refsum)
+		return 0;	/* Not held by anything! */
+
+	cc->allrefs = 1;
+	cc->bstart = clock();
+	cc->gray.size = cc->stack.size = 0;
+	if(cc_reserve(vm, &cc->stack, m->nvariables) < 0)
+	{
+		cc->allrefs = 0;
+		return 0;
+	}
+	for(i = 0; i < m->nvariables; ++i)
+		cc_edge(cc, &m->variables[i], CC_MARKGRAY);
+	if(cc_mark_gray(vm, cc) || cc_scan(vm, cc))
+	{
+		cc_abort(cc);
+		dead = 0;
+	}
+	else
+		dead = ((unsigned)eel_module_countref(mo) == m->refsum);
+	for(i = 0; i < m->nvariables; ++i)
+		cc_edge(cc, &m->variables[i], CC_RESTORE);
+	n = cc_whites(cc);
+	cc->allrefs = 0;
+	if(!dead)
+	{
+		cc->gray.size = 0;
+		return 0;
+	}
+
+	/*
+	 * Nothing can reach the statics anymore, so anything only reachable
+	 * through them is garbage as well.
+	 */
+	cc_free_whites(cc, n);
+	for(i = 0; i < m->nvariables; ++i)
+	{
+		eel_v_disown(&m->variables[i]);
+		m->variables[i].classid = EEL_CNIL;
+	}
+	++cc->stats.modules;
+	return 1;
+}
+
+
+/*----------------------------------------------------------
+	Collection
+----------------------------------------------------------*/
+
+int eel_collect_cycles(EEL_vm *vm, int budget)
+{
+	EEL_state *es = VMP->state;
+	EEL_ccstate *cc = VMP->cc;
+	int freed = 0;
+	if(!cc || cc->running)
+		return 0;
+	++cc->running;
+	++cc->stats.runs;
+	cc->start = clock();
+	cc->budget = budget;
+	cc->work = 0;
+	cc->expired = 0;
+
+	/* Without a budget, deferred roots are handled like any others */
+	if(budget < 0)
+		cc->ndeferred = 0;
+
+	/* Buffered roots, newest first, in batches */
+	while(cc->roots.size > cc->ndeferred)
+	{
+		int n = cc->roots.size - cc->ndeferred;
+		if(n > EEL_CC_BATCH)
+			n = EEL_CC_BATCH;
+		if(cc_reserve(vm, &cc->batch, n) < 0)
+			break;
+		while(n--)
+		{
+			EEL_object *o = cc->roots.array[--cc->roots.size];
+			o2EEL_ccnode(o)->index = 0;
+			cc->batch.array[cc->batch.size++] = o;
+		}
+		freed += cc_batch(vm, cc);
+		if(cc_expired(cc))
+			break;
+	}
+
+	/* Modules held by their own static variables */
+	if(!es->module_lock && !cc_expired(cc))
+	{
+		EEL_object *mo;
+		int released = 0;
+		++es->module_lock;
+		for(mo = es->deadmods; mo && !cc->expired; mo = mo->lnext)
+			released += cc_module(vm, cc, mo);
+		--es->module_lock;
+		if(released)
+			eel_clean_modules(vm);
+	}
+
+	--cc->running;
+	return freed;
+}
+
+
+void eel_cc__step(EEL_vm *vm)
+{
+	EEL_ccstate *cc = VMP->cc;
+	VMP->ccpending = 0;
+	VMP->ccallocs = 0;
+	/*
+	 * Back off while we're not finding any garbage. The buffer only holds
+	 * each container once, so the work per step doesn't grow much.
+	 */
+	if(eel_collect_cycles(vm, EEL_CC_BUDGET))
+		VMP->cctrigger = EEL_CC_TRIGGER;
+	else if(VMP->cctrigger < EEL_CC_TRIGGER * EEL_CC_BACKOFF)
+		VMP->cctrigger *= 2;
+	/* Keep going if we're falling behind */
+	if(cc && (cc->roots.size - cc->ndeferred >= EEL_CC_TRIGGER))
+		VMP->ccpending = 1;
+}
+
+
+void eel_cc_stats(EEL_vm *vm, EEL_ccstats *st)
+{
+	EEL_ccstate *cc = VMP->cc;
+	if(!cc)
+	{
+		memset(st, 0, sizeof(EEL_ccstats));
+		return;
+	}
+	*st = cc->stats;
+	st->roots = cc->roots.size;
+	st->deferred = cc->ndeferred;
+}
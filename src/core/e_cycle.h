@@ -0,0 +1,121 @@
+/*
+---------------------------------------------------------------------------
+	e_cycle.h - EEL Cycle Collector
+---------------------------------------------------------------------------
+ * Copyright 2026 David Olofson
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from the
+ * use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/*
+   Cycle collection
+   ----------------
+	Refcounting cannot reclaim objects that reference each other in a
+	loop, so tables and arrays (the "containers") that have their
+	refcounts decremented to non-zero values are buffered as possible
+	roots of garbage cycles.
+	   The collector does trial deletion (Bacon & Rajan) over the
+	buffered roots, in batches: Internal references are subtracted
+	from the refcounts of everything reachable from the roots (mark
+	gray), anything that still has references from the outside is
+	restored (scan black), and what remains (white) is garbage. The
+	white containers are cleared, which breaks the cycles and lets
+	plain refcounting destroy the objects.
+	   Modules that are refused by the module garbage collector
+	(functions still referenced) are checked the same way, starting
+	from their static variables. If all extra references come from
+	objects only reachable through the statics, the statics are
+	released, and the module can be unloaded.
+	   A collection runs in steps that each finish a number of root
+	batches. Steps are triggered by container allocation volume (see
+	EEL_CC_TRIGGER in e_config.h) and run the next time the VM calls
+	a function, or explicitly through collect_cycles().
+	   The time budget is checked while tracing, and a batch that does
+	not fit is undone. The root that caused most of the tracing is then
+	deferred; deferred roots are only processed by collections without
+	a budget, so a large live structure does not stall every step.
+ */
+
+#ifndef	EEL_E_CYCLE_H
+#define	EEL_E_CYCLE_H
+
+#include "EEL.h"
+#include "EEL_types.h"
+#include "e_config.h"
+
+/*
+ * Collector node info. This MUST be the first field of the implementation
+ * struct of every container class!
+ */
+typedef struct
+{
+	int		index;		/* Root buffer index + 1, or 0 */
+	int		color;		/* EEL_cccolors */
+} EEL_ccnode;
+
+typedef enum
+{
+	EEL_CC_BLACK = 0,	/* In use (or not visited) */
+	EEL_CC_GRAY,		/* Possible member of a garbage cycle */
+	EEL_CC_WHITE		/* Member of a garbage cycle */
+} EEL_cccolors;
+
+/* Collector statistics */
+typedef struct
+{
+	int		roots;		/* Currently buffered roots */
+	int		deferred;	/* Roots deferred to a full collection */
+	unsigned	runs;		/* Number of collection steps */
+	unsigned	visited;	/* Total nodes traversed */
+	unsigned	collected;	/* Total containers freed */
+	unsigned	modules;	/* Dead modules released */
+} EEL_ccstats;
+
+/* Returns 1 if objects of class 'cid' are handled by the cycle collector. */
+static inline int eel_cc_container(EEL_classes cid)
+{
+	return (unsigned)(cid - EEL_CARRAY) <= EEL_CTABLE - EEL_CARRAY;
+}
+
+static inline EEL_ccnode *o2EEL_ccnode(EEL_object *o)
+{
+	return (EEL_ccnode *)(o + 1);
+}
+
+/*
+ * Add container 'o' to the root buffer, unless it's already there, or can't
+ * be part of a cycle. (Called by eel_o_disown() and friends.)
+ */
+void eel_cc_buffer(EEL_object *o);
+
+/* Remove container 'o' from the root buffer, if it's there. */
+void eel_cc__forget(EEL_object *o);
+static inline void eel_cc_forget(EEL_object *o)
+{
+	if(o2EEL_ccnode(o)->index)
+		eel_cc__forget(o);
+}
+
+/* Run a collection step if one has been triggered. */
+void eel_cc__step(EEL_vm *vm);
+
+void eel_cc_stats(EEL_vm *vm, EEL_ccstats *st);
+
+/* Free collector buffers. (Any remaining roots are just forgotten!) */
+void eel_cc_close(EEL_vm *vm);
+
+#endif	/* EEL_E_CYCLE_H */
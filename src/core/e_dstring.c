@@ -302,7 +302,9 @@ EEL_xno eel_ds_write(EEL_object *eo, int pos, const char *s, int len)
 	{
 		if(ds_setsize(eo, pos + len + 1) < 0)
 			return EEL_XMEMORY;
-		memset(ds->buffer + ds->length, 0, ds->maxlength - ds->length);
+		if(pos > ds->length)
+			memset(ds->buffer + ds->length, 0, pos - ds->length);
+		ds->buffer[pos + len] = 0;
 		ds->length = pos + len;
 	}
 
@@ -59,6 +59,7 @@ static EEL_xno f_destruct(EEL_object *eo)
 		eel_free(vm, f->e.lines);
 		eel_free(vm, f->e.code);
 		eel_free(vm, f->e.argdefaults);
+		eel_free(vm, f->e.icache);
 		DBGN(printf("--- Freeing constants of '%s' ---\n",
 				eel_o2s(f->common.name));)
 		for(i = 0; i < f->e.nconstants; ++i)
@@ -91,6 +91,15 @@ typedef union
 		unsigned short	nconstants;
 		EEL_value	*constants;
 
+		/*
+		 * Inline caches for INDGETC/INDSETC; table item positions,
+		 * one per instruction. (See icache_lookup() in e_vm.c.)
+		 */
+		unsigned short	nicaches;
+		EEL_int32	*icache;
+		unsigned	ichits;		/* Cache hits */
+		unsigned	icmisses;	/* Cache misses */
+
 		/* Argument defaults (constant indexes) */
 		int		*argdefaults;	/* size: optargs or tupargs */
 
@@ -99,6 +108,13 @@ typedef union
 		int		codesize;	/* # of bytes */
 		unsigned char	*code;		/* Code */
 
+		/*
+		 * Operator instructions rewritten into type specialized forms
+		 * and back by the VM. (See QUICKEN() in e_vm.c.)
+		 */
+		unsigned	quickens;	/* Instructions specialized */
+		unsigned	dequickens;	/* Type misses, back to generic */
+
 		/* Debug info */
 		int		nlines;
 		EEL_int32	*lines;		/* Source line numbers */
@@ -107,7 +107,9 @@ EEL_object *eel_load_buffer(EEL_vm *vm,
 	{
 		EEL_xno x;
 		eel_compile(es, m, flags);
+		eel_vm_hold_budget(es->vm);
 		x = eel_callnf(es->vm, m, "__init_module", NULL);
+		eel_vm_release_budget(es->vm);
 		if(x)
 			eel_cerror(es, "Could not initialize module '%s'! (%s)",
 					eel_table_getss(o2EEL_module(m)->exports,
@@ -145,6 +147,7 @@ EEL_object *eel_get_loaded_module(EEL_vm *vm, const char *modname)
 EEL_object *eel_load(EEL_vm *vm, const char *modname, EEL_sflags flags)
 {
 	EEL_state *es = VMP->state;
+	EEL_xno x;
 	int res;
 #if 0
 	eel_clear_errors(VMP->state);
@@ -152,7 +155,10 @@ EEL_object *eel_load(EEL_vm *vm, const char *modname, EEL_sflags flags)
 #endif
 	if(!es->eellib)
 		return eel_get_loaded_module(vm, modname); /* Bootstrap! */
-	if(eel_callnf(vm, es->eellib, "load", "Rsi", &res, modname, flags))
+	eel_vm_hold_budget(vm);
+	x = eel_callnf(vm, es->eellib, "load", "Rsi", &res, modname, flags);
+	eel_vm_release_budget(vm);
+	if(x)
 		return NULL;
 	if(!EEL_IS_OBJREF(vm->heap[res].classid))
 		return NULL;
@@ -271,9 +277,11 @@ static EEL_xno m_real_destruct(EEL_object *eo)
 	}
 	eel_free(vm, m->variables);
 
-	/* Release exports */
+	/* Release exports and imports */
 	if(m->exports)
 		eel_o_disown(&m->exports);
+	eel_module_clear_imports(eo);
+	eel_free(vm, m->imports.array);
 
 	/* Release functions and other objects */
 	DBG1(printf("  Objects... (%d)\n", o->size);)
@@ -485,6 +493,32 @@ void eel_unlock_modules(EEL_state *es)
 	Convenience functions
 ----------------------------------------------------------*/
 
+int eel_module_add_import(EEL_object *mo, EEL_object *name, unsigned flags,
+		EEL_uint32 stamp)
+{
+	EEL_module *m = o2EEL_module(mo);
+	EEL_import_da *a = &m->imports;
+	if(a->size >= a->maxsize)
+		if(eel_imports_setsize(mo->vm, a, a->maxsize ?
+				a->maxsize * 2 : 4) < 0)
+			return -1;
+	a->array[a->size].name = name;
+	a->array[a->size].flags = flags;
+	a->array[a->size].stamp = stamp;
+	eel_o_own(name);
+	++a->size;
+	return 0;
+}
+
+
+void eel_module_clear_imports(EEL_object *mo)
+{
+	EEL_import_da *a = &o2EEL_module(mo)->imports;
+	while(a->size)
+		eel_o_disown_nz(a->array[--a->size].name);
+}
+
+
 const char *eel_module_modname(EEL_object *m)
 {
 	if(!m)
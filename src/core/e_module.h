@@ -32,12 +32,23 @@
 typedef enum
 {
 	/* This module instance can be shared by other modules */
-	EEL_M_SHARED =		0x00000001
+	EEL_M_SHARED =		0x00000001,
+	/* The module named itself with a 'module' statement */
+	EEL_M_NAMED =		0x00000002
 } EEL_mflags;
 
 typedef EEL_object *EEL_object_p;
 EEL_DARRAY(eel_objs_, EEL_object_p)
 
+/* Module import, as seen by the compiler */
+typedef struct
+{
+	EEL_object	*name;		/* Module name or path (string) */
+	unsigned	flags;		/* EEL_sflags passed to eel_load() */
+	EEL_uint32	stamp;		/* eel_bc_stamp() of the imported module */
+} EEL_import;
+EEL_DARRAY(eel_imports_, EEL_import)
+
 typedef struct
 {
 	unsigned	id;		/* Long time "unique" ID. */
@@ -59,6 +70,9 @@ typedef struct
 	 */
 	unsigned	refsum;
 
+	/* Imports, in order, for saving precompiled modules */
+	EEL_import_da	imports;
+
 	/* Static variables */
 	unsigned	nvariables;
 	unsigned	maxvariables;	/* FIXME: This is compiler stuff! */
@@ -80,6 +94,15 @@ TODO: to minimize duplication of data.
 EEL_MAKE_CAST(EEL_module);
 void eel_cmodule_register(EEL_vm *vm);
 
+/*
+ * Record an import of module 'name' (which is owned by the module) loaded
+ * with 'flags', where 'stamp' identifies the version of the module that was
+ * imported. Returns -1 if out of memory.
+ */
+int eel_module_add_import(EEL_object *mo, EEL_object *name, unsigned flags,
+		EEL_uint32 stamp);
+void eel_module_clear_imports(EEL_object *mo);
+
 /* Count references to compiler generated objects */
 int eel_module_countref(EEL_object *mo);
 
@@ -0,0 +1,278 @@
+/*
+---------------------------------------------------------------------------
+	e_mpool.c - EEL Memory Pools
+---------------------------------------------------------------------------
+ * Copyright 2026 David Olofson
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from the
+ * use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include <string.h>
+#include "e_mpool.h"
+#include "e_vm.h"
+
+#define	MP_CLASSES	(EEL_MP_MAXSIZE / EEL_MP_GRANULARITY)
+
+typedef struct EEL_mpslab EEL_mpslab;
+struct EEL_mpslab
+{
+	EEL_mpslab	*next;		/* Next slab of the same size class */
+	int		sclass;		/* Size class */
+	int		used;		/* Number of blocks in use */
+};
+
+/* Block header. (The union keeps the payload aligned for doubles.) */
+typedef union
+{
+	EEL_mpslab	*slab;		/* Owner slab, or NULL if direct */
+	double		align;
+} EEL_mpheader;
+
+/* Free list link, stored in the payload area of free blocks */
+typedef struct EEL_mpfree EEL_mpfree;
+struct EEL_mpfree
+{
+	EEL_mpfree	*next;
+};
+
+struct EEL_mpool
+{
+	EEL_vm		*owner;		/* VM that created the pool */
+	EEL_mpfree	*free[MP_CLASSES];
+	EEL_mpslab	*slabs[MP_CLASSES];
+	EEL_mpstats	stats;
+};
+typedef struct EEL_mpool EEL_mpool;
+
+/* Slab header size, rounded up to keep the blocks aligned */
+#define	MP_SLABHEAD	((sizeof(EEL_mpslab) + sizeof(EEL_mpheader) - 1) / \
+				sizeof(EEL_mpheader) * sizeof(EEL_mpheader))
+
+
+static inline int mp_class(int size)
+{
+	return size ? (size - 1) / EEL_MP_GRANULARITY : 0;
+}
+
+static inline int mp_size(int sclass)
+{
+	return (sclass + 1) * EEL_MP_GRANULARITY;
+}
+
+static inline EEL_mpheader *mp_header(void *block)
+{
+	return ((EEL_mpheader *)block) - 1;
+}
+
+
+int eel_mp_open(EEL_vm *vm, EEL_vm *parent)
+{
+	EEL_mpool *mp;
+	if(parent)
+	{
+		VMP->mpool = eel_vm2p(parent)->mpool;
+		return 0;
+	}
+	mp = (EEL_mpool *)eel_malloc(vm, sizeof(EEL_mpool));
+	if(!mp)
+		return -1;
+	memset(mp, 0, sizeof(EEL_mpool));
+	mp->owner = vm;
+	VMP->mpool = mp;
+	return 0;
+}
+
+
+void eel_mp_close(EEL_vm *vm)
+{
+	EEL_mpool *mp = VMP->mpool;
+	int c;
+	VMP->mpool = NULL;
+	if(!mp || (mp->owner != vm))
+		return;
+	for(c = 0; c < MP_CLASSES; ++c)
+		while(mp->slabs[c])
+		{
+			EEL_mpslab *s = mp->slabs[c];
+			mp->slabs[c] = s->next;
+			eel_free(vm, s);
+		}
+	eel_free(vm, mp);
+}
+
+
+/* Allocate a new slab for size class 'c', and add its blocks to the pool. */
+static int mp_refill(EEL_vm *vm, EEL_mpool *mp, int c)
+{
+	int stride = sizeof(EEL_mpheader) + mp_size(c);
+	int i, n = (EEL_MP_SLABSIZE - MP_SLABHEAD) / stride;
+	char *p;
+	EEL_mpslab *s = (EEL_mpslab *)eel_malloc(vm, EEL_MP_SLABSIZE);
+	if(!s)
+		return -1;
+	s->sclass = c;
+	s->used = 0;
+	s->next = mp->slabs[c];
+	mp->slabs[c] = s;
+	p = (char *)s + MP_SLABHEAD + (n - 1) * stride;
+	for(i = 0; i < n; ++i, p -= stride)
+	{
+		EEL_mpheader *h = (EEL_mpheader *)p;
+		EEL_mpfree *b = (EEL_mpfree *)(h + 1);
+		h->slab = s;
+		b->next = mp->free[c];
+		mp->free[c] = b;
+	}
+	++mp->stats.slabs;
+	++mp->stats.misses;
+	return 0;
+}
+
+
+void *eel_mp_alloc(EEL_vm *vm, int size)
+{
+	EEL_mpool *mp = VMP->mpool;
+	EEL_mpfree *b;
+	int c;
+	if(size > EEL_MP_MAXSIZE)
+	{
+		EEL_mpheader *h = (EEL_mpheader *)eel_malloc(vm,
+				sizeof(EEL_mpheader) + size);
+		if(!h)
+			return NULL;
+		h->slab = NULL;
+		++mp->stats.large;
+		return h + 1;
+	}
+	c = mp_class(size);
+	if(mp->free[c])
+		++mp->stats.hits;
+	else if(mp_refill(vm, mp, c) < 0)
+		return NULL;
+	b = mp->free[c];
+	mp->free[c] = b->next;
+	++mp_header(b)->slab->used;
+	++mp->stats.blocks;
+	return b;
+}
+
+
+void eel_mp_free(EEL_vm *vm, void *block)
+{
+	EEL_mpool *mp = VMP->mpool;
+	EEL_mpheader *h;
+	EEL_mpfree *b;
+	int c;
+	if(!block)
+		return;
+	h = mp_header(block);
+	if(!h->slab)
+	{
+		--mp->stats.large;
+		eel_free(vm, h);
+		return;
+	}
+	c = h->slab->sclass;
+	--h->slab->used;
+	b = (EEL_mpfree *)block;
+	b->next = mp->free[c];
+	mp->free[c] = b;
+	--mp->stats.blocks;
+}
+
+
+/*
+ * Like realloc(), a 'size' of 0 frees the block and returns NULL, and a NULL
+ * 'block' just allocates a new one.
+ */
+void *eel_mp_realloc(EEL_vm *vm, void *block, int size)
+{
+	EEL_mpheader *h;
+	void *nb;
+	int oldsize;
+	if(!block)
+		return eel_mp_alloc(vm, size);
+	if(!size)
+	{
+		eel_mp_free(vm, block);
+		return NULL;
+	}
+	h = mp_header(block);
+	if(!h->slab)
+	{
+		if(size > EEL_MP_MAXSIZE)
+		{
+			h = (EEL_mpheader *)eel_realloc(vm, h,
+					sizeof(EEL_mpheader) + size);
+			return h ? h + 1 : NULL;
+		}
+		oldsize = size;		/* Shrinking into a pooled block */
+	}
+	else
+	{
+		if(mp_class(size) == h->slab->sclass)
+			return block;
+		oldsize = mp_size(h->slab->sclass);
+	}
+	if(!(nb = eel_mp_alloc(vm, size)))
+		return NULL;
+	memcpy(nb, block, oldsize < size ? oldsize : size);
+	eel_mp_free(vm, block);
+	return nb;
+}
+
+
+int eel_trim_pools(EEL_vm *vm)
+{
+	EEL_mpool *mp = VMP->mpool;
+	int c, released = 0;
+	for(c = 0; c < MP_CLASSES; ++c)
+	{
+		EEL_mpfree **bp = &mp->free[c];
+		EEL_mpslab **sp = &mp->slabs[c];
+
+		/* Unlink free blocks that belong to unused slabs */
+		while(*bp)
+			if(!mp_header(*bp)->slab->used)
+				*bp = (*bp)->next;
+			else
+				bp = &(*bp)->next;
+
+		/* Release the unused slabs */
+		while(*sp)
+		{
+			EEL_mpslab *s = *sp;
+			if(s->used)
+			{
+				sp = &s->next;
+				continue;
+			}
+			*sp = s->next;
+			eel_free(vm, s);
+			--mp->stats.slabs;
+			++mp->stats.trimmed;
+			released += EEL_MP_SLABSIZE;
+		}
+	}
+	return released;
+}
+
+
+void eel_mp_stats(EEL_vm *vm, EEL_mpstats *st)
+{
+	*st = VMP->mpool->stats;
+}
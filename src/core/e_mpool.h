@@ -0,0 +1,76 @@
+/*
+---------------------------------------------------------------------------
+	e_mpool.h - EEL Memory Pools
+---------------------------------------------------------------------------
+ * Copyright 2026 David Olofson
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from the
+ * use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/*
+   Memory pools
+   ------------
+	Objects, and the item buffers of tables and arrays, are allocated
+	from size class pools rather than directly through the VM memory
+	manager. Each size class keeps a free list of blocks, carved out
+	of slabs of EEL_MP_SLABSIZE bytes that are allocated through the
+	VM memory manager as needed. Requests larger than EEL_MP_MAXSIZE
+	go to the VM memory manager directly.
+	   Every block has a small header pointing to the slab it belongs
+	to (or NULL for direct allocations), so blocks can be freed and
+	reallocated without knowing their sizes. This also means that
+	memory from the pools MUST NOT be passed to eel_free() or
+	eel_realloc(), and vice versa!
+	   There is one pool per state, owned by the state VM and shared by
+	all VMs of the state, just like the memory manager callbacks.
+	Memory is not returned to the system until eel_trim_pools() is
+	called, which frees all slabs that have no blocks in use.
+ */
+
+#ifndef	EEL_E_MPOOL_H
+#define	EEL_E_MPOOL_H
+
+#include "EEL.h"
+#include "e_config.h"
+
+/* Pool statistics */
+typedef struct
+{
+	int		slabs;		/* Slabs currently allocated */
+	int		blocks;		/* Pooled blocks in use */
+	int		large;		/* Direct allocations in use */
+	unsigned	hits;		/* Allocations served from free lists */
+	unsigned	misses;		/* Allocations that needed a new slab */
+	unsigned	trimmed;	/* Total slabs released by trimming */
+} EEL_mpstats;
+
+/*
+ * Set up the pool of VM 'vm', or share the one of 'parent' if it's not NULL.
+ * Returns 0 on success, or -1 if the pool could not be allocated.
+ */
+int eel_mp_open(EEL_vm *vm, EEL_vm *parent);
+
+/* Destroy the pool, unless 'vm' is just sharing it. */
+void eel_mp_close(EEL_vm *vm);
+
+void *eel_mp_alloc(EEL_vm *vm, int size);
+void *eel_mp_realloc(EEL_vm *vm, void *block, int size);
+void eel_mp_free(EEL_vm *vm, void *block);
+
+void eel_mp_stats(EEL_vm *vm, EEL_mpstats *st);
+
+#endif	/* EEL_E_MPOOL_H */
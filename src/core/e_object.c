@@ -70,10 +70,10 @@ static inline void eeld_o_unlink(EEL_vm *vm, EEL_object *o)
 EEL_object *eel_o_alloc(EEL_vm *vm, int size, EEL_classes cid)
 {
 #if DBGM(1) + 0 == 1
-	EEL_object *o = (EEL_object *)eel_malloc(vm,
+	EEL_object *o = (EEL_object *)eel_mp_alloc(vm,
 			sizeof(EEL_object_dbg) + sizeof(EEL_object) + size);
 #else
-	EEL_object *o = (EEL_object *)eel_malloc(vm, sizeof(EEL_object) + size);
+	EEL_object *o = (EEL_object *)eel_mp_alloc(vm, sizeof(EEL_object) + size);
 #endif
 	if(!o)
 		return NULL;
@@ -90,6 +90,15 @@ EEL_object *eel_o_alloc(EEL_vm *vm, int size, EEL_classes cid)
 	printf("*<%s> (refcount = %d)\n", eel_typename(vm, o->classid),
 			o->refcount);
 #endif
+	if(eel_cc_container(cid))
+	{
+		o2EEL_ccnode(o)->index = 0;
+		o2EEL_ccnode(o)->color = EEL_CC_BLACK;
+#if EEL_CC_TRIGGER > 0
+		if(++VMP->ccallocs >= VMP->cctrigger)
+			VMP->ccpending = 1;
+#endif
+	}
 	DBGM(++VMP->created;)
 #if DBGM(1) + 0 == 1
 	eeld_o_link(vm, o);
@@ -106,6 +115,8 @@ EEL_object *eel_o_alloc(EEL_vm *vm, int size, EEL_classes cid)
 
 static inline void o__dealloc(EEL_object *o)
 {
+	if(eel_cc_container(o->classid))
+		eel_cc_forget(o);
 #ifdef EEL_VM_CHECKING
 	if(o->lprev || o->lnext)
 	{
@@ -118,11 +129,11 @@ static inline void o__dealloc(EEL_object *o)
 	++eel_vm2p(o->vm)->destroyed;
 	eeld_o_unlink(o->vm, o);
 # if DBGK(1) + 0 == 0
-	eel_free(o->vm, o2dbg(o));
+	eel_mp_free(o->vm, o2dbg(o));
 # endif
 #else
 # if DBGK(1) + 0 == 0
-	eel_free(o->vm, o);
+	eel_mp_free(o->vm, o);
 # endif
 #endif
 }
@@ -62,6 +62,8 @@
 #include "e_module.h"
 #include "e_error.h"
 #include "e_config.h"
+#include "e_cycle.h"
+#include "e_mpool.h"
 
 #if (DBGK(1)+0 == 1) || (DBGL(1)+0 == 1) || (DBGK3(1)+0 == 1) ||	\
 		(DBGK4(1)+0 == 1) || (DBG7(1)+0 == 1) ||		\
@@ -406,6 +408,8 @@ static inline void eel_o_disown(EEL_object **po)
 		*po = NULL;
 		eel_o__dispose(o);
  	}
+	else if(eel_cc_container(o->classid))
+		eel_cc_buffer(o);
 }
 
 
@@ -439,6 +443,8 @@ static inline void eel_o_disown_nz(EEL_object *o)
 	)
 	if(!o->refcount)
 		eel_o__dispose(o);
+	else if(eel_cc_container(o->classid))
+		eel_cc_buffer(o);
 }
 
 
@@ -21,6 +21,7 @@
  * 3. This notice may not be removed or altered from any source distribution.
  */
 
+#include <stdlib.h>
 #include <string.h>
 #include "ec_symtab.h"
 #include "e_state.h"
@@ -38,6 +39,8 @@
 #include "eel_dir.h"
 #include "eel_math.h"
 #include "eel_dsp.h"
+#include "eel_serial.h"
+#include "eel_threads.h"
 #include "e_sharedstate.h"
 
 
@@ -68,6 +71,7 @@ static EEL_xno array_sadd(EEL_object *a, const char *s)
 static EEL_xno init_env_table(EEL_state *es)
 {
 	EEL_value a, v;
+	const char *s;
 	EEL_xno x = eel_o_construct(es->vm, EEL_CTABLE, NULL, 0, &v);
 	if(x)
 	{
@@ -86,6 +90,18 @@ static EEL_xno init_env_table(EEL_state *es)
 	XCHECK(array_sadd(a.objref.v, ""));
 	XCHECK(eel_setsindex(es->environment, "path_modules", &a));
 	eel_disown(a.objref.v);
+
+	/* Compile cache directory; disabled unless set */
+	if((s = getenv("EEL_COMPILE_CACHE")) && s[0])
+	{
+		eel_s2v(es->vm, &v, s);
+		if(v.classid == EEL_CNIL)
+			return EEL_XMEMORY;
+		x = eel_setsindex(es->environment, "path_compile_cache", &v);
+		eel_v_disown(&v);
+		if(x)
+			return x;
+	}
 	return 0;
 }
 
@@ -435,6 +451,24 @@ EEL_vm *eel_open(int argc, const char *argv[])
 		return NULL;
 	}
 
+	/* Install serialization module */
+	if(eel_serial_init(vm))
+	{
+		eel_msg(es, EEL_EM_IERROR, "Could not initialize built-in"
+				" serialization module!\n");
+		es_close(es);
+		return NULL;
+	}
+
+	/* Install green threads module */
+	if(eel_threads_init(vm))
+	{
+		eel_msg(es, EEL_EM_IERROR, "Could not initialize built-in"
+				" threads module!\n");
+		es_close(es);
+		return NULL;
+	}
+
 	return es->vm;
 }
 
@@ -568,7 +602,11 @@ static void es_close(EEL_state *es)
 	VMP->is_closing = 1;
 	DBGK2(printf("eel_close(): Running $.cleanup and deleting environment.\n");)
 	if(es->eellib)
+	{
+		eel_vm_hold_budget(vm);
 		eel_callnf(vm, es->eellib, "__cleanup", NULL);
+		eel_vm_release_budget(vm);
+	}
 	DBGK2(printf("eel_close(): Garbage collecting remaining modules.\n");)
 	while(eel_clean_modules(vm))
 		;
@@ -617,6 +655,8 @@ static void es_close(EEL_state *es)
 	}
 # endif
 #endif
+	DBGK2(printf("eel_close(): Collecting circular garbage.\n");)
+	eel_collect_cycles(vm, -1);
 	DBGK2(printf("eel_close(): VM Cleanup.\n");)
 	eel_vm_cleanup(vm);
 	DBGK2(printf("eel_close(): Destroying built-in classes.\n");)
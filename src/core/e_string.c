@@ -38,9 +38,6 @@ TODO: turned into EEL strings at init time, to avoid hashing every time.
 #include "e_vm.h"
 #include "e_register.h"
 
-/* Size of pool hash table */
-#define	PS_TABLESIZE	256
-#define	HASH2BUCKET(vmp, hash)	((vmp)->strings + ((hash) % PS_TABLESIZE))
 
 #ifdef EEL_CACHE_STRINGS
 /* List operators for string cache (uses the limbo list pointers) */
@@ -76,14 +73,93 @@ static inline void ps_unlink(EEL_object **head, EEL_object *o)
 }
 
 
+/*
+ * Find the bucket that string with hash code 'hash' belongs in. While
+ * resizing, buckets that have not yet been migrated are still in use in the
+ * old bucket table.
+ */
+static inline EEL_object **ps_bucket(EEL_vm_private *vmp, EEL_hash hash)
+{
+	if(vmp->ostrings)
+	{
+		int ob = hash & (vmp->osbuckets - 1);
+		if(ob >= vmp->smigrate)
+			return vmp->ostrings + ob;
+	}
+	return vmp->strings + (hash & (vmp->sbuckets - 1));
+}
+
+
+/* Move up to 'count' buckets from the old bucket table to the new one */
+static inline void ps_migrate(EEL_vm *vm, int count)
+{
+	EEL_vm_private *vmp = VMP;
+	while(count--)
+	{
+		EEL_object **ob = vmp->ostrings + vmp->smigrate;
+		while(*ob)
+		{
+			EEL_object *o = *ob;
+			EEL_hash h = o2EEL_string(o)->hash;
+			ps_unlink(ob, o);
+			ps_push(vmp->strings + (h & (vmp->sbuckets - 1)), o);
+		}
+		if(++vmp->smigrate >= vmp->osbuckets)
+		{
+			PSDBG(printf("--- String pool resized to %d buckets\n",
+					vmp->sbuckets);)
+			eel_free(vm, vmp->ostrings);
+			vmp->ostrings = NULL;
+			vmp->osbuckets = vmp->smigrate = 0;
+			return;
+		}
+	}
+}
+
+
+/*
+ * Start growing the bucket table, if the pool has more strings than buckets.
+ * Failing to allocate a new table is not an error; we just keep using the old
+ * one.
+ */
+static inline void ps_grow(EEL_vm *vm)
+{
+	EEL_vm_private *vmp = VMP;
+	EEL_object **nb;
+	int n;
+	if(vmp->ostrings || (vmp->scount <= vmp->sbuckets))
+		return;
+	n = vmp->sbuckets * 2;
+	nb = eel_malloc(vm, sizeof(EEL_object *) * n);
+	if(!nb)
+		return;
+	memset(nb, 0, sizeof(EEL_object *) * n);
+	vmp->ostrings = vmp->strings;
+	vmp->osbuckets = vmp->sbuckets;
+	vmp->smigrate = 0;
+	vmp->strings = nb;
+	vmp->sbuckets = n;
+}
+
+
+/* Add new string 'o' to the pool */
+static inline void ps_add(EEL_vm *vm, EEL_object *o)
+{
+	ps_push(ps_bucket(VMP, o2EEL_string(o)->hash), o);
+	++VMP->scount;
+	++VMP->smisses;
+	ps_grow(vm);
+}
+
+
 static inline EEL_object *ps_find(EEL_vm *vm, const char *s,
 		int len, unsigned int *hash)
 {
 	EEL_object *pso;
-	EEL_object **list;
+	if(VMP->ostrings)
+		ps_migrate(vm, EEL_STRING_POOL_MIGRATE);
 	*hash = eel_hashmem((const char *)s, len);
-	list = HASH2BUCKET(VMP, *hash);
-	for(pso = *list; pso; pso = o2EEL_string(pso)->snext)
+	for(pso = *ps_bucket(VMP, *hash); pso; pso = o2EEL_string(pso)->snext)
 	{
 		EEL_string *ps = o2EEL_string(pso);
 		if(ps->hash != *hash)
@@ -136,8 +212,11 @@ static inline void ps_resurrect(EEL_object *pso)
 		/* Bring it back from the (almost) dead. */
 		ps_cache_unlink(VMP, pso);
 		--VMP->scache_size;
+		++VMP->scache_hits;
 	}
+	else
 #endif
+		++VMP->shits;
 	eel_o_own(pso);
 	print_cache(vm);
 }
@@ -173,7 +252,7 @@ EEL_object *eel_ps_nnew_grab(EEL_vm *vm, char *s, int len)
 	ps->buffer = s;
 	ps->length = len;
 	ps->hash = hash;
-	ps_push(HASH2BUCKET(VMP, hash), pso);
+	ps_add(vm, pso);
 	PSDBG2(printf("CREATED STRING %s\n", eel_o_stringrep(pso));)
 	print_cache(vm);
 	return pso;
@@ -190,6 +269,7 @@ EEL_object *eel_ps_nnew(EEL_vm *vm, const char *s, int len)
 {
 	unsigned int hash;
 	EEL_string *ps;
+	char *buf;
 	EEL_object *pso = ps_find(vm, s, len, &hash);
 	if(pso)
 	{
@@ -197,21 +277,22 @@ EEL_object *eel_ps_nnew(EEL_vm *vm, const char *s, int len)
 		return pso;
 	}
 	/* Nope, we need to add a new string to the pool. */
+	buf = eel_malloc(vm, len + 1);
+	if(!buf)
+		return NULL;
 	pso = eel_o_alloc(vm, sizeof(EEL_string), EEL_CSTRING);
 	if(!pso)
-		return NULL;
-	ps = o2EEL_string(pso);
-	ps->buffer = eel_malloc(vm, len + 1);
-	if(!ps->buffer)
 	{
-		eel_o_disown_nz(pso);
+		eel_free(vm, buf);
 		return NULL;
 	}
-	memcpy((void *)ps->buffer, s, len);
-	((char *)ps->buffer)[len] = 0;
+	memcpy(buf, s, len);
+	buf[len] = 0;
+	ps = o2EEL_string(pso);
+	ps->buffer = buf;
 	ps->length = len;
 	ps->hash = hash;
-	ps_push(HASH2BUCKET(VMP, hash), pso);
+	ps_add(vm, pso);
 	PSDBG2(printf("CREATED STRING %s\n", eel_o_stringrep(pso));)
 	print_cache(vm);
 	return pso;
@@ -229,7 +310,10 @@ static inline void really_destruct(EEL_vm *vm, EEL_object *eo)
 	EEL_string *ps = o2EEL_string(eo);
 	PSDBG2(printf("DESTROYING STRING %s\n", eel_o_stringrep(eo));)
 	if(VMP->strings)
-		ps_unlink(HASH2BUCKET(VMP, ps->hash), eo);
+	{
+		ps_unlink(ps_bucket(VMP, ps->hash), eo);
+		--VMP->scount;
+	}
 	eel_free(vm, (void *)(ps->buffer));
 	PSDBG2(printf("   STRING DESTROYED.\n");)
 }
@@ -298,12 +382,19 @@ static void ps_uncache(EEL_vm *vm)
 
 int eel_ps_open(EEL_vm *vm)
 {
-	VMP->strings = eel_malloc(vm, sizeof(EEL_pstring *) * PS_TABLESIZE);
+	VMP->strings = eel_malloc(vm,
+			sizeof(EEL_object *) * EEL_STRING_POOL_SIZE);
 	if(!VMP->strings)
 		return -1;
-	memset(VMP->strings, 0, sizeof(EEL_pstring *) * PS_TABLESIZE);
+	memset(VMP->strings, 0, sizeof(EEL_object *) * EEL_STRING_POOL_SIZE);
+	VMP->sbuckets = EEL_STRING_POOL_SIZE;
+	VMP->scount = 0;
+	VMP->ostrings = NULL;
+	VMP->osbuckets = VMP->smigrate = 0;
+	VMP->shits = VMP->smisses = 0;
 #ifdef EEL_CACHE_STRINGS
 	VMP->scache_max = EEL_DEFAULT_STRING_CACHE;
+	VMP->scache_hits = 0;
 #endif
 	return 0;
 }
@@ -318,29 +409,74 @@ void eel_ps_close(EEL_vm *vm)
 	PSDBG(printf("  OK.\n");)
 #endif
 	PSDBG(printf("--- Closing string pool -------------\n");)
-	for(i = 0; i < PS_TABLESIZE; ++i)
+	/* Finish any pending resize, so we only have one table to clean */
+	if(VMP->ostrings)
+		ps_migrate(vm, VMP->osbuckets);
+	for(i = 0; i < VMP->sbuckets; ++i)
 	{
 		PSDBG(int pb = 0;)
 		while(VMP->strings[i])
 		{
-			EEL_string *ps = o2EEL_string(VMP->strings[i]);
 			PSDBG(if(!pb)
 			{
 				printf("--- BIN %3.1d -------------------------\n", i);
 				pb = 1;
 			})
 			PSDBG(printf("WARNING: Pooled string \"%s\" leaked!\n",
-					ps->buffer);)
-			ps_unlink(VMP->strings + (ps->hash % PS_TABLESIZE),
-					VMP->strings[i]);
+					o2EEL_string(VMP->strings[i])->buffer);)
+			ps_unlink(VMP->strings + i, VMP->strings[i]);
 		}
 	}
 	eel_free(vm, VMP->strings);
 	VMP->strings = NULL;
+	VMP->sbuckets = VMP->scount = 0;
 	PSDBG(printf("--- String pool closed --------------\n");)
 }
 
 
+static inline int ps_longest_chain(EEL_object **buckets, int n)
+{
+	int i, longest = 0;
+	for(i = 0; i < n; ++i)
+	{
+		int len = 0;
+		EEL_object *o;
+		for(o = buckets[i]; o; o = o2EEL_string(o)->snext)
+			++len;
+		if(len > longest)
+			longest = len;
+	}
+	return longest;
+}
+
+
+void eel_ps_stats(EEL_vm *vm, EEL_psstats *st)
+{
+	EEL_vm_private *vmp = VMP;
+	memset(st, 0, sizeof(EEL_psstats));
+	if(!vmp->strings)
+		return;
+	st->strings = vmp->scount;
+	st->buckets = vmp->sbuckets;
+	st->longest = ps_longest_chain(vmp->strings, vmp->sbuckets);
+	if(vmp->ostrings)
+	{
+		int ol = ps_longest_chain(vmp->ostrings + vmp->smigrate,
+				vmp->osbuckets - vmp->smigrate);
+		if(ol > st->longest)
+			st->longest = ol;
+		st->migrating = vmp->osbuckets - vmp->smigrate;
+	}
+	st->hits = vmp->shits;
+	st->misses = vmp->smisses;
+#ifdef EEL_CACHE_STRINGS
+	st->cache_size = vmp->scache_size;
+	st->cache_max = vmp->scache_max;
+	st->cache_hits = vmp->scache_hits;
+#endif
+}
+
+
 /*-------------------------------------------------------------------------
 	String class implementation
 -------------------------------------------------------------------------*/
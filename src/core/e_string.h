@@ -48,6 +48,21 @@ EEL_object *eel_ps_nnew_grab(EEL_vm *vm, char *s, int len);
 int eel_ps_open(EEL_vm *vm);
 void eel_ps_close(EEL_vm *vm);
 
+/* String pool statistics */
+typedef struct
+{
+	int		strings;	/* Number of strings in the pool */
+	int		buckets;	/* Number of hash buckets */
+	int		longest;	/* Longest bucket chain */
+	int		migrating;	/* Old buckets left to migrate */
+	unsigned	hits;		/* Lookups finding a live string */
+	unsigned	misses;		/* Lookups creating a new string */
+	int		cache_size;	/* Number of cached "dead" strings */
+	int		cache_max;	/* Max number of cached strings */
+	unsigned	cache_hits;	/* Strings resurrected from cache */
+} EEL_psstats;
+void eel_ps_stats(EEL_vm *vm, EEL_psstats *st);
+
 
 static inline const char *eel_o2s(EEL_object *o)
 {
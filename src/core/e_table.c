@@ -31,14 +31,6 @@
 #include "e_register.h"
 
 
-struct EEL_tableitem
-{
-	EEL_hash	hash;
-	EEL_value	key;
-	EEL_value	value;
-};
-
-
 static inline int t_setsize(EEL_object *eo, int newlength)
 {
 	EEL_table *t = o2EEL_table(eo);
@@ -49,7 +41,7 @@ static inline int t_setsize(EEL_object *eo, int newlength)
 		t->length = newlength;
 		return 0;
 	}
-	ni = eel_realloc(eo->vm, t->items, sizeof(EEL_tableitem) * n);
+	ni = eel_mp_realloc(eo->vm, t->items, sizeof(EEL_tableitem) * n);
 	if(!ni)
 	{
 		if(newlength)
@@ -78,187 +70,247 @@ static inline int t_setsize(EEL_object *eo, int newlength)
 }
 
 
+/*----------------------------------------------------------
+	Hash index
+----------------------------------------------------------*/
+
+/* Home slot of hash code 'h' (Fibonacci hashing) */
+static inline unsigned t__home(EEL_table *t, EEL_hash h)
+{
+	return (unsigned)(h * 2654435769U) >> (32 - t->ibits);
+}
+
+
+/* Add item 'pos' to the index. (The index must have a free slot!) */
+static inline void t__index_add(EEL_table *t, int pos)
+{
+	unsigned mask = (1U << t->ibits) - 1;
+	unsigned s = t__home(t, t->items[pos].hash);
+	while(t->index[s] >= 0)
+		s = (s + 1) & mask;
+	t->index[s] = pos;
+}
+
+
+/* Find the index slot that refers to item 'pos' */
+static inline unsigned t__index_slot(EEL_table *t, int pos)
+{
+	unsigned mask = (1U << t->ibits) - 1;
+	unsigned s = t__home(t, t->items[pos].hash);
+	while(t->index[s] != pos)
+		s = (s + 1) & mask;
+	return s;
+}
+
+
 /*
- * WARNING:
- *	This REQUIRES that 'pos' is inside or just after the end of the array!
+ * Remove the index entry in slot 's', shifting subsequent entries of the probe
+ * sequence back, so that no tombstones are needed.
  */
-static inline EEL_tableitem *insert_item(EEL_object *eo, int pos,
-		EEL_value *key, EEL_value *value, EEL_hash h)
+static inline void t__index_remove(EEL_table *t, unsigned s)
+{
+	unsigned mask = (1U << t->ibits) - 1;
+	unsigned j = s;
+	while(1)
+	{
+		unsigned home;
+		j = (j + 1) & mask;
+		if(t->index[j] < 0)
+			break;
+		home = t__home(t, t->items[t->index[j]].hash);
+		/* Can the entry at 'j' be moved back to 's'? */
+		if(((j - home) & mask) >= ((j - s) & mask))
+		{
+			t->index[s] = t->index[j];
+			s = j;
+		}
+	}
+	t->index[s] = -1;
+}
+
+
+/*
+ * (Re)build, resize or remove the index as needed to keep the load factor
+ * between 1/8 and 1/2. Returns -1 if out of memory.
+ */
+static int t__reindex(EEL_object *eo)
 {
-	int i;
-	EEL_tableitem *ti;
 	EEL_table *t = o2EEL_table(eo);
-#ifdef EEL_VM_CHECKING
-	if(pos > t->length)
+	int i, bits, *ni;
+	if(t->length <= EEL_TABLE_INDEXMIN)
 	{
-		fprintf(stderr, "INTERNAL ERROR: e_table.c, insert_item(): "
-				"Insert position %d, but there are only %d "
-				"items!\n", pos, t->length);
-		return NULL;
+		if(t->index)
+		{
+			eel_mp_free(eo->vm, t->index);
+			t->index = NULL;
+			t->ibits = 0;
+		}
+		return 0;
 	}
-#endif
+	if(t->index && (t->length * 2 <= (1 << t->ibits)) &&
+			(t->length * 8 >= (1 << t->ibits)))
+		return 0;	/* Current index is fine! */
+	for(bits = 4; (1 << bits) < t->length * 4; ++bits)
+		;
+	if(t->index && (bits == t->ibits))
+		return 0;
+	ni = (int *)eel_mp_alloc(eo->vm, sizeof(int) << bits);
+	if(!ni)
+		return -1;
+	memset(ni, -1, sizeof(int) << bits);
+	eel_mp_free(eo->vm, t->index);
+	t->index = ni;
+	t->ibits = bits;
+	for(i = 0; i < t->length; ++i)
+		t__index_add(t, i);
+	return 0;
+}
+
+
+/*
+ * Append a new item to table 'eo'.
+ */
+static inline EEL_tableitem *insert_item(EEL_object *eo,
+		EEL_value *key, EEL_value *value, EEL_hash h)
+{
+	EEL_tableitem *ti;
+	EEL_table *t = o2EEL_table(eo);
+	int pos = t->length;
 
 	/* Resize */
 	if(t_setsize(eo, t->length + 1) < 0)
 		return NULL;
-	ti = t->items;
 
-	/* Move */
-	for(i = t->length - 1; i > pos; --i)
+	/* Write */
+	ti = t->items + pos;
+	ti->hash = h;
+	eel_v_copy(&ti->key, key);
+	eel_v_copy(&ti->value, value);
+
+	/* Index */
+	if(t->index && (t->length * 2 <= (1 << t->ibits)))
+		t__index_add(t, pos);
+	else if(t__reindex(eo) < 0)
 	{
-		ti[i].hash = ti[i - 1].hash;
-		eel_v_move(&ti[i].key, &ti[i - 1].key);
-		eel_v_move(&ti[i].value, &ti[i - 1].value);
+		eel_v_disown_nz(&ti->key);
+		eel_v_disown_nz(&ti->value);
+		t_setsize(eo, pos);
+		return NULL;
 	}
+	return ti;
+}
 
-	/* Write */
-	ti[pos].hash = h;
-	eel_v_copy(&ti[pos].key, key);
-	eel_v_copy(&ti[pos].value, value);
-#if 0
-	printf("....................\n");
-	for(i = 0; i < t->length; ++i)
-		printf("   %d:\t%x\t%s\t%s\n", i, ti[i].hash,
-				eel_v_stringrep(eo->vm, &ti[i].key),
-				eel_v_stringrep(eo->vm, &ti[i].value));
-	printf("''''''''''''''''''''\n");
-#endif
-#ifdef EEL_VM_CHECKING
-	for(i = 0; i < t->length - 1; ++i)
-		if(ti[i].hash > ti[i + 1].hash)
-			fprintf(stderr, "INTERNAL ERROR: Items %d and %d of %s "
-					"are stored in the wrong order!\n",
-					i, i + 1, eel_o_stringrep(eo));
-#endif
-	return ti + pos;
+
+/*
+ * Remove item 'pos' from table 'eo', moving the last item into its place.
+ */
+static inline void remove_item(EEL_object *eo, int pos)
+{
+	EEL_table *t = o2EEL_table(eo);
+	EEL_tableitem *ti = t->items;
+	int last = t->length - 1;
+
+	/* Clean out item */
+	eel_v_disown_nz(&ti[pos].key);
+	eel_v_disown_nz(&ti[pos].value);
+	if(t->index)
+		t__index_remove(t, t__index_slot(t, pos));
+
+	/* Fill the hole with the last item */
+	if(pos != last)
+	{
+		if(t->index)
+			t->index[t__index_slot(t, last)] = pos;
+		ti[pos].hash = ti[last].hash;
+		eel_v_move(&ti[pos].key, &ti[last].key);
+		eel_v_move(&ti[pos].value, &ti[last].value);
+	}
+
+	/* Truncate */
+	t_setsize(eo, last);
+	if(t->index && (t->length * 8 < (1 << t->ibits)))
+		t__reindex(eo);	/* Failing to shrink is harmless */
 }
 
 
 /*
- * Find an item with hash code 'key' in array 'list' of 'size' elements.
- *
- * Returns the index of the hit, or if there is no hit, an inverted (that is,
- * *not* two's complement!) index indicating where a new item with hash code
- * 'key' should go if inserted.
- *
- * NOTE:
- *	Hash codes are not guaranteed to make unique keys! As a result, all we
- *	know when getting a "positive" from this is that we found one of
- *	potentially several items with the right hash code. If there are
- *	several, they will all be grouped together, but we may land anywhere in
- *	the group, so we have to look in both directions.
+ * Check if the key of item 'ti' matches 'key'. (Hash codes are assumed to have
+ * been checked already.)
  */
-static inline int t__binary_find(EEL_tableitem *list, int size, EEL_hash h)
+static inline int t__match(EEL_object *eo, EEL_tableitem *ti, EEL_value *key)
 {
-	int low = 0;
-	int high = size - 1;
-	while(high >= low)
+	switch(key->classid)
 	{
-		int mid = (low + high + 1) / 2;
-		if(h < list[mid].hash)
-			high = mid - 1;
-		else if(h > list[mid].hash)
-			low = mid + 1;
-		else
-			return mid;
+	  case EEL_CNIL:
+		return ti->key.classid == EEL_CNIL;
+	  case EEL_CREAL:
+		if(ti->key.classid != EEL_CREAL)
+			return 0;
+		return ti->key.real.v == key->real.v;
+	  case EEL_CINTEGER:
+	  case EEL_CBOOLEAN:
+	  case EEL_CCLASSID:
+		if(ti->key.classid != key->classid)
+			return 0;
+		return ti->key.integer.v == key->integer.v;
+	  case EEL_COBJREF:
+	  case EEL_CWEAKREF:
+	  {
+		EEL_value v;
+		if(!EEL_IS_OBJREF(ti->key.classid))
+			return 0;
+		if(ti->key.objref.v == key->objref.v)
+			return 1;	/* Same instance! ==> */
+		/* Strings are pooled, so there are no other matches. */
+		if(key->objref.v->classid == EEL_CSTRING)
+			return 0;
+		if(eel_o__metamethod(ti->key.objref.v,
+				EEL_MM_COMPARE, key, &v))
+			return 0;	/* Cannot even compare! */
+		return !v.integer.v;
+	  }
+	  default:
+		eel_ierror(eel_vm2p(eo->vm)->state,
+				"e_table.c: INTERNAL ERROR: Illegal "
+				"key type for t__find()!\n");
+		return 0;
 	}
-	return ~((low + high + 1) / 2);
 }
 
 
 /*
- * Find item by 'key' in table 't', starting at item 'first'.
+ * Find item by 'key', with hash code 'h', in table 'eo'.
  *
- * Returns the index of the hit, or if there is no hit, an inverted (that is,
- * *not* two's complement!) index indicating where a new item with hash code
- * 'key' should go if inserted.
+ * Returns the index of the hit, or -1 if there is no hit.
+ *
+ * NOTE:
+ *	Hash codes are not guaranteed to make unique keys, so we still need to
+ *	check the keys of items with matching hash codes.
  */
 static inline int t__find(EEL_object *eo, EEL_value *key, EEL_hash h)
 {
-	int i, first;
 	EEL_table *t = o2EEL_table(eo);
 	EEL_tableitem *ti = t->items;
-	if(t->length < 10)
+	if(!t->index)
 	{
-		for(first = 0; ; ++first)
-		{
-			if(first == t->length)
-				return ~first;
-			if(ti[first].hash < h)
-				continue;
-			if(ti[first].hash > h)
-				return ~first;
-			break;		/* Found! */
-		}
+		int i;
+		for(i = 0; i < t->length; ++i)
+			if((ti[i].hash == h) && t__match(eo, ti + i, key))
+				return i;
 	}
 	else
 	{
-		/* Find group of items with the right hash, if any. */
-		first = t__binary_find(ti, t->length, h);
-		if(first < 0)
-			return first;
-
-		/* Back up to the first item with this hash code. */
-		while((first > 0) && (ti[first - 1].hash == h))
-			--first;
-	}
-	
-	/* Fast-path for string lookups */
-	if(EEL_IS_OBJREF(key->classid) &&
-			(key->objref.v->classid == EEL_CSTRING))
-	{
-		for(i = first; (i < t->length) && (ti[i].hash == h); ++i)
-			/* NOTE: Nasty backwards testing here...! */
-			if(ti[i].key.objref.v == key->objref.v)
-				if(EEL_IS_OBJREF(ti[i].key.classid))
-					return i;	/* Found! */
-		return ~first;	/* Not found! */
-	}
-
-	/* Generic linear scan - NO shortcuts for strings! */
-	for(i = first; (i < t->length) && (ti[i].hash == h); ++i)
-		switch(key->classid)
+		unsigned mask = (1U << t->ibits) - 1;
+		unsigned s = t__home(t, h);
+		int i;
+		while((i = t->index[s]) >= 0)
 		{
-		  case EEL_CNIL:
-			if(ti[i].key.classid == EEL_CNIL)
-				return i;
-			continue;
-		  case EEL_CREAL:
-			if(ti[i].key.classid != EEL_CREAL)
-				continue;
-			if(ti[i].key.real.v == key->real.v)
-				return i;
-			continue;
-		  case EEL_CINTEGER:
-		  case EEL_CBOOLEAN:
-		  case EEL_CCLASSID:
-			if(ti[i].key.classid != key->classid)
-				continue;
-			if(ti[i].key.integer.v == key->integer.v)
+			if((ti[i].hash == h) && t__match(eo, ti + i, key))
 				return i;
-			continue;
-		  case EEL_COBJREF:
-		  case EEL_CWEAKREF:
-		  {
-			EEL_value v;
-			if(!EEL_IS_OBJREF(ti[i].key.classid))
-				continue;
-			if(ti[i].key.objref.v == key->objref.v)
-				return i;	/* Same instance! ==> */
-			if(eel_o__metamethod(ti[i].key.objref.v,
-					EEL_MM_COMPARE, key, &v))
-				continue;	/* Cannot even compare! */
-			if(v.integer.v)
-				continue;	/* Not equal! */
-			return i;
-		  }
-		  default:
-			eel_ierror(eel_vm2p(eo->vm)->state,
-					"e_table.c: INTERNAL ERROR: Illegal "
-					"key type for t__find()!\n");
-			return -1;
+			s = (s + 1) & mask;
 		}
-	return ~first;	/* Not found! */
+	}
+	return -1;	/* Not found! */
 }
 
 
@@ -278,7 +330,7 @@ static inline EEL_xno t__setindex(EEL_object *eo, EEL_value *op1, EEL_value *op2
 	else
 	{
 		/* Add new item */
-		if(!insert_item(eo, ~pos, op1, op2, h))
+		if(!insert_item(eo, op1, op2, h))
 			return EEL_XMEMORY;
 		return 0;
 	}
@@ -295,7 +347,8 @@ static EEL_xno t_destruct(EEL_object *eo)
 		eel_v_disown_nz(&ti->key);
 		eel_v_disown_nz(&ti->value);
 	}
-	eel_free(eo->vm, t->items);
+	eel_mp_free(eo->vm, t->items);
+	eel_mp_free(eo->vm, t->index);
 	return 0;
 }
 
@@ -329,6 +382,8 @@ static EEL_xno t_construct(EEL_vm *vm, EEL_classes cid,
 	t->items = NULL;
 	t->asize = 0;
 	t->length = 0;
+	t->index = NULL;
+	t->ibits = 0;
 	if(!initc)
 	{
 		eel_o2v(result, eo);
@@ -364,13 +419,28 @@ static inline EEL_object *t__clone(EEL_object *orig)
 		return NULL;
 	clonet = o2EEL_table(clone);
 	len = origt->length;
-	clonet->items = (EEL_tableitem *)eel_malloc(orig->vm,
+	clonet->items = (EEL_tableitem *)eel_mp_alloc(orig->vm,
 			sizeof(EEL_tableitem) * len);
-	if(!clonet->items)
+	if(!clonet->items && len)
 	{
 		eel_o_free(clone);
 		return NULL;
 	}
+	clonet->index = NULL;
+	clonet->ibits = origt->ibits;
+	if(origt->index)
+	{
+		clonet->index = (int *)eel_mp_alloc(orig->vm,
+				sizeof(int) << origt->ibits);
+		if(!clonet->index)
+		{
+			eel_mp_free(orig->vm, clonet->items);
+			eel_o_free(clone);
+			return NULL;
+		}
+		memcpy(clonet->index, origt->index,
+				sizeof(int) << origt->ibits);
+	}
 	for(i = 0; i < len; ++i)
 	{
 		clonet->items[i].hash = origt->items[i].hash;
@@ -441,7 +511,7 @@ static EEL_xno t_insert(EEL_object *eo, EEL_value *op1, EEL_value *op2)
 		return EEL_XWRONGINDEX;
 
 	/* Add new item */
-	if(!insert_item(eo, ~pos, op1, op2, h))
+	if(!insert_item(eo, op1, op2, h))
 		return EEL_XMEMORY;
 	return 0;
 }
@@ -452,7 +522,6 @@ static EEL_xno t_delete(EEL_object *eo, EEL_value *op1, EEL_value *op2)
 	int pos, i;
 	EEL_table *t = o2EEL_table(eo);
 	EEL_tableitem *ti = t->items;
-	EEL_hash h;
 	if(op2)
 		return EEL_XWRONGINDEX;	/* Can't do ranges with tables! */
 	if(!op1)
@@ -463,27 +532,13 @@ static EEL_xno t_delete(EEL_object *eo, EEL_value *op1, EEL_value *op2)
 			eel_v_disown_nz(&ti[i].value);
 		}
 		t_setsize(eo, 0);
+		t__reindex(eo);
 		return 0;
 	}
-	h = eel_v2hash(op1);
-	pos = t__find(eo, op1, h);
+	pos = t__find(eo, op1, eel_v2hash(op1));
 	if(pos < 0)
 		return EEL_XWRONGINDEX;
-
-	/* Clean out item */
-	eel_v_disown_nz(&ti[pos].key);
-	eel_v_disown_nz(&ti[pos].value);
-
-	/* Shift subsequent items */
-	for(i = pos; i < t->length - 1; ++i)
-	{
-		ti[i].hash = ti[i + 1].hash;
-		eel_v_move(&ti[i].key, &ti[i + 1].key);
-		eel_v_move(&ti[i].value, &ti[i + 1].value);
-	}
-
-	/* Truncate */
-	t_setsize(eo, t->length - 1);
+	remove_item(eo, pos);
 	return 0;
 }
 
@@ -581,6 +636,19 @@ EEL_xno eel_table_get(EEL_object *to, EEL_value *key, EEL_value *value)
 }
 
 
+int eel_table_find(EEL_object *to, EEL_value *key)
+{
+#ifdef EEL_VM_CHECKING
+	if(to->classid != EEL_CTABLE)
+		eel_ierror(eel_vm2p(to->vm)->state,
+				"eel_table_find() used on "
+				"non-table object %s!\n",
+				eel_o_stringrep(to));
+#endif
+	return t__find(to, key, eel_v2hash(key));
+}
+
+
 EEL_xno eel_table_gets(EEL_object *to, const char *key, EEL_value *value)
 {
 	EEL_vm *vm = to->vm;
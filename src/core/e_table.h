@@ -27,14 +27,29 @@
 #include "EEL.h"
 #include "EEL_types.h"
 #include "e_config.h"
+#include "e_cycle.h"
 
-typedef struct EEL_tableitem EEL_tableitem;
+typedef struct EEL_tableitem
+{
+	EEL_hash	hash;
+	EEL_value	key;
+	EEL_value	value;
+} EEL_tableitem;
 
+/*
+ * Items are kept in a dense array, in insertion order. (Deleting an item moves
+ * the last item into the hole.) Tables with more than EEL_TABLE_INDEXMIN
+ * items also get an open addressing hash index, mapping hash codes to item
+ * positions.
+ */
 typedef struct
 {
+	EEL_ccnode	cc;		/* MUST be first! */
 	int		length;		/* # of items */
 	int		asize;		/* Current size of array */
 	EEL_tableitem	*items;
+	int		ibits;		/* log2 of index size; 0 if no index */
+	int		*index;		/* Item positions; -1 for free slots */
 } EEL_table;
 
 EEL_MAKE_CAST(EEL_table)
@@ -52,6 +67,9 @@ void eel_ctable_register(EEL_vm *vm);
 /* Iteration */
 EEL_tableitem *eel_table_get_item(EEL_object *to, int i);
 
+/* Lookup; returns the position of the item with key 'key', or -1 */
+int eel_table_find(EEL_object *to, EEL_value *key);
+
 /* Item access */
 EEL_value *eel_table_get_key(EEL_tableitem *ti);
 EEL_value *eel_table_get_value(EEL_tableitem *ti);
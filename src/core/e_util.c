@@ -134,6 +134,7 @@ const char *eel_mm_name(EEL_mmindex mm)
 	  MMN(COPY)
 	  MMN(INSERT)
 	  MMN(DELETE)
+	  MMN(SLICE)
 	  MMN(LENGTH)
 	  MMN(COMPARE)
 	  MMN(EQ)
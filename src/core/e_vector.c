@@ -28,6 +28,7 @@
 #include "e_vm.h"
 #include "e_string.h"
 #include "e_register.h"
+#include "e_vkernel.h"
 
 
 static inline EEL_xno v_setsize(EEL_object *eo, int newsize)
@@ -46,6 +47,15 @@ static inline EEL_xno v_setsize(EEL_object *eo, int newsize)
 }
 
 
+/* Views and vectors with views cannot change size */
+static inline EEL_xno v_resizable(EEL_vector *v)
+{
+	if(v->parent || v->views)
+		return EEL_XSHARINGVIOLATION;
+	return 0;
+}
+
+
 /* Fast cast and write - no index checking! */
 static inline EEL_xno write_index(EEL_object *eo, int i, EEL_value *v)
 {
@@ -227,6 +237,27 @@ static inline int item_size(EEL_classes vt)
 }
 
 
+static inline EEL_vktypes vk_type(EEL_classes vt)
+{
+	switch(vt)
+	{
+	  case EEL_CVECTOR_U8:
+	  case EEL_CVECTOR_S8:
+		return EEL_VK_8;
+	  case EEL_CVECTOR_U16:
+	  case EEL_CVECTOR_S16:
+		return EEL_VK_16;
+	  case EEL_CVECTOR_U32:
+	  case EEL_CVECTOR_S32:
+		return EEL_VK_32;
+	  case EEL_CVECTOR_F:
+		return EEL_VK_F;
+	  default:
+		return EEL_VK_D;
+	}
+}
+
+
 static EEL_xno v_delete(EEL_object *eo, EEL_value *op1, EEL_value *op2)
 {
 	EEL_vector *v = o2EEL_vector(eo);
@@ -234,6 +265,8 @@ static EEL_xno v_delete(EEL_object *eo, EEL_value *op1, EEL_value *op2)
 	EEL_xno x = eel_get_delete_range(&i0, &i1, op1, op2, v->length);
 	if(x)
 		return x;
+	if((x = v_resizable(v)))
+		return x;
 	is = item_size(eo->classid);
 	memmove(v->buffer.u8 + i0 * is, v->buffer.u8 + (i1 + 1) * is,
 			(v->length - i1 - 1) * is);
@@ -262,6 +295,8 @@ static inline int make_clone_nc(EEL_vm *vm, EEL_object *clone,
 	clonev->isize = origv->isize;
 	clonev->maxlength = origv->length;
 	clonev->length = origv->length;
+	clonev->parent = NULL;
+	clonev->views = 0;
 	return 0;
 }
 
@@ -310,6 +345,8 @@ static EEL_xno v_construct(EEL_vm *vm, EEL_classes cid,
 	vec->isize = item_size(eo->classid);
 	vec->length = vec->maxlength = 0;
 	vec->buffer.u8 = NULL;
+	vec->parent = NULL;
+	vec->views = 0;
 	if(!initc)
 	{
 		eel_o2v(result, eo);
@@ -347,6 +384,8 @@ EEL_object *eel_cv_new_noinit(EEL_vm *vm, EEL_classes cid, unsigned size)
 	vec = o2EEL_vector(eo);
 	vec->isize = item_size(eo->classid);
 	vec->length = vec->maxlength = size;
+	vec->parent = NULL;
+	vec->views = 0;
 	vec->buffer.u8 = eel_malloc(vm, vec->length * vec->isize);
 	if(!vec->buffer.u8)
 	{
@@ -357,9 +396,37 @@ EEL_object *eel_cv_new_noinit(EEL_vm *vm, EEL_classes cid, unsigned size)
 }
 
 
+EEL_object *eel_cv_new_view(EEL_object *v, int start, int length)
+{
+	EEL_vector *vec;
+	EEL_vector *pv = o2EEL_vector(v);
+	EEL_object *eo = eel_o_alloc(v->vm, sizeof(EEL_vector), v->classid);
+	if(!eo)
+		return NULL;
+	vec = o2EEL_vector(eo);
+	vec->isize = pv->isize;
+	vec->length = vec->maxlength = length;
+	vec->buffer.u8 = pv->buffer.u8 + start * pv->isize;
+	vec->views = 0;
+
+	/* Views of views are views of the original buffer */
+	vec->parent = pv->parent ? pv->parent : v;
+	++o2EEL_vector(vec->parent)->views;
+	eel_o_own(vec->parent);
+	return eo;
+}
+
+
 static EEL_xno v_destruct(EEL_object *eo)
 {
-	eel_free(eo->vm, o2EEL_vector(eo)->buffer.u8);
+	EEL_vector *vec = o2EEL_vector(eo);
+	if(vec->parent)
+	{
+		--o2EEL_vector(vec->parent)->views;
+		eel_o_disown_nz(vec->parent);
+	}
+	else
+		eel_free(eo->vm, vec->buffer.u8);
 	return 0;
 }
 
@@ -459,6 +526,8 @@ static EEL_xno v_setindex(EEL_object *eo, EEL_value *op1, EEL_value *op2)
 
 	if(i >= vec->length)
 	{
+		if((x = v_resizable(vec)))
+			return x;
 		if(v_setsize(eo, i + 1) < 0)
 			return EEL_XMEMORY;
 		if(i > vec->length)
@@ -501,6 +570,8 @@ static EEL_xno v_insert(EEL_object *eo, EEL_value *op1, EEL_value *op2)
 	}
 	if(i < 0)
 		return EEL_XLOWINDEX;
+	if((x = v_resizable(v)))
+		return x;
 
 	/* Extend buffer if needed */
 	x = v_setsize(eo, v->length + 1);
@@ -547,6 +618,8 @@ static EEL_xno v_copy(EEL_object *eo, EEL_value *op1, EEL_value *op2)
 	sv->isize = ov->isize;
 	sv->maxlength = length;
 	sv->length = length;
+	sv->parent = NULL;
+	sv->views = 0;
 	memcpy(sv->buffer.u8, ov->buffer.u8 + start * ov->isize,
 			length * ov->isize);
 	eel_o2v(op2, so);
@@ -554,25 +627,32 @@ static EEL_xno v_copy(EEL_object *eo, EEL_value *op1, EEL_value *op2)
 }
 
 
-static EEL_xno v_length(EEL_object *eo, EEL_value *op1, EEL_value *op2)
+static EEL_xno v_slice(EEL_object *eo, EEL_value *op1, EEL_value *op2)
 {
-	op2->classid = EEL_CINTEGER;
-	op2->integer.v = o2EEL_vector(eo)->length;
+	EEL_vector *ov = o2EEL_vector(eo);
+	EEL_object *so;
+	int start = eel_v2l(op1);
+	int length = eel_v2l(op2);
+	if(start < 0)
+		return EEL_XLOWINDEX;
+	else if(start > ov->length)
+		return EEL_XHIGHINDEX;
+	if(length < 0)
+		return EEL_XWRONGINDEX;
+	else if(start + length > ov->length)
+		return EEL_XHIGHINDEX;
+	so = eel_cv_new_view(eo, start, length);
+	if(!so)
+		return EEL_XMEMORY;
+	eel_o2v(op2, so);
 	return 0;
 }
 
 
-static inline int vcmp_u8_u8(EEL_uint8 *a, EEL_uint8 *b, int length)
+static EEL_xno v_length(EEL_object *eo, EEL_value *op1, EEL_value *op2)
 {
-	int i;
-	for(i = 0; i < length; ++i)
-		if(a[i] != b[i])
-		{
-			if(a[i] > b[i])
-				return 1;
-			else/* if(a[i] < b[i])*/
-				return -1;
-		}
+	op2->classid = EEL_CINTEGER;
+	op2->integer.v = o2EEL_vector(eo)->length;
 	return 0;
 }
 
@@ -580,6 +660,7 @@ static inline int vcmp_u8_u8(EEL_uint8 *a, EEL_uint8 *b, int length)
 static EEL_xno v_compare(EEL_object *eo, EEL_value *op1, EEL_value *op2)
 {
 	EEL_vector *v, *ov;
+	int i;
 	if(!EEL_IS_OBJREF(op1->classid))
 		return EEL_XWRONGTYPE;
 
@@ -599,22 +680,15 @@ static EEL_xno v_compare(EEL_object *eo, EEL_value *op1, EEL_value *op2)
 		op2->integer.v = -1;
 		return 0;
 	}
-	switch(eo->classid)
-	{
-	  case EEL_CVECTOR_U8:
-		op2->integer.v = vcmp_u8_u8(v->buffer.u8, ov->buffer.u8, v->length);
-		return 0;
-	  case EEL_CVECTOR_S8:
-	  case EEL_CVECTOR_U16:
-	  case EEL_CVECTOR_S16:
-	  case EEL_CVECTOR_U32:
-	  case EEL_CVECTOR_S32:
-	  case EEL_CVECTOR_F:
-	  case EEL_CVECTOR_D:
-		return EEL_XNOTIMPLEMENTED;
-	  default:
-		return EEL_XINTERNAL;
-	}
+	i = eel_vk->mismatch[vk_type(eo->classid)](v->buffer.u8,
+			ov->buffer.u8, v->length);
+	if(i >= v->length)
+		op2->integer.v = 0;
+	else if(get_rvalue(eo, i) > get_rvalue(op1->objref.v, i))
+		op2->integer.v = 1;
+	else
+		op2->integer.v = -1;
+	return 0;
 }
 
 
@@ -654,303 +728,200 @@ static EEL_xno v_clone(EEL_vm *vm,
 }
 
 
-static inline EEL_xno do_vadd(EEL_object *eo, EEL_value *op1, EEL_object *to)
+/*
+ * Convert 'n' items from 'o', starting at 'start', to kernel type 'dt' in
+ * 'd', the way get_ivalue() and get_rvalue() would.
+ */
+static void vk_convert(void *d, EEL_vktypes dt, EEL_object *o, int start,
+		int n)
 {
+	EEL_vector *vec = o2EEL_vector(o);
 	int i;
-	EEL_integer iv;
-	EEL_real rv;
-	EEL_vector *source = o2EEL_vector(eo);
-	EEL_vector *target = o2EEL_vector(to);
-	switch(op1->classid)
+	switch(dt)
 	{
-	  case EEL_CNIL:
-		if(target == source)
-			return 0;
-		memcpy(target->buffer.u8, source->buffer.u8,
-				source->length * source->isize);
-		return 0;
-	  case EEL_CBOOLEAN:
-	  case EEL_CINTEGER:
-	  case EEL_CCLASSID:
-		switch(eo->classid)
-		{
-		  /*
-		   * Sign is irrelevant to addition, so we group u* and s*.
-		   */
-		  case EEL_CVECTOR_U8:
-		  case EEL_CVECTOR_S8:
-			for(i = 0; i < source->length; ++i)
-				target->buffer.u8[i] = source->buffer.u8[i] +
-						op1->integer.v;
-			return 0;
-		  case EEL_CVECTOR_U16:
-		  case EEL_CVECTOR_S16:
-			for(i = 0; i < source->length; ++i)
-				target->buffer.u16[i] = source->buffer.u16[i] +
-						op1->integer.v;
-			return 0;
-		  case EEL_CVECTOR_U32:
-		  case EEL_CVECTOR_S32:
-			for(i = 0; i < source->length; ++i)
-				target->buffer.u32[i] = source->buffer.u32[i] +
-						op1->integer.v;
-			return 0;
-		  case EEL_CVECTOR_F:
-			rv = op1->integer.v;
-			for(i = 0; i < source->length; ++i)
-				target->buffer.f[i] = source->buffer.f[i] + rv;
-			return 0;
-		  case EEL_CVECTOR_D:
-			rv = op1->integer.v;
-			for(i = 0; i < source->length; ++i)
-				target->buffer.d[i] = source->buffer.d[i] + rv;
-			return 0;
-		  default:
-			return EEL_XINTERNAL;
-		}
-	  case EEL_CREAL:
-		switch(eo->classid)
+	  case EEL_VK_8:
+		for(i = 0; i < n; ++i)
+			((EEL_uint8 *)d)[i] = get_ivalue(o, start + i);
+		return;
+	  case EEL_VK_16:
+		for(i = 0; i < n; ++i)
+			((EEL_uint16 *)d)[i] = get_ivalue(o, start + i);
+		return;
+	  case EEL_VK_32:
+		for(i = 0; i < n; ++i)
+			((EEL_uint32 *)d)[i] = get_ivalue(o, start + i);
+		return;
+	  case EEL_VK_F:
+		if(o->classid == EEL_CVECTOR_S16)
 		{
-		  case EEL_CVECTOR_U8:
-		  case EEL_CVECTOR_S8:
-			iv = floor(op1->real.v);
-			for(i = 0; i < source->length; ++i)
-				target->buffer.u8[i] = source->buffer.u8[i] + iv;
-			return 0;
-		  case EEL_CVECTOR_U16:
-		  case EEL_CVECTOR_S16:
-			iv = floor(op1->real.v);
-			for(i = 0; i < source->length; ++i)
-				target->buffer.u16[i] = source->buffer.u16[i] + iv;
-			return 0;
-		  case EEL_CVECTOR_U32:
-		  case EEL_CVECTOR_S32:
-			iv = floor(op1->real.v);
-			for(i = 0; i < source->length; ++i)
-				target->buffer.u32[i] = source->buffer.u32[i] + iv;
-			return 0;
-		  case EEL_CVECTOR_F:
-			for(i = 0; i < source->length; ++i)
-				target->buffer.f[i] = source->buffer.f[i] +
-						op1->real.v;
-			return 0;
-		  case EEL_CVECTOR_D:
-			for(i = 0; i < source->length; ++i)
-				target->buffer.d[i] = source->buffer.d[i] +
-						op1->real.v;
-			return 0;
-		  default:
-			return EEL_XINTERNAL;
+			eel_vk->s16_2f(d, vec->buffer.s16 + start, n);
+			return;
 		}
-	  case EEL_COBJREF:
-	  case EEL_CWEAKREF:
-	  {
-		switch(eo->classid)
+		for(i = 0; i < n; ++i)
+			((float *)d)[i] = get_rvalue(o, start + i);
+		return;
+	  case EEL_VK_D:
+		switch(o->classid)
 		{
-		  case EEL_CVECTOR_U8:
-		  case EEL_CVECTOR_S8:
-			for(i = 0; i < source->length; ++i)
-				target->buffer.u8[i] = source->buffer.u8[i] +
-						get_ivalue(op1->objref.v, i);
-			return 0;
-		  case EEL_CVECTOR_U16:
-		  case EEL_CVECTOR_S16:
-			for(i = 0; i < source->length; ++i)
-				target->buffer.u16[i] = source->buffer.u16[i] +
-						get_ivalue(op1->objref.v, i);
-			return 0;
-		  case EEL_CVECTOR_U32:
 		  case EEL_CVECTOR_S32:
-			for(i = 0; i < source->length; ++i)
-				target->buffer.u32[i] = source->buffer.u32[i] +
-						get_ivalue(op1->objref.v, i);
-			return 0;
+			eel_vk->s32_2d(d, vec->buffer.s32 + start, n);
+			return;
 		  case EEL_CVECTOR_F:
-			for(i = 0; i < source->length; ++i)
-				target->buffer.f[i] = source->buffer.f[i] +
-						get_rvalue(op1->objref.v, i);
-			return 0;
+			eel_vk->f2d(d, vec->buffer.f + start, n);
+			return;
 		  case EEL_CVECTOR_D:
-			for(i = 0; i < source->length; ++i)
-				target->buffer.d[i] = source->buffer.d[i] +
-						get_rvalue(op1->objref.v, i);
-			return 0;
+			memcpy(d, vec->buffer.d + start, n * sizeof(double));
+			return;
 		  default:
-			return EEL_XWRONGTYPE;
+			for(i = 0; i < n; ++i)
+				((double *)d)[i] = get_rvalue(o, start + i);
+			return;
 		}
-	  }
 	  default:
-		return EEL_XWRONGTYPE;
+		return;
 	}
 }
 
 
-static EEL_xno v_vadd(EEL_object *eo, EEL_value *op1, EEL_value *op2)
+/* Returns non-zero if the buffers of 'a' and 'b' overlap, but do not match */
+static inline int v_aliased(EEL_vector *a, EEL_vector *b)
 {
-	EEL_xno x;
-	EEL_object *to = empty_clone(eo);
-	if(!to)
-		return EEL_XMEMORY;
-	x = do_vadd(eo, op1, to);
-	if(x)
+	const EEL_uint8 *a0 = a->buffer.u8;
+	const EEL_uint8 *b0 = b->buffer.u8;
+	return (a0 != b0) && (a0 < b0 + b->length * b->isize) &&
+			(b0 < a0 + a->length * a->isize);
+}
+
+
+/* target = source <op> o, where 'o' is an object */
+static EEL_xno do_vop_object(EEL_object *eo, EEL_object *o,
+		EEL_object *to, EEL_vkops op)
+{
+	EEL_vector *source = o2EEL_vector(eo);
+	EEL_vector *target = o2EEL_vector(to);
+	EEL_vktypes t = vk_type(eo->classid);
+	int is = source->isize;
+	int n = source->length;
+	int m = 0;
+	if((o->classid >= EEL_CVECTOR_U8) && (o->classid <= EEL_CVECTOR_D))
 	{
-		eel_o_free(to);
-		return x;
+		EEL_vector *other = o2EEL_vector(o);
+		EEL_vktypes ot = vk_type(o->classid);
+		if(v_aliased(target, other))
+		{
+			/* 'o' is a view overlapping the target; use a copy */
+			EEL_xno x;
+			EEL_object *tmp = full_clone(o);
+			if(!tmp)
+				return EEL_XMEMORY;
+			x = do_vop_object(eo, tmp, to, op);
+			eel_o_disown_nz(tmp);
+			return x;
+		}
+		m = other->length < n ? other->length : n;
+		if(ot == t)
+			eel_vk->vv[op][t](target->buffer.u8,
+					source->buffer.u8, other->buffer.u8, m);
+		else
+		{
+			/*
+			 * Integer items that fit in a float can be operated on
+			 * as floats with the same result, but larger ones must
+			 * be applied to float vectors in double precision.
+			 */
+			double buf[EEL_VK_CHUNK];
+			int i, c;
+			int fd = (t == EEL_VK_F) && ((ot == EEL_VK_32) ||
+					(ot == EEL_VK_D));
+			for(i = 0; i < m; i += c)
+			{
+				c = m - i < EEL_VK_CHUNK ? m - i : EEL_VK_CHUNK;
+				if(fd)
+				{
+					vk_convert(buf, EEL_VK_D, o, i, c);
+					eel_vk->fd[op](target->buffer.f + i,
+							source->buffer.f + i,
+							buf, c);
+				}
+				else
+				{
+					vk_convert(buf, t, o, i, c);
+					eel_vk->vv[op][t](
+							target->buffer.u8 + i * is,
+							source->buffer.u8 + i * is,
+							buf, c);
+				}
+			}
+		}
 	}
-	eel_o2v(op2, to);
+
+	/* Items past the end of 'o' are 0 */
+	if(m < n)
+		eel_vk->vs[op][t](target->buffer.u8 + m * is,
+				source->buffer.u8 + m * is, 0.0, n - m);
 	return 0;
 }
 
 
-static EEL_xno v_ipvadd(EEL_object *eo, EEL_value *op1, EEL_value *op2)
+/*
+ * Scalar operand 'v' (integer, boolean, class ID or real) as applied to items
+ * of kernel type 't'. Reals are floored for integer items.
+ */
+static inline double vk_scalar(EEL_vktypes t, EEL_value *v)
 {
-	EEL_xno x = do_vadd(eo, op1, eo);
-	if(x)
-		return x;
-	eel_o_own(eo);
-	eel_o2v(op2, eo);
-	return 0;
+	EEL_integer iv;
+	if(v->classid != EEL_CREAL)
+		return v->integer.v;
+	if((t == EEL_VK_F) || (t == EEL_VK_D))
+		return v->real.v;
+	iv = floor(v->real.v);
+	return iv;
 }
 
 
-static inline EEL_xno do_vsub(EEL_object *eo, EEL_value *op1, EEL_object *to)
+/* target = source <op> op1 */
+static inline EEL_xno do_vop(EEL_object *eo, EEL_value *op1, EEL_object *to,
+		EEL_vkops op)
 {
-	int i;
-	EEL_integer iv;
-	EEL_real rv;
 	EEL_vector *source = o2EEL_vector(eo);
 	EEL_vector *target = o2EEL_vector(to);
+	EEL_vktypes t = vk_type(eo->classid);
 	switch(op1->classid)
 	{
 	  case EEL_CNIL:
 		if(target == source)
 			return 0;
-		memcpy(target->buffer.u8, source->buffer.u8,
-				source->length * source->isize);
+		if(op == EEL_VK_MUL)
+			memset(target->buffer.u8, 0,
+					source->length * source->isize);
+		else
+			memcpy(target->buffer.u8, source->buffer.u8,
+					source->length * source->isize);
 		return 0;
 	  case EEL_CBOOLEAN:
 	  case EEL_CINTEGER:
 	  case EEL_CCLASSID:
-		switch(eo->classid)
-		{
-		  /*
-		   * Sign is irrelevant to addition, so we group u* and s*.
-		   */
-		  case EEL_CVECTOR_U8:
-		  case EEL_CVECTOR_S8:
-			for(i = 0; i < source->length; ++i)
-				target->buffer.u8[i] = source->buffer.u8[i] -
-						op1->integer.v;
-			return 0;
-		  case EEL_CVECTOR_U16:
-		  case EEL_CVECTOR_S16:
-			for(i = 0; i < source->length; ++i)
-				target->buffer.u16[i] = source->buffer.u16[i] -
-						op1->integer.v;
-			return 0;
-		  case EEL_CVECTOR_U32:
-		  case EEL_CVECTOR_S32:
-			for(i = 0; i < source->length; ++i)
-				target->buffer.u32[i] = source->buffer.u32[i] -
-						op1->integer.v;
-			return 0;
-		  case EEL_CVECTOR_F:
-			rv = op1->integer.v;
-			for(i = 0; i < source->length; ++i)
-				target->buffer.f[i] = source->buffer.f[i] - rv;
-			return 0;
-		  case EEL_CVECTOR_D:
-			rv = op1->integer.v;
-			for(i = 0; i < source->length; ++i)
-				target->buffer.d[i] = source->buffer.d[i] - rv;
-			return 0;
-		  default:
-			return EEL_XINTERNAL;
-		}
 	  case EEL_CREAL:
-		switch(eo->classid)
-		{
-		  case EEL_CVECTOR_U8:
-		  case EEL_CVECTOR_S8:
-			iv = floor(op1->real.v);
-			for(i = 0; i < source->length; ++i)
-				target->buffer.u8[i] = source->buffer.u8[i] - iv;
-			return 0;
-		  case EEL_CVECTOR_U16:
-		  case EEL_CVECTOR_S16:
-			iv = floor(op1->real.v);
-			for(i = 0; i < source->length; ++i)
-				target->buffer.u16[i] = source->buffer.u16[i] - iv;
-			return 0;
-		  case EEL_CVECTOR_U32:
-		  case EEL_CVECTOR_S32:
-			iv = floor(op1->real.v);
-			for(i = 0; i < source->length; ++i)
-				target->buffer.u32[i] = source->buffer.u32[i] - iv;
-			return 0;
-		  case EEL_CVECTOR_F:
-			for(i = 0; i < source->length; ++i)
-				target->buffer.f[i] = source->buffer.f[i] -
-						op1->real.v;
-			return 0;
-		  case EEL_CVECTOR_D:
-			for(i = 0; i < source->length; ++i)
-				target->buffer.d[i] = source->buffer.d[i] -
-						op1->real.v;
-			return 0;
-		  default:
-			return EEL_XINTERNAL;
-		}
+		eel_vk->vs[op][t](target->buffer.u8, source->buffer.u8,
+				vk_scalar(t, op1), source->length);
+		return 0;
 	  case EEL_COBJREF:
 	  case EEL_CWEAKREF:
-	  {
-		switch(eo->classid)
-		{
-		  case EEL_CVECTOR_U8:
-		  case EEL_CVECTOR_S8:
-			for(i = 0; i < source->length; ++i)
-				target->buffer.u8[i] = source->buffer.u8[i] -
-						get_ivalue(op1->objref.v, i);
-			return 0;
-		  case EEL_CVECTOR_U16:
-		  case EEL_CVECTOR_S16:
-			for(i = 0; i < source->length; ++i)
-				target->buffer.u16[i] = source->buffer.u16[i] -
-						get_ivalue(op1->objref.v, i);
-			return 0;
-		  case EEL_CVECTOR_U32:
-		  case EEL_CVECTOR_S32:
-			for(i = 0; i < source->length; ++i)
-				target->buffer.u32[i] = source->buffer.u32[i] -
-						get_ivalue(op1->objref.v, i);
-			return 0;
-		  case EEL_CVECTOR_F:
-			for(i = 0; i < source->length; ++i)
-				target->buffer.f[i] = source->buffer.f[i] -
-						get_rvalue(op1->objref.v, i);
-			return 0;
-		  case EEL_CVECTOR_D:
-			for(i = 0; i < source->length; ++i)
-				target->buffer.d[i] = source->buffer.d[i] -
-						get_rvalue(op1->objref.v, i);
-			return 0;
-		  default:
-			return EEL_XWRONGTYPE;
-		}
-	  }
+		return do_vop_object(eo, op1->objref.v, to, op);
 	  default:
 		return EEL_XWRONGTYPE;
 	}
 }
 
 
-static EEL_xno v_vsub(EEL_object *eo, EEL_value *op1, EEL_value *op2)
+static inline EEL_xno v_vop(EEL_object *eo, EEL_value *op1, EEL_value *op2,
+		EEL_vkops op)
 {
 	EEL_xno x;
 	EEL_object *to = empty_clone(eo);
 	if(!to)
 		return EEL_XMEMORY;
-	x = do_vsub(eo, op1, to);
+	x = do_vop(eo, op1, to, op);
 	if(x)
 	{
 		eel_o_free(to);
@@ -961,9 +932,10 @@ static EEL_xno v_vsub(EEL_object *eo, EEL_value *op1, EEL_value *op2)
 }
 
 
-static EEL_xno v_ipvsub(EEL_object *eo, EEL_value *op1, EEL_value *op2)
+static inline EEL_xno v_ipvop(EEL_object *eo, EEL_value *op1, EEL_value *op2,
+		EEL_vkops op)
 {
-	EEL_xno x = do_vsub(eo, op1, eo);
+	EEL_xno x = do_vop(eo, op1, eo, op);
 	if(x)
 		return x;
 	eel_o_own(eo);
@@ -972,161 +944,39 @@ static EEL_xno v_ipvsub(EEL_object *eo, EEL_value *op1, EEL_value *op2)
 }
 
 
-static inline EEL_xno do_vmul(EEL_object *eo, EEL_value *op1, EEL_object *to)
+static EEL_xno v_vadd(EEL_object *eo, EEL_value *op1, EEL_value *op2)
 {
-	int i;
-	EEL_integer iv;
-	EEL_real rv;
-	EEL_vector *source = o2EEL_vector(eo);
-	EEL_vector *target = o2EEL_vector(to);
-	switch(op1->classid)
-	{
-	  case EEL_CNIL:
-		if(target == source)
-			return 0;
-		memset(target->buffer.u8, 0, source->length * source->isize);
-		return 0;
-	  case EEL_CBOOLEAN:
-	  case EEL_CINTEGER:
-	  case EEL_CCLASSID:
-		switch(eo->classid)
-		{
-		  /*
-		   * Sign is irrelevant to addition, so we group u* and s*.
-		   */
-		  case EEL_CVECTOR_U8:
-		  case EEL_CVECTOR_S8:
-			for(i = 0; i < source->length; ++i)
-				target->buffer.u8[i] = source->buffer.u8[i] *
-						op1->integer.v;
-			return 0;
-		  case EEL_CVECTOR_U16:
-		  case EEL_CVECTOR_S16:
-			for(i = 0; i < source->length; ++i)
-				target->buffer.u16[i] = source->buffer.u16[i] *
-						op1->integer.v;
-			return 0;
-		  case EEL_CVECTOR_U32:
-		  case EEL_CVECTOR_S32:
-			for(i = 0; i < source->length; ++i)
-				target->buffer.u32[i] = source->buffer.u32[i] *
-						op1->integer.v;
-			return 0;
-		  case EEL_CVECTOR_F:
-			rv = op1->integer.v;
-			for(i = 0; i < source->length; ++i)
-				target->buffer.f[i] = source->buffer.f[i] * rv;
-			return 0;
-		  case EEL_CVECTOR_D:
-			rv = op1->integer.v;
-			for(i = 0; i < source->length; ++i)
-				target->buffer.d[i] = source->buffer.d[i] * rv;
-			return 0;
-		  default:
-			return EEL_XINTERNAL;
-		}
-	  case EEL_CREAL:
-		switch(eo->classid)
-		{
-		  case EEL_CVECTOR_U8:
-		  case EEL_CVECTOR_S8:
-			iv = floor(op1->real.v);
-			for(i = 0; i < source->length; ++i)
-				target->buffer.u8[i] = source->buffer.u8[i] * iv;
-			return 0;
-		  case EEL_CVECTOR_U16:
-		  case EEL_CVECTOR_S16:
-			iv = floor(op1->real.v);
-			for(i = 0; i < source->length; ++i)
-				target->buffer.u16[i] = source->buffer.u16[i] * iv;
-			return 0;
-		  case EEL_CVECTOR_U32:
-		  case EEL_CVECTOR_S32:
-			iv = floor(op1->real.v);
-			for(i = 0; i < source->length; ++i)
-				target->buffer.u32[i] = source->buffer.u32[i] * iv;
-			return 0;
-		  case EEL_CVECTOR_F:
-			for(i = 0; i < source->length; ++i)
-				target->buffer.f[i] = source->buffer.f[i] *
-						op1->real.v;
-			return 0;
-		  case EEL_CVECTOR_D:
-			for(i = 0; i < source->length; ++i)
-				target->buffer.d[i] = source->buffer.d[i] *
-						op1->real.v;
-			return 0;
-		  default:
-			return EEL_XINTERNAL;
-		}
-	  case EEL_COBJREF:
-	  case EEL_CWEAKREF:
-	  {
-		switch(eo->classid)
-		{
-		  case EEL_CVECTOR_U8:
-		  case EEL_CVECTOR_S8:
-			for(i = 0; i < source->length; ++i)
-				target->buffer.u8[i] = source->buffer.u8[i] *
-						get_ivalue(op1->objref.v, i);
-			return 0;
-		  case EEL_CVECTOR_U16:
-		  case EEL_CVECTOR_S16:
-			for(i = 0; i < source->length; ++i)
-				target->buffer.u16[i] = source->buffer.u16[i] *
-						get_ivalue(op1->objref.v, i);
-			return 0;
-		  case EEL_CVECTOR_U32:
-		  case EEL_CVECTOR_S32:
-			for(i = 0; i < source->length; ++i)
-				target->buffer.u32[i] = source->buffer.u32[i] *
-						get_ivalue(op1->objref.v, i);
-			return 0;
-		  case EEL_CVECTOR_F:
-			for(i = 0; i < source->length; ++i)
-				target->buffer.f[i] = source->buffer.f[i] *
-						get_rvalue(op1->objref.v, i);
-			return 0;
-		  case EEL_CVECTOR_D:
-			for(i = 0; i < source->length; ++i)
-				target->buffer.d[i] = source->buffer.d[i] *
-						get_rvalue(op1->objref.v, i);
-			return 0;
-		  default:
-			return EEL_XWRONGTYPE;
-		}
-	  }
-	  default:
-		return EEL_XWRONGTYPE;
-	}
+	return v_vop(eo, op1, op2, EEL_VK_ADD);
+}
+
+
+static EEL_xno v_ipvadd(EEL_object *eo, EEL_value *op1, EEL_value *op2)
+{
+	return v_ipvop(eo, op1, op2, EEL_VK_ADD);
+}
+
+
+static EEL_xno v_vsub(EEL_object *eo, EEL_value *op1, EEL_value *op2)
+{
+	return v_vop(eo, op1, op2, EEL_VK_SUB);
+}
+
+
+static EEL_xno v_ipvsub(EEL_object *eo, EEL_value *op1, EEL_value *op2)
+{
+	return v_ipvop(eo, op1, op2, EEL_VK_SUB);
 }
 
 
 static EEL_xno v_vmul(EEL_object *eo, EEL_value *op1, EEL_value *op2)
 {
-	EEL_xno x;
-	EEL_object *to = empty_clone(eo);
-	if(!to)
-		return EEL_XMEMORY;
-	x = do_vmul(eo, op1, to);
-	if(x)
-	{
-		eel_o_free(to);
-		return x;
-	}
-	eel_o2v(op2, to);
-	return 0;
+	return v_vop(eo, op1, op2, EEL_VK_MUL);
 }
 
 
 static EEL_xno v_ipvmul(EEL_object *eo, EEL_value *op1, EEL_value *op2)
 {
-	EEL_xno x = do_vmul(eo, op1, eo);
-	if(x)
-		return x;
-	eel_o_own(eo);
-	eel_o2v(op2, eo);
-	return 0;
+	return v_ipvop(eo, op1, op2, EEL_VK_MUL);
 }
 
 
@@ -1139,6 +989,8 @@ static inline EEL_xno v__append(EEL_object *eo, EEL_value *op1, EEL_object *to)
 	int len = EEL_IS_OBJREF(op1->classid) ? eel_length(op1->objref.v) : -1;
 	if(!len)
 		return 0;	/* Nothing to do! */
+	if((x = v_resizable(vec)))
+		return x;
 	if(len > 0)
 	{
 		int i;
@@ -1235,6 +1087,8 @@ void eel_cvector_register(EEL_vm *vm)
 		"vector_f",	"vector_d"
 	};
 
+	eel_vk_init();
+
 	/* Register virtual base class */
 	eel_register_class(vm, EEL_CVECTOR, "vector", EEL_COBJECT,
 			default_construct, NULL, NULL);
@@ -1248,6 +1102,7 @@ void eel_cvector_register(EEL_vm *vm)
 		eel_set_metamethod(c, EEL_MM_GETINDEX, v_getindex);
 		eel_set_metamethod(c, EEL_MM_SETINDEX, v_setindex);
 		eel_set_metamethod(c, EEL_MM_COPY, v_copy);
+		eel_set_metamethod(c, EEL_MM_SLICE, v_slice);
 		eel_set_metamethod(c, EEL_MM_LENGTH, v_length);
 		eel_set_metamethod(c, EEL_MM_COMPARE, v_compare);
 		eel_set_metamethod(c, EEL_MM_SERIALIZE, v_serialize);
@@ -1267,68 +1122,260 @@ void eel_cvector_register(EEL_vm *vm)
 }
 
 
-#if 0
+/*----------------------------------------------------------
+	Fused vector expressions
+----------------------------------------------------------*/
+
+static inline int is_vector(EEL_value *v)
+{
+	return EEL_IS_OBJREF(v->classid) &&
+			(v->objref.v->classid >= EEL_CVECTOR_U8) &&
+			(v->objref.v->classid <= EEL_CVECTOR_D);
+}
+
+
+static inline int is_scalar(EEL_value *v)
+{
+	switch(v->classid)
+	{
+	  case EEL_CBOOLEAN:
+	  case EEL_CINTEGER:
+	  case EEL_CCLASSID:
+	  case EEL_CREAL:
+		return 1;
+	  default:
+		return 0;
+	}
+}
+
+
+static inline EEL_vkops vk_op(char c)
+{
+	switch(c)
+	{
+	  case '-':	return EEL_VK_SUB;
+	  case '*':	return EEL_VK_MUL;
+	  default:	return EEL_VK_ADD;
+	}
+}
+
+
+/* Stack entry; item pointer for vectors, or NULL and a scalar value */
+typedef struct
+{
+	const EEL_uint8	*items;
+	double		s;
+} VK_entry;
+
+
+EEL_xno eel_vector_expr(const char *expr, EEL_value *operands,
+		EEL_value *result)
+{
+	double tmp[EEL_VEXPR_MAXOPERANDS][EEL_VK_CHUNK];
+	VK_entry stack[EEL_VEXPR_MAXOPERANDS];
+	EEL_object *vo = NULL;
+	EEL_object *to;
+	EEL_vector *target;
+	EEL_vktypes t;
+	const char *e;
+	int sp, is, n, i, c;
+
+	/*
+	 * Check that we can do it. Scalars cannot be left hand operands, and
+	 * that's about all we need to know about intermediate results.
+	 */
+	for(e = expr, sp = 0; *e; ++e)
+	{
+		if((*e >= 'a') && (*e < 'a' + EEL_VEXPR_MAXOPERANDS) &&
+				(sp < EEL_VEXPR_MAXOPERANDS))
+		{
+			EEL_value *v = &operands[*e - 'a'];
+			if(is_vector(v))
+			{
+				EEL_object *o = v->objref.v;
+				if(!vo)
+					vo = o;
+				else if((o->classid != vo->classid) ||
+						(o2EEL_vector(o)->length !=
+						o2EEL_vector(vo)->length))
+					return EEL_XNOTIMPLEMENTED;
+				stack[sp++].items = o2EEL_vector(o)->buffer.u8;
+			}
+			else if(is_scalar(v))
+				stack[sp++].items = NULL;
+			else
+				return EEL_XNOTIMPLEMENTED;
+		}
+		else if((*e < 'a') && (sp >= 2) && stack[sp - 2].items)
+			--sp;
+		else
+			return EEL_XNOTIMPLEMENTED;
+	}
+	if((sp != 1) || !vo)
+		return EEL_XNOTIMPLEMENTED;
+
+	if(!(to = empty_clone(vo)))
+		return EEL_XMEMORY;
+	target = o2EEL_vector(to);
+	t = vk_type(to->classid);
+	is = target->isize;
+	n = target->length;
+	for(i = 0; i < n; i += c)
+	{
+		c = n - i < EEL_VK_CHUNK ? n - i : EEL_VK_CHUNK;
+		for(e = expr, sp = 0; *e; ++e)
+		{
+			VK_entry *l, *r;
+			void *d;
+			if(*e >= 'a')
+			{
+				EEL_value *v = &operands[*e - 'a'];
+				if(is_vector(v))
+					stack[sp].items = o2EEL_vector(
+							v->objref.v)->buffer.u8
+							+ i * is;
+				else
+				{
+					stack[sp].items = NULL;
+					stack[sp].s = vk_scalar(t, v);
+				}
+				++sp;
+				continue;
+			}
+
+			/* The last operator writes directly to the result */
+			l = &stack[sp - 2];
+			r = &stack[sp - 1];
+			if(e[1])
+				d = tmp[sp - 2];
+			else
+				d = target->buffer.u8 + i * is;
+			if(r->items)
+				eel_vk->vv[vk_op(*e)][t](d, l->items, r->items,
+						c);
+			else
+				eel_vk->vs[vk_op(*e)][t](d, l->items, r->s, c);
+			l->items = d;
+			--sp;
+		}
+	}
+	eel_o2v(result, to);
+	return 0;
+}
+
+
 /*----------------------------------------------------------
 	EEL Vector API
 ----------------------------------------------------------*/
 
+/* Check that 'count' items from 'start', 'vstride' apart, are inside 'v' */
+static EEL_xno v_checkrange(EEL_object *v, int start, int vstride, int count)
+{
+	int length, last;
+	if((v->classid < EEL_CVECTOR_U8) || (v->classid > EEL_CVECTOR_D))
+		return EEL_XWRONGTYPE;
+	if(count < 0)
+		return EEL_XWRONGINDEX;
+	if(!count)
+		return 0;
+	length = o2EEL_vector(v)->length;
+	last = start + (count - 1) * vstride;
+	if((start < 0) || (last < 0))
+		return EEL_XLOWINDEX;
+	if((start >= length) || (last >= length))
+		return EEL_XHIGHINDEX;
+	return 0;
+}
+
+
 EEL_xno eel_vector_read_i(EEL_object *v, int start, int vstride,
 		int *buf, int count, int bstride)
 {
-	return EEL_XNOTIMPLEMENTED;
+	int i;
+	EEL_xno x = v_checkrange(v, start, vstride, count);
+	if(x)
+		return x;
+	for(i = 0; i < count; ++i)
+		buf[i * bstride] = get_ivalue(v, start + i * vstride);
+	return 0;
 }
 
 
 EEL_xno eel_vector_read_f(EEL_object *v, int start, int vstride,
 		float *buf, int count, int bstride)
 {
-	return EEL_XNOTIMPLEMENTED;
+	int i;
+	EEL_xno x = v_checkrange(v, start, vstride, count);
+	if(x)
+		return x;
+	for(i = 0; i < count; ++i)
+		buf[i * bstride] = get_rvalue(v, start + i * vstride);
+	return 0;
 }
 
 
 EEL_xno eel_vector_read_d(EEL_object *v, int start, int vstride,
 		double *buf, int count, int bstride)
 {
-	EEL_vector *vec = o2EEL_vector(eo);
-	switch(v->type)
-	{
-	  case EEL_CVECTOR_U8:
-	  case EEL_CVECTOR_S8:
-	  case EEL_CVECTOR_U16:
-	  case EEL_CVECTOR_S16:
-	  case EEL_CVECTOR_U32:
-	  case EEL_CVECTOR_S32:
-	  case EEL_CVECTOR_F:
-		return EEL_XNOTIMPLEMENTED;
-	  case EEL_CVECTOR_D:
-	  {
-		vec->buffer.d[i];
-		return EEL_XNONE;
-	  }
-	  default:
-		return EEL_XWRONGTYPE;
-	}
-	return EEL_XNOTIMPLEMENTED;
+	int i;
+	EEL_xno x = v_checkrange(v, start, vstride, count);
+	if(x)
+		return x;
+	for(i = 0; i < count; ++i)
+		buf[i * bstride] = get_rvalue(v, start + i * vstride);
+	return 0;
 }
 
 
 EEL_xno eel_vector_write_i(EEL_object *v, int start, int vstride,
 		const int *buf, int count, int bstride)
 {
-	return EEL_XNOTIMPLEMENTED;
+	int i;
+	EEL_value val;
+	EEL_xno x = v_checkrange(v, start, vstride, count);
+	if(x)
+		return x;
+	val.classid = EEL_CINTEGER;
+	for(i = 0; i < count; ++i)
+	{
+		val.integer.v = buf[i * bstride];
+		write_index(v, start + i * vstride, &val);
+	}
+	return 0;
 }
 
 
 EEL_xno eel_vector_write_f(EEL_object *v, int start, int vstride,
 		const float *buf, int count, int bstride)
 {
-	return EEL_XNOTIMPLEMENTED;
+	int i;
+	EEL_value val;
+	EEL_xno x = v_checkrange(v, start, vstride, count);
+	if(x)
+		return x;
+	val.classid = EEL_CREAL;
+	for(i = 0; i < count; ++i)
+	{
+		val.real.v = buf[i * bstride];
+		write_index(v, start + i * vstride, &val);
+	}
+	return 0;
 }
 
 
 EEL_xno eel_vector_write_d(EEL_object *v, int start, int vstride,
 		const double *buf, int count, int bstride)
 {
-	return EEL_XNOTIMPLEMENTED;
+	int i;
+	EEL_value val;
+	EEL_xno x = v_checkrange(v, start, vstride, count);
+	if(x)
+		return x;
+	val.classid = EEL_CREAL;
+	for(i = 0; i < count; ++i)
+	{
+		val.real.v = buf[i * bstride];
+		write_index(v, start + i * vstride, &val);
+	}
+	return 0;
 }
-#endif
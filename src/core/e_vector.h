@@ -33,12 +33,18 @@
 
 /*
  * The actual vector class
+ *
+ * A vector can also be a view; a range of the items of another vector, that
+ * shares the buffer of that vector instead of owning one. Views keep their
+ * 'parent' alive, and neither can be resized while there are views.
  */
 typedef struct
 {
 	int		length;		/* # of items */
 	int		maxlength;	/* Buffer size (items) */
 	int		isize;		/* Size of one item (bytes) */
+	EEL_object	*parent;	/* Owner of the buffer, if a view */
+	int		views;		/* # of views of this buffer */
 	union
 	{
 		EEL_uint8	*u8;
@@ -54,4 +60,14 @@ typedef struct
 EEL_MAKE_CAST(EEL_vector)
 void eel_cvector_register(EEL_vm *vm);
 
+/*
+ * Evaluate the fused vector expression 'expr' (see EEL_IVEXPR) over 'operands'
+ * in a single pass, without creating intermediate vectors. This only handles
+ * expressions where the left hand operand of every operator is a vector, and
+ * all vector operands are of the same class and length. Anything else returns
+ * EEL_XNOTIMPLEMENTED, and should be evaluated one operator at a time instead.
+ */
+EEL_xno eel_vector_expr(const char *expr, EEL_value *operands,
+		EEL_value *result);
+
 #endif	/* EEL_E_VECTOR_H */
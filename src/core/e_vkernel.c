@@ -0,0 +1,733 @@
+/*
+---------------------------------------------------------------------------
+	e_vkernel.c - EEL Vector Kernels
+---------------------------------------------------------------------------
+ * Copyright 2026 David Olofson
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from the
+ * use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include <string.h>
+#include "e_vkernel.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#	define	VK_X86
+#	include <immintrin.h>
+#endif
+
+
+/*----------------------------------------------------------
+	Portable kernels
+----------------------------------------------------------*/
+
+/*
+ * Integer math is done in unsigned 32 bit precision, as the item types would
+ * be promoted to (signed) int, and may overflow that when multiplied.
+ */
+#define	VK_C_IVV(name, T, OP)						\
+static void c_##name(void *d, const void *a, const void *b, int n)	\
+{									\
+	T *dp = (T *)d;							\
+	const T *ap = (const T *)a;					\
+	const T *bp = (const T *)b;					\
+	int i;								\
+	for(i = 0; i < n; ++i)						\
+		dp[i] = (T)((EEL_uint32)ap[i] OP (EEL_uint32)bp[i]);	\
+}
+
+#define	VK_C_IVS(name, T, OP)						\
+static void c_##name(void *d, const void *a, double s, int n)		\
+{									\
+	T *dp = (T *)d;							\
+	const T *ap = (const T *)a;					\
+	EEL_uint32 sv = (EEL_uint32)(EEL_int32)s;			\
+	int i;								\
+	for(i = 0; i < n; ++i)						\
+		dp[i] = (T)((EEL_uint32)ap[i] OP sv);			\
+}
+
+#define	VK_C_RVV(name, T, OP)						\
+static void c_##name(void *d, const void *a, const void *b, int n)	\
+{									\
+	T *dp = (T *)d;							\
+	const T *ap = (const T *)a;					\
+	const T *bp = (const T *)b;					\
+	int i;								\
+	for(i = 0; i < n; ++i)						\
+		dp[i] = ap[i] OP bp[i];					\
+}
+
+#define	VK_C_RVS(name, T, OP)						\
+static void c_##name(void *d, const void *a, double s, int n)		\
+{									\
+	T *dp = (T *)d;							\
+	const T *ap = (const T *)a;					\
+	int i;								\
+	for(i = 0; i < n; ++i)						\
+		dp[i] = ap[i] OP s;					\
+}
+
+#define	VK_C_FD(name, OP)						\
+static void c_##name(float *d, const float *a, const double *b, int n)	\
+{									\
+	int i;								\
+	for(i = 0; i < n; ++i)						\
+		d[i] = a[i] OP b[i];					\
+}
+
+#define	VK_C_MISMATCH(name, T)						\
+static int c_##name(const void *a, const void *b, int n)		\
+{									\
+	const T *ap = (const T *)a;					\
+	const T *bp = (const T *)b;					\
+	int i;								\
+	for(i = 0; i < n; ++i)						\
+		if(ap[i] != bp[i])					\
+			break;						\
+	return i;							\
+}
+
+#define	VK_C_CONVERT(name, DT, ST)					\
+static void c_##name(DT *d, const ST *s, int n)				\
+{									\
+	int i;								\
+	for(i = 0; i < n; ++i)						\
+		d[i] = s[i];						\
+}
+
+VK_C_IVV(add8, EEL_uint8, +)
+VK_C_IVV(sub8, EEL_uint8, -)
+VK_C_IVV(mul8, EEL_uint8, *)
+VK_C_IVV(add16, EEL_uint16, +)
+VK_C_IVV(sub16, EEL_uint16, -)
+VK_C_IVV(mul16, EEL_uint16, *)
+VK_C_IVV(add32, EEL_uint32, +)
+VK_C_IVV(sub32, EEL_uint32, -)
+VK_C_IVV(mul32, EEL_uint32, *)
+VK_C_RVV(addf, float, +)
+VK_C_RVV(subf, float, -)
+VK_C_RVV(mulf, float, *)
+VK_C_RVV(addd, double, +)
+VK_C_RVV(subd, double, -)
+VK_C_RVV(muld, double, *)
+
+VK_C_IVS(adds8, EEL_uint8, +)
+VK_C_IVS(subs8, EEL_uint8, -)
+VK_C_IVS(muls8, EEL_uint8, *)
+VK_C_IVS(adds16, EEL_uint16, +)
+VK_C_IVS(subs16, EEL_uint16, -)
+VK_C_IVS(muls16, EEL_uint16, *)
+VK_C_IVS(adds32, EEL_uint32, +)
+VK_C_IVS(subs32, EEL_uint32, -)
+VK_C_IVS(muls32, EEL_uint32, *)
+VK_C_RVS(addsf, float, +)
+VK_C_RVS(subsf, float, -)
+VK_C_RVS(mulsf, float, *)
+VK_C_RVS(addsd, double, +)
+VK_C_RVS(subsd, double, -)
+VK_C_RVS(mulsd, double, *)
+
+VK_C_FD(addfd, +)
+VK_C_FD(subfd, -)
+VK_C_FD(mulfd, *)
+
+VK_C_MISMATCH(mismatch8, EEL_uint8)
+VK_C_MISMATCH(mismatch16, EEL_uint16)
+VK_C_MISMATCH(mismatch32, EEL_uint32)
+VK_C_MISMATCH(mismatchf, float)
+VK_C_MISMATCH(mismatchd, double)
+
+VK_C_CONVERT(f2d, double, float)
+VK_C_CONVERT(d2f, float, double)
+VK_C_CONVERT(s32_2d, double, EEL_int32)
+VK_C_CONVERT(s16_2f, float, EEL_int16)
+
+static const EEL_vkernels vk_c = {
+	"c",
+	{
+		{ c_add8, c_add16, c_add32, c_addf, c_addd },
+		{ c_sub8, c_sub16, c_sub32, c_subf, c_subd },
+		{ c_mul8, c_mul16, c_mul32, c_mulf, c_muld }
+	},
+	{
+		{ c_adds8, c_adds16, c_adds32, c_addsf, c_addsd },
+		{ c_subs8, c_subs16, c_subs32, c_subsf, c_subsd },
+		{ c_muls8, c_muls16, c_muls32, c_mulsf, c_mulsd }
+	},
+	{ c_addfd, c_subfd, c_mulfd },
+	{ c_mismatch8, c_mismatch16, c_mismatch32, c_mismatchf, c_mismatchd },
+	c_f2d, c_d2f, c_s32_2d, c_s16_2f
+};
+
+
+#ifdef VK_X86
+/*----------------------------------------------------------
+	x86 kernels
+------------------------------------------------------------
+ * The SIMD loops handle whole vectors only, and leave the rest to the
+ * portable kernels. Each kernel is compiled for its instruction set through
+ * function attributes, so no special compiler flags are needed, and the
+ * rest of EEL runs on any x86 CPU.
+ */
+
+#define	VK_SSE2	__attribute__((target("sse2")))
+#define	VK_AVX2	__attribute__((target("avx2")))
+
+/* d[i] = a[i] <vop> b[i], using 'cname' for the tail */
+#define	VK_VV(isa, name, cname, T, VT, LANES, LOAD, STORE, VOP)		\
+static isa void name(void *d, const void *a, const void *b, int n)	\
+{									\
+	T *dp = (T *)d;							\
+	const T *ap = (const T *)a;					\
+	const T *bp = (const T *)b;					\
+	int i;								\
+	for(i = 0; i + (LANES) <= n; i += (LANES))			\
+		STORE(dp + i, VOP(LOAD(ap + i), LOAD(bp + i)));		\
+	cname(dp + i, ap + i, bp + i, n - i);				\
+}
+
+/* d[i] = a[i] <vop> s, with 's' converted and broadcast by SET1 */
+#define	VK_VS(isa, name, cname, T, VT, LANES, LOAD, STORE, VOP, SET1)	\
+static isa void name(void *d, const void *a, double s, int n)		\
+{									\
+	T *dp = (T *)d;							\
+	const T *ap = (const T *)a;					\
+	VT sv = SET1(s);						\
+	int i;								\
+	for(i = 0; i + (LANES) <= n; i += (LANES))			\
+		STORE(dp + i, VOP(LOAD(ap + i), sv));			\
+	cname(dp + i, ap + i, s, n - i);				\
+}
+
+/* SSE2 */
+#define	S_LDI(p)	_mm_loadu_si128((const __m128i *)(p))
+#define	S_STI(p, v)	_mm_storeu_si128((__m128i *)(p), (v))
+#define	S_SET8(s)	_mm_set1_epi8((char)(EEL_int32)(s))
+#define	S_SET16(s)	_mm_set1_epi16((short)(EEL_int32)(s))
+#define	S_SET32(s)	_mm_set1_epi32((EEL_int32)(s))
+
+/* No 8 bit multiply; do even and odd bytes as 16 bit words */
+static inline VK_SSE2 __m128i sse2_mul8(__m128i a, __m128i b)
+{
+	__m128i even = _mm_mullo_epi16(a, b);
+	__m128i odd = _mm_mullo_epi16(_mm_srli_epi16(a, 8),
+			_mm_srli_epi16(b, 8));
+	return _mm_or_si128(_mm_and_si128(even, _mm_set1_epi16(0xff)),
+			_mm_slli_epi16(odd, 8));
+}
+
+/* No 32 bit low multiply before SSE4.1; do even and odd as 64 bit */
+static inline VK_SSE2 __m128i sse2_mul32(__m128i a, __m128i b)
+{
+	__m128i even = _mm_mul_epu32(a, b);
+	__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32),
+			_mm_srli_epi64(b, 32));
+	return _mm_unpacklo_epi32(
+			_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+			_mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+VK_VV(VK_SSE2, sse2_add8, c_add8, EEL_uint8, __m128i, 16, S_LDI, S_STI,
+		_mm_add_epi8)
+VK_VV(VK_SSE2, sse2_sub8, c_sub8, EEL_uint8, __m128i, 16, S_LDI, S_STI,
+		_mm_sub_epi8)
+VK_VV(VK_SSE2, sse2_mul8v, c_mul8, EEL_uint8, __m128i, 16, S_LDI, S_STI,
+		sse2_mul8)
+VK_VV(VK_SSE2, sse2_add16, c_add16, EEL_uint16, __m128i, 8, S_LDI, S_STI,
+		_mm_add_epi16)
+VK_VV(VK_SSE2, sse2_sub16, c_sub16, EEL_uint16, __m128i, 8, S_LDI, S_STI,
+		_mm_sub_epi16)
+VK_VV(VK_SSE2, sse2_mul16, c_mul16, EEL_uint16, __m128i, 8, S_LDI, S_STI,
+		_mm_mullo_epi16)
+VK_VV(VK_SSE2, sse2_add32, c_add32, EEL_uint32, __m128i, 4, S_LDI, S_STI,
+		_mm_add_epi32)
+VK_VV(VK_SSE2, sse2_sub32, c_sub32, EEL_uint32, __m128i, 4, S_LDI, S_STI,
+		_mm_sub_epi32)
+VK_VV(VK_SSE2, sse2_mul32v, c_mul32, EEL_uint32, __m128i, 4, S_LDI, S_STI,
+		sse2_mul32)
+VK_VV(VK_SSE2, sse2_addf, c_addf, float, __m128, 4, _mm_loadu_ps,
+		_mm_storeu_ps, _mm_add_ps)
+VK_VV(VK_SSE2, sse2_subf, c_subf, float, __m128, 4, _mm_loadu_ps,
+		_mm_storeu_ps, _mm_sub_ps)
+VK_VV(VK_SSE2, sse2_mulf, c_mulf, float, __m128, 4, _mm_loadu_ps,
+		_mm_storeu_ps, _mm_mul_ps)
+VK_VV(VK_SSE2, sse2_addd, c_addd, double, __m128d, 2, _mm_loadu_pd,
+		_mm_storeu_pd, _mm_add_pd)
+VK_VV(VK_SSE2, sse2_subd, c_subd, double, __m128d, 2, _mm_loadu_pd,
+		_mm_storeu_pd, _mm_sub_pd)
+VK_VV(VK_SSE2, sse2_muld, c_muld, double, __m128d, 2, _mm_loadu_pd,
+		_mm_storeu_pd, _mm_mul_pd)
+
+VK_VS(VK_SSE2, sse2_adds8, c_adds8, EEL_uint8, __m128i, 16, S_LDI, S_STI,
+		_mm_add_epi8, S_SET8)
+VK_VS(VK_SSE2, sse2_subs8, c_subs8, EEL_uint8, __m128i, 16, S_LDI, S_STI,
+		_mm_sub_epi8, S_SET8)
+VK_VS(VK_SSE2, sse2_muls8, c_muls8, EEL_uint8, __m128i, 16, S_LDI, S_STI,
+		sse2_mul8, S_SET8)
+VK_VS(VK_SSE2, sse2_adds16, c_adds16, EEL_uint16, __m128i, 8, S_LDI, S_STI,
+		_mm_add_epi16, S_SET16)
+VK_VS(VK_SSE2, sse2_subs16, c_subs16, EEL_uint16, __m128i, 8, S_LDI, S_STI,
+		_mm_sub_epi16, S_SET16)
+VK_VS(VK_SSE2, sse2_muls16, c_muls16, EEL_uint16, __m128i, 8, S_LDI, S_STI,
+		_mm_mullo_epi16, S_SET16)
+VK_VS(VK_SSE2, sse2_adds32, c_adds32, EEL_uint32, __m128i, 4, S_LDI, S_STI,
+		_mm_add_epi32, S_SET32)
+VK_VS(VK_SSE2, sse2_subs32, c_subs32, EEL_uint32, __m128i, 4, S_LDI, S_STI,
+		_mm_sub_epi32, S_SET32)
+VK_VS(VK_SSE2, sse2_muls32, c_muls32, EEL_uint32, __m128i, 4, S_LDI, S_STI,
+		sse2_mul32, S_SET32)
+VK_VS(VK_SSE2, sse2_addsd, c_addsd, double, __m128d, 2, _mm_loadu_pd,
+		_mm_storeu_pd, _mm_add_pd, _mm_set1_pd)
+VK_VS(VK_SSE2, sse2_subsd, c_subsd, double, __m128d, 2, _mm_loadu_pd,
+		_mm_storeu_pd, _mm_sub_pd, _mm_set1_pd)
+VK_VS(VK_SSE2, sse2_mulsd, c_mulsd, double, __m128d, 2, _mm_loadu_pd,
+		_mm_storeu_pd, _mm_mul_pd, _mm_set1_pd)
+
+/* float <op> double, in double precision; 4 items at a time */
+#define	VK_SSE2_FS(name, cname, VOP)					\
+static VK_SSE2 void name(void *d, const void *a, double s, int n)	\
+{									\
+	float *dp = (float *)d;						\
+	const float *ap = (const float *)a;				\
+	__m128d sv = _mm_set1_pd(s);					\
+	int i;								\
+	for(i = 0; i + 4 <= n; i += 4)					\
+	{								\
+		__m128 x = _mm_loadu_ps(ap + i);			\
+		__m128d lo = VOP(_mm_cvtps_pd(x), sv);			\
+		__m128d hi = VOP(_mm_cvtps_pd(_mm_movehl_ps(x, x)), sv);\
+		_mm_storeu_ps(dp + i, _mm_movelh_ps(_mm_cvtpd_ps(lo),	\
+				_mm_cvtpd_ps(hi)));			\
+	}								\
+	cname(dp + i, ap + i, s, n - i);				\
+}
+#define	VK_SSE2_FD(name, cname, VOP)					\
+static VK_SSE2 void name(float *d, const float *a, const double *b, int n)\
+{									\
+	int i;								\
+	for(i = 0; i + 4 <= n; i += 4)					\
+	{								\
+		__m128 x = _mm_loadu_ps(a + i);				\
+		__m128d lo = VOP(_mm_cvtps_pd(x), _mm_loadu_pd(b + i));	\
+		__m128d hi = VOP(_mm_cvtps_pd(_mm_movehl_ps(x, x)),	\
+				_mm_loadu_pd(b + i + 2));		\
+		_mm_storeu_ps(d + i, _mm_movelh_ps(_mm_cvtpd_ps(lo),	\
+				_mm_cvtpd_ps(hi)));			\
+	}								\
+	cname(d + i, a + i, b + i, n - i);				\
+}
+VK_SSE2_FS(sse2_addsf, c_addsf, _mm_add_pd)
+VK_SSE2_FS(sse2_subsf, c_subsf, _mm_sub_pd)
+VK_SSE2_FS(sse2_mulsf, c_mulsf, _mm_mul_pd)
+VK_SSE2_FD(sse2_addfd, c_addfd, _mm_add_pd)
+VK_SSE2_FD(sse2_subfd, c_subfd, _mm_sub_pd)
+VK_SSE2_FD(sse2_mulfd, c_mulfd, _mm_mul_pd)
+
+static VK_SSE2 int sse2_mismatch8(const void *a, const void *b, int n)
+{
+	const EEL_uint8 *ap = (const EEL_uint8 *)a;
+	const EEL_uint8 *bp = (const EEL_uint8 *)b;
+	int i;
+	for(i = 0; i + 16 <= n; i += 16)
+	{
+		unsigned m = _mm_movemask_epi8(_mm_cmpeq_epi8(S_LDI(ap + i),
+				S_LDI(bp + i)));
+		if(m != 0xffff)
+			return i + __builtin_ctz(~m);
+	}
+	return i + c_mismatch8(ap + i, bp + i, n - i);
+}
+
+/* The first differing byte is in the first differing item */
+static VK_SSE2 int sse2_mismatch16(const void *a, const void *b, int n)
+{
+	return sse2_mismatch8(a, b, n * 2) / 2;
+}
+
+static VK_SSE2 int sse2_mismatch32(const void *a, const void *b, int n)
+{
+	return sse2_mismatch8(a, b, n * 4) / 4;
+}
+
+static VK_SSE2 int sse2_mismatchf(const void *a, const void *b, int n)
+{
+	const float *ap = (const float *)a;
+	const float *bp = (const float *)b;
+	int i;
+	for(i = 0; i + 4 <= n; i += 4)
+	{
+		int m = _mm_movemask_ps(_mm_cmpneq_ps(_mm_loadu_ps(ap + i),
+				_mm_loadu_ps(bp + i)));
+		if(m)
+			return i + __builtin_ctz(m);
+	}
+	return i + c_mismatchf(ap + i, bp + i, n - i);
+}
+
+static VK_SSE2 int sse2_mismatchd(const void *a, const void *b, int n)
+{
+	const double *ap = (const double *)a;
+	const double *bp = (const double *)b;
+	int i;
+	for(i = 0; i + 2 <= n; i += 2)
+	{
+		int m = _mm_movemask_pd(_mm_cmpneq_pd(_mm_loadu_pd(ap + i),
+				_mm_loadu_pd(bp + i)));
+		if(m)
+			return i + __builtin_ctz(m);
+	}
+	return i + c_mismatchd(ap + i, bp + i, n - i);
+}
+
+static VK_SSE2 void sse2_f2d(double *d, const float *s, int n)
+{
+	int i;
+	for(i = 0; i + 4 <= n; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(s + i);
+		_mm_storeu_pd(d + i, _mm_cvtps_pd(x));
+		_mm_storeu_pd(d + i + 2, _mm_cvtps_pd(_mm_movehl_ps(x, x)));
+	}
+	c_f2d(d + i, s + i, n - i);
+}
+
+static VK_SSE2 void sse2_d2f(float *d, const double *s, int n)
+{
+	int i;
+	for(i = 0; i + 4 <= n; i += 4)
+		_mm_storeu_ps(d + i, _mm_movelh_ps(
+				_mm_cvtpd_ps(_mm_loadu_pd(s + i)),
+				_mm_cvtpd_ps(_mm_loadu_pd(s + i + 2))));
+	c_d2f(d + i, s + i, n - i);
+}
+
+static VK_SSE2 void sse2_s32_2d(double *d, const EEL_int32 *s, int n)
+{
+	int i;
+	for(i = 0; i + 4 <= n; i += 4)
+	{
+		__m128i x = S_LDI(s + i);
+		_mm_storeu_pd(d + i, _mm_cvtepi32_pd(x));
+		_mm_storeu_pd(d + i + 2, _mm_cvtepi32_pd(
+				_mm_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2))));
+	}
+	c_s32_2d(d + i, s + i, n - i);
+}
+
+static VK_SSE2 void sse2_s16_2f(float *d, const EEL_int16 *s, int n)
+{
+	int i;
+	for(i = 0; i + 8 <= n; i += 8)
+	{
+		__m128i x = S_LDI(s + i);
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+		_mm_storeu_ps(d + i, _mm_cvtepi32_ps(lo));
+		_mm_storeu_ps(d + i + 4, _mm_cvtepi32_ps(hi));
+	}
+	c_s16_2f(d + i, s + i, n - i);
+}
+
+static const EEL_vkernels vk_sse2 = {
+	"sse2",
+	{
+		{ sse2_add8, sse2_add16, sse2_add32, sse2_addf, sse2_addd },
+		{ sse2_sub8, sse2_sub16, sse2_sub32, sse2_subf, sse2_subd },
+		{ sse2_mul8v, sse2_mul16, sse2_mul32v, sse2_mulf, sse2_muld }
+	},
+	{
+		{ sse2_adds8, sse2_adds16, sse2_adds32, sse2_addsf,
+				sse2_addsd },
+		{ sse2_subs8, sse2_subs16, sse2_subs32, sse2_subsf,
+				sse2_subsd },
+		{ sse2_muls8, sse2_muls16, sse2_muls32, sse2_mulsf,
+				sse2_mulsd }
+	},
+	{ sse2_addfd, sse2_subfd, sse2_mulfd },
+	{
+		sse2_mismatch8, sse2_mismatch16, sse2_mismatch32,
+		sse2_mismatchf, sse2_mismatchd
+	},
+	sse2_f2d, sse2_d2f, sse2_s32_2d, sse2_s16_2f
+};
+
+
+/* AVX2 */
+#define	A_LDI(p)	_mm256_loadu_si256((const __m256i *)(p))
+#define	A_STI(p, v)	_mm256_storeu_si256((__m256i *)(p), (v))
+#define	A_SET8(s)	_mm256_set1_epi8((char)(EEL_int32)(s))
+#define	A_SET16(s)	_mm256_set1_epi16((short)(EEL_int32)(s))
+#define	A_SET32(s)	_mm256_set1_epi32((EEL_int32)(s))
+
+static inline VK_AVX2 __m256i avx2_mul8(__m256i a, __m256i b)
+{
+	__m256i even = _mm256_mullo_epi16(a, b);
+	__m256i odd = _mm256_mullo_epi16(_mm256_srli_epi16(a, 8),
+			_mm256_srli_epi16(b, 8));
+	return _mm256_or_si256(_mm256_and_si256(even,
+			_mm256_set1_epi16(0xff)), _mm256_slli_epi16(odd, 8));
+}
+
+VK_VV(VK_AVX2, avx2_add8, c_add8, EEL_uint8, __m256i, 32, A_LDI, A_STI,
+		_mm256_add_epi8)
+VK_VV(VK_AVX2, avx2_sub8, c_sub8, EEL_uint8, __m256i, 32, A_LDI, A_STI,
+		_mm256_sub_epi8)
+VK_VV(VK_AVX2, avx2_mul8v, c_mul8, EEL_uint8, __m256i, 32, A_LDI, A_STI,
+		avx2_mul8)
+VK_VV(VK_AVX2, avx2_add16, c_add16, EEL_uint16, __m256i, 16, A_LDI, A_STI,
+		_mm256_add_epi16)
+VK_VV(VK_AVX2, avx2_sub16, c_sub16, EEL_uint16, __m256i, 16, A_LDI, A_STI,
+		_mm256_sub_epi16)
+VK_VV(VK_AVX2, avx2_mul16, c_mul16, EEL_uint16, __m256i, 16, A_LDI, A_STI,
+		_mm256_mullo_epi16)
+VK_VV(VK_AVX2, avx2_add32, c_add32, EEL_uint32, __m256i, 8, A_LDI, A_STI,
+		_mm256_add_epi32)
+VK_VV(VK_AVX2, avx2_sub32, c_sub32, EEL_uint32, __m256i, 8, A_LDI, A_STI,
+		_mm256_sub_epi32)
+VK_VV(VK_AVX2, avx2_mul32, c_mul32, EEL_uint32, __m256i, 8, A_LDI, A_STI,
+		_mm256_mullo_epi32)
+VK_VV(VK_AVX2, avx2_addf, c_addf, float, __m256, 8, _mm256_loadu_ps,
+		_mm256_storeu_ps, _mm256_add_ps)
+VK_VV(VK_AVX2, avx2_subf, c_subf, float, __m256, 8, _mm256_loadu_ps,
+		_mm256_storeu_ps, _mm256_sub_ps)
+VK_VV(VK_AVX2, avx2_mulf, c_mulf, float, __m256, 8, _mm256_loadu_ps,
+		_mm256_storeu_ps, _mm256_mul_ps)
+VK_VV(VK_AVX2, avx2_addd, c_addd, double, __m256d, 4, _mm256_loadu_pd,
+		_mm256_storeu_pd, _mm256_add_pd)
+VK_VV(VK_AVX2, avx2_subd, c_subd, double, __m256d, 4, _mm256_loadu_pd,
+		_mm256_storeu_pd, _mm256_sub_pd)
+VK_VV(VK_AVX2, avx2_muld, c_muld, double, __m256d, 4, _mm256_loadu_pd,
+		_mm256_storeu_pd, _mm256_mul_pd)
+
+VK_VS(VK_AVX2, avx2_adds8, c_adds8, EEL_uint8, __m256i, 32, A_LDI, A_STI,
+		_mm256_add_epi8, A_SET8)
+VK_VS(VK_AVX2, avx2_subs8, c_subs8, EEL_uint8, __m256i, 32, A_LDI, A_STI,
+		_mm256_sub_epi8, A_SET8)
+VK_VS(VK_AVX2, avx2_muls8, c_muls8, EEL_uint8, __m256i, 32, A_LDI, A_STI,
+		avx2_mul8, A_SET8)
+VK_VS(VK_AVX2, avx2_adds16, c_adds16, EEL_uint16, __m256i, 16, A_LDI, A_STI,
+		_mm256_add_epi16, A_SET16)
+VK_VS(VK_AVX2, avx2_subs16, c_subs16, EEL_uint16, __m256i, 16, A_LDI, A_STI,
+		_mm256_sub_epi16, A_SET16)
+VK_VS(VK_AVX2, avx2_muls16, c_muls16, EEL_uint16, __m256i, 16, A_LDI, A_STI,
+		_mm256_mullo_epi16, A_SET16)
+VK_VS(VK_AVX2, avx2_adds32, c_adds32, EEL_uint32, __m256i, 8, A_LDI, A_STI,
+		_mm256_add_epi32, A_SET32)
+VK_VS(VK_AVX2, avx2_subs32, c_subs32, EEL_uint32, __m256i, 8, A_LDI, A_STI,
+		_mm256_sub_epi32, A_SET32)
+VK_VS(VK_AVX2, avx2_muls32, c_muls32, EEL_uint32, __m256i, 8, A_LDI, A_STI,
+		_mm256_mullo_epi32, A_SET32)
+VK_VS(VK_AVX2, avx2_addsd, c_addsd, double, __m256d, 4, _mm256_loadu_pd,
+		_mm256_storeu_pd, _mm256_add_pd, _mm256_set1_pd)
+VK_VS(VK_AVX2, avx2_subsd, c_subsd, double, __m256d, 4, _mm256_loadu_pd,
+		_mm256_storeu_pd, _mm256_sub_pd, _mm256_set1_pd)
+VK_VS(VK_AVX2, avx2_mulsd, c_mulsd, double, __m256d, 4, _mm256_loadu_pd,
+		_mm256_storeu_pd, _mm256_mul_pd, _mm256_set1_pd)
+
+#define	VK_AVX2_FS(name, cname, VOP)					\
+static VK_AVX2 void name(void *d, const void *a, double s, int n)	\
+{									\
+	float *dp = (float *)d;						\
+	const float *ap = (const float *)a;				\
+	__m256d sv = _mm256_set1_pd(s);					\
+	int i;								\
+	for(i = 0; i + 4 <= n; i += 4)					\
+		_mm_storeu_ps(dp + i, _mm256_cvtpd_ps(VOP(		\
+				_mm256_cvtps_pd(_mm_loadu_ps(ap + i)),	\
+				sv)));					\
+	cname(dp + i, ap + i, s, n - i);				\
+}
+#define	VK_AVX2_FD(name, cname, VOP)					\
+static VK_AVX2 void name(float *d, const float *a, const double *b, int n)\
+{									\
+	int i;								\
+	for(i = 0; i + 4 <= n; i += 4)					\
+		_mm_storeu_ps(d + i, _mm256_cvtpd_ps(VOP(		\
+				_mm256_cvtps_pd(_mm_loadu_ps(a + i)),	\
+				_mm256_loadu_pd(b + i))));		\
+	cname(d + i, a + i, b + i, n - i);				\
+}
+VK_AVX2_FS(avx2_addsf, c_addsf, _mm256_add_pd)
+VK_AVX2_FS(avx2_subsf, c_subsf, _mm256_sub_pd)
+VK_AVX2_FS(avx2_mulsf, c_mulsf, _mm256_mul_pd)
+VK_AVX2_FD(avx2_addfd, c_addfd, _mm256_add_pd)
+VK_AVX2_FD(avx2_subfd, c_subfd, _mm256_sub_pd)
+VK_AVX2_FD(avx2_mulfd, c_mulfd, _mm256_mul_pd)
+
+static VK_AVX2 int avx2_mismatch8(const void *a, const void *b, int n)
+{
+	const EEL_uint8 *ap = (const EEL_uint8 *)a;
+	const EEL_uint8 *bp = (const EEL_uint8 *)b;
+	int i;
+	for(i = 0; i + 32 <= n; i += 32)
+	{
+		unsigned m = _mm256_movemask_epi8(_mm256_cmpeq_epi8(
+				A_LDI(ap + i), A_LDI(bp + i)));
+		if(m != 0xffffffff)
+			return i + __builtin_ctz(~m);
+	}
+	return i + c_mismatch8(ap + i, bp + i, n - i);
+}
+
+static VK_AVX2 int avx2_mismatch16(const void *a, const void *b, int n)
+{
+	return avx2_mismatch8(a, b, n * 2) / 2;
+}
+
+static VK_AVX2 int avx2_mismatch32(const void *a, const void *b, int n)
+{
+	return avx2_mismatch8(a, b, n * 4) / 4;
+}
+
+static VK_AVX2 int avx2_mismatchf(const void *a, const void *b, int n)
+{
+	const float *ap = (const float *)a;
+	const float *bp = (const float *)b;
+	int i;
+	for(i = 0; i + 8 <= n; i += 8)
+	{
+		int m = _mm256_movemask_ps(_mm256_cmp_ps(
+				_mm256_loadu_ps(ap + i),
+				_mm256_loadu_ps(bp + i), _CMP_NEQ_UQ));
+		if(m)
+			return i + __builtin_ctz(m);
+	}
+	return i + c_mismatchf(ap + i, bp + i, n - i);
+}
+
+static VK_AVX2 int avx2_mismatchd(const void *a, const void *b, int n)
+{
+	const double *ap = (const double *)a;
+	const double *bp = (const double *)b;
+	int i;
+	for(i = 0; i + 4 <= n; i += 4)
+	{
+		int m = _mm256_movemask_pd(_mm256_cmp_pd(
+				_mm256_loadu_pd(ap + i),
+				_mm256_loadu_pd(bp + i), _CMP_NEQ_UQ));
+		if(m)
+			return i + __builtin_ctz(m);
+	}
+	return i + c_mismatchd(ap + i, bp + i, n - i);
+}
+
+static VK_AVX2 void avx2_f2d(double *d, const float *s, int n)
+{
+	int i;
+	for(i = 0; i + 4 <= n; i += 4)
+		_mm256_storeu_pd(d + i, _mm256_cvtps_pd(_mm_loadu_ps(s + i)));
+	c_f2d(d + i, s + i, n - i);
+}
+
+static VK_AVX2 void avx2_d2f(float *d, const double *s, int n)
+{
+	int i;
+	for(i = 0; i + 4 <= n; i += 4)
+		_mm_storeu_ps(d + i, _mm256_cvtpd_ps(_mm256_loadu_pd(s + i)));
+	c_d2f(d + i, s + i, n - i);
+}
+
+static VK_AVX2 void avx2_s32_2d(double *d, const EEL_int32 *s, int n)
+{
+	int i;
+	for(i = 0; i + 4 <= n; i += 4)
+		_mm256_storeu_pd(d + i, _mm256_cvtepi32_pd(S_LDI(s + i)));
+	c_s32_2d(d + i, s + i, n - i);
+}
+
+static VK_AVX2 void avx2_s16_2f(float *d, const EEL_int16 *s, int n)
+{
+	int i;
+	for(i = 0; i + 8 <= n; i += 8)
+		_mm256_storeu_ps(d + i, _mm256_cvtepi32_ps(
+				_mm256_cvtepi16_epi32(S_LDI(s + i))));
+	c_s16_2f(d + i, s + i, n - i);
+}
+
+static const EEL_vkernels vk_avx2 = {
+	"avx2",
+	{
+		{ avx2_add8, avx2_add16, avx2_add32, avx2_addf, avx2_addd },
+		{ avx2_sub8, avx2_sub16, avx2_sub32, avx2_subf, avx2_subd },
+		{ avx2_mul8v, avx2_mul16, avx2_mul32, avx2_mulf, avx2_muld }
+	},
+	{
+		{ avx2_adds8, avx2_adds16, avx2_adds32, avx2_addsf,
+				avx2_addsd },
+		{ avx2_subs8, avx2_subs16, avx2_subs32, avx2_subsf,
+				avx2_subsd },
+		{ avx2_muls8, avx2_muls16, avx2_muls32, avx2_mulsf,
+				avx2_mulsd }
+	},
+	{ avx2_addfd, avx2_subfd, avx2_mulfd },
+	{
+		avx2_mismatch8, avx2_mismatch16, avx2_mismatch32,
+		avx2_mismatchf, avx2_mismatchd
+	},
+	avx2_f2d, avx2_d2f, avx2_s32_2d, avx2_s16_2f
+};
+
+#endif /* VK_X86 */
+
+
+/*----------------------------------------------------------
+	Dispatch
+----------------------------------------------------------*/
+
+const EEL_vkernels *eel_vk = &vk_c;
+
+/* Returns kernel set 'name', if the CPU supports it, otherwise NULL. */
+static const EEL_vkernels *vk_find(const char *name)
+{
+	if(!strcmp(name, vk_c.name))
+		return &vk_c;
+#ifdef VK_X86
+	__builtin_cpu_init();
+	if(!strcmp(name, vk_sse2.name))
+	{
+#	ifndef __x86_64__
+		if(!__builtin_cpu_supports("sse2"))
+			return NULL;
+#	endif
+		return &vk_sse2;
+	}
+	if(!strcmp(name, vk_avx2.name))
+		return __builtin_cpu_supports("avx2") ? &vk_avx2 : NULL;
+#endif
+	return NULL;
+}
+
+
+void eel_vk_init(void)
+{
+	static const char *const order[] = { "avx2", "sse2", NULL };
+	int i;
+	for(i = 0; order[i]; ++i)
+		if(!eel_vk_select(order[i]))
+			return;
+	eel_vk = &vk_c;
+}
+
+
+int eel_vk_select(const char *name)
+{
+	const EEL_vkernels *vk = vk_find(name);
+	if(!vk)
+		return -1;
+	eel_vk = vk;
+	return 0;
+}
@@ -0,0 +1,116 @@
+/*
+---------------------------------------------------------------------------
+	e_vkernel.h - EEL Vector Kernels
+---------------------------------------------------------------------------
+ * Copyright 2026 David Olofson
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from the
+ * use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/*
+   Vector kernels
+   --------------
+	The inner loops of the vector classes; element-wise arithmetic,
+	comparison and conversions over raw item buffers. There is a
+	portable C implementation of every kernel, and on x86 there are
+	SSE2 and AVX2 versions as well. The best set the CPU supports is
+	selected at startup, and can be changed with eel_vk_select(), for
+	testing and benchmarking.
+	   Signed and unsigned integers of the same size share kernels, as
+	the operations wrap around, and only the low bits matter. Kernels
+	must give exactly the same results as the portable versions, so
+	'float' operations with 'double' operands are done in double
+	precision, and rounded once, when storing the results.
+	   Item buffers may be the same (in-place operations), but must not
+	overlap otherwise.
+ */
+
+#ifndef	EEL_E_VKERNEL_H
+#define	EEL_E_VKERNEL_H
+
+#include "EEL_types.h"
+
+/* Item types, as far as the kernels are concerned */
+typedef enum
+{
+	EEL_VK_8 = 0,	/* vector_u8, vector_s8 */
+	EEL_VK_16,	/* vector_u16, vector_s16 */
+	EEL_VK_32,	/* vector_u32, vector_s32 */
+	EEL_VK_F,	/* vector_f */
+	EEL_VK_D,	/* vector_d */
+	EEL_VK__COUNT
+} EEL_vktypes;
+
+/* Arithmetic operations */
+typedef enum
+{
+	EEL_VK_ADD = 0,
+	EEL_VK_SUB,
+	EEL_VK_MUL,
+	EEL_VK__OPS
+} EEL_vkops;
+
+typedef struct
+{
+	const char	*name;
+
+	/* d[i] = a[i] <op> b[i] */
+	void (*vv[EEL_VK__OPS][EEL_VK__COUNT])(void *d, const void *a,
+			const void *b, int n);
+
+	/*
+	 * d[i] = a[i] <op> s. (Integer types use the low bits of 's', which
+	 * must be an integer value.)
+	 */
+	void (*vs[EEL_VK__OPS][EEL_VK__COUNT])(void *d, const void *a,
+			double s, int n);
+
+	/* d[i] = a[i] <op> b[i], calculated in double precision */
+	void (*fd[EEL_VK__OPS])(float *d, const float *a, const double *b,
+			int n);
+
+	/*
+	 * Returns the index of the first item where 'a' and 'b' differ, or
+	 * 'n' if they don't. (Integers are compared bitwise, so signed and
+	 * unsigned types share kernels, like above.)
+	 */
+	int (*mismatch[EEL_VK__COUNT])(const void *a, const void *b, int n);
+
+	/* Conversions */
+	void (*f2d)(double *d, const float *s, int n);
+	void (*d2f)(float *d, const double *s, int n);
+	void (*s32_2d)(double *d, const EEL_int32 *s, int n);
+	void (*s16_2f)(float *d, const EEL_int16 *s, int n);
+} EEL_vkernels;
+
+/* The current kernel set. (Never NULL.) */
+extern const EEL_vkernels *eel_vk;
+
+/*
+ * Select the best kernel set supported by the CPU. Called when the vector
+ * classes are registered.
+ */
+void eel_vk_init(void);
+
+/*
+ * Select kernel set 'name' ("c", "sse2" or "avx2"). Returns 0 on success, or
+ * -1 if there is no such kernel set, or if the CPU does not support it. This
+ * affects all VMs in the process!
+ */
+int eel_vk_select(const char *name);
+
+#endif	/* EEL_E_VKERNEL_H */
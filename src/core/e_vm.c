@@ -24,6 +24,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <limits.h>
 #include "EEL.h"
 #include "e_state.h"
 #include "ec_coder.h"
@@ -33,11 +34,17 @@
 #include "e_operate.h"
 #include "e_array.h"
 #include "e_function.h"
+#include "e_table.h"
+#include "eel_threads.h"
 
 #ifdef DEBUG
 #	include <stdio.h>
 #endif
 
+#ifdef EEL_VM_SEQUENCE_PROFILING
+#	include <stdio.h>
+#endif
+
 #if defined(EEL_PROFILING) || defined(EEL_VM_PROFILING)
 #	include <sys/io.h>
 #	include <sys/time.h>
@@ -421,6 +428,120 @@ static inline void vmprofile_in(EEL_vm *vm, EEL_opcodes opcode)
 #  define	vmprofile_out(vm)
 #endif
 
+#ifdef EEL_VM_SEQUENCE_PROFILING
+/*
+ * Count the instruction at 'ins' as the end of a pair and a triple, if the
+ * previous instructions fell through to it. Branches, calls and returns end
+ * the current sequence, as there is no way to fuse instructions across those.
+ */
+static inline void vmsequence_in(EEL_vm *vm, unsigned char *ins)
+{
+	int op = *ins;
+	++VMP->vmsq_count;
+	if(ins != VMP->vmsq_next)
+		VMP->vmsq_prev[0] = VMP->vmsq_prev[1] = -1;
+	if(VMP->vmsq_prev[1] >= 0)
+		++VMP->vmsq_pairs[VMP->vmsq_prev[1] * (EEL_O_LAST + 1) + op];
+	if(VMP->vmsq_prev[0] >= 0)
+	{
+		unsigned key = ((VMP->vmsq_prev[0] * (EEL_O_LAST + 1) +
+				VMP->vmsq_prev[1]) * (EEL_O_LAST + 1) + op) + 1;
+		unsigned i = (key * 2654435761U) & (EEL_VMS_TRIPLES - 1);
+		int n;
+		for(n = 0; n < EEL_VMS_TRIPLES; ++n)
+		{
+			EEL_vmsentry *e = &VMP->vmsq_triples[i];
+			if(!e->key)
+				e->key = key;
+			if(e->key == key)
+			{
+				++e->count;
+				break;
+			}
+			i = (i + 1) & (EEL_VMS_TRIPLES - 1);
+		}
+		if(n == EEL_VMS_TRIPLES)
+			++VMP->vmsq_lost;
+	}
+	VMP->vmsq_prev[0] = VMP->vmsq_prev[1];
+	VMP->vmsq_prev[1] = op;
+	VMP->vmsq_next = ins + eel_i_size(op);
+}
+
+
+static int vmsequence_cmp(const void *a, const void *b)
+{
+	const EEL_vmsentry *ea = (const EEL_vmsentry *)a;
+	const EEL_vmsentry *eb = (const EEL_vmsentry *)b;
+	if(ea->count != eb->count)
+		return ea->count < eb->count ? 1 : -1;
+	return ea->key < eb->key ? -1 : 1;
+}
+
+/* Print the 'count' most frequently executed sequences of 'length' */
+static void vmsequence_print(EEL_vm *vm, EEL_vmsentry *e, int n, int count,
+		int length)
+{
+	int i;
+	qsort(e, n, sizeof(EEL_vmsentry), vmsequence_cmp);
+	printf("|\tcount\t%%\tsequence\n");
+	printf("|\t- - - - - - - - - - - - - - - - - - - -\n");
+	for(i = 0; (i < n) && (i < count) && e[i].count; ++i)
+	{
+		unsigned key = e[i].key - 1;
+		int op[3];
+		op[2] = key % (EEL_O_LAST + 1);
+		op[1] = key / (EEL_O_LAST + 1) % (EEL_O_LAST + 1);
+		op[0] = key / ((EEL_O_LAST + 1) * (EEL_O_LAST + 1));
+		printf("|\t%lld\t%.2f\t", e[i].count,
+				e[i].count * 100.0f / VMP->vmsq_count);
+		if(length == 3)
+			printf("%s ", eel_i_name(op[0]));
+		printf("%s %s\n", eel_i_name(op[1]), eel_i_name(op[2]));
+	}
+}
+
+static void vmsequence_report(EEL_vm *vm)
+{
+	int i, j, n;
+	EEL_vmsentry *e = (EEL_vmsentry *)malloc(sizeof(EEL_vmsentry) *
+			(EEL_O_LAST + 1) * (EEL_O_LAST + 1));
+	if(!e)
+		return;
+	printf(".----------------------------------"
+			"----------------- -- -- - - -  -  -\n");
+	printf("| EEL VM instruction sequences, sorted by count\n");
+	printf("|--- -- - - -  -  -\n");
+	printf("| Pairs:\n");
+	for(n = 0, i = 0; i <= EEL_O_LAST; ++i)
+		for(j = 0; j <= EEL_O_LAST; ++j)
+		{
+			long long c = VMP->vmsq_pairs[i * (EEL_O_LAST + 1) + j];
+			if(!c)
+				continue;
+			e[n].key = i * (EEL_O_LAST + 1) + j + 1;
+			e[n++].count = c;
+		}
+	vmsequence_print(vm, e, n, 40, 2);
+	printf("|--- -- - - -  -  -\n");
+	printf("| Triples:\n");
+	for(n = 0, i = 0; i < EEL_VMS_TRIPLES; ++i)
+		if(VMP->vmsq_triples[i].key)
+			e[n++] = VMP->vmsq_triples[i];
+	vmsequence_print(vm, e, n, 40, 3);
+	printf("|--- -- - - -  -  -\n");
+	printf("|      VM instructions executed: %lld\n", VMP->vmsq_count);
+	if(VMP->vmsq_lost)
+		printf("|  Triples not fitting in table: %lld\n",
+				VMP->vmsq_lost);
+	printf("'----------------------------------"
+			"----------------- -- -- - - -  -  -\n");
+	free(e);
+}
+#else
+#  define	vmsequence_in(vm, ins)
+#endif
+
 
 /*
  * Push a new call register frame for an EEL or C function call. This also sets
@@ -495,8 +616,12 @@ printf("==================================\n");
 }
 
 
-/* Call an EEL function */
-static inline EEL_xno call_eel(EEL_vm *vm, EEL_object *fo, int result, int levels)
+/*
+ * Call an EEL function. 'flags' (EEL_CFF_*) are set in the new callframe, for
+ * the return instructions to act upon.
+ */
+static inline EEL_xno call_eel(EEL_vm *vm, EEL_object *fo, int result,
+		int levels, unsigned flags)
 {
 	EEL_callframe *cf;
 	EEL_function *f = o2EEL_function(fo);
@@ -535,7 +660,7 @@ static inline EEL_xno call_eel(EEL_vm *vm, EEL_object *fo, int result, int level
 		}
 	}
 
-	cf->flags = 0;
+	cf->flags = flags;
 	cf->f = fo;
 	cf->catcher = NULL;
 	vm->pc = 0;
@@ -556,8 +681,12 @@ static inline EEL_xno call_eel(EEL_vm *vm, EEL_object *fo, int result, int level
 }
 
 
-/* Call a C function */
-static inline EEL_xno call_c(EEL_vm *vm, EEL_object *fo, int result, int levels)
+/*
+ * Call a C function. If EEL_CFF_PUSHRESULT is set in 'flags', the result is
+ * pushed onto the argument stack, rather than received in heap[result].
+ */
+static inline EEL_xno call_c(EEL_vm *vm, EEL_object *fo, int result,
+		int levels, unsigned flags)
 {
 	EEL_callframe *cf;
 	EEL_function *f = o2EEL_function(fo);
@@ -576,22 +705,23 @@ static inline EEL_xno call_c(EEL_vm *vm, EEL_object *fo, int result, int levels)
 	 * NOTE: This differs from the call_eel() version, as C functions
 	 *       aren't expected to check if the result is desired. (The VM
 	 *       RETURNR instruction checks cf->result before copying.)
-	 *
-	 * FIXME: We should probably remove this special case. Substantial
-	 *        optimizations are often possible when results are ignored,
-	 *        especially in API bindings that need to wrap everything in
-	 *        managed objects!
+	 *       If the result is going to be discarded, the function gets
+	 *       the (nil) register of its own frame as a scratch result,
+	 *       which is what eel_result_ignored() checks for. Functions
+	 *       may then skip the result, and any work needed to create it.
 	 */
 	if(result >= 0)
+	{
 		cf->result = result;
-	else
-		cf->result = vm->base;
 #ifdef EEL_VM_CHECKING
-	vm->heap[cf->result].classid = EEL_CILLEGAL;
-	vm->heap[cf->result].integer.v = 1006;
+		vm->heap[cf->result].classid = EEL_CILLEGAL;
+		vm->heap[cf->result].integer.v = 1006;
 #endif
+	}
+	else
+		cf->result = vm->base;
 
-	cf->flags = 0;
+	cf->flags = flags;
 	cf->f = fo;
 	cf->catcher = NULL;
 
@@ -638,18 +768,24 @@ static inline EEL_xno call_c(EEL_vm *vm, EEL_object *fo, int result, int levels)
 	/* Handle/discard result apropriately */
 	if(f->common.flags & EEL_FF_RESULTS)
 	{
-#ifdef EEL_VM_CHECKING
-		if(vm->heap[cf->result].classid == EEL_CILLEGAL)
+		if(result >= 0)
 		{
-			eel_vmdump(vm, "C function forgot to return a result! "
-					"(Value source: %d)",
-					vm->heap[cf->result].integer.v);
-			return EEL_XVMCHECK;
-		}
+#ifdef EEL_VM_CHECKING
+			if(vm->heap[result].classid == EEL_CILLEGAL)
+			{
+				eel_vmdump(vm, "C function forgot to return a "
+						"result! (Value source: %d)",
+						vm->heap[result].integer.v);
+				return EEL_XVMCHECK;
+			}
 #endif
-		/* Receive or discard the result */
-		if(result >= 0)
-			eel_v_receive(vm->heap + cf->result);
+			/* Receive, or hand it over to the argument stack */
+			if(flags & EEL_CFF_PUSHRESULT)
+				eel_v_move(vm->heap + vm->sp++,
+						vm->heap + result);
+			else
+				eel_v_receive(vm->heap + result);
+		}
 		else
 			eel_v_disown(vm->heap + cf->result);
 	}
@@ -658,9 +794,12 @@ static inline EEL_xno call_c(EEL_vm *vm, EEL_object *fo, int result, int levels)
 }
 
 
-static inline EEL_xno call_f(EEL_vm *vm, EEL_object *fo, int result, int levels)
+static inline EEL_xno call_f(EEL_vm *vm, EEL_object *fo, int result,
+		int levels, unsigned flags)
 {
 	EEL_function *f = o2EEL_function(fo);
+	if(VMP->ccpending)
+		eel_cc__step(vm);
 	if((result >= 0) && !(f->common.flags & EEL_FF_RESULTS))
 		return EEL_XNORESULT;
 	if(f->common.flags & EEL_FF_CFUNC)
@@ -669,16 +808,16 @@ static inline EEL_xno call_f(EEL_vm *vm, EEL_object *fo, int result, int levels)
 		/* Subtract the C function execution time */
 		EEL_xno res;
 		long long t2, t1 = getns();
-		res = call_c(vm, fo, result, levels);
+		res = call_c(vm, fo, result, levels, flags);
 		t2 = getns();
 		VMP->vmp_time += t2 - t1 - VMP->vmp_overhead;
 		return res;
 	}
 #else
-		return call_c(vm, fo, result, levels);
+		return call_c(vm, fo, result, levels, flags);
 #endif
 	else
-		return call_eel(vm, fo, result, levels);
+		return call_eel(vm, fo, result, levels, flags);
 }
 
 
@@ -702,7 +841,7 @@ TODO: Fast shortcut instead of dummy/empty catchers!
 	 * This is basically an ordinary function call, except
 	 * we let the catcher inherit the result index, and we...
 	 */
-	x = call_eel(vm, catcher, cf->result, 0);
+	x = call_eel(vm, catcher, cf->result, 0, 0);
 	if(x)
 		return x;
 	/*
@@ -781,6 +920,43 @@ static inline void reload_context(EEL_vm *vm, EEL_vmstate *vms)
 }
 
 
+void eel_vm_slice(EEL_vm *vm, int n)
+{
+	long long left;
+	VMP->executed += VMP->slicelen - (VMP->slice > 0 ? VMP->slice : 0);
+	left = VMP->budgetend - VMP->executed;
+	if(!VMP->budgethold && (left < n))
+		n = left > 0 ? left : 0;
+	VMP->slice = VMP->slicelen = n;
+}
+
+
+void eel_vm_release_budget(EEL_vm *vm)
+{
+	if(--VMP->budgethold)
+		return;
+	/* Clamp the count in progress to what's left of the budget */
+	eel_vm_slice(vm, VMP->slice > 0 ? VMP->slice : 0);
+}
+
+
+/*
+ * The current instruction count has run out. Returns EEL_XCOUNTER if the
+ * budget is used up, EEL_XYIELD if other threads should get to run, or 0.
+ */
+static EEL_xno slice_end(EEL_vm *vm)
+{
+	int yield = 0;
+	if(VMP->threads)
+		yield = eel_threads_slice_end(vm);
+	else
+		eel_vm_slice(vm, INT_MAX);
+	if(!VMP->budgethold && (VMP->executed >= VMP->budgetend))
+		return EEL_XCOUNTER;
+	return yield ? EEL_XYIELD : 0;
+}
+
+
 /*
  * Reschedule. Handles the exception previously set by eel__throw().
  *
@@ -815,9 +991,15 @@ static EEL_xno eel__scheduler(EEL_vm *vm, EEL_vmstate *vms)
 	switch(x)
 	{
 	  case EEL_XOK:
-	  case EEL_XYIELD:
-/*TODO: Reschedule, if other threads should run some. */
 		break;
+	  case EEL_XYIELD:
+	  case EEL_XCOUNTER:
+		/*
+		 * Leave the VM loop, so the caller can run other threads, or
+		 * return to the host. Execution resumes from here on the next
+		 * eel_run().
+		 */
+		return x;
 	  case EEL_XEND:
 /*TODO: If there are other threads, reschedule! */
 		return EEL_XEND;
@@ -827,6 +1009,7 @@ static EEL_xno eel__scheduler(EEL_vm *vm, EEL_vmstate *vms)
 		int base = vm->base;
 		EEL_callframe *cf = b2callframe(vm, base);
 		int result = cf->result;
+		int push;
 
 		/*
 		 * Find the first frame that is NOT a try block or catcher.
@@ -853,6 +1036,7 @@ static EEL_xno eel__scheduler(EEL_vm *vm, EEL_vmstate *vms)
 		DBG5(printf("|------------------------------\n");)
 
 		/* The actual RETURN: */
+		push = cf->flags & EEL_CFF_PUSHRESULT;
 		base = cf->r_base;
 		cf = b2callframe(vm, base);
 
@@ -875,7 +1059,9 @@ static EEL_xno eel__scheduler(EEL_vm *vm, EEL_vmstate *vms)
 			return EEL_XEND;
 
 		reload_context(vm, vms);
-		if(result >= 0)
+		if(push && (result >= 0))
+			eel_v_move(vm->heap + vm->sp++, vm->heap + result);
+		else if(result >= 0)
 			eel_v_receive(vm->heap + result);
 		break;
 	  }
@@ -984,6 +1170,266 @@ static inline EEL_value *get_tuparg_default(EEL_callframe *cf, unsigned pos)
 }
 
 
+/*
+ * Inline cache for INDGETC/INDSETC. Each instruction has a slot 'ic' in the
+ * function, holding the table item position where the constant key 'key' was
+ * last found. As string keys are pooled, a hit is confirmed by checking that
+ * the item at that position has the very same key object, so tables never
+ * need to invalidate anything; moved or deleted items just cause a miss.
+ *
+ * Returns the item, or NULL if the key is not in the table, or if the table
+ * and key are not of a kind that is cached. (The caller should use the
+ * GETINDEX/SETINDEX metamethods in that case.)
+ */
+static inline EEL_tableitem *icache_lookup(EEL_function *f, EEL_object *to,
+		EEL_value *key, unsigned ic)
+{
+	EEL_table *t;
+	int pos;
+	if((to->classid != EEL_CTABLE) || (key->classid != EEL_COBJREF) ||
+			(key->objref.v->classid != EEL_CSTRING))
+		return NULL;
+	t = o2EEL_table(to);
+	pos = f->e.icache[ic];
+	if((pos < t->length) && (t->items[pos].key.objref.v == key->objref.v)
+			&& EEL_IS_OBJREF(t->items[pos].key.classid))
+	{
+		++f->e.ichits;
+		return t->items + pos;
+	}
+	++f->e.icmisses;
+	pos = eel_table_find(to, key);
+	if(pos < 0)
+		return NULL;
+	f->e.icache[ic] = pos;
+	return t->items + pos;
+}
+
+
+/*
+ * Operators for the quickened instructions, for operands already known to be
+ * integers or reals. Results must be exactly what eel_op_*() would produce,
+ * as a site may flip between the generic and quickened forms at any time.
+ */
+static inline int q_operator(int op)
+{
+	switch(op)
+	{
+	  case EEL_OP_ADD:
+	  case EEL_OP_SUB:
+	  case EEL_OP_MUL:
+	  case EEL_OP_DIV:
+	  case EEL_OP_EQ:
+	  case EEL_OP_NE:
+	  case EEL_OP_GT:
+	  case EEL_OP_GE:
+	  case EEL_OP_LT:
+	  case EEL_OP_LE:
+		return 1;
+	  default:
+		return 0;
+	}
+}
+
+static inline EEL_xno q_iop(int op, EEL_integer left, EEL_integer right,
+		EEL_value *result)
+{
+	switch(op)
+	{
+	  case EEL_OP_ADD:
+		result->classid = EEL_CINTEGER;
+		result->integer.v = left + right;
+		return 0;
+	  case EEL_OP_SUB:
+		result->classid = EEL_CINTEGER;
+		result->integer.v = left - right;
+		return 0;
+	  case EEL_OP_MUL:
+		result->classid = EEL_CINTEGER;
+		result->integer.v = left * right;
+		return 0;
+	  case EEL_OP_DIV:
+		if(!right)
+			return EEL_XDIVBYZERO;
+#ifdef EEL_PASCAL_IDIV
+		result->classid = EEL_CREAL;
+		result->real.v = (EEL_real)left / right;
+#else
+		result->classid = EEL_CINTEGER;
+		result->integer.v = left / right;
+#endif
+		return 0;
+	  case EEL_OP_EQ:
+		result->classid = EEL_CBOOLEAN;
+		result->integer.v = left == right;
+		return 0;
+	  case EEL_OP_NE:
+		result->classid = EEL_CBOOLEAN;
+		result->integer.v = left != right;
+		return 0;
+	  case EEL_OP_GT:
+		result->classid = EEL_CBOOLEAN;
+		result->integer.v = left > right;
+		return 0;
+	  case EEL_OP_GE:
+		result->classid = EEL_CBOOLEAN;
+		result->integer.v = left >= right;
+		return 0;
+	  case EEL_OP_LT:
+		result->classid = EEL_CBOOLEAN;
+		result->integer.v = left < right;
+		return 0;
+	  case EEL_OP_LE:
+		result->classid = EEL_CBOOLEAN;
+		result->integer.v = left <= right;
+		return 0;
+	}
+	return EEL_XINTERNAL;
+}
+
+/* NOTE: LT and LE are inverted GE and GT, like eel_op_lt()/eel_op_le()! */
+static inline EEL_xno q_rop(int op, EEL_real left, EEL_real right,
+		EEL_value *result)
+{
+	switch(op)
+	{
+	  case EEL_OP_ADD:
+		result->classid = EEL_CREAL;
+		result->real.v = left + right;
+		return 0;
+	  case EEL_OP_SUB:
+		result->classid = EEL_CREAL;
+		result->real.v = left - right;
+		return 0;
+	  case EEL_OP_MUL:
+		result->classid = EEL_CREAL;
+		result->real.v = left * right;
+		return 0;
+	  case EEL_OP_DIV:
+		if(!right)
+			return EEL_XDIVBYZERO;
+		result->classid = EEL_CREAL;
+		result->real.v = left / right;
+		return 0;
+	  case EEL_OP_EQ:
+		result->classid = EEL_CBOOLEAN;
+		result->integer.v = left == right;
+		return 0;
+	  case EEL_OP_NE:
+		result->classid = EEL_CBOOLEAN;
+		result->integer.v = !(left == right);
+		return 0;
+	  case EEL_OP_GT:
+		result->classid = EEL_CBOOLEAN;
+		result->integer.v = left > right;
+		return 0;
+	  case EEL_OP_GE:
+		result->classid = EEL_CBOOLEAN;
+		result->integer.v = left >= right;
+		return 0;
+	  case EEL_OP_LT:
+		result->classid = EEL_CBOOLEAN;
+		result->integer.v = !(left >= right);
+		return 0;
+	  case EEL_OP_LE:
+		result->classid = EEL_CBOOLEAN;
+		result->integer.v = !(left > right);
+		return 0;
+	}
+	return EEL_XINTERNAL;
+}
+
+
+/*
+ * Compare-and-branch tests. The compiler fuses comparisons with conditional
+ * jumps into these, so the results must be exactly what the BOP, BOPI or BOPC
+ * would have produced and JUMPNZ would have tested.
+ */
+static inline EEL_xno q_cmp(EEL_vm *vm, int op, EEL_value *left,
+		EEL_value *right, int *result)
+{
+	EEL_value r;
+	EEL_xno x;
+	if((left->classid == EEL_CINTEGER) && (right->classid == EEL_CINTEGER))
+		x = q_iop(op, left->integer.v, right->integer.v, &r);
+	else if((left->classid == EEL_CREAL) && (right->classid == EEL_CREAL))
+		x = q_rop(op, left->real.v, right->real.v, &r);
+	else
+	{
+		x = eel_operate(left, op, right, &r);
+		if(x)
+			return x;
+		eel_v_receive(&r);
+		*result = eel_test_nz(vm, &r);
+		return 0;
+	}
+	*result = r.integer.v;
+	return x;
+}
+
+static inline EEL_xno q_cmpi(EEL_vm *vm, int op, EEL_value *left, int right,
+		int *result)
+{
+	EEL_value r;
+	switch(left->classid)
+	{
+	  case EEL_CINTEGER:
+		q_iop(op, left->integer.v, right, &r);
+		break;
+	  case EEL_CREAL:
+		q_rop(op, left->real.v, right, &r);
+		break;
+	  default:
+		r.classid = EEL_CINTEGER;
+		r.integer.v = right;
+		return q_cmp(vm, op, left, &r, result);
+	}
+	*result = r.integer.v;
+	return 0;
+}
+
+/*
+ * Evaluate a VEXPR expression one operator at a time, like the equivalent BOP
+ * instructions would, for operands that eel_vector_expr() cannot handle.
+ */
+static inline EEL_xno vexpr_operate(const char *expr, EEL_value *operands,
+		EEL_value *result)
+{
+	EEL_value stack[EEL_VEXPR_MAXOPERANDS];
+	int sp = 0;
+	for( ; *expr; ++expr)
+	{
+		EEL_xno x;
+		int op;
+		if((*expr >= 'a') && (*expr < 'a' + EEL_VEXPR_MAXOPERANDS) &&
+				(sp < EEL_VEXPR_MAXOPERANDS))
+		{
+			stack[sp++] = operands[*expr - 'a'];
+			continue;
+		}
+		switch(*expr)
+		{
+		  case '+':	op = EEL_OP_VADD; break;
+		  case '-':	op = EEL_OP_VSUB; break;
+		  case '*':	op = EEL_OP_VMUL; break;
+		  default:	return EEL_XINTERNAL;
+		}
+		if(sp < 2)
+			return EEL_XINTERNAL;
+		x = eel_operate(&stack[sp - 2], op, &stack[sp - 1],
+				&stack[sp - 2]);
+		if(x)
+			return x;
+		eel_v_receive(&stack[sp - 2]);
+		--sp;
+	}
+	if(sp != 1)
+		return EEL_XINTERNAL;
+	*result = stack[0];
+	return 0;
+}
+
+
 #define	XCHECK(fn)			\
 	({				\
 		EEL_xno xxx = (fn);	\
@@ -1016,6 +1462,34 @@ static inline EEL_value *get_tuparg_default(EEL_callframe *cf, unsigned pos)
 	}						\
 })
 
+/*
+ * Instruction quickening. A generic operator instruction that sees two
+ * integer or two real operands rewrites itself (that is, the opcode of the
+ * instruction currently being executed, of operand layout 'y') into the 'iop'
+ * or 'rop' form, which handles only that case. On a type miss, a quickened
+ * instruction DEQUICKEN()s back to the generic form, and takes the slow path.
+ */
+#define	QUICKEN(left, right, iop, rop, y)				\
+	({								\
+		if(((left).classid == EEL_CINTEGER) &&			\
+				((right).classid == EEL_CINTEGER))	\
+		{							\
+			CODE[PC - EEL_OSIZE_##y] = EEL_O##iop##_##y;	\
+			++o2EEL_function(CALLFRAME->f)->e.quickens;	\
+		}							\
+		else if(((left).classid == EEL_CREAL) &&		\
+				((right).classid == EEL_CREAL))		\
+		{							\
+			CODE[PC - EEL_OSIZE_##y] = EEL_O##rop##_##y;	\
+			++o2EEL_function(CALLFRAME->f)->e.quickens;	\
+		}							\
+	})
+#define	DEQUICKEN(op, y)						\
+	({								\
+		CODE[PC - EEL_OSIZE_##y] = EEL_O##op##_##y;		\
+		++o2EEL_function(CALLFRAME->f)->e.dequickens;		\
+	})
+
 /*
  * Various stuff to do right before executing a VM instruction.
  * (Might include NEXT and stuff, so DO NOT use inside NEXT!)
@@ -1042,6 +1516,8 @@ static inline EEL_value *get_tuparg_default(EEL_callframe *cf, unsigned pos)
 		)							\
 		DBG4E(check_callframe(vm, CALLFRAME);)			\
 		DBG6B(++VMP->instructions;)				\
+		if(--VMP->slice < 0)					\
+			XCHECK(slice_end(vm));				\
 	} while(0)
 
 EEL_xno eel_run(EEL_vm *vm)
@@ -1078,6 +1554,7 @@ EEL_xno eel_run(EEL_vm *vm)
 	{								\
 		PREINSTRUCTION;						\
 		vmprofile_in(vm, (EEL_opcodes)vms.code[PC]);		\
+		vmsequence_in(vm, vms.code + PC);			\
 		{							\
 			++PC;						\
 			THROW(EEL_XILLEGAL);				\
@@ -1092,6 +1569,7 @@ EEL_xno eel_run(EEL_vm *vm)
 	{								\
 		PREINSTRUCTION;						\
 		vmprofile_in(vm, (EEL_opcodes)vms.code[PC]);		\
+		vmsequence_in(vm, vms.code + PC);			\
 		{							\
 			EEL_OPR_##y(vms.code + PC)			\
 			PC += EEL_OSIZE_##y;				\
@@ -1126,6 +1604,7 @@ EEL_xno eel_run(EEL_vm *vm)
 	{								\
 		PREINSTRUCTION;						\
 		vmprofile_in(vm, (EEL_opcodes)vms.code[PC]);		\
+		vmsequence_in(vm, vms.code + PC);			\
 		switch((EEL_opcodes)vms.code[PC])			\
 		{							\
 		  case EEL_OILLEGAL_0:					\
@@ -1247,6 +1726,126 @@ EEL_xno eel_run(EEL_vm *vm)
 		if(eel_test_nz(vm, &R[A]))
 			PC += B;
 
+	  EEL_IJUMPEQ
+		int jump;
+		XCHECK(q_cmp(vm, EEL_OP_EQ, &R[A], &R[B], &jump));
+		if(jump)
+			PC += C;
+
+	  EEL_IJUMPNE
+		int jump;
+		XCHECK(q_cmp(vm, EEL_OP_NE, &R[A], &R[B], &jump));
+		if(jump)
+			PC += C;
+
+	  EEL_IJUMPGE
+		int jump;
+		XCHECK(q_cmp(vm, EEL_OP_GE, &R[A], &R[B], &jump));
+		if(jump)
+			PC += C;
+
+	  EEL_IJUMPLE
+		int jump;
+		XCHECK(q_cmp(vm, EEL_OP_LE, &R[A], &R[B], &jump));
+		if(jump)
+			PC += C;
+
+	  EEL_IJUMPGT
+		int jump;
+		XCHECK(q_cmp(vm, EEL_OP_GT, &R[A], &R[B], &jump));
+		if(jump)
+			PC += C;
+
+	  EEL_IJUMPLT
+		int jump;
+		XCHECK(q_cmp(vm, EEL_OP_LT, &R[A], &R[B], &jump));
+		if(jump)
+			PC += C;
+
+	  EEL_IJUMPEQI
+		int jump;
+		XCHECK(q_cmpi(vm, EEL_OP_EQ, &R[A], B, &jump));
+		if(jump)
+			PC += C;
+
+	  EEL_IJUMPNEI
+		int jump;
+		XCHECK(q_cmpi(vm, EEL_OP_NE, &R[A], B, &jump));
+		if(jump)
+			PC += C;
+
+	  EEL_IJUMPGEI
+		int jump;
+		XCHECK(q_cmpi(vm, EEL_OP_GE, &R[A], B, &jump));
+		if(jump)
+			PC += C;
+
+	  EEL_IJUMPLEI
+		int jump;
+		XCHECK(q_cmpi(vm, EEL_OP_LE, &R[A], B, &jump));
+		if(jump)
+			PC += C;
+
+	  EEL_IJUMPGTI
+		int jump;
+		XCHECK(q_cmpi(vm, EEL_OP_GT, &R[A], B, &jump));
+		if(jump)
+			PC += C;
+
+	  EEL_IJUMPLTI
+		int jump;
+		XCHECK(q_cmpi(vm, EEL_OP_LT, &R[A], B, &jump));
+		if(jump)
+			PC += C;
+
+	  EEL_IJUMPEQC
+		EEL_function *f = o2EEL_function(CALLFRAME->f);
+		int jump;
+		XCHECK(q_cmp(vm, EEL_OP_EQ, &R[A], &f->e.constants[B],
+				&jump));
+		if(jump)
+			PC += C;
+
+	  EEL_IJUMPNEC
+		EEL_function *f = o2EEL_function(CALLFRAME->f);
+		int jump;
+		XCHECK(q_cmp(vm, EEL_OP_NE, &R[A], &f->e.constants[B],
+				&jump));
+		if(jump)
+			PC += C;
+
+	  EEL_IJUMPGEC
+		EEL_function *f = o2EEL_function(CALLFRAME->f);
+		int jump;
+		XCHECK(q_cmp(vm, EEL_OP_GE, &R[A], &f->e.constants[B],
+				&jump));
+		if(jump)
+			PC += C;
+
+	  EEL_IJUMPLEC
+		EEL_function *f = o2EEL_function(CALLFRAME->f);
+		int jump;
+		XCHECK(q_cmp(vm, EEL_OP_LE, &R[A], &f->e.constants[B],
+				&jump));
+		if(jump)
+			PC += C;
+
+	  EEL_IJUMPGTC
+		EEL_function *f = o2EEL_function(CALLFRAME->f);
+		int jump;
+		XCHECK(q_cmp(vm, EEL_OP_GT, &R[A], &f->e.constants[B],
+				&jump));
+		if(jump)
+			PC += C;
+
+	  EEL_IJUMPLTC
+		EEL_function *f = o2EEL_function(CALLFRAME->f);
+		int jump;
+		XCHECK(q_cmp(vm, EEL_OP_LT, &R[A], &f->e.constants[B],
+				&jump));
+		if(jump)
+			PC += C;
+
 	  EEL_ISWITCH
 		EEL_value offs;
 		EEL_xno x;
@@ -1481,7 +2080,7 @@ EEL_xno eel_run(EEL_vm *vm)
 		DBG4E(dump_callframe(vm, CALLFRAME, "CALL");)
 		XCHECK(get_function(vm, &R[A], &f));
 		XCHECK(check_args(vm, f));
-		XCHECK(call_f(vm, f, -1, 0));
+		XCHECK(call_f(vm, f, -1, 0, 0));
 		reload_context(vm, &vms);
 
 	  EEL_ICALLR
@@ -1489,7 +2088,7 @@ EEL_xno eel_run(EEL_vm *vm)
 		DBG4E(dump_callframe(vm, CALLFRAME, "CALLR");)
 		XCHECK(get_function(vm, &R[A], &f));
 		XCHECK(check_args(vm, f));
-		XCHECK(call_f(vm, f, vm->base + B, 0));
+		XCHECK(call_f(vm, f, vm->base + B, 0, 0));
 		reload_context(vm, &vms);
 
 	  EEL_ICCALL
@@ -1502,7 +2101,7 @@ EEL_xno eel_run(EEL_vm *vm)
 		if(f->e.constants[B].objref.v->classid != EEL_CFUNCTION)
 			DUMP(EEL_XARGUMENTS, "CCALL: Object is not a function!");
 #endif
-		XCHECK(call_f(vm, f->e.constants[B].objref.v, -1, A));
+		XCHECK(call_f(vm, f->e.constants[B].objref.v, -1, A, 0));
 		reload_context(vm, &vms);
 
 	  EEL_ICCALLR
@@ -1515,7 +2114,23 @@ EEL_xno eel_run(EEL_vm *vm)
 		if(f->e.constants[C].objref.v->classid != EEL_CFUNCTION)
 			DUMP(EEL_XARGUMENTS, "CCALL: Object is not a function!");
 #endif
-		XCHECK(call_f(vm, f->e.constants[C].objref.v, vm->base + B, A));
+		XCHECK(call_f(vm, f->e.constants[C].objref.v, vm->base + B, A,
+				0));
+		reload_context(vm, &vms);
+
+	  EEL_IPHCCALL
+		EEL_function *f = o2EEL_function(CALLFRAME->f);
+		DBG4E(dump_callframe(vm, CALLFRAME, "PHCCALL");)
+#ifdef EEL_VM_CHECKING
+		if(!EEL_IS_OBJREF(f->e.constants[C].classid))
+			DUMP(EEL_XARGUMENTS, "PHCCALL: Constant is not an "
+					"object reference!");
+		if(f->e.constants[C].objref.v->classid != EEL_CFUNCTION)
+			DUMP(EEL_XARGUMENTS, "PHCCALL: Object is not a "
+					"function!");
+#endif
+		XCHECK(call_f(vm, f->e.constants[C].objref.v, vm->base + B, A,
+				EEL_CFF_PUSHRESULT));
 		reload_context(vm, &vms);
 
 	  EEL_IRETURN
@@ -1543,6 +2158,7 @@ EEL_xno eel_run(EEL_vm *vm)
 
 	  EEL_IRETURNR
 		int ri = CALLFRAME->result;
+		int push = CALLFRAME->flags & EEL_CFF_PUSHRESULT;
 		DBG6(printf("Copying result from R[%d] to heap[%d]\n", A, ri);)
 		/* Give the result to the caller! */
 		if(ri >=0)
@@ -1568,7 +2184,13 @@ EEL_xno eel_run(EEL_vm *vm)
 			RETURN(EEL_XEND);
 		reload_context(vm, &vms);
 		DBG6(printf("<=== (Returned to function %p)\n", CALLFRAME->f);)
-		if(ri >=0)
+		if(push)
+		{
+			/* PHCCALL; hand the result over to the argument stack */
+			eel_v_move(S, vm->heap + ri);
+			++vm->sp;
+		}
+		else if(ri >=0)
 			eel_v_receive(vm->heap + ri);
 
 	  /* Memory management */
@@ -1761,10 +2383,18 @@ EEL_xno eel_run(EEL_vm *vm)
 
 	  EEL_IINDGETC
 		EEL_function *f = o2EEL_function(CALLFRAME->f);
+		EEL_tableitem *ti;
 		switch(R[B].classid)
 		{
 		  case EEL_COBJREF:
 		  case EEL_CWEAKREF:
+			if((ti = icache_lookup(f, R[B].objref.v,
+					&f->e.constants[C], D)))
+			{
+				eel_v_copy(&R[A], &ti->value);
+				eel_v_receive(&R[A]);
+				NEXT;
+			}
 			XCHECK(eel_o__metamethod(R[B].objref.v,
 					EEL_MM_GETINDEX, &f->e.constants[C],
 					&R[A]));
@@ -1776,10 +2406,18 @@ EEL_xno eel_run(EEL_vm *vm)
 
 	  EEL_IINDSETC
 		EEL_function *f = o2EEL_function(CALLFRAME->f);
+		EEL_tableitem *ti;
 		switch(R[B].classid)
 		{
 		  case EEL_COBJREF:
 		  case EEL_CWEAKREF:
+			if((ti = icache_lookup(f, R[B].objref.v,
+					&f->e.constants[C], D)))
+			{
+				eel_v_disown_nz(&ti->value);
+				eel_v_copy(&ti->value, &R[A]);
+				NEXT;
+			}
 			XCHECK(eel_o__metamethod(R[B].objref.v,
 					EEL_MM_SETINDEX, &f->e.constants[C],
 					&R[A]));
@@ -2032,6 +2670,8 @@ EEL_xno eel_run(EEL_vm *vm)
 #endif
 	  /* Operators */
 	  EEL_IBOP
+		if(q_operator(C))
+			QUICKEN(R[B], R[D], IBOP, RBOP, ABCD);
 		XCHECK(eel_operate(&R[B], C, &R[D], &R[A]));
 		eel_v_receive(&R[A]);
 
@@ -2054,6 +2694,12 @@ EEL_xno eel_run(EEL_vm *vm)
 
 	  EEL_IBOPI
 		EEL_value iv;
+		if(q_operator(C))
+		{
+			/* Only the register operand decides the form */
+			iv.classid = R[B].classid;
+			QUICKEN(R[B], iv, IBOPI, RBOPI, ABCsDx);
+		}
 		iv.classid = EEL_CINTEGER;
 		iv.integer.v = D;
 		XCHECK(eel_operate(&R[B], C, &iv, &R[A]));
@@ -2137,18 +2783,22 @@ EEL_xno eel_run(EEL_vm *vm)
 		}
 
 	  EEL_IADD
+		QUICKEN(R[B], R[C], IADD, RADD, ABC);
 		XCHECK(eel_op_add(&R[B], &R[C], &R[A]));
 		eel_v_receive(&R[A]);
 
 	  EEL_ISUB
+		QUICKEN(R[B], R[C], ISUB, RSUB, ABC);
 		XCHECK(eel_op_sub(&R[B], &R[C], &R[A]));
 		eel_v_receive(&R[A]);
 
 	  EEL_IMUL
+		QUICKEN(R[B], R[C], IMUL, RMUL, ABC);
 		XCHECK(eel_op_mul(&R[B], &R[C], &R[A]));
 		eel_v_receive(&R[A]);
 
 	  EEL_IDIV
+		QUICKEN(R[B], R[C], IDIV, RDIV, ABC);
 		XCHECK(eel_op_div(&R[B], &R[C], &R[A]));
 		eel_v_receive(&R[A]);
 
@@ -2190,6 +2840,153 @@ EEL_xno eel_run(EEL_vm *vm)
 		XCHECK(eel_op_power(&R[A], &R[B], S));
 		++vm->sp;
 
+	  /* Quickened operators */
+	  EEL_IIADD
+		if((R[B].classid != EEL_CINTEGER) ||
+				(R[C].classid != EEL_CINTEGER))
+		{
+			DEQUICKEN(ADD, ABC);
+			XCHECK(eel_op_add(&R[B], &R[C], &R[A]));
+			eel_v_receive(&R[A]);
+			NEXT;
+		}
+		q_iop(EEL_OP_ADD, R[B].integer.v, R[C].integer.v, &R[A]);
+
+	  EEL_IRADD
+		if((R[B].classid != EEL_CREAL) || (R[C].classid != EEL_CREAL))
+		{
+			DEQUICKEN(ADD, ABC);
+			XCHECK(eel_op_add(&R[B], &R[C], &R[A]));
+			eel_v_receive(&R[A]);
+			NEXT;
+		}
+		q_rop(EEL_OP_ADD, R[B].real.v, R[C].real.v, &R[A]);
+
+	  EEL_IISUB
+		if((R[B].classid != EEL_CINTEGER) ||
+				(R[C].classid != EEL_CINTEGER))
+		{
+			DEQUICKEN(SUB, ABC);
+			XCHECK(eel_op_sub(&R[B], &R[C], &R[A]));
+			eel_v_receive(&R[A]);
+			NEXT;
+		}
+		q_iop(EEL_OP_SUB, R[B].integer.v, R[C].integer.v, &R[A]);
+
+	  EEL_IRSUB
+		if((R[B].classid != EEL_CREAL) || (R[C].classid != EEL_CREAL))
+		{
+			DEQUICKEN(SUB, ABC);
+			XCHECK(eel_op_sub(&R[B], &R[C], &R[A]));
+			eel_v_receive(&R[A]);
+			NEXT;
+		}
+		q_rop(EEL_OP_SUB, R[B].real.v, R[C].real.v, &R[A]);
+
+	  EEL_IIMUL
+		if((R[B].classid != EEL_CINTEGER) ||
+				(R[C].classid != EEL_CINTEGER))
+		{
+			DEQUICKEN(MUL, ABC);
+			XCHECK(eel_op_mul(&R[B], &R[C], &R[A]));
+			eel_v_receive(&R[A]);
+			NEXT;
+		}
+		q_iop(EEL_OP_MUL, R[B].integer.v, R[C].integer.v, &R[A]);
+
+	  EEL_IRMUL
+		if((R[B].classid != EEL_CREAL) || (R[C].classid != EEL_CREAL))
+		{
+			DEQUICKEN(MUL, ABC);
+			XCHECK(eel_op_mul(&R[B], &R[C], &R[A]));
+			eel_v_receive(&R[A]);
+			NEXT;
+		}
+		q_rop(EEL_OP_MUL, R[B].real.v, R[C].real.v, &R[A]);
+
+	  EEL_IIDIV
+		if((R[B].classid != EEL_CINTEGER) ||
+				(R[C].classid != EEL_CINTEGER))
+		{
+			DEQUICKEN(DIV, ABC);
+			XCHECK(eel_op_div(&R[B], &R[C], &R[A]));
+			eel_v_receive(&R[A]);
+			NEXT;
+		}
+		XCHECK(q_iop(EEL_OP_DIV, R[B].integer.v, R[C].integer.v,
+				&R[A]));
+
+	  EEL_IRDIV
+		if((R[B].classid != EEL_CREAL) || (R[C].classid != EEL_CREAL))
+		{
+			DEQUICKEN(DIV, ABC);
+			XCHECK(eel_op_div(&R[B], &R[C], &R[A]));
+			eel_v_receive(&R[A]);
+			NEXT;
+		}
+		XCHECK(q_rop(EEL_OP_DIV, R[B].real.v, R[C].real.v,
+				&R[A]));
+
+	  EEL_IIBOP
+		if((R[B].classid != EEL_CINTEGER) ||
+				(R[D].classid != EEL_CINTEGER))
+		{
+			DEQUICKEN(BOP, ABCD);
+			XCHECK(eel_operate(&R[B], C, &R[D], &R[A]));
+			eel_v_receive(&R[A]);
+			NEXT;
+		}
+		XCHECK(q_iop(C, R[B].integer.v, R[D].integer.v, &R[A]));
+
+	  EEL_IRBOP
+		if((R[B].classid != EEL_CREAL) || (R[D].classid != EEL_CREAL))
+		{
+			DEQUICKEN(BOP, ABCD);
+			XCHECK(eel_operate(&R[B], C, &R[D], &R[A]));
+			eel_v_receive(&R[A]);
+			NEXT;
+		}
+		XCHECK(q_rop(C, R[B].real.v, R[D].real.v, &R[A]));
+
+	  EEL_IIBOPI
+		if(R[B].classid != EEL_CINTEGER)
+		{
+			EEL_value iv;
+			iv.classid = EEL_CINTEGER;
+			iv.integer.v = D;
+			DEQUICKEN(BOPI, ABCsDx);
+			XCHECK(eel_operate(&R[B], C, &iv, &R[A]));
+			eel_v_receive(&R[A]);
+			NEXT;
+		}
+		XCHECK(q_iop(C, R[B].integer.v, D, &R[A]));
+
+	  EEL_IRBOPI
+		if(R[B].classid != EEL_CREAL)
+		{
+			EEL_value iv;
+			iv.classid = EEL_CINTEGER;
+			iv.integer.v = D;
+			DEQUICKEN(BOPI, ABCsDx);
+			XCHECK(eel_operate(&R[B], C, &iv, &R[A]));
+			eel_v_receive(&R[A]);
+			NEXT;
+		}
+		XCHECK(q_rop(C, R[B].real.v, D, &R[A]));
+
+	  /* Fused vector expressions */
+	  EEL_IVEXPR
+		EEL_function *f = o2EEL_function(CALLFRAME->f);
+		const char *expr = o2EEL_string(f->e.constants[C].objref.v)->
+				buffer;
+		EEL_xno x = eel_vector_expr(expr, &R[B], &R[A]);
+		if(!x)
+			eel_v_receive(&R[A]);
+		else if(x == EEL_XNOTIMPLEMENTED)
+			XCHECK(vexpr_operate(expr, &R[B], &R[A]));
+		else
+			THROW(x);
+
 	  /* Constructors */
 	  EEL_INEW
 		XCHECK(eel_o__construct(vm, B,
@@ -2218,7 +3015,7 @@ EEL_xno eel_run(EEL_vm *vm)
 		DBGK4(printf("TRY passing on result index heap[%d].\n",
 				CALLFRAME->result);)
 		XCHECK(call_eel(vm, f->e.constants[B].objref.v,
-				CALLFRAME->result, 0));
+				CALLFRAME->result, 0, 0));
 		reload_context(vm, &vms);
 		CALLFRAME->catcher = f->e.constants[A].objref.v;
 		CALLFRAME->flags |= EEL_CFF_TRYBLOCK;
@@ -2234,7 +3031,7 @@ EEL_xno eel_run(EEL_vm *vm)
 		DBGK4(printf("UNTRY passing on result index heap[%d].\n",
 				CALLFRAME->result);)
 		XCHECK(call_eel(vm, f->e.constants[A].objref.v,
-				CALLFRAME->result, 0));
+				CALLFRAME->result, 0, 0));
 		reload_context(vm, &vms);
 		CALLFRAME->flags |= EEL_CFF_TRYBLOCK | EEL_CFF_UNTRY;
 
@@ -2362,6 +3159,11 @@ static inline int vm_init(EEL_state *es, EEL_vm *vm, int heap)
 		vm->realloc = default_realloc;
 		vm->free = default_free;
 	}
+	if(eel_mp_open(vm, es->vm) < 0)
+	{
+		eel_vm_close(vm);
+		return -1;
+	}
 	VMP->state = es;
 
 	/*
@@ -2394,6 +3196,21 @@ EEL_vm *eel_vm_open(EEL_state *es, int heap)
 
 	if(vm_init(es, vm, heap) < 0)
 		return NULL;
+	VMP->cctrigger = EEL_CC_TRIGGER;
+	VMP->slice = VMP->slicelen = INT_MAX;
+	VMP->budgetend = LLONG_MAX;
+
+#ifdef EEL_VM_SEQUENCE_PROFILING
+	VMP->vmsq_pairs = (long long *)calloc((EEL_O_LAST + 1) *
+			(EEL_O_LAST + 1), sizeof(long long));
+	VMP->vmsq_triples = (EEL_vmsentry *)calloc(EEL_VMS_TRIPLES,
+			sizeof(EEL_vmsentry));
+	if(!VMP->vmsq_pairs || !VMP->vmsq_triples)
+	{
+		eel_vm_close(vm);
+		return NULL;
+	}
+#endif
 
 #ifdef EEL_VM_PROFILING
 	for(i = 0; i < EEL_VMP_POINTS; ++i)
@@ -2517,7 +3334,15 @@ void eel_vm_close(EEL_vm *vm)
 	printf("'----------------------------------"
 			"----------------- -- -- - - -  -  -\n");
 #endif
+#ifdef EEL_VM_SEQUENCE_PROFILING
+	if(VMP->vmsq_pairs && VMP->vmsq_triples)
+		vmsequence_report(vm);
+	free(VMP->vmsq_pairs);
+	free(VMP->vmsq_triples);
+#endif
+	eel_cc_close(vm);
 	eel_free(vm, vm->scratch);
+	eel_mp_close(vm);
 	free(vm->heap);
 	free(vm);
 }
@@ -2671,6 +3496,9 @@ static inline EEL_xno call_do_run(EEL_vm *vm)
 		{
 		  case EEL_XOK:
 		  case EEL_XYIELD:
+			/* Let any green threads run for a while */
+			if(VMP->threads)
+				eel_threads_schedule(vm);
 			break;
 		  case EEL_XEND:
 			return 0;
@@ -2686,6 +3514,7 @@ EEL_xno eel_call(EEL_vm *vm, EEL_object *f)
 	EEL_xno x;
 	EEL_function *func;
 	int result;
+	int outer = !vm->base;	/* Not called from within the VM */
 /*FIXME:*/
 	int save_resv = vm->resv;
 	int save_argv = vm->argv;
@@ -2734,14 +3563,25 @@ EEL_xno eel_call(EEL_vm *vm, EEL_object *f)
 		result = vm->base;
 	else
 		result = -1;
-	x = call_f(vm, f, result, 0);
+	x = call_f(vm, f, result, 0, 0);
 	if(!x)
 	{
 		/* If it's an EEL function, we actually need to *run* it...! */
 		if(!(func->common.flags & EEL_FF_CFUNC))
 		{
+			/*
+			 * Only calls from outside the VM can be suspended when
+			 * the budget runs out. Anything else has C code waiting
+			 * for it to finish.
+			 */
+			if(!outer)
+				eel_vm_hold_budget(vm);
 			x = call_do_run(vm);
-			if(x)
+			if(!outer)
+				eel_vm_release_budget(vm);
+			if(x == EEL_XCOUNTER)
+				VMP->suspended = 1;
+			else if(x)
 				call_msg(f, EEL_EM_VMERROR, "  Function "
 						"aborted with exception %s",
 						eel_x_name(vm, x));
@@ -2759,6 +3599,44 @@ EEL_xno eel_call(EEL_vm *vm, EEL_object *f)
 }
 
 
+EEL_xno eel_resume(EEL_vm *vm)
+{
+	EEL_xno x;
+	if(!VMP->suspended)
+		return EEL_XBADCONTEXT;
+	VMP->suspended = 0;
+	eel_clear_errors(VMP->state);
+	x = call_do_run(vm);
+	if(x == EEL_XCOUNTER)
+		VMP->suspended = 1;
+	else if(x)
+		eel_msg(VMP->state, EEL_EM_VMERROR, "eel_resume(): Function "
+				"aborted with exception %s", eel_x_name(vm, x));
+	return x;
+}
+
+
+void eel_set_budget(EEL_vm *vm, int instructions)
+{
+	/* Charge what's been executed, and start over at the next instruction */
+	eel_vm_slice(vm, 0);
+	if(instructions < 0)
+		VMP->budgetend = LLONG_MAX;
+	else
+		VMP->budgetend = VMP->executed + instructions;
+}
+
+
+int eel_get_budget(EEL_vm *vm)
+{
+	long long left;
+	if(VMP->budgetend == LLONG_MAX)
+		return -1;
+	left = VMP->budgetend - eel_vm_icount(vm);
+	return left > 0 ? left : 0;
+}
+
+
 EEL_xno eel_calln(EEL_vm *vm, EEL_object *m, const char *fn)
 {
 	EEL_xno x;
@@ -2817,6 +3695,96 @@ EEL_xno eel_callnf(EEL_vm *vm, EEL_object *m, const char *fn, const char *fmt, .
 	return x;
 }
 
+
+/*----------------------------------------------------------
+	Green thread contexts
+----------------------------------------------------------*/
+
+void eel_vm_swap(EEL_vm *vm, EEL_vmcontext *ctx)
+{
+	EEL_vmcontext tmp = *ctx;
+	ctx->heapsize = vm->heapsize;
+	ctx->heap = vm->heap;
+	ctx->pc = vm->pc;
+	ctx->base = vm->base;
+	ctx->sp = vm->sp;
+	ctx->sbase = vm->sbase;
+	ctx->resv = vm->resv;
+	ctx->argv = vm->argv;
+	ctx->argc = vm->argc;
+	eel_v_move(&ctx->exception, &VMP->exception);
+	vm->heapsize = tmp.heapsize;
+	vm->heap = tmp.heap;
+	vm->pc = tmp.pc;
+	vm->base = tmp.base;
+	vm->sp = tmp.sp;
+	vm->sbase = tmp.sbase;
+	vm->resv = tmp.resv;
+	vm->argv = tmp.argv;
+	vm->argc = tmp.argc;
+	eel_v_move(&VMP->exception, &tmp.exception);
+}
+
+
+EEL_xno eel_vm_context_open(EEL_vm *vm, EEL_vmcontext *ctx, int heap,
+		EEL_object *fo, EEL_value *argv, int argc)
+{
+	EEL_xno x;
+	int i, result;
+	memset(ctx, 0, sizeof(EEL_vmcontext));
+	ctx->exception.classid = EEL_CNIL;
+	eel_vm_swap(vm, ctx);
+	if(set_heap(vm, heap) < 0)
+	{
+		eel_vm_swap(vm, ctx);
+		return EEL_XMEMORY;
+	}
+
+	/* Same as a fresh VM, except that we always want the result */
+	vm->sbase = vm->sp = 1;
+	if(o2EEL_function(fo)->common.flags & EEL_FF_RESULTS)
+	{
+		vm->heap[0].classid = EEL_CBOOLEAN;
+		vm->heap[0].integer.v = 1;
+		result = 0;
+	}
+	else
+	{
+		vm->heap[0].classid = EEL_CNIL;
+		result = -1;
+	}
+
+	if(grow_heap(vm, vm->sp + argc) < 0)
+		x = EEL_XMEMORY;
+	else
+	{
+		for(i = 0; i < argc; ++i)
+			eel_v_copy(vm->heap + vm->sp++, argv + i);
+		if(!(x = check_args(vm, fo)))
+			x = call_f(vm, fo, result, 0, 0);
+	}
+	if(x)
+		stack_clear(vm);
+	eel_vm_swap(vm, ctx);
+	return x;
+}
+
+
+void eel_vm_context_close(EEL_vm *vm, EEL_vmcontext *ctx)
+{
+	if(!ctx->heap)
+		return;
+	eel_vm_swap(vm, ctx);
+	unwind(vm, 0);
+	stack_clear(vm);
+	eel_v_disown_nz(&VMP->exception);
+	VMP->exception.classid = EEL_CNIL;
+	free(vm->heap);
+	vm->heap = NULL;
+	vm->heapsize = 0;
+	eel_vm_swap(vm, ctx);
+}
+
 #if 0
 /*----------------------------------------------------------
 	VM Context Stack
@@ -60,6 +60,18 @@
 #define	EEL_IJUMPLE	EEL_I(JUMPLE, ABsCx)	/* If R[A] <= R[B] then PC += sCx; */
 #define	EEL_IJUMPGT	EEL_I(JUMPGT, ABsCx)	/* If R[A] > R[B] then PC += sCx; */
 #define	EEL_IJUMPLT	EEL_I(JUMPLT, ABsCx)	/* If R[A] < R[B] then PC += sCx; */
+#define	EEL_IJUMPEQI	EEL_I(JUMPEQI, AsBxsCx)	/* If R[A] == sBx then PC += sCx; */
+#define	EEL_IJUMPNEI	EEL_I(JUMPNEI, AsBxsCx)	/* If R[A] != sBx then PC += sCx; */
+#define	EEL_IJUMPGEI	EEL_I(JUMPGEI, AsBxsCx)	/* If R[A] >= sBx then PC += sCx; */
+#define	EEL_IJUMPLEI	EEL_I(JUMPLEI, AsBxsCx)	/* If R[A] <= sBx then PC += sCx; */
+#define	EEL_IJUMPGTI	EEL_I(JUMPGTI, AsBxsCx)	/* If R[A] > sBx then PC += sCx; */
+#define	EEL_IJUMPLTI	EEL_I(JUMPLTI, AsBxsCx)	/* If R[A] < sBx then PC += sCx; */
+#define	EEL_IJUMPEQC	EEL_I(JUMPEQC, ABxsCx)	/* If R[A] == c[Bx] then PC += sCx; */
+#define	EEL_IJUMPNEC	EEL_I(JUMPNEC, ABxsCx)	/* If R[A] != c[Bx] then PC += sCx; */
+#define	EEL_IJUMPGEC	EEL_I(JUMPGEC, ABxsCx)	/* If R[A] >= c[Bx] then PC += sCx; */
+#define	EEL_IJUMPLEC	EEL_I(JUMPLEC, ABxsCx)	/* If R[A] <= c[Bx] then PC += sCx; */
+#define	EEL_IJUMPGTC	EEL_I(JUMPGTC, ABxsCx)	/* If R[A] > c[Bx] then PC += sCx; */
+#define	EEL_IJUMPLTC	EEL_I(JUMPLTC, ABxsCx)	/* If R[A] < c[Bx] then PC += sCx; */
 #define	EEL_ISWITCH	EEL_I(SWITCH, ABxsCx)	/* try PC = c[Bx][R[A]]; */
 						/* except PC += sCx; */
 #define	EEL_IPRELOOP	EEL_I(PRELOOP, ABCsDx)
@@ -117,6 +129,13 @@
 			 * a local function, or that the function called does
 			 * not use upvalues.
 			 */
+#define	EEL_IPHCCALL	EEL_I(PHCCALL, ABCx)
+			/* Like CCALLR, but the result is pushed onto the
+			 * argument stack as the function returns. R[B] only
+			 * passes the result through try blocks and catchers,
+			 * and is undefined afterwards. The argument stack must
+			 * hold nothing but the arguments of this call.
+			 */
 #define	EEL_IRETURN	EEL_I(RETURN, 0)	/* Clean up and return. */
 #define	EEL_IRETURNR	EEL_I(RETURNR, A)	/* result = R[A]; CLEAN; RETURN; */
 
@@ -168,8 +187,9 @@
 #define	EEL_IINDSETI	EEL_I(INDSETI, ABC)	/* R[C][B] = R[A]; */
 #define	EEL_IINDGET	EEL_I(INDGET, ABC)	/* R[A] = R[C][R[B]]; */
 #define	EEL_IINDSET	EEL_I(INDSET, ABC)	/* R[C][R[B]] = R[A]; */
-#define	EEL_IINDGETC	EEL_I(INDGETC, ABCx)	/* R[A] = R[B][c[Cx]]; */
-#define	EEL_IINDSETC	EEL_I(INDSETC, ABCx)	/* R[B][c[Cx]] = R[A]; */
+#define	EEL_IINDGETC	EEL_I(INDGETC, ABCxDx)	/* R[A] = R[B][c[Cx]]; */
+#define	EEL_IINDSETC	EEL_I(INDSETC, ABCxDx)	/* R[B][c[Cx]] = R[A]; */
+			/* (Dx is the inline cache slot of INDGETC/INDSETC) */
 
 /* Argument access */
 #define	EEL_IGETARGI	EEL_I(GETARGI, AB)	/* R[A] = args[B]; */
@@ -235,6 +255,32 @@
 #define	EEL_IPHMOD	EEL_I(PHMOD, AB)	/* push R[A] % R[B]; */
 #define	EEL_IPHPOWER	EEL_I(PHPOWER, AB)	/* push R[A] ** R[B]; */
 
+/*
+ * Quickened operators. The VM rewrites the generic instructions above into
+ * these after seeing their operands, and back again on a type miss, so these
+ * are never issued by the compiler. 'I' variants require both operands to be
+ * integers, 'R' variants require reals.
+ */
+#define	EEL_IIADD	EEL_I(IADD, ABC)	/* R[A] = R[B] + R[C]; */
+#define	EEL_IRADD	EEL_I(RADD, ABC)	/* R[A] = R[B] + R[C]; */
+#define	EEL_IISUB	EEL_I(ISUB, ABC)	/* R[A] = R[B] - R[C]; */
+#define	EEL_IRSUB	EEL_I(RSUB, ABC)	/* R[A] = R[B] - R[C]; */
+#define	EEL_IIMUL	EEL_I(IMUL, ABC)	/* R[A] = R[B] * R[C]; */
+#define	EEL_IRMUL	EEL_I(RMUL, ABC)	/* R[A] = R[B] * R[C]; */
+#define	EEL_IIDIV	EEL_I(IDIV, ABC)	/* R[A] = R[B] / R[C]; */
+#define	EEL_IRDIV	EEL_I(RDIV, ABC)	/* R[A] = R[B] / R[C]; */
+#define	EEL_IIBOP	EEL_I(IBOP, ABCD)	/* R[A] = R[B] op[C] R[D]; */
+#define	EEL_IRBOP	EEL_I(RBOP, ABCD)	/* R[A] = R[B] op[C] R[D]; */
+#define	EEL_IIBOPI	EEL_I(IBOPI, ABCsDx)	/* R[A] = R[B] op[C] D; */
+#define	EEL_IRBOPI	EEL_I(RBOPI, ABCsDx)	/* R[A] = R[B] op[C] D; */
+
+/*
+ * Fused vector expression. c[Cx] is a string with the expression in postfix
+ * form, where 'a', 'b', ... are the operands R[B], R[B + 1], ..., and '+',
+ * '-' and '*' are the #+, #- and #* operators.
+ */
+#define	EEL_IVEXPR	EEL_I(VEXPR, ABCx)	/* R[A] = c[Cx](R[B]...); */
+
 /* Constructors */
 #define	EEL_INEW	EEL_I(NEW, AB)
 			/* R[A] = instance of type B from argument stack */
@@ -305,9 +351,19 @@
 	EEL_IPHMOD	EEL_IPHPOWER					\
 	EEL_INEW	EEL_ICLONE					\
 	EEL_ITRY	EEL_IUNTRY	EEL_ITHROW	EEL_IRETRY	\
-	EEL_IRETX	EEL_IRETXR
+	EEL_IRETX	EEL_IRETXR					\
+	EEL_IIADD	EEL_IRADD	EEL_IISUB	EEL_IRSUB	\
+	EEL_IIMUL	EEL_IRMUL	EEL_IIDIV	EEL_IRDIV	\
+	EEL_IIBOP	EEL_IRBOP	EEL_IIBOPI	EEL_IRBOPI	\
+	EEL_IVEXPR	EEL_IPHCCALL					\
+	EEL_IJUMPEQ	EEL_IJUMPNE	EEL_IJUMPGE	EEL_IJUMPLE	\
+	EEL_IJUMPGT	EEL_IJUMPLT					\
+	EEL_IJUMPEQI	EEL_IJUMPNEI	EEL_IJUMPGEI	EEL_IJUMPLEI	\
+	EEL_IJUMPGTI	EEL_IJUMPLTI					\
+	EEL_IJUMPEQC	EEL_IJUMPNEC	EEL_IJUMPGEC	EEL_IJUMPLEC	\
+	EEL_IJUMPGTC	EEL_IJUMPLTC
 
-#define	EEL_I_LAST	EEL_IRETXR
+#define	EEL_I_LAST	EEL_IJUMPLTC
 
 
 /*
@@ -371,6 +427,12 @@
 	unsigned B = EEL_OS16((ins), 3);
 #define	EEL_OSIZE_AxsBx		5
 
+#define	EEL_OPR_AsBxsCx(ins)		\
+	unsigned A = EEL_O8((ins), 1);	\
+	int B = EEL_OS16((ins), 2);	\
+	int C = EEL_OS16((ins), 4);
+#define	EEL_OSIZE_AsBxsCx	6
+
 #define	EEL_OPR_ABCx(ins)		\
 	unsigned A = EEL_O8((ins), 1);	\
 	unsigned B = EEL_O8((ins), 2);	\
@@ -409,6 +471,13 @@
 	int D = EEL_OS16((ins), 4);
 #define	EEL_OSIZE_ABCsDx	6
 
+#define	EEL_OPR_ABCxDx(ins)		\
+	unsigned A = EEL_O8((ins), 1);	\
+	unsigned B = EEL_O8((ins), 2);	\
+	unsigned C = EEL_O16((ins), 3);	\
+	unsigned D = EEL_O16((ins), 5);
+#define	EEL_OSIZE_ABCxDx	7
+
 /*
  * Instruction operand layouts
  */
@@ -430,8 +499,10 @@ typedef enum
 	EEL_OL_ABsCx,
 	EEL_OL_ABxCx,
 	EEL_OL_ABxsCx,
+	EEL_OL_AsBxsCx,
 	EEL_OL_ABCDx,
-	EEL_OL_ABCsDx
+	EEL_OL_ABCsDx,
+	EEL_OL_ABCxDx
 } EEL_operands;
 
 /*
@@ -546,6 +617,7 @@ typedef enum EEL_opcodes
 #define	EEL_CFF_TRYBLOCK	0x00000001
 #define	EEL_CFF_CATCHER		0x00000002
 #define	EEL_CFF_UNTRY		0x00000004
+#define	EEL_CFF_PUSHRESULT	0x00000008	/* Push result (PHCCALL) */
 
 typedef struct
 {
@@ -637,6 +709,18 @@ typedef enum
 } EEL_vmpxpoints;
 #endif
 
+#ifdef EEL_VM_SEQUENCE_PROFILING
+/* Size of the instruction triple histogram. (Must be a power of two!) */
+#define	EEL_VMS_TRIPLES	16384
+
+/* Histogram entry for one sequence of three VM instructions */
+typedef struct
+{
+	unsigned	key;	/* Packed opcodes + 1, or 0 for a free slot */
+	long long	count;	/* Number of times the sequence was executed */
+} EEL_vmsentry;
+#endif
+
 /* Private stuff, not suitable for the public VM struct */
 #if 0
 typedef struct EEL_vm_context EEL_vm_context;
@@ -651,11 +735,19 @@ typedef struct
 
 	/* String pool with cache */
 	EEL_object	**strings;	/* Array of buckets (lists) */
+	int		sbuckets;	/* Number of buckets (power of 2) */
+	int		scount;		/* Number of strings in the pool */
+	EEL_object	**ostrings;	/* Old buckets, while resizing */
+	int		osbuckets;	/* Number of old buckets */
+	int		smigrate;	/* Next old bucket to migrate */
+	unsigned	shits;		/* Lookups finding a live string */
+	unsigned	smisses;	/* Lookups creating a new string */
 #ifdef EEL_CACHE_STRINGS
 	EEL_object	*scache;	/* List of "dead" strings */
 	EEL_object	*scache_last;	/* End of cache list */
 	int		scache_size;	/* Current # of cached strings */
 	int		scache_max;	/* Max # of cached strings */
+	unsigned	scache_hits;	/* Strings resurrected from cache */
 #endif
 
 	/* Memory management/accounting */
@@ -678,6 +770,26 @@ typedef struct
 
 	int		is_closing;	/* Are we destroying the state? */
 
+	/* Cycle collector */
+	struct EEL_ccstate *cc;		/* Collector state (e_cycle.c) */
+	int		ccallocs;	/* Containers allocated since last step */
+	int		cctrigger;	/* Current step interval (allocations) */
+	int		ccpending;	/* Collection step triggered */
+
+	/* Memory pools (shared by all VMs of the state) */
+	struct EEL_mpool *mpool;
+
+	/* Green threads */
+	struct EEL_threads *threads;	/* Scheduler (threads/eel_threads.c) */
+
+	/* Instruction counting and budgets */
+	int		slice;		/* Instructions left of current count */
+	int		slicelen;	/* Length of current count */
+	long long	executed;	/* Instructions before current count */
+	long long	budgetend;	/* 'executed' where the budget runs out */
+	int		budgethold;	/* Budget is not enforced while > 0 */
+	int		suspended;	/* eel_call() ran out of budget */
+
 #ifdef	EEL_PROFILING
 	EEL_object	*p_current;	/* Currently running function */
 	long long	p_time;		/* Time of entering p_current */
@@ -688,6 +800,14 @@ typedef struct
 	EEL_opcodes	vmp_opcode;	/* Opcode currently being timed */
 	EEL_vmpentry	vmprof[EEL_VMP_POINTS];
 #endif
+#ifdef	EEL_VM_SEQUENCE_PROFILING
+	unsigned char	*vmsq_next;	/* Address following last instruction */
+	int		vmsq_prev[2];	/* Last two opcodes, or -1 */
+	long long	vmsq_count;	/* Instructions executed */
+	long long	vmsq_lost;	/* Triples that didn't fit the histogram */
+	long long	*vmsq_pairs;	/* [first * (EEL_O_LAST + 1) + second] */
+	EEL_vmsentry	*vmsq_triples;	/* Hash table of EEL_VMS_TRIPLES */
+#endif
 } EEL_vm_private;
 
 /* Get the private part, which is right after the public interface. */
@@ -705,6 +825,75 @@ static inline EEL_object *eel__current_function(EEL_vm *vm)
 	return cf->f;
 }
 
+
+/*
+ * Execution context of a green thread; the parts of EEL_vm and
+ * EEL_vm_private that need one instance per thread. A context is switched in
+ * by swapping it with the VM registers, and switched out by swapping again.
+ */
+typedef struct
+{
+	int		heapsize;
+	EEL_value	*heap;
+	int		pc;
+	int		base;
+	int		sp;
+	int		sbase;
+	int		resv;
+	int		argv;
+	int		argc;
+	EEL_value	exception;
+} EEL_vmcontext;
+
+/* Exchange the current execution context of 'vm' with 'ctx'. */
+void eel_vm_swap(EEL_vm *vm, EEL_vmcontext *ctx);
+
+/*
+ * Set up 'ctx' with a new heap of 'heap' values, ready to call 'fo' with the
+ * 'argc' arguments at 'argv' once run. The result of the call, if any, ends up
+ * in ctx->heap[0], and belongs to the caller. (C functions are called right
+ * away.)
+ *
+ * Returns 0, or an exception code if the call could not be set up. The context
+ * must be closed with eel_vm_context_close() either way.
+ */
+EEL_xno eel_vm_context_open(EEL_vm *vm, EEL_vmcontext *ctx, int heap,
+		EEL_object *fo, EEL_value *argv, int argc);
+
+/* Unwind any calls in progress in 'ctx', and free its heap. */
+void eel_vm_context_close(EEL_vm *vm, EEL_vmcontext *ctx);
+
+
+/*
+ * Instruction counting
+ *	The VM counts instructions down from VMP->slice, and calls back when
+ *	the count runs out, to switch threads and enforce the budget. Between
+ *	counts, the instructions executed are charged to VMP->executed.
+ */
+
+/*
+ * Charge the instructions executed so far, and start a new count of 'n'
+ * instructions, or whatever is left of the budget, if that's less.
+ */
+void eel_vm_slice(EEL_vm *vm, int n);
+
+/* Total number of VM instructions executed by 'vm'. */
+static inline long long eel_vm_icount(EEL_vm *vm)
+{
+	return VMP->executed + VMP->slicelen -
+			(VMP->slice > 0 ? VMP->slice : 0);
+}
+
+/*
+ * Stop enforcing the budget, for code that cannot be suspended, as it has C
+ * code waiting for it to finish. Calls nest.
+ */
+static inline void eel_vm_hold_budget(EEL_vm *vm)
+{
+	++VMP->budgethold;
+}
+void eel_vm_release_budget(EEL_vm *vm);
+
 #ifdef EEL_VM_CHECKING
 # define	EEL_IN_HEAP(vm, v)					\
 		((v >= vm->heap) && (v < vm->heap + vm->heapsize))
@@ -0,0 +1,1856 @@
+/*
+---------------------------------------------------------------------------
+	ec_bytecode.c - EEL Precompiled Module Format and Compile Cache
+---------------------------------------------------------------------------
+ * Copyright 2026 David Olofson
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from the
+ * use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+# include <process.h>
+#else
+# include <unistd.h>
+#endif
+#include "ec_bytecode.h"
+#include "ec_coder.h"
+#include "EEL_version.h"
+#include "EEL_platform.h"
+#include "e_state.h"
+#include "e_error.h"
+#include "e_module.h"
+#include "e_function.h"
+#include "e_string.h"
+#include "e_dstring.h"
+#include "e_array.h"
+#include "e_table.h"
+#include "e_object.h"
+
+/* Value tags */
+typedef enum
+{
+	EBC_NIL = 0,
+	EBC_REAL,
+	EBC_INTEGER,
+	EBC_BOOLEAN,
+	EBC_CLASSID,		/* Class name */
+	EBC_STRING,
+	EBC_DSTRING,
+	EBC_FUNCTION,		/* Index into module 'objects' */
+	EBC_FOREIGN,		/* Module name, export name */
+	EBC_ENVIRONMENT,
+	EBC_ARRAY,
+	EBC_TABLE
+} EBC_tags;
+
+/* Nesting limit for arrays and tables */
+#define	EBC_MAXDEPTH	64
+
+static const unsigned char ebc_magic[4] = { 'E', 'E', 'L', 'B' };
+
+#define	EBC_EELVERSION	EEL_MAKE_VERSION(EEL_MAJOR_VERSION,		\
+				EEL_MINOR_VERSION, EEL_MICRO_VERSION)
+
+
+int eel_bc_check(const unsigned char *data, unsigned len)
+{
+	if(!data || (len < sizeof(ebc_magic)))
+		return 0;
+	return memcmp(data, ebc_magic, sizeof(ebc_magic)) == 0;
+}
+
+
+/* Module specials that belong to the loader, rather than the code */
+static int bc_special_export(EEL_value *k)
+{
+	const char *s = eel_v2s(k);
+	if(!s)
+		return 0;
+	return !strcmp(s, "__filename") || !strcmp(s, "__modname") ||
+			!strcmp(s, "__modpath") || !strcmp(s, "__source");
+}
+
+
+/*----------------------------------------------------------
+	Writer
+----------------------------------------------------------*/
+
+typedef struct
+{
+	EEL_vm		*vm;
+	EEL_object	*module;
+	unsigned char	*data;
+	int		size;
+	int		maxsize;
+	int		depth;
+	int		fail;	/* Out of memory, or not serializable */
+} EBC_writer;
+
+
+static void w_bytes(EBC_writer *w, const void *d, int n)
+{
+	if(w->fail)
+		return;
+	if(w->size + n > w->maxsize)
+	{
+		unsigned char *nd;
+		int ns = w->maxsize ? w->maxsize : 256;
+		while(ns < w->size + n)
+			ns *= 2;
+		nd = (unsigned char *)eel_realloc(w->vm, w->data, ns);
+		if(!nd)
+		{
+			w->fail = 1;
+			return;
+		}
+		w->data = nd;
+		w->maxsize = ns;
+	}
+	memcpy(w->data + w->size, d, n);
+	w->size += n;
+}
+
+
+static void w_u8(EBC_writer *w, unsigned v)
+{
+	unsigned char b = v;
+	w_bytes(w, &b, 1);
+}
+
+
+static void w_u16(EBC_writer *w, unsigned v)
+{
+	unsigned char b[2];
+	b[0] = v;
+	b[1] = v >> 8;
+	w_bytes(w, b, 2);
+}
+
+
+static void w_u32(EBC_writer *w, EEL_uint32 v)
+{
+	unsigned char b[4];
+	b[0] = v;
+	b[1] = v >> 8;
+	b[2] = v >> 16;
+	b[3] = v >> 24;
+	w_bytes(w, b, 4);
+}
+
+
+static void w_real(EBC_writer *w, EEL_real v)
+{
+	union
+	{
+		EEL_real		r;
+		unsigned long long	u;
+	} cvt;
+	cvt.r = v;
+	w_u32(w, (EEL_uint32)cvt.u);
+	w_u32(w, (EEL_uint32)(cvt.u >> 32));
+}
+
+
+static void w_string(EBC_writer *w, const char *s, int len)
+{
+	w_u32(w, len);
+	w_bytes(w, s, len);
+}
+
+
+static int bc_objindex(EEL_object *mo, EEL_object *o)
+{
+	EEL_object_p_da *a = &o2EEL_module(mo)->objects;
+	int i;
+	for(i = 0; i < a->size; ++i)
+		if(a->array[i] == o)
+			return i;
+	return -1;
+}
+
+
+/* Find the name under which module 'mo' exports 'o' */
+static EEL_object *bc_export_name(EEL_object *mo, EEL_object *o)
+{
+	EEL_object *x = o2EEL_module(mo)->exports;
+	int i, len = eel_length(x);
+	for(i = 0; i < len; ++i)
+	{
+		EEL_tableitem *ti = eel_table_get_item(x, i);
+		EEL_value *k = eel_table_get_key(ti);
+		EEL_value *v = eel_table_get_value(ti);
+		if(!EEL_IS_OBJREF(v->classid) || (v->objref.v != o))
+			continue;
+		if(EEL_CLASS(k) != EEL_CSTRING)
+			continue;
+		return k->objref.v;
+	}
+	return NULL;
+}
+
+
+static void w_value(EBC_writer *w, EEL_value *v);
+
+static void w_function(EBC_writer *w, EEL_object *fo)
+{
+	EEL_function *f = o2EEL_function(fo);
+	EEL_object *key;
+	const char *modname;
+	if(f->common.module == w->module)
+	{
+		int i = bc_objindex(w->module, fo);
+		if(i < 0)
+		{
+			w->fail = 1;
+			return;
+		}
+		w_u8(w, EBC_FUNCTION);
+		w_u32(w, i);
+		return;
+	}
+	if(!f->common.module || !(key = bc_export_name(f->common.module, fo)))
+	{
+		w->fail = 1;
+		return;
+	}
+	modname = eel_table_getss(o2EEL_module(f->common.module)->exports,
+			"__modname");
+	if(!modname)
+	{
+		w->fail = 1;
+		return;
+	}
+	w_u8(w, EBC_FOREIGN);
+	w_string(w, modname, strlen(modname));
+	w_string(w, eel_o2s(key), eel_length(key));
+}
+
+
+static void w_object(EBC_writer *w, EEL_object *o)
+{
+	EEL_vm *vm = w->vm;
+	int i, len;
+	if(o == VMP->state->environment)
+	{
+		w_u8(w, EBC_ENVIRONMENT);
+		return;
+	}
+	if(++w->depth > EBC_MAXDEPTH)
+	{
+		w->fail = 1;
+		return;
+	}
+	switch((EEL_classes)o->classid)
+	{
+	  case EEL_CSTRING:
+		w_u8(w, EBC_STRING);
+		w_string(w, eel_o2s(o), eel_length(o));
+		break;
+	  case EEL_CDSTRING:
+		w_u8(w, EBC_DSTRING);
+		w_string(w, o2EEL_dstring(o)->buffer, eel_length(o));
+		break;
+	  case EEL_CFUNCTION:
+		w_function(w, o);
+		break;
+	  case EEL_CARRAY:
+	  {
+		EEL_array *a = o2EEL_array(o);
+		w_u8(w, EBC_ARRAY);
+		w_u32(w, a->length);
+		for(i = 0; i < a->length; ++i)
+			w_value(w, &a->values[i]);
+		break;
+	  }
+	  case EEL_CTABLE:
+		len = eel_length(o);
+		w_u8(w, EBC_TABLE);
+		w_u32(w, len);
+		for(i = 0; i < len; ++i)
+		{
+			EEL_tableitem *ti = eel_table_get_item(o, i);
+			w_value(w, eel_table_get_key(ti));
+			w_value(w, eel_table_get_value(ti));
+		}
+		break;
+	  default:
+		w->fail = 1;
+		break;
+	}
+	--w->depth;
+}
+
+
+static void w_value(EBC_writer *w, EEL_value *v)
+{
+	switch((EEL_classes)v->classid)
+	{
+	  case EEL_CNIL:
+		w_u8(w, EBC_NIL);
+		break;
+	  case EEL_CREAL:
+		w_u8(w, EBC_REAL);
+		w_real(w, v->real.v);
+		break;
+	  case EEL_CINTEGER:
+		w_u8(w, EBC_INTEGER);
+		w_u32(w, v->integer.v);
+		break;
+	  case EEL_CBOOLEAN:
+		w_u8(w, EBC_BOOLEAN);
+		w_u8(w, v->integer.v ? 1 : 0);
+		break;
+	  case EEL_CCLASSID:
+	  {
+		const char *cn = eel_typename(w->vm, v->integer.v);
+		w_u8(w, EBC_CLASSID);
+		w_string(w, cn, strlen(cn));
+		break;
+	  }
+	  case EEL_COBJREF:
+		w_object(w, v->objref.v);
+		break;
+	  default:
+		w->fail = 1;	/* Weak references and the like */
+		break;
+	}
+}
+
+
+static void w_function_header(EBC_writer *w, EEL_function *f)
+{
+	w_string(w, eel_o2s(f->common.name), eel_length(f->common.name));
+	w_u16(w, f->common.flags);
+	w_u8(w, f->common.results);
+	w_u8(w, f->common.reqargs);
+	w_u8(w, f->common.optargs);
+	w_u8(w, f->common.tupargs);
+	w_u8(w, f->e.framesize);
+	w_u8(w, f->e.cleansize);
+	w_u16(w, f->e.nicaches);
+}
+
+
+static void w_function_body(EBC_writer *w, EEL_function *f)
+{
+	int i, n;
+	w_u32(w, f->e.codesize);
+
+	/* Save instructions the VM has quickened in their generic form */
+	for(i = 0; i < f->e.codesize; i += n)
+	{
+		n = eel_i_size(f->e.code[i]);
+		if(i + n > f->e.codesize)
+			n = f->e.codesize - i;
+		w_u8(w, eel_i_generic(f->e.code[i]));
+		w_bytes(w, f->e.code + i + 1, n - 1);
+	}
+	w_u32(w, f->e.nlines);
+	for(i = 0; i < f->e.nlines; ++i)
+		w_u32(w, f->e.lines[i]);
+	if(f->e.argdefaults)
+	{
+		w_u8(w, 1);
+		for(i = 0; i < f->common.optargs + f->common.tupargs; ++i)
+			w_u32(w, f->e.argdefaults[i]);
+	}
+	else
+		w_u8(w, 0);
+	w_u16(w, f->e.nconstants);
+	for(i = 0; i < f->e.nconstants; ++i)
+		w_value(w, &f->e.constants[i]);
+}
+
+
+static EEL_object *bc_dump(EEL_object *mo, const char *key)
+{
+	EEL_module *m = o2EEL_module(mo);
+	EEL_object *res;
+	EBC_writer w;
+	int i, n, len;
+	memset(&w, 0, sizeof(w));
+	w.vm = mo->vm;
+	w.module = mo;
+
+	/* Header */
+	w_bytes(&w, ebc_magic, sizeof(ebc_magic));
+	w_u16(&w, EEL_BC_VERSION);
+	w_u16(&w, EEL_O_LAST);
+	w_u32(&w, EBC_EELVERSION);
+	if(key)
+		w_string(&w, key, strlen(key));
+	else
+		w_u32(&w, 0);
+
+	/* Module name, if declared by the module itself */
+	if(m->flags & EEL_M_NAMED)
+	{
+		const char *mn = eel_table_getss(m->exports, "__modname");
+		w_u8(&w, 1);
+		w_string(&w, mn, strlen(mn));
+	}
+	else
+		w_u8(&w, 0);
+
+	/* Imports */
+	w_u32(&w, m->imports.size);
+	for(i = 0; i < m->imports.size; ++i)
+	{
+		EEL_object *in = m->imports.array[i].name;
+		w_string(&w, eel_o2s(in), eel_length(in));
+		w_u32(&w, m->imports.array[i].flags);
+		w_u32(&w, m->imports.array[i].stamp);
+	}
+
+	/* Functions, part 1; create before anything can refer to them */
+	w_u32(&w, m->objects.size);
+	for(i = 0; i < m->objects.size; ++i)
+	{
+		EEL_object *o = m->objects.array[i];
+		if((o->classid != EEL_CFUNCTION) ||
+				(o2EEL_function(o)->common.flags &
+				EEL_FF_CFUNC))
+		{
+			w.fail = 1;
+			break;
+		}
+		w_function_header(&w, o2EEL_function(o));
+	}
+
+	/*
+	 * Static variables. The compiler only initializes the environment;
+	 * anything else is put there by __init_module(), so we get the same
+	 * result whether or not the module has been initialized.
+	 */
+	w_u32(&w, m->nvariables);
+	for(i = 0; i < m->nvariables; ++i)
+		if(EEL_IS_OBJREF(m->variables[i].classid) &&
+				(m->variables[i].objref.v ==
+				eel_vm2p(w.vm)->state->environment))
+			w_u8(&w, EBC_ENVIRONMENT);
+		else
+			w_u8(&w, EBC_NIL);
+
+	/* Functions, part 2 */
+	for(i = 0; (i < m->objects.size) && !w.fail; ++i)
+		w_function_body(&w, o2EEL_function(m->objects.array[i]));
+
+	/* Exports */
+	len = eel_length(m->exports);
+	for(i = 0, n = 0; i < len; ++i)
+		if(!bc_special_export(eel_table_get_key(
+				eel_table_get_item(m->exports, i))))
+			++n;
+	w_u32(&w, n);
+	for(i = 0; i < len; ++i)
+	{
+		EEL_tableitem *ti = eel_table_get_item(m->exports, i);
+		if(bc_special_export(eel_table_get_key(ti)))
+			continue;
+		w_value(&w, eel_table_get_key(ti));
+		w_value(&w, eel_table_get_value(ti));
+	}
+
+	if(w.fail)
+		res = NULL;
+	else
+		res = eel_ds_nnew(w.vm, (const char *)w.data, w.size);
+	eel_free(w.vm, w.data);
+	return res;
+}
+
+
+EEL_object *eel_bc_dump(EEL_object *mo)
+{
+	if(mo->classid != EEL_CMODULE)
+		return NULL;
+	return bc_dump(mo, NULL);
+}
+
+
+/*----------------------------------------------------------
+	Reader
+----------------------------------------------------------*/
+
+typedef struct
+{
+	EEL_state		*es;
+	EEL_object		*module;
+	const unsigned char	*data;
+	unsigned		len;
+	unsigned		pos;
+	int			depth;
+	const char		*error;		/* First error, if any */
+	EEL_object_p_da		imports;	/* Modules loaded for imports */
+	int			checkstamps;	/* Fail if imports changed */
+} EBC_reader;
+
+
+static int r_fail(EBC_reader *r, const char *error)
+{
+	if(!r->error)
+		r->error = error;
+	return -1;
+}
+
+
+static const unsigned char *r_bytes(EBC_reader *r, unsigned n)
+{
+	const unsigned char *d;
+	if(r->error)
+		return NULL;
+	if((n > r->len) || (r->pos > r->len - n))
+	{
+		r_fail(r, "Unexpected end of data");
+		return NULL;
+	}
+	d = r->data + r->pos;
+	r->pos += n;
+	return d;
+}
+
+
+static unsigned r_u8(EBC_reader *r)
+{
+	const unsigned char *d = r_bytes(r, 1);
+	return d ? d[0] : 0;
+}
+
+
+static unsigned r_u16(EBC_reader *r)
+{
+	const unsigned char *d = r_bytes(r, 2);
+	return d ? (d[0] | (d[1] << 8)) : 0;
+}
+
+
+static EEL_uint32 r_u32(EBC_reader *r)
+{
+	const unsigned char *d = r_bytes(r, 4);
+	if(!d)
+		return 0;
+	return d[0] | (d[1] << 8) | (d[2] << 16) | ((EEL_uint32)d[3] << 24);
+}
+
+
+static EEL_real r_real(EBC_reader *r)
+{
+	union
+	{
+		EEL_real		r;
+		unsigned long long	u;
+	} cvt;
+	cvt.u = r_u32(r);
+	cvt.u |= (unsigned long long)r_u32(r) << 32;
+	return cvt.r;
+}
+
+
+/* Returns a new pooled string, or NULL */
+static EEL_object *r_string(EBC_reader *r)
+{
+	EEL_object *s;
+	unsigned len = r_u32(r);
+	const unsigned char *d = r_bytes(r, len);
+	if(!d)
+		return NULL;
+	if(!(s = eel_ps_nnew(r->es->vm, (const char *)d, len)))
+		r_fail(r, "Could not create string");
+	return s;
+}
+
+
+static EEL_classes r_classid(EBC_reader *r)
+{
+	EEL_state *es = r->es;
+	EEL_object *cn = r_string(r);
+	int i;
+	if(!cn)
+		return -1;
+	for(i = 0; i < es->nclasses; ++i)
+		if(es->classes[i] && !strcmp(eel_typename(es->vm, i),
+				eel_o2s(cn)))
+			break;
+	eel_o_disown_nz(cn);
+	if(i >= es->nclasses)
+	{
+		r_fail(r, "Unknown class");
+		return -1;
+	}
+	return i;
+}
+
+
+/*
+ * Look up function 'key' exported by module 'modname', via the imports of
+ * the module being loaded, or the built-in library.
+ */
+static int r_foreign(EBC_reader *r, EEL_value *v)
+{
+	EEL_state *es = r->es;
+	EEL_object *modname = r_string(r);
+	EEL_object *key = r_string(r);
+	EEL_value kv;
+	int i, res = -1;
+	if(!modname || !key)
+	{
+		if(modname)
+			eel_o_disown_nz(modname);
+		if(key)
+			eel_o_disown_nz(key);
+		return -1;
+	}
+	eel_o2v(&kv, key);
+	for(i = 0; i <= r->imports.size; ++i)
+	{
+		EEL_object *c = i < r->imports.size ?
+				r->imports.array[i] : es->eellib;
+		EEL_object *fm;
+		EEL_value fv;
+		const char *fmn;
+		if(!c || (c->classid != EEL_CMODULE))
+			continue;
+		if(eel_table_get(o2EEL_module(c)->exports, &kv, &fv))
+			continue;
+		if(EEL_CLASS(&fv) != EEL_CFUNCTION)
+			continue;
+		fm = o2EEL_function(fv.objref.v)->common.module;
+		if(!fm)
+			continue;
+		fmn = eel_table_getss(o2EEL_module(fm)->exports, "__modname");
+		if(!fmn || strcmp(fmn, eel_o2s(modname)))
+			continue;
+		eel_v_copy(v, &fv);
+		res = 0;
+		break;
+	}
+	eel_o_disown_nz(modname);
+	eel_o_disown_nz(key);
+	if(res)
+		r_fail(r, "Could not find imported function");
+	return res;
+}
+
+
+/* Read a value. The caller owns any object reference returned. */
+static int r_value(EBC_reader *r, EEL_value *v)
+{
+	EEL_vm *vm = r->es->vm;
+	EEL_module *m = o2EEL_module(r->module);
+	unsigned tag = r_u8(r);
+	unsigned i, n;
+	v->classid = EEL_CNIL;
+	switch((EBC_tags)tag)
+	{
+	  case EBC_NIL:
+		break;
+	  case EBC_REAL:
+		eel_d2v(v, r_real(r));
+		break;
+	  case EBC_INTEGER:
+		eel_l2v(v, (EEL_int32)r_u32(r));
+		break;
+	  case EBC_BOOLEAN:
+		eel_b2v(v, r_u8(r));
+		break;
+	  case EBC_CLASSID:
+	  {
+		EEL_classes cid = r_classid(r);
+		if(cid < 0)
+			return -1;
+		v->classid = EEL_CCLASSID;
+		v->integer.v = cid;
+		break;
+	  }
+	  case EBC_STRING:
+	  {
+		EEL_object *s = r_string(r);
+		if(!s)
+			return -1;
+		eel_o2v(v, s);
+		break;
+	  }
+	  case EBC_DSTRING:
+	  {
+		EEL_object *s;
+		n = r_u32(r);
+		if(!r_bytes(r, n))
+			return -1;
+		s = eel_ds_nnew(vm, (const char *)r->data + r->pos - n, n);
+		if(!s)
+			return r_fail(r, "Could not create dstring");
+		eel_o2v(v, s);
+		break;
+	  }
+	  case EBC_FUNCTION:
+		i = r_u32(r);
+		if(r->error)
+			return -1;
+		if(i >= m->objects.size)
+			return r_fail(r, "Function index out of range");
+		eel_o2v(v, m->objects.array[i]);
+		eel_o_own(v->objref.v);
+		break;
+	  case EBC_FOREIGN:
+		return r_foreign(r, v);
+	  case EBC_ENVIRONMENT:
+		eel_o2v(v, r->es->environment);
+		eel_o_own(v->objref.v);
+		break;
+	  case EBC_ARRAY:
+	  case EBC_TABLE:
+	  {
+		int table = (tag == EBC_TABLE);
+		EEL_value cv;
+		if(++r->depth > EBC_MAXDEPTH)
+			return r_fail(r, "Data nested too deep");
+		n = r_u32(r);
+		if(r->error)
+			return -1;
+		if(eel_o_construct(vm, table ? EEL_CTABLE : EEL_CARRAY,
+				NULL, 0, &cv))
+			return r_fail(r, "Could not construct container");
+		for(i = 0; i < n; ++i)
+		{
+			EEL_value key, val;
+			EEL_xno x;
+			if(table && r_value(r, &key))
+				break;
+			if(r_value(r, &val))
+			{
+				if(table)
+					eel_v_disown(&key);
+				break;
+			}
+			if(table)
+			{
+				x = eel_table_set(cv.objref.v, &key, &val);
+				eel_v_disown(&key);
+			}
+			else
+				x = eel_setlindex(cv.objref.v, i, &val);
+			eel_v_disown(&val);
+			if(x)
+			{
+				r_fail(r, "Could not fill container");
+				break;
+			}
+		}
+		--r->depth;
+		if(i < n)
+		{
+			eel_v_disown(&cv);
+			return -1;
+		}
+		*v = cv;
+		break;
+	  }
+	  default:
+		return r_fail(r, "Unknown value tag");
+	}
+	return r->error ? -1 : 0;
+}
+
+
+static int r_header(EBC_reader *r, EEL_object **key)
+{
+	const unsigned char *magic = r_bytes(r, sizeof(ebc_magic));
+	*key = NULL;
+	if(!magic || memcmp(magic, ebc_magic, sizeof(ebc_magic)))
+		return r_fail(r, "Not a precompiled EEL module");
+	if(r_u16(r) != EEL_BC_VERSION)
+		return r_fail(r, "Unsupported format version");
+	if(r_u16(r) != EEL_O_LAST)
+		return r_fail(r, "Incompatible instruction set");
+	if(r_u32(r) != EBC_EELVERSION)
+		return r_fail(r, "Compiled by a different EEL version");
+	*key = r_string(r);
+	return *key ? 0 : -1;
+}
+
+
+static int r_function_header(EBC_reader *r)
+{
+	EEL_vm *vm = r->es->vm;
+	EEL_module *m = o2EEL_module(r->module);
+	EEL_function *f;
+	EEL_value fov;
+	EEL_object *name = r_string(r);
+	if(!name)
+		return -1;
+	if(eel_objs_setsize(vm, &m->objects, m->objects.size + 1) < 0)
+	{
+		eel_o_disown_nz(name);
+		return r_fail(r, "Could not add function to module");
+	}
+	if(eel_o_construct(vm, EEL_CFUNCTION, NULL, 0, &fov))
+	{
+		eel_o_disown_nz(name);
+		return r_fail(r, "Could not create function");
+	}
+	f = o2EEL_function(fov.objref.v);
+	f->common.module = r->module;
+	f->common.name = name;
+	f->common.flags = r_u16(r) & ~EEL_FF_CFUNC;
+	f->common.results = r_u8(r);
+	f->common.reqargs = r_u8(r);
+	f->common.optargs = r_u8(r);
+	f->common.tupargs = r_u8(r);
+	f->e.framesize = r_u8(r);
+	f->e.cleansize = r_u8(r);
+	f->e.nicaches = r_u16(r);
+	m->objects.array[m->objects.size++] = fov.objref.v;
+	if(f->e.nicaches)
+	{
+		f->e.icache = (EEL_int32 *)eel_malloc(vm,
+				f->e.nicaches * sizeof(EEL_int32));
+		if(!f->e.icache)
+			return r_fail(r, "Could not allocate inline caches");
+		memset(f->e.icache, 0, f->e.nicaches * sizeof(EEL_int32));
+	}
+	return r->error ? -1 : 0;
+}
+
+
+/*
+ * Operand kinds of 'opcode', one character per operand, in the order of the
+ * operand layout:
+ *	r	Register		c	Constant
+ *	f	Function constant	t	SWITCH jump table constant
+ *	e	VEXPR expression	x	VEXPR register range
+ *	v	Static variable		j	Branch offset
+ *	o	Operator		n	Class ID
+ *	k	Inline cache slot	u	Register, 'l' levels up
+ *	l	Upvalue or call level	d	Cleaning table position
+ *	i	Anything (checked by the VM)
+ * Returns NULL for illegal opcodes.
+ */
+static const char *bc_operand_kinds(int opcode)
+{
+	switch((EEL_opcodes)opcode)
+	{
+	  case EEL_OILLEGAL_0:
+	  case EEL_ONOP_0:
+	  case EEL_OPHTRUE_0:
+	  case EEL_OPHFALSE_0:
+	  case EEL_OPUSHNIL_0:
+	  case EEL_OPHARGS_0:
+	  case EEL_OPUSHTUP_0:
+	  case EEL_ORETURN_0:
+	  case EEL_ORETRY_0:
+	  case EEL_ORETX_0:
+		return "";
+	  case EEL_OJUMP_sAx:
+		return "j";
+	  case EEL_OJUMPZ_AsBx:
+	  case EEL_OJUMPNZ_AsBx:
+		return "rj";
+	  case EEL_OJUMPEQ_ABsCx:
+	  case EEL_OJUMPNE_ABsCx:
+	  case EEL_OJUMPGE_ABsCx:
+	  case EEL_OJUMPLE_ABsCx:
+	  case EEL_OJUMPGT_ABsCx:
+	  case EEL_OJUMPLT_ABsCx:
+		return "rrj";
+	  case EEL_OJUMPEQI_AsBxsCx:
+	  case EEL_OJUMPNEI_AsBxsCx:
+	  case EEL_OJUMPGEI_AsBxsCx:
+	  case EEL_OJUMPLEI_AsBxsCx:
+	  case EEL_OJUMPGTI_AsBxsCx:
+	  case EEL_OJUMPLTI_AsBxsCx:
+		return "rij";
+	  case EEL_OJUMPEQC_ABxsCx:
+	  case EEL_OJUMPNEC_ABxsCx:
+	  case EEL_OJUMPGEC_ABxsCx:
+	  case EEL_OJUMPLEC_ABxsCx:
+	  case EEL_OJUMPGTC_ABxsCx:
+	  case EEL_OJUMPLTC_ABxsCx:
+		return "rcj";
+	  case EEL_OSWITCH_ABxsCx:
+		return "rtj";
+	  case EEL_OPRELOOP_ABCsDx:
+	  case EEL_OLOOP_ABCsDx:
+		return "rrrj";
+	  case EEL_OPUSH_A:
+	  case EEL_OCALL_A:
+	  case EEL_ORETURNR_A:
+	  case EEL_OARGC_A:
+	  case EEL_OTUPC_A:
+	  case EEL_OLDTRUE_A:
+	  case EEL_OLDFALSE_A:
+	  case EEL_OLDNIL_A:
+	  case EEL_OINITNIL_A:
+	  case EEL_OASNNIL_A:
+	  case EEL_OTHROW_A:
+	  case EEL_ORETXR_A:
+		return "r";
+	  case EEL_OPUSH2_AB:
+	  case EEL_OCALLR_AB:
+	  case EEL_OTSPEC_AB:
+	  case EEL_OMOVE_AB:
+	  case EEL_OINIT_AB:
+	  case EEL_OASSIGN_AB:
+	  case EEL_ONEG_AB:
+	  case EEL_OBNOT_AB:
+	  case EEL_ONOT_AB:
+	  case EEL_OCASTR_AB:
+	  case EEL_OCASTI_AB:
+	  case EEL_OCASTB_AB:
+	  case EEL_OTYPEOF_AB:
+	  case EEL_OSIZEOF_AB:
+	  case EEL_OWEAKREF_AB:
+	  case EEL_OPHADD_AB:
+	  case EEL_OPHSUB_AB:
+	  case EEL_OPHMUL_AB:
+	  case EEL_OPHDIV_AB:
+	  case EEL_OPHMOD_AB:
+	  case EEL_OPHPOWER_AB:
+	  case EEL_OCLONE_AB:
+		return "rr";
+	  case EEL_OPUSH3_ABC:
+	  case EEL_OINDGET_ABC:
+	  case EEL_OINDSET_ABC:
+	  case EEL_OCAST_ABC:
+	  case EEL_OADD_ABC:
+	  case EEL_OSUB_ABC:
+	  case EEL_OMUL_ABC:
+	  case EEL_ODIV_ABC:
+	  case EEL_OMOD_ABC:
+	  case EEL_OPOWER_ABC:
+	  case EEL_OIADD_ABC:
+	  case EEL_ORADD_ABC:
+	  case EEL_OISUB_ABC:
+	  case EEL_ORSUB_ABC:
+	  case EEL_OIMUL_ABC:
+	  case EEL_ORMUL_ABC:
+	  case EEL_OIDIV_ABC:
+	  case EEL_ORDIV_ABC:
+		return "rrr";
+	  case EEL_OPUSH4_ABCD:
+		return "rrrr";
+	  case EEL_OPUSHI_sAx:
+	  case EEL_OPHARGI_A:
+		return "i";
+	  case EEL_OCLEAN_A:
+		return "d";
+	  case EEL_OPHARGI2_AB:
+		return "ii";
+	  case EEL_OPUSHC_Ax:
+		return "c";
+	  case EEL_OPUSHC2_AxBx:
+		return "cc";
+	  case EEL_OPUSHIC_AxsBx:
+	  case EEL_OPUSHCI_AxsBx:
+		return "ci";
+	  case EEL_OPHVAR_Ax:
+		return "v";
+	  case EEL_OPHUVAL_AB:
+		return "ul";
+	  case EEL_OCCALL_ABx:
+		return "lf";
+	  case EEL_OCCALLR_ABCx:
+	  case EEL_OPHCCALL_ABCx:
+		return "lrf";
+	  case EEL_OSPEC_AB:
+		return "ir";
+	  case EEL_OLDI_AsBx:
+	  case EEL_OINITI_AsBx:
+	  case EEL_OASSIGNI_AsBx:
+	  case EEL_OGETARGI_AB:
+	  case EEL_OSETARGI_AB:
+		return "ri";
+	  case EEL_OLDC_ABx:
+	  case EEL_OINITC_ABx:
+	  case EEL_OASSIGNC_ABx:
+		return "rc";
+	  case EEL_OGETUVAL_ABC:
+	  case EEL_OSETUVAL_ABC:
+		return "rul";
+	  case EEL_OGETVAR_ABx:
+	  case EEL_OSETVAR_ABx:
+		return "rv";
+	  case EEL_OINDGETI_ABC:
+	  case EEL_OINDSETI_ABC:
+	  case EEL_OGETTARGI_ABC:
+		return "rir";
+	  case EEL_OINDGETC_ABCxDx:
+	  case EEL_OINDSETC_ABCxDx:
+		return "rrck";
+	  case EEL_OGETUVARGI_ABC:
+	  case EEL_OSETUVARGI_ABC:
+		return "ril";
+	  case EEL_OGETUVTARGI_ABCD:
+		return "rirl";
+	  case EEL_OBOP_ABCD:
+	  case EEL_OIPBOP_ABCD:
+	  case EEL_OIBOP_ABCD:
+	  case EEL_ORBOP_ABCD:
+		return "rror";
+	  case EEL_OPHBOP_ABC:
+		return "ror";
+	  case EEL_OBOPS_ABCsDx:
+	  case EEL_OIPBOPS_ABCsDx:
+		return "rrov";
+	  case EEL_OBOPI_ABCsDx:
+	  case EEL_OIPBOPI_ABCsDx:
+	  case EEL_OIBOPI_ABCsDx:
+	  case EEL_ORBOPI_ABCsDx:
+		return "rroi";
+	  case EEL_OPHBOPI_ABsCx:
+		return "roi";
+	  case EEL_OBOPC_ABCDx:
+		return "rroc";
+	  case EEL_OVEXPR_ABCx:
+		return "rxe";
+	  case EEL_ONEW_AB:
+		return "rn";
+	  case EEL_OTRY_AxBx:
+		return "ff";
+	  case EEL_OUNTRY_Ax:
+		return "f";
+	}
+	return NULL;
+}
+
+
+/* Constant 'c' of 'f', if it is an object of class 'cid', otherwise NULL */
+static EEL_object *bc_constant(EEL_function *f, int c, EEL_classes cid)
+{
+	EEL_value *v;
+	if((c < 0) || (c >= f->e.nconstants))
+		return NULL;
+	v = &f->e.constants[c];
+	if(!EEL_IS_OBJREF(v->classid) || (v->objref.v->classid != cid))
+		return NULL;
+	return v->objref.v;
+}
+
+
+/* Decode the operands of 'ins', as described by the layout name */
+static void bc_decode(const unsigned char *ins, const char *kinds, int *vals)
+{
+	const char *ol = eel_ol_name(eel_i_operands(ins[0]));
+	int i, pos;
+	for(i = 0, pos = 1; kinds[i]; ++i)
+	{
+		int sgn = (*ol == 's');
+		if(sgn)
+			++ol;
+		if(ol[1] == 'x')
+		{
+			vals[i] = sgn ? EEL_OS16(ins, pos) : EEL_O16(ins, pos);
+			ol += 2;
+			pos += 2;
+		}
+		else
+		{
+			vals[i] = sgn ? EEL_OS8(ins, pos) : EEL_O8(ins, pos);
+			ol += 1;
+			pos += 1;
+		}
+	}
+}
+
+
+/*
+ * Widen the cleaning table depth range of instruction 'pc' to include
+ * 'lo'..'hi'. Returns 1 if the range changed.
+ */
+static int bc_clean_merge(unsigned char *cs, int codesize, int pc, int lo,
+		int hi)
+{
+	unsigned char *clo = cs + codesize;
+	unsigned char *chi = cs + 2 * codesize;
+	if(pc >= codesize)
+		return 0;
+	if(!(cs[pc] & 2))
+	{
+		cs[pc] |= 2;
+		clo[pc] = lo;
+		chi[pc] = hi;
+		return 1;
+	}
+	if((lo >= clo[pc]) && (hi <= chi[pc]))
+		return 0;
+	if(lo < clo[pc])
+		clo[pc] = lo;
+	if(hi > chi[pc])
+		chi[pc] = hi;
+	return 1;
+}
+
+
+/*
+ * Follow all paths through the code of 'f', tracking the range of cleaning
+ * table depths at each instruction, so that INIT* cannot overflow the table,
+ * and CLEAN cannot leave entries that were never written below the top. 'cs'
+ * holds the instruction start flags, followed by two 'codesize' byte arrays
+ * for the low and high depths.
+ */
+static int bc_check_clean(EBC_reader *r, EEL_function *f, unsigned char *cs)
+{
+	int codesize = f->e.codesize;
+	int pc, size, changed;
+	bc_clean_merge(cs, codesize, 0, 0, 0);
+	do
+	{
+		changed = 0;
+		for(pc = 0; pc < codesize; pc += size)
+		{
+			const unsigned char *ins = f->e.code + pc;
+			const char *kinds = bc_operand_kinds(ins[0]);
+			int i, vals[4];
+			int lo = cs[codesize + pc];
+			int hi = cs[2 * codesize + pc];
+			size = eel_i_size(ins[0]);
+			if(!(cs[pc] & 2))
+				continue;
+			bc_decode(ins, kinds, vals);
+			switch(ins[0])
+			{
+			  case EEL_OINIT_AB:
+			  case EEL_OINITI_AsBx:
+			  case EEL_OINITNIL_A:
+			  case EEL_OINITC_ABx:
+				if(++hi > f->e.cleansize)
+					return r_fail(r, "Cleaning table "
+							"overflow");
+				++lo;
+				break;
+			  case EEL_OCLEAN_A:
+				if(vals[0] > lo)
+					return r_fail(r, "Cleaning table "
+							"underflow");
+				lo = hi = vals[0];
+				break;
+			}
+			for(i = 0; kinds[i]; ++i)
+				if(kinds[i] == 'j')
+					changed |= bc_clean_merge(cs, codesize,
+							pc + size + vals[i],
+							lo, hi);
+				else if(kinds[i] == 't')
+				{
+					EEL_object *jt = f->e.constants[
+							vals[i]].objref.v;
+					int j;
+					for(j = 0; j < o2EEL_table(jt)->length;
+							++j)
+						changed |= bc_clean_merge(cs,
+								codesize,
+								eel_table_get_item(
+								jt, j)->value.
+								integer.v,
+								lo, hi);
+				}
+			switch(ins[0])
+			{
+			  case EEL_OJUMP_sAx:
+			  case EEL_OSWITCH_ABxsCx:
+			  case EEL_ORETURN_0:
+			  case EEL_ORETURNR_A:
+			  case EEL_OTHROW_A:
+			  case EEL_ORETRY_0:
+			  case EEL_ORETX_0:
+			  case EEL_ORETXR_A:
+				break;
+			  default:
+				changed |= bc_clean_merge(cs, codesize,
+						pc + size, lo, hi);
+				break;
+			}
+		}
+	} while(changed);
+	return 0;
+}
+
+
+/*
+ * Check that the code of 'f' only contains valid instructions, with operands
+ * that stay within the register frame, constant table, static variables and
+ * inline caches, branches that land on instructions, and balanced use of the
+ * cleaning table, so that a corrupt or stale file cannot crash the VM.
+ */
+static int bc_check_code(EBC_reader *r, EEL_function *f)
+{
+	EEL_vm *vm = r->es->vm;
+	EEL_module *m = o2EEL_module(r->module);
+	unsigned char *code = f->e.code;
+	unsigned char *starts;
+	int pc, size, res = 0;
+	if(!(starts = (unsigned char *)eel_malloc(vm, 3 * f->e.codesize)))
+		return r_fail(r, "Could not allocate code check buffer");
+	memset(starts, 0, 3 * f->e.codesize);
+
+	/* Instruction boundaries */
+	for(pc = 0; pc < f->e.codesize; pc += size)
+	{
+		if(!bc_operand_kinds(code[pc]))
+		{
+			res = r_fail(r, "Illegal instruction");
+			break;
+		}
+		size = eel_i_size(code[pc]);
+		if(size > f->e.codesize - pc)
+		{
+			res = r_fail(r, "Truncated instruction");
+			break;
+		}
+		starts[pc] = 1;
+	}
+
+	/* Operands */
+	for(pc = 0; !res && (pc < f->e.codesize); pc += size)
+	{
+		const unsigned char *ins = code + pc;
+		const char *kinds = bc_operand_kinds(ins[0]);
+		int i, vals[4], level = 0, count = 1;
+		size = eel_i_size(ins[0]);
+		bc_decode(ins, kinds, vals);
+		for(i = 0; kinds[i]; ++i)
+			if(kinds[i] == 'l')
+				level = vals[i];
+
+		/* These divide by the number of tuple arguments */
+		if(((ins[0] == EEL_OTUPC_A) || (ins[0] == EEL_OTSPEC_AB)) &&
+				!f->common.tupargs)
+			res = r_fail(r, "Tuple instruction in function without "
+					"tuple arguments");
+
+		for(i = 0; !res && kinds[i]; ++i)
+		{
+			int v = vals[i];
+			switch(kinds[i])
+			{
+			  case 'u':
+				if(level)
+					break;
+				/* fall through */
+			  case 'r':
+				if(v >= f->e.framesize)
+					res = r_fail(r, "Register out of range");
+				break;
+			  case 'x':
+			  {
+				EEL_object *so = bc_constant(f, vals[i + 1],
+						EEL_CSTRING);
+				const char *s;
+				if(!so)
+					break;	/* Reported as 'e' */
+				for(s = o2EEL_string(so)->buffer; *s; ++s)
+					if((*s >= 'a') && (*s <= 'z') &&
+							(*s - 'a' + 1 > count))
+						count = *s - 'a' + 1;
+				if(v + count > f->e.framesize)
+					res = r_fail(r, "Register out of range");
+				break;
+			  }
+			  case 'c':
+				if(v >= f->e.nconstants)
+					res = r_fail(r, "Constant out of range");
+				break;
+			  case 'f':
+				if(!bc_constant(f, v, EEL_CFUNCTION))
+					res = r_fail(r, "Bad function constant");
+				break;
+			  case 'e':
+				if(!bc_constant(f, v, EEL_CSTRING))
+					res = r_fail(r, "Bad expression constant");
+				break;
+			  case 't':
+			  {
+				EEL_object *jt = bc_constant(f, v, EEL_CTABLE);
+				int j;
+				if(!jt)
+				{
+					res = r_fail(r, "Bad jump table");
+					break;
+				}
+				for(j = 0; j < o2EEL_table(jt)->length; ++j)
+				{
+					EEL_value *to = &eel_table_get_item(jt,
+							j)->value;
+					if((to->classid != EEL_CINTEGER) ||
+							(to->integer.v < 0) ||
+							(to->integer.v >=
+							f->e.codesize) ||
+							!starts[to->integer.v])
+					{
+						res = r_fail(r, "Bad jump table");
+						break;
+					}
+				}
+				break;
+			  }
+			  case 'v':
+				if((v < 0) || (v >= m->nvariables))
+					res = r_fail(r, "Variable out of range");
+				break;
+			  case 'j':
+				v += pc + size;
+				if((v < 0) || (v >= f->e.codesize) ||
+						!starts[v])
+					res = r_fail(r, "Bad branch target");
+				break;
+			  case 'd':
+				if(v > f->e.cleansize)
+					res = r_fail(r, "Cleaning table position "
+							"out of range");
+				break;
+			  case 'l':
+			  {
+				/*
+				 * The VM does not check levels. Function
+				 * nesting is not recorded, but only functions
+				 * that use upvalues are given any, and nesting
+				 * cannot be deeper than the number of
+				 * functions. (For calls, the level is for the
+				 * function called.)
+				 */
+				const char *fk = strchr(kinds, 'f');
+				EEL_object *uvf = fk ? bc_constant(f,
+						vals[fk - kinds],
+						EEL_CFUNCTION) : NULL;
+				if(!v || (fk && !uvf))
+					break;	/* No upvalues, or reported as 'f' */
+				if((v > m->objects.size) || !((uvf ?
+						o2EEL_function(uvf) : f)->
+						common.flags & EEL_FF_UPVALUES))
+					res = r_fail(r, "Upvalue level out of "
+							"range");
+				break;
+			  }
+			  case 'o':
+				if(v > EEL_OP_BNOT)
+					res = r_fail(r, "Bad operator");
+				break;
+			  case 'n':
+				if((v >= r->es->nclasses) ||
+						!r->es->classes[v])
+					res = r_fail(r, "Bad class");
+				break;
+			  case 'k':
+				if(v >= f->e.nicaches)
+					res = r_fail(r, "Inline cache out of "
+							"range");
+				break;
+			}
+		}
+	}
+
+	/*
+	 * The VM must never run off the end of the code. (A final TRY or UNTRY
+	 * is used when the block returns on all paths.)
+	 */
+	if(!res)
+		for(pc = 0; pc < f->e.codesize; pc += size)
+		{
+			size = eel_i_size(code[pc]);
+			if(pc + size < f->e.codesize)
+				continue;
+			switch(code[pc])
+			{
+			  case EEL_OJUMP_sAx:
+			  case EEL_ORETURN_0:
+			  case EEL_ORETURNR_A:
+			  case EEL_OTHROW_A:
+			  case EEL_ORETRY_0:
+			  case EEL_ORETX_0:
+			  case EEL_ORETXR_A:
+			  case EEL_OTRY_AxBx:
+			  case EEL_OUNTRY_Ax:
+				break;
+			  default:
+				res = r_fail(r, "Code does not end with a "
+						"return or jump");
+				break;
+			}
+		}
+	if(!res)
+		res = bc_check_clean(r, f, starts);
+	eel_free(vm, starts);
+	return res;
+}
+
+
+static int r_function_body(EBC_reader *r, EEL_function *f)
+{
+	EEL_vm *vm = r->es->vm;
+	const unsigned char *d;
+	unsigned i, n;
+
+	/* Code */
+	n = r_u32(r);
+	if(!(d = r_bytes(r, n)))
+		return -1;
+	if(!n || !(f->e.code = (unsigned char *)eel_malloc(vm, n)))
+		return r_fail(r, "Could not allocate code");
+	memcpy(f->e.code, d, n);
+	f->e.codesize = n;
+
+	/* Line numbers */
+	n = r_u32(r);
+	if(r->error || (n > r->len))
+		return r_fail(r, "Corrupt line number table");
+	if(n)
+	{
+		f->e.lines = (EEL_int32 *)eel_malloc(vm, n * sizeof(EEL_int32));
+		if(!f->e.lines)
+			return r_fail(r, "Could not allocate line table");
+		for(i = 0; i < n; ++i)
+			f->e.lines[i] = (EEL_int32)r_u32(r);
+		f->e.nlines = n;
+	}
+
+	/* Argument defaults */
+	if(r_u8(r))
+	{
+		n = f->common.optargs + f->common.tupargs;
+		f->e.argdefaults = (int *)eel_malloc(vm, (n ? n : 1) *
+				sizeof(int));
+		if(!f->e.argdefaults)
+			return r_fail(r, "Could not allocate argument defaults");
+		for(i = 0; i < n; ++i)
+			f->e.argdefaults[i] = (EEL_int32)r_u32(r);
+	}
+
+	/* Constants */
+	n = r_u16(r);
+	if(r->error)
+		return -1;
+	if(n)
+	{
+		f->e.constants = (EEL_value *)eel_malloc(vm,
+				n * sizeof(EEL_value));
+		if(!f->e.constants)
+			return r_fail(r, "Could not allocate constants");
+		for(i = 0; i < n; ++i)
+		{
+			EEL_value *c = &f->e.constants[i];
+			if(r_value(r, c))
+				return -1;
+			/* Same rules as eel_coder_add_constant()! */
+			if((EEL_CLASS(c) == EEL_CFUNCTION) &&
+					(o2EEL_function(c->objref.v)->
+					common.module == f->common.module))
+				eel_o_disown_nz(c->objref.v);
+			++f->e.nconstants;
+		}
+	}
+	if(r->error)
+		return -1;
+
+	/* Argument defaults refer to constants */
+	if(f->e.argdefaults)
+	{
+		n = f->common.optargs + f->common.tupargs;
+		for(i = 0; i < n; ++i)
+			if(f->e.argdefaults[i] >= f->e.nconstants)
+				return r_fail(r, "Bad argument default");
+	}
+	return bc_check_code(r, f);
+}
+
+
+static int r_module(EBC_reader *r, EEL_sflags sflags, EEL_object **name)
+{
+	EEL_state *es = r->es;
+	EEL_vm *vm = es->vm;
+	EEL_object *mo = r->module;
+	EEL_module *m = o2EEL_module(mo);
+	EEL_object *key;
+	unsigned i, n;
+
+	*name = NULL;
+	if(r_header(r, &key))
+		return -1;
+	eel_o_disown_nz(key);
+
+	/* Module name */
+	if(r_u8(r))
+	{
+		EEL_value v;
+		if(!(*name = r_string(r)))
+			return -1;
+		if((sflags & EEL_SF_SHARED) && es->modules &&
+				(eel_table_gets(es->modules, eel_o2s(*name),
+				&v) == 0))
+			return r_fail(r, "A shared module with that name "
+					"is already loaded");
+	}
+
+	/* Imports */
+	n = r_u32(r);
+	for(i = 0; (i < n) && !r->error; ++i)
+	{
+		EEL_object *im, *in = r_string(r);
+		unsigned flags = r_u32(r);
+		EEL_uint32 stamp = r_u32(r);
+		if(!in)
+			return -1;
+		if(eel_objs_setsize(vm, &r->imports, r->imports.size + 1) < 0)
+		{
+			eel_o_disown_nz(in);
+			return r_fail(r, "Could not record import");
+		}
+		if(!(im = eel_load(vm, eel_o2s(in), flags)))
+		{
+			eel_o_disown_nz(in);
+			return r_fail(r, "Could not load imported module");
+		}
+		r->imports.array[r->imports.size++] = im;
+		if(r->checkstamps && (eel_bc_stamp(im) != stamp))
+		{
+			eel_o_disown_nz(in);
+			return r_fail(r, "Imported module has changed");
+		}
+		if(eel_module_add_import(mo, in, flags, eel_bc_stamp(im)) < 0)
+		{
+			eel_o_disown_nz(in);
+			return r_fail(r, "Could not record import");
+		}
+		eel_o_disown_nz(in);
+	}
+
+	/* Functions, part 1 */
+	n = r_u32(r);
+	if(r->error || (n > r->len))
+		return r_fail(r, "Corrupt function table");
+	for(i = 0; i < n; ++i)
+		if(r_function_header(r))
+			return -1;
+
+	/* Static variables */
+	n = r_u32(r);
+	if(r->error || (n > r->len))
+		return r_fail(r, "Corrupt variable table");
+	if(n)
+	{
+		m->variables = (EEL_value *)eel_malloc(vm,
+				n * sizeof(EEL_value));
+		if(!m->variables)
+			return r_fail(r, "Could not allocate variables");
+		m->maxvariables = n;
+		for(i = 0; i < n; ++i)
+		{
+			if(r_value(r, &m->variables[i]))
+				return -1;
+			++m->nvariables;
+		}
+	}
+
+	/* Functions, part 2 */
+	for(i = 0; i < m->objects.size; ++i)
+		if(r_function_body(r, o2EEL_function(m->objects.array[i])))
+			return -1;
+
+	/* Exports */
+	n = r_u32(r);
+	for(i = 0; (i < n) && !r->error; ++i)
+	{
+		EEL_value k, v;
+		EEL_xno x;
+		if(r_value(r, &k))
+			return -1;
+		if(r_value(r, &v))
+		{
+			eel_v_disown(&k);
+			return -1;
+		}
+		x = eel_table_set(m->exports, &k, &v);
+		eel_v_disown(&k);
+		eel_v_disown(&v);
+		if(x)
+			return r_fail(r, "Could not add export");
+	}
+
+	if(!r->error && (r->pos != r->len))
+		return r_fail(r, "Garbage after end of module");
+	return r->error ? -1 : 0;
+}
+
+
+/* Undo everything a failed r_module() may have done to the module */
+static void bc_reset(EBC_reader *r, int nexports)
+{
+	EEL_vm *vm = r->es->vm;
+	EEL_module *m = o2EEL_module(r->module);
+	EEL_object_p_da *o = &m->objects;
+	int i;
+	for(i = 0; i < o->size; ++i)
+		eel_function_detach(o2EEL_function(o->array[i]));
+	while(o->size)
+		eel_o_disown_nz(o->array[--o->size]);
+	while(m->nvariables)
+		eel_v_disown(&m->variables[--m->nvariables]);
+	eel_free(vm, m->variables);
+	m->variables = NULL;
+	m->maxvariables = 0;
+	while(eel_length(m->exports) > nexports)
+	{
+		EEL_tableitem *ti = eel_table_get_item(m->exports,
+				eel_length(m->exports) - 1);
+		eel_table_delete(m->exports, eel_table_get_key(ti));
+	}
+	eel_module_clear_imports(r->module);
+}
+
+
+/*
+ * Load 'data' into 'mo'. On failure, the module is restored to the state it
+ * was in, and the error message is returned. If 'checkstamps' is set, loading
+ * fails if any imported module has changed since 'data' was compiled.
+ */
+static const char *bc_load(EEL_state *es, EEL_object *mo,
+		const unsigned char *data, unsigned len, EEL_sflags sflags,
+		int checkstamps)
+{
+	EEL_module *m = o2EEL_module(mo);
+	EEL_object *name;
+	EBC_reader r;
+	int i, nexports = eel_length(m->exports);
+	memset(&r, 0, sizeof(r));
+	r.es = es;
+	r.module = mo;
+	r.data = data;
+	r.len = len;
+	r.checkstamps = checkstamps;
+
+	/* No dependencies on this module until we're done! */
+	m->refsum = -1;
+
+	if(r_module(&r, sflags, &name))
+		bc_reset(&r, nexports);
+	else if(name)
+	{
+		/* Named module; see compile2() */
+		eel_table_setss(m->exports, "__modname", eel_o2s(name));
+		m->flags |= EEL_M_NAMED;
+		if(sflags & EEL_SF_SHARED)
+		{
+			m->flags |= EEL_M_SHARED;
+			eel_share_module(mo);
+		}
+	}
+	if(name)
+		eel_o_disown_nz(name);
+
+	/* The module now holds on to whatever it needs from the imports */
+	for(i = 0; i < r.imports.size; ++i)
+		eel_o_disown_nz(r.imports.array[i]);
+	eel_free(es->vm, r.imports.array);
+
+	if(r.error)
+		return r.error;
+
+	m->refsum = eel_module_countref(mo);
+	return NULL;
+}
+
+
+void eel_bc_load(EEL_state *es, EEL_object *mo,
+		const unsigned char *data, unsigned len, EEL_sflags sflags)
+{
+	const char *error = bc_load(es, mo, data, len, sflags, 0);
+	if(error)
+		eel_cerror(es, "Could not load precompiled module \"%s\": %s!",
+				eel_module_filename(mo), error);
+}
+
+
+/*----------------------------------------------------------
+	Compile cache
+----------------------------------------------------------*/
+
+static EEL_uint32 bc_hash(EEL_uint32 h, const void *data, unsigned len)
+{
+	const unsigned char *d = (const unsigned char *)data;
+	while(len--)
+	{
+		h ^= *d++;
+		h *= 16777619U;		/* FNV-1a */
+	}
+	return h;
+}
+
+
+EEL_uint32 eel_bc_stamp(EEL_object *mo)
+{
+	EEL_module *m = o2EEL_module(mo);
+	EEL_uint32 h = 2166136261U;
+	const char *fn = eel_module_filename(mo);
+	struct stat st;
+	long long t[2];
+	int i;
+	if(fn)
+		h = bc_hash(h, fn, strlen(fn));
+	if(fn && !stat(fn, &st))
+	{
+		t[0] = st.st_mtime;
+		t[1] = st.st_size;
+		h = bc_hash(h, t, sizeof(t));
+	}
+	for(i = 0; i < m->imports.size; ++i)
+		h = bc_hash(h, &m->imports.array[i].stamp, sizeof(EEL_uint32));
+	return h;
+}
+
+
+/*
+ * Construct the cache key and cache file name for 'mo'. Returns 0 if the
+ * module cannot or should not be cached.
+ */
+static int bc_cache_name(EEL_state *es, EEL_object *mo, EEL_sflags sflags,
+		char *key, int keysize, char *path, int pathsize)
+{
+	EEL_module *m = o2EEL_module(mo);
+	unsigned long long h = 14695981039346656037ULL;	/* FNV-1a */
+	const char *dir, *fn, *k;
+	struct stat st;
+	EEL_value v;
+	int n;
+#ifndef _WIN32
+	char rp[PATH_MAX];
+#endif
+	if(sflags & (EEL_SF_LIST | EEL_SF_LISTASM))
+		return 0;
+	if(!es->environment || eel_table_gets(es->environment,
+			"path_compile_cache", &v))
+		return 0;
+	if(!(dir = eel_v2s(&v)) || !dir[0])
+		return 0;
+	if(!(fn = eel_table_getss(m->exports, "__filename")))
+		return 0;
+	if(stat(fn, &st) || !S_ISREG(st.st_mode))
+		return 0;
+#ifndef _WIN32
+	if(realpath(fn, rp))
+		fn = rp;
+#endif
+	n = snprintf(key, keysize, "%s|%lld|%lld|%d|%d|%x", fn,
+			(long long)st.st_mtime, (long long)st.st_size,
+			EEL_BC_VERSION, EEL_O_LAST,
+			sflags & (EEL_SF_NOPRECEDENCE | EEL_SF_NOOPTIMIZE));
+	if((n < 0) || (n >= keysize))
+		return 0;
+	for(k = key; *k; ++k)
+	{
+		h ^= (unsigned char)*k;
+		h *= 1099511628211ULL;
+	}
+	n = snprintf(path, pathsize, "%s%c%016llx%s", dir, EEL_DIRSEP, h,
+			EEL_BC_EXTENSION);
+	return (n > 0) && (n < pathsize);
+}
+
+
+int eel_bc_cache_load(EEL_state *es, EEL_object *mo, EEL_sflags sflags)
+{
+	EEL_vm *vm = es->vm;
+	char key[1024], path[1024];
+	unsigned char *data;
+	EEL_object *fkey;
+	EBC_reader r;
+	FILE *f;
+	long len;
+	int res = 0;
+	if(!bc_cache_name(es, mo, sflags, key, sizeof(key),
+			path, sizeof(path)))
+		return 0;
+	if(!(f = fopen(path, "rb")))
+		return 0;
+	if(fseek(f, 0, SEEK_END) || ((len = ftell(f)) <= 0) ||
+			fseek(f, 0, SEEK_SET) ||
+			!(data = (unsigned char *)eel_malloc(vm, len)))
+	{
+		fclose(f);
+		return 0;
+	}
+	if(fread(data, 1, len, f) != (size_t)len)
+		len = 0;
+	fclose(f);
+
+	/* Check that it's actually the file we're looking for */
+	memset(&r, 0, sizeof(r));
+	r.es = es;
+	r.data = data;
+	r.len = len;
+	if(!r_header(&r, &fkey))
+	{
+		res = !strcmp(eel_o2s(fkey), key);
+		eel_o_disown_nz(fkey);
+	}
+	if(res)
+		res = !bc_load(es, mo, data, len, sflags, 1);
+	eel_free(vm, data);
+	return res;
+}
+
+
+/*
+ * Create a uniquely named temporary file next to 'path', so that concurrent
+ * writers never write to the same file. Returns NULL on failure.
+ */
+static FILE *bc_cache_tmp(const char *path, char *tmp, int tmpsize)
+{
+#ifdef _WIN32
+	snprintf(tmp, tmpsize, "%s.%d.tmp", path, (int)_getpid());
+	return fopen(tmp, "wb");
+#else
+	FILE *f;
+	int fd;
+	snprintf(tmp, tmpsize, "%s.XXXXXX", path);
+	if((fd = mkstemp(tmp)) < 0)
+		return NULL;
+	fchmod(fd, 0644);
+	if(!(f = fdopen(fd, "wb")))
+	{
+		close(fd);
+		remove(tmp);
+	}
+	return f;
+#endif
+}
+
+void eel_bc_cache_save(EEL_state *es, EEL_object *mo, EEL_sflags sflags)
+{
+	char key[1024], path[1024], tmp[1040];
+	EEL_object *d;
+	FILE *f;
+	int ok;
+	if(!bc_cache_name(es, mo, sflags, key, sizeof(key),
+			path, sizeof(path)))
+		return;
+	if(!(d = bc_dump(mo, key)))
+		return;
+	if((f = bc_cache_tmp(path, tmp, sizeof(tmp))))
+	{
+		ok = fwrite(o2EEL_dstring(d)->buffer, 1, eel_length(d), f) ==
+				(size_t)eel_length(d);
+		ok &= fclose(f) == 0;
+		/* Write and rename, so readers never see partial files */
+		if(!ok || rename(tmp, path))
+			remove(tmp);
+	}
+	eel_o_disown_nz(d);
+}
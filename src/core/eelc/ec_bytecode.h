@@ -0,0 +1,90 @@
+/*
+---------------------------------------------------------------------------
+	ec_bytecode.h - EEL Precompiled Module Format and Compile Cache
+---------------------------------------------------------------------------
+ * Copyright 2026 David Olofson
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from the
+ * use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#ifndef EEL_EC_BYTECODE_H
+#define EEL_EC_BYTECODE_H
+
+#include "e_eel.h"
+
+/*
+ * A precompiled module is a little endian dump of everything the compiler
+ * leaves behind in a module; static variables, functions (code, constants,
+ * argument defaults and line info) and exports, along with the list of
+ * imports, which are loaded again when the module is loaded.
+ *
+ * Objects from other modules are referenced by module name and export name,
+ * and classes are referenced by name, so precompiled modules do not depend
+ * on memory layout or class registration order. They DO depend on the VM
+ * instruction set, though, which is why the header carries EEL_BC_VERSION,
+ * the number of opcodes and the EEL version.
+ */
+
+/* Bump whenever the VM instruction set or this format changes! */
+#define	EEL_BC_VERSION	3
+
+/* File name extension for precompiled modules */
+#define	EEL_BC_EXTENSION	".eelc"
+
+/* Returns 1 if 'data' starts with a precompiled module header. */
+int eel_bc_check(const unsigned char *data, unsigned len);
+
+/*
+ * Serialize the compiled module 'mo' into a new dstring object. Returns NULL
+ * if the module contains something that cannot be serialized.
+ */
+EEL_object *eel_bc_dump(EEL_object *mo);
+
+/*
+ * Return a hash identifying the current version of module 'mo'; its file
+ * name, modification time and size, and the stamps of the modules it
+ * imported. The stamp changes when any module it depends on is modified.
+ */
+EEL_uint32 eel_bc_stamp(EEL_object *mo);
+
+/*
+ * Initialize the module 'mo', which must not be compiled, from the
+ * precompiled module in 'data'. Throws a compiler error on failure.
+ */
+void eel_bc_load(EEL_state *es, EEL_object *mo,
+		const unsigned char *data, unsigned len, EEL_sflags sflags);
+
+/*
+ * Compile cache
+ *
+ *	If $.path_compile_cache is set to a directory, modules compiled from
+ *	files are dumped in there, keyed on file name, modification time,
+ *	size, EEL version and code generation flags. When a matching entry is
+ *	found, and the stamps of the modules it imports still match those
+ *	recorded when it was compiled, it is loaded instead of compiling the
+ *	source.
+ *
+ *	eel_bc_cache_load() returns 1 if 'mo' was loaded from the cache, or
+ *	0 if it should be compiled as usual. It never throws.
+ *
+ *	eel_bc_cache_save() quietly does nothing if the module cannot be
+ *	cached for whatever reason.
+ */
+int eel_bc_cache_load(EEL_state *es, EEL_object *mo, EEL_sflags sflags);
+void eel_bc_cache_save(EEL_state *es, EEL_object *mo, EEL_sflags sflags);
+
+#endif /* EEL_EC_BYTECODE_H */
@@ -57,6 +57,17 @@ void eel_coder_realloc_constants(EEL_coder *cdr, int size);
 void eel_coder_realloc_variables(EEL_coder *cdr, int size);
 
 
+/* Allocate an inline cache slot in the current function */
+int eel_coder_add_icache(EEL_coder *cdr)
+{
+	EEL_function *f = o2EEL_function(cdr->f);
+	/* If we run out, sites share the last slot. Slower, but still works. */
+	if(f->e.nicaches == 65535)
+		return 65534;
+	return f->e.nicaches++;
+}
+
+
 /* Operators */
 const char *eel_opname(EEL_operators op)
 {
@@ -173,13 +184,36 @@ int eel_i_size(int opcode)
 	  case EEL_OL_ABsCx:	return EEL_OSIZE_ABsCx;
 	  case EEL_OL_ABxCx:	return EEL_OSIZE_ABxCx;
 	  case EEL_OL_ABxsCx:	return EEL_OSIZE_ABxsCx;
+	  case EEL_OL_AsBxsCx:	return EEL_OSIZE_AsBxsCx;
 	  case EEL_OL_ABCDx:	return EEL_OSIZE_ABCDx;
 	  case EEL_OL_ABCsDx:	return EEL_OSIZE_ABCsDx;
+	  case EEL_OL_ABCxDx:	return EEL_OSIZE_ABCxDx;
 	}
 	return 1;
 }
 
 
+int eel_i_generic(int opcode)
+{
+	switch((EEL_opcodes)opcode)
+	{
+	  case EEL_OIADD_ABC:
+	  case EEL_ORADD_ABC:	return EEL_OADD_ABC;
+	  case EEL_OISUB_ABC:
+	  case EEL_ORSUB_ABC:	return EEL_OSUB_ABC;
+	  case EEL_OIMUL_ABC:
+	  case EEL_ORMUL_ABC:	return EEL_OMUL_ABC;
+	  case EEL_OIDIV_ABC:
+	  case EEL_ORDIV_ABC:	return EEL_ODIV_ABC;
+	  case EEL_OIBOP_ABCD:
+	  case EEL_ORBOP_ABCD:	return EEL_OBOP_ABCD;
+	  case EEL_OIBOPI_ABCsDx:
+	  case EEL_ORBOPI_ABCsDx: return EEL_OBOPI_ABCsDx;
+	  default:		return opcode;
+	}
+}
+
+
 const char *eel_ol_name(EEL_operands oprs)
 {
 	switch(oprs)
@@ -201,8 +235,10 @@ const char *eel_ol_name(EEL_operands oprs)
 	  case EEL_OL_ABsCx:	return "ABsCx";
 	  case EEL_OL_ABxCx:	return "ABxCx";
 	  case EEL_OL_ABxsCx:	return "ABxsCx";
+	  case EEL_OL_AsBxsCx:	return "AsBxsCx";
 	  case EEL_OL_ABCDx:	return "ABCDx";
 	  case EEL_OL_ABCsDx:	return "ABCsDx";
+	  case EEL_OL_ABCxDx:	return "ABCxDx";
 	}
 	return "<BAD OPERANDS>";
 }
@@ -261,6 +297,96 @@ const char *eel_i_stringrep(EEL_state *es, EEL_object *fo, int pc,
 		while(count < 24)
 			buf[count++] = ' ';
 		snprintf(buf + count, BS-24, "; (PC + %d)", B);
+	  EEL_IJUMPEQ
+		count = snprintf(buf, BS, "R%d, R%d, %d", A, B, pc + C);
+		while(count < 24)
+			buf[count++] = ' ';
+		snprintf(buf + count, BS-24, "; (PC + %d)", C);
+	  EEL_IJUMPNE
+		count = snprintf(buf, BS, "R%d, R%d, %d", A, B, pc + C);
+		while(count < 24)
+			buf[count++] = ' ';
+		snprintf(buf + count, BS-24, "; (PC + %d)", C);
+	  EEL_IJUMPGE
+		count = snprintf(buf, BS, "R%d, R%d, %d", A, B, pc + C);
+		while(count < 24)
+			buf[count++] = ' ';
+		snprintf(buf + count, BS-24, "; (PC + %d)", C);
+	  EEL_IJUMPLE
+		count = snprintf(buf, BS, "R%d, R%d, %d", A, B, pc + C);
+		while(count < 24)
+			buf[count++] = ' ';
+		snprintf(buf + count, BS-24, "; (PC + %d)", C);
+	  EEL_IJUMPGT
+		count = snprintf(buf, BS, "R%d, R%d, %d", A, B, pc + C);
+		while(count < 24)
+			buf[count++] = ' ';
+		snprintf(buf + count, BS-24, "; (PC + %d)", C);
+	  EEL_IJUMPLT
+		count = snprintf(buf, BS, "R%d, R%d, %d", A, B, pc + C);
+		while(count < 24)
+			buf[count++] = ' ';
+		snprintf(buf + count, BS-24, "; (PC + %d)", C);
+	  EEL_IJUMPEQI
+		count = snprintf(buf, BS, "R%d, %d, %d", A, B, pc + C);
+		while(count < 24)
+			buf[count++] = ' ';
+		snprintf(buf + count, BS-24, "; (PC + %d)", C);
+	  EEL_IJUMPNEI
+		count = snprintf(buf, BS, "R%d, %d, %d", A, B, pc + C);
+		while(count < 24)
+			buf[count++] = ' ';
+		snprintf(buf + count, BS-24, "; (PC + %d)", C);
+	  EEL_IJUMPGEI
+		count = snprintf(buf, BS, "R%d, %d, %d", A, B, pc + C);
+		while(count < 24)
+			buf[count++] = ' ';
+		snprintf(buf + count, BS-24, "; (PC + %d)", C);
+	  EEL_IJUMPLEI
+		count = snprintf(buf, BS, "R%d, %d, %d", A, B, pc + C);
+		while(count < 24)
+			buf[count++] = ' ';
+		snprintf(buf + count, BS-24, "; (PC + %d)", C);
+	  EEL_IJUMPGTI
+		count = snprintf(buf, BS, "R%d, %d, %d", A, B, pc + C);
+		while(count < 24)
+			buf[count++] = ' ';
+		snprintf(buf + count, BS-24, "; (PC + %d)", C);
+	  EEL_IJUMPLTI
+		count = snprintf(buf, BS, "R%d, %d, %d", A, B, pc + C);
+		while(count < 24)
+			buf[count++] = ' ';
+		snprintf(buf + count, BS-24, "; (PC + %d)", C);
+	  EEL_IJUMPEQC
+		count = snprintf(buf, BS, "R%d, C%d, %d", A, B, pc + C);
+		while(count < 24)
+			buf[count++] = ' ';
+		snprintf(buf + count, BS-24, "; (PC + %d)", C);
+	  EEL_IJUMPNEC
+		count = snprintf(buf, BS, "R%d, C%d, %d", A, B, pc + C);
+		while(count < 24)
+			buf[count++] = ' ';
+		snprintf(buf + count, BS-24, "; (PC + %d)", C);
+	  EEL_IJUMPGEC
+		count = snprintf(buf, BS, "R%d, C%d, %d", A, B, pc + C);
+		while(count < 24)
+			buf[count++] = ' ';
+		snprintf(buf + count, BS-24, "; (PC + %d)", C);
+	  EEL_IJUMPLEC
+		count = snprintf(buf, BS, "R%d, C%d, %d", A, B, pc + C);
+		while(count < 24)
+			buf[count++] = ' ';
+		snprintf(buf + count, BS-24, "; (PC + %d)", C);
+	  EEL_IJUMPGTC
+		count = snprintf(buf, BS, "R%d, C%d, %d", A, B, pc + C);
+		while(count < 24)
+			buf[count++] = ' ';
+		snprintf(buf + count, BS-24, "; (PC + %d)", C);
+	  EEL_IJUMPLTC
+		count = snprintf(buf, BS, "R%d, C%d, %d", A, B, pc + C);
+		while(count < 24)
+			buf[count++] = ' ';
+		snprintf(buf + count, BS-24, "; (PC + %d)", C);
 	  EEL_ISWITCH
 		count = snprintf(buf, BS, "R%d, C%d, %d", A, B, pc + C);
 		while(count < 24)
@@ -346,6 +472,14 @@ const char *eel_i_stringrep(EEL_state *es, EEL_object *fo, int pc,
 				o2EEL_string(o2EEL_function(
 				f->e.constants[C].objref.v)->
 				common.name)->buffer);
+	  EEL_IPHCCALL
+		count = snprintf(buf, BS, "C%d, R%d, %d", C, B, A);
+		while(count < 24)
+			buf[count++] = ' ';
+		snprintf(buf + count, BS-24, "; (%s)",
+				o2EEL_string(o2EEL_function(
+				f->e.constants[C].objref.v)->
+				common.name)->buffer);
 	  EEL_IRETURN
 	  EEL_IRETURNR
 		snprintf(buf, BS, "R%d", A);
@@ -436,13 +570,15 @@ const char *eel_i_stringrep(EEL_state *es, EEL_object *fo, int pc,
 		tmp = eel_v_stringrep(es->vm, &f->e.constants[C]);
 		while(count < 24)
 			buf[count++] = ' ';
-		snprintf(buf + count, BS-24, "; C%d = %s", C, tmp);
+		snprintf(buf + count, BS-24, "; C%d = %s (IC%d)", C, tmp,
+				D);
 	  EEL_IINDSETC
 		count = snprintf(buf, BS, "R%d, R%d[C%d]", A, B, C);
 		tmp = eel_v_stringrep(es->vm, &f->e.constants[C]);
 		while(count < 24)
 			buf[count++] = ' ';
-		snprintf(buf + count, BS-24, "; C%d = %s", C, tmp);
+		snprintf(buf + count, BS-24, "; C%d = %s (IC%d)", C, tmp,
+				D);
 
 	  /* Argument access */
 	  EEL_IGETARGI
@@ -595,6 +731,40 @@ const char *eel_i_stringrep(EEL_state *es, EEL_object *fo, int pc,
 	  EEL_IRETX
 	  EEL_IRETXR
 		snprintf(buf, BS, "R%d", A);
+
+	  /* Quickened operators */
+	  EEL_IIADD
+		snprintf(buf, BS, "R%d, R%d, R%d", B, C, A);
+	  EEL_IRADD
+		snprintf(buf, BS, "R%d, R%d, R%d", B, C, A);
+	  EEL_IISUB
+		snprintf(buf, BS, "R%d, R%d, R%d", B, C, A);
+	  EEL_IRSUB
+		snprintf(buf, BS, "R%d, R%d, R%d", B, C, A);
+	  EEL_IIMUL
+		snprintf(buf, BS, "R%d, R%d, R%d", B, C, A);
+	  EEL_IRMUL
+		snprintf(buf, BS, "R%d, R%d, R%d", B, C, A);
+	  EEL_IIDIV
+		snprintf(buf, BS, "R%d, R%d, R%d", B, C, A);
+	  EEL_IRDIV
+		snprintf(buf, BS, "R%d, R%d, R%d", B, C, A);
+	  EEL_IIBOP
+		snprintf(buf, BS, "R%d %s R%d, R%d", B, eel_opname(C), D, A);
+	  EEL_IRBOP
+		snprintf(buf, BS, "R%d %s R%d, R%d", B, eel_opname(C), D, A);
+	  EEL_IIBOPI
+		snprintf(buf, BS, "R%d %s %d, R%d", B, eel_opname(C), D, A);
+	  EEL_IRBOPI
+		snprintf(buf, BS, "R%d %s %d, R%d", B, eel_opname(C), D, A);
+
+	  /* Fused vector expressions */
+	  EEL_IVEXPR
+		count = snprintf(buf, BS, "C%d(R%d), R%d", C, B, A);
+		tmp = eel_v_stringrep(es->vm, &f->e.constants[C]);
+		while(count < 24)
+			buf[count++] = ' ';
+		snprintf(buf + count, BS-24, "; C%d = %s", C, tmp);
 		break;
 	  }
 	}
@@ -646,6 +816,14 @@ int eel_coder_close(EEL_coder *cdr)
 	eel_coder_realloc_code(cdr, f->e.codesize);
 	eel_coder_realloc_lines(cdr, f->e.nlines);
 	eel_coder_realloc_constants(cdr, f->e.nconstants);
+	if(f->e.nicaches && !f->e.icache)
+	{
+		f->e.icache = (EEL_int32 *)calloc(f->e.nicaches,
+				sizeof(EEL_int32));
+		if(!f->e.icache)
+			eel_serror(cdr->state, "Could not allocate inline "
+					"caches!");
+	}
 	while(cdr->firstml)
 		eel_ml_close(cdr->firstml);
 	free(cdr->registers);
@@ -1665,6 +1843,29 @@ int eel_codeABCsDx(EEL_coder *cdr, EEL_opcodes op, int a, int b, int c, int d)
 }
 
 
+int eel_codeABCxDx(EEL_coder *cdr, EEL_opcodes op, int a, int b, int c, int d)
+{
+	unsigned char buf[EEL_OSIZE_ABCxDx];
+	int res = 0;
+	EEL_OPERANDS(EEL_OL_ABCxDx)
+	EEL_RANGE(A, a, 0, 255);
+	EEL_RANGE(B, b, 0, 255);
+	EEL_RANGE(C, c, 0, 65535);
+	EEL_RANGE(D, d, 0, 65535);
+	if(res)
+		eel_ierror(cdr->state,"Could not generate %s instruction!",
+				eel_i_name(op));
+	buf[0] = op;
+	buf[1] = a;
+	buf[2] = b;
+	buf[3] = c & 0xff;
+	buf[4] = c >> 8;
+	buf[5] = d & 0xff;
+	buf[6] = d >> 8;
+	return code(cdr, buf, EEL_OSIZE_ABCxDx);
+}
+
+
 static inline int eel_get_offset_pos(unsigned char opcode, int *isize)
 {
 	switch(opcode)
@@ -46,6 +46,7 @@ struct EEL_coder
 	int		maxcode;	/* Bytes of code allocated */
 	int		peephole;	/* Enable peephole optimizer */
 	int		codeonly;	/* Disable targets, optimization etc */
+	int		inlinepos;	/* Source pos of inlinable 'return' */
 
 	/* Debug info */
 	int		fragline;	/* 'lines' index for fragment start */
@@ -91,6 +92,9 @@ int eel_coder_add_constant(EEL_coder *cdr, EEL_value *value);
  */
 int eel_coder_add_variable(EEL_coder *cdr, EEL_value *value);
 
+/* Allocate an inline cache slot for INDGETC/INDSETC. Returns it's index. */
+int eel_coder_add_icache(EEL_coder *cdr);
+
 
 /*----------------------------------------------------------
 	Register allocation
@@ -178,6 +182,7 @@ int eel_codeABxCx(EEL_coder *cdr, EEL_opcodes op, int a, int b, int c);
 int eel_codeABxsCx(EEL_coder *cdr, EEL_opcodes op, int a, int b, int c);
 int eel_codeABCDx(EEL_coder *cdr, EEL_opcodes op, int a, int b, int c, int d);
 int eel_codeABCsDx(EEL_coder *cdr, EEL_opcodes op, int a, int b, int c, int d);
+int eel_codeABCxDx(EEL_coder *cdr, EEL_opcodes op, int a, int b, int c, int d);
 
 /*
  * Make the current code position a jump target, and return the position. This
@@ -231,6 +236,12 @@ EEL_operands eel_i_operands(int opcode);
 /* Returns size of a complete instruction with 'opcode'. */
 int eel_i_size(int opcode);
 
+/*
+ * Returns the generic opcode that the VM quickened into 'opcode', or 'opcode'
+ * itself if it is not a quickened instruction.
+ */
+int eel_i_generic(int opcode);
+
 const char *eel_ol_name(EEL_operands oprs);
 
 #endif	/* EEL_EC_CODER_H */
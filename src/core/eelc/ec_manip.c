@@ -28,6 +28,7 @@
 #include "e_object.h"
 #include "e_string.h"
 #include "e_function.h"
+#include "e_state.h"
 
 static void do_operate(EEL_manipulator *m, int r, int ip);
 static void do_cast(EEL_manipulator *m, int r);
@@ -162,14 +163,14 @@ void eel_m_op(EEL_mlist *ml, EEL_manipulator *left, EEL_operators op,
 	EEL_manipulator *m;
 #ifdef EEL_CONSTANT_FOLDING
 	/* Check if this is a constant subexpression that we can evaluate! */
-	if(eel_m_is_constant(right) && (!left || eel_m_is_constant(left)))
+	if(eel_m_is_known(right) && (!left || eel_m_is_known(left)))
 	{
 		EEL_xno res;
 		EEL_value leftv, rightv, resv;
-		eel_m_get_constant(right, &rightv);
+		eel_m_get_known(right, &rightv);
 		if(left)
 		{
-			eel_m_get_constant(left, &leftv);
+			eel_m_get_known(left, &leftv);
 			res = eel_operate(&leftv, op, &rightv, &resv);
 			eel_v_disown_nz(&leftv);
 		}
@@ -199,7 +200,7 @@ void eel_m_cast(EEL_mlist *ml, EEL_manipulator *object, EEL_classes cid)
 {
 	EEL_manipulator *m;
 #ifdef EEL_CONSTANT_FOLDING
-	if(eel_m_is_constant(object))
+	if(eel_m_is_known(object))
 	{
 		int op;
 		switch(cid)
@@ -213,7 +214,7 @@ void eel_m_cast(EEL_mlist *ml, EEL_manipulator *object, EEL_classes cid)
 		{
 			EEL_xno res;
 			EEL_value objv, resv;
-			eel_m_get_constant(object, &objv);
+			eel_m_get_known(object, &objv);
 			res = eel_unop(op, &objv, &resv);
 			eel_v_disown_nz(&objv);
 			if(res == EEL_XOK)
@@ -602,6 +603,27 @@ void eel_m_get_constant(EEL_manipulator *m, EEL_value *v)
 }
 
 
+int eel_m_is_known(EEL_manipulator *m)
+{
+#ifdef EEL_CONSTANT_PROPAGATION
+	if((m->kind == EEL_MVARIABLE) && !m->v.variable.level &&
+			(m->v.variable.s->v.var.known > 0))
+		return eel_test_init(m->coder->state, m->v.variable.s) ==
+				EEL_EYES;
+#endif
+	return eel_m_is_constant(m);
+}
+
+
+void eel_m_get_known(EEL_manipulator *m, EEL_value *v)
+{
+	if(m->kind == EEL_MVARIABLE)
+		*v = m->v.variable.s->v.var.value;
+	else
+		eel_m_get_constant(m, v);
+}
+
+
 int eel_m_independent(EEL_manipulator *m1, EEL_manipulator *m2)
 {
 	switch(m1->kind)
@@ -665,6 +687,101 @@ int eel_m_independent(EEL_manipulator *m1, EEL_manipulator *m2)
 	Code generation tools
 ----------------------------------------------------------*/
 
+/*
+ * Fused vector expressions. Trees of two or more #+, #- and #* operators are
+ * coded as a single VEXPR instruction, which evaluates the whole expression
+ * in one pass over the vectors, instead of creating a temporary vector for
+ * every operator. Operands are read into consecutive registers first, which
+ * is only safe for operands that cannot have side effects.
+ */
+static inline char vexpr_op(EEL_manipulator *m)
+{
+	if(m->kind != EEL_MOP)
+		return 0;
+	switch(m->v.op.op)
+	{
+	  case EEL_OP_VADD:	return '+';
+	  case EEL_OP_VSUB:	return '-';
+	  case EEL_OP_VMUL:	return '*';
+	  default:		return 0;
+	}
+}
+
+static inline int vexpr_operand(EEL_manipulator *m)
+{
+	switch(m->kind)
+	{
+	  case EEL_MCONSTANT:
+	  case EEL_MRESULT:
+	  case EEL_MREGISTER:
+	  case EEL_MSTATVAR:
+	  case EEL_MVARIABLE:
+	  case EEL_MARGUMENT:
+	  case EEL_MOPTARG:
+		return 1;
+	  default:
+		return 0;
+	}
+}
+
+/*
+ * Append the postfix form of 'm' to 'expr', and its operands to 'operands'.
+ * Returns 0 if 'm' cannot be fused.
+ */
+static int vexpr_collect(EEL_manipulator *m, EEL_manipulator **operands,
+		int *noperands, char *expr, int *len)
+{
+	char op = vexpr_op(m);
+	if(op)
+	{
+		if(!m->v.op.left ||
+				!vexpr_collect(m->v.op.left, operands,
+				noperands, expr, len) ||
+				!vexpr_collect(m->v.op.right, operands,
+				noperands, expr, len))
+			return 0;
+		expr[(*len)++] = op;
+		return 1;
+	}
+	if(!vexpr_operand(m) || (*noperands >= EEL_VEXPR_MAXOPERANDS))
+		return 0;
+	expr[(*len)++] = 'a' + *noperands;
+	operands[(*noperands)++] = m;
+	return 1;
+}
+
+/* Returns 1 if the expression was coded as a VEXPR, otherwise 0. */
+static int do_vexpr(EEL_manipulator *m, int r)
+{
+	EEL_coder *cdr = m->coder;
+	EEL_manipulator *operands[EEL_VEXPR_MAXOPERANDS];
+	char expr[EEL_VEXPR_MAXOPERANDS * 2];
+	int noperands = 0;
+	int len = 0;
+	int i, first, c;
+	EEL_value v;
+	if(!vexpr_collect(m, operands, &noperands, expr, &len))
+		return 0;
+	if(len - noperands < 2)
+		return 0;
+	expr[len] = 0;
+
+	first = eel_r_alloc(cdr, noperands, EEL_RUTEMPORARY);
+	for(i = 0; i < noperands; ++i)
+		eel_m_read(operands[i], first + i);
+	v.classid = EEL_COBJREF;
+	v.objref.v = eel_ps_new(cdr->state->vm, expr);
+	if(!v.objref.v)
+		eel_serror(cdr->state, "Could not create string object for "
+				"vector expression!");
+	c = eel_coder_add_constant(cdr, &v);
+	eel_v_disown_nz(&v);
+	eel_codeABCx(cdr, EEL_OVEXPR_ABCx, r, first, c);
+	eel_r_free(cdr, first, noperands);
+	return 1;
+}
+
+
 static void do_operate(EEL_manipulator *m, int r, int ip)
 {
 	EEL_coder *cdr = m->coder;
@@ -706,6 +823,9 @@ static void do_operate(EEL_manipulator *m, int r, int ip)
 		if(!m->v.op.left)
 			eel_ierror(cdr->state, "Left hand operand to binary"
 					" operator missing!");
+		if(!ip && vexpr_op(m) && do_vexpr(m, r))
+			return;
+
 		/* Code binary operators */
 		lr = eel_m_direct_read(m->v.op.left);
 		if(lr < 0)
@@ -1268,6 +1388,7 @@ void eel_m_write(EEL_manipulator *m, int r)
 	  case EEL_MVARIABLE:
 	  {
 		EEL_symbol *s = m->v.variable.s;
+		s->v.var.known = -1;
 		if(m->v.variable.level)
 			eel_codeABC(cdr, EEL_OSETUVAL_ABC, r,
 					m->v.variable.r,
@@ -1356,9 +1477,35 @@ static int can_write_weakref(EEL_manipulator *m)
 }
 
 
+/*
+ * If 'to' is a local variable that has not been written before, and 'from' is
+ * a constant value that is not an object, we can remember that value for
+ * constant propagation.
+ */
+static int can_propagate(EEL_manipulator *from, EEL_manipulator *to,
+		EEL_value *v)
+{
+#ifdef EEL_CONSTANT_PROPAGATION
+	EEL_state *es = to->coder->state;
+	if((to->kind != EEL_MVARIABLE) || to->v.variable.level ||
+			to->v.variable.s->v.var.known ||
+			(es->context->sflags & EEL_SF_NOOPTIMIZE) ||
+			!eel_m_is_known(from))
+		return 0;
+	eel_m_get_known(from, v);
+	if(!EEL_IS_OBJREF(v->classid))
+		return 1;
+	eel_v_disown_nz(v);
+#endif
+	return 0;
+}
+
+
 void eel_m_copy(EEL_manipulator *from, EEL_manipulator *to)
 {
 	EEL_coder *cdr = from->coder;
+	EEL_value v;
+	int known = can_propagate(from, to, &v);
 	int dr = eel_m_direct_read(from);
 	int dw = eel_m_direct_write(to);
 	if(dr >= 0)
@@ -1373,6 +1520,11 @@ void eel_m_copy(EEL_manipulator *from, EEL_manipulator *to)
 		eel_m_write(to, r);
 		eel_r_free(cdr, r, 1);
 	}
+	if(known)
+	{
+		to->v.variable.s->v.var.known = 1;
+		to->v.variable.s->v.var.value = v;
+	}
 }
 
 
@@ -1383,6 +1535,8 @@ static void apply_op(EEL_manipulator *from, EEL_operators op,
 	EEL_mlist *ml = eel_ml_open(cdr);
 	EEL_manipulator *m;
 	int dw = eel_m_direct_write(to);
+	if(to->kind == EEL_MVARIABLE)
+		to->v.variable.s->v.var.known = -1;
 	eel_m_op(ml, to, op, from);
 	m = eel_ml_get(ml, 0);
 	if(dw >= 0)
@@ -226,6 +226,16 @@ int eel_m_is_constant(EEL_manipulator *m);
  */
 void eel_m_get_constant(EEL_manipulator *m, EEL_value *v);
 
+/*
+ * Like eel_m_is_constant(), but also accepts local variables with values that
+ * are known at compile time through constant propagation. This is for
+ * optimizations only; to the language, these are still variables!
+ */
+int eel_m_is_known(EEL_manipulator *m);
+
+/* Read the value of 'm', which must pass eel_m_is_known(), into 'v'. */
+void eel_m_get_known(EEL_manipulator *m, EEL_value *v);
+
 /*
  * This function returns 1 if the two manipulators definitely refer to
  * independent objects, and it returns 0 if 'm1' and 'm2' refer to, or could
@@ -24,6 +24,8 @@
 #include "ec_optimizer.h"
 #include "ec_coder.h"
 #include "e_function.h"
+#include "e_string.h"
+#include "e_table.h"
 
 #ifdef EEL_PEEPHOLE_OPTIMIZER
 
@@ -214,6 +216,19 @@ static inline int eel_pair_subst(EEL_coder *cdr, int pc, unsigned flags)
 		eel_codeABsCx(cdr, EEL_OPHBOPI_ABsCx, i1[2], i1[3],
 				EEL_OS16(i1, 4));
 		break;
+	  case EEL_MKOPT(EEL_OCCALLR_ABCx, EEL_OPUSH_A):
+		/*
+		 *	CCALLR Cx, R[y], z	PHCCALL Cx, R[y], z
+		 *	PUSH R[y]
+		 *
+		 * Nested calls are evaluated before any arguments of the
+		 * outer call are pushed, so the stack holds nothing else.
+		 */
+		if(keepregs || (i1[2] != i2[1]))
+			return 0;
+		eel_codeABCx(cdr, EEL_OPHCCALL_ABCx, i1[1], i1[2],
+				EEL_O16(i1, 3));
+		break;
 	  case EEL_MKOPT(EEL_OLDC_ABx, EEL_OINDGET_ABC):
 		/*
 		 *	LDC Cx, R[y]		INDGETC R[z][Cx], R[w]
@@ -221,7 +236,8 @@ static inline int eel_pair_subst(EEL_coder *cdr, int pc, unsigned flags)
 		 */
 		if(keepregs || (i1[1] != i2[2]))
 			return 0;
-		eel_codeABCx(cdr, EEL_OINDGETC_ABCx, i2[1], i2[3], EEL_O16(i1, 2));
+		eel_codeABCxDx(cdr, EEL_OINDGETC_ABCxDx, i2[1], i2[3],
+				EEL_O16(i1, 2), eel_coder_add_icache(cdr));
 		break;
 	  case EEL_MKOPT(EEL_OLDC_ABx, EEL_OINDSET_ABC):
 		/*
@@ -230,7 +246,8 @@ static inline int eel_pair_subst(EEL_coder *cdr, int pc, unsigned flags)
 		 */
 		if(keepregs || (i1[1] != i2[2]))
 			return 0;
-		eel_codeABCx(cdr, EEL_OINDSETC_ABCx, i2[1], i2[3], EEL_O16(i1, 2));
+		eel_codeABCxDx(cdr, EEL_OINDSETC_ABCxDx, i2[1], i2[3],
+				EEL_O16(i1, 2), eel_coder_add_icache(cdr));
 		break;
 	  case EEL_MKOPT(EEL_OLDC_ABx, EEL_OBOP_ABCD):
 		/*
@@ -427,3 +444,1285 @@ void eel_optimize(EEL_coder *cdr, unsigned flags)
 }
 
 #endif /* EEL_PEEPHOLE_OPTIMIZER */
+
+
+#ifdef EEL_LIVENESS_OPTIMIZER
+
+/*
+ * Register liveness optimizer
+ *
+ * Unlike the peephole optimizer, this one looks at the complete code of a
+ * function once it has been compiled and wired, so it can tell when a
+ * register is actually dead, rather than relying on hints from the parser.
+ *
+ *	1. Decode the code into an instruction table, and find the successors
+ *	   of each instruction. (Branches, SWITCH tables and fall-through.)
+ *	2. Calculate the set of registers that are live after each
+ *	   instruction, iterating backwards until nothing changes.
+ *	3. Remove definitions of dead temporaries and dead assignments to
+ *	   variables, and fold temporaries that are only used to pass a value
+ *	   from one instruction to the next.
+ *	4. Renumber the temporary registers, packing them as tightly as their
+ *	   live ranges allow, and shrink the register frame accordingly.
+ *	5. Remove deleted and unreachable instructions, and relocate branches,
+ *	   SWITCH jump tables and line number info.
+ *
+ * Registers that are ever initialized as variables (INIT*) are not renamed,
+ * as they may be accessed as upvalues by functions called from here, and
+ * are referred to by index by the clean table. Calls and try blocks are
+ * assumed to read all of them.
+ */
+
+#define	EEL_RS_WORDS	((256 + 31) / 32)
+typedef struct
+{
+	EEL_uint32	w[EEL_RS_WORDS];
+} EEL_regset;
+
+static inline void rs_clear(EEL_regset *rs)
+{
+	memset(rs, 0, sizeof(EEL_regset));
+}
+
+static inline void rs_set(EEL_regset *rs, int r)
+{
+	rs->w[r >> 5] |= 1 << (r & 31);
+}
+
+static inline void rs_reset(EEL_regset *rs, int r)
+{
+	rs->w[r >> 5] &= ~(1 << (r & 31));
+}
+
+static inline int rs_test(EEL_regset *rs, int r)
+{
+	return (rs->w[r >> 5] >> (r & 31)) & 1;
+}
+
+/* a |= b; Returns 1 if 'a' changed. */
+static inline int rs_merge(EEL_regset *a, EEL_regset *b)
+{
+	int i, changed = 0;
+	for(i = 0; i < EEL_RS_WORDS; ++i)
+	{
+		EEL_uint32 w = a->w[i] | b->w[i];
+		if(w != a->w[i])
+		{
+			a->w[i] = w;
+			changed = 1;
+		}
+	}
+	return changed;
+}
+
+
+/* Register operand roles */
+#define	EEL_RO_USE	0x01	/* Register is read */
+#define	EEL_RO_DEF	0x02	/* Register is written */
+
+/* Instruction properties */
+#define	EEL_RI_CALL	0x01	/* May access register variables indirectly */
+#define	EEL_RI_PURE	0x02	/* No side effects, and cannot fail */
+#define	EEL_RI_UNKNOWN	0x04	/* Not understood by the optimizer */
+
+#define	EEL_RO_MAX	4
+typedef struct
+{
+	unsigned char	pos;	/* Offset of operand in instruction */
+	unsigned char	count;	/* Number of registers (VEXPR range) */
+	unsigned char	role;	/* EEL_RO_* */
+} EEL_regoperand;
+
+typedef struct
+{
+	int		pc;		/* Original code position */
+	int		target;		/* Branch target, or -1 */
+	unsigned char	nro;		/* Number of register operands */
+	unsigned char	info;		/* EEL_RI_* */
+	unsigned char	leader;	/* Branch target */
+	unsigned char	reachable;
+	unsigned char	deleted;
+	EEL_regoperand	ro[EEL_RO_MAX];
+	EEL_regset	live;		/* Registers live after instruction */
+} EEL_rinstruction;
+
+
+/* Offset of the branch offset operand of 'opcode', or -1 */
+static int branch_offset(int opcode)
+{
+	switch(opcode)
+	{
+	  case EEL_OJUMP_sAx:
+		return EEL_OSIZE_sAx - 2;
+	  case EEL_OJUMPZ_AsBx:
+	  case EEL_OJUMPNZ_AsBx:
+		return EEL_OSIZE_AsBx - 2;
+	  case EEL_OSWITCH_ABxsCx:
+	  case EEL_OJUMPEQC_ABxsCx:
+	  case EEL_OJUMPNEC_ABxsCx:
+	  case EEL_OJUMPGEC_ABxsCx:
+	  case EEL_OJUMPLEC_ABxsCx:
+	  case EEL_OJUMPGTC_ABxsCx:
+	  case EEL_OJUMPLTC_ABxsCx:
+		return EEL_OSIZE_ABxsCx - 2;
+	  case EEL_OPRELOOP_ABCsDx:
+	  case EEL_OLOOP_ABCsDx:
+		return EEL_OSIZE_ABCsDx - 2;
+	  case EEL_OJUMPEQ_ABsCx:
+	  case EEL_OJUMPNE_ABsCx:
+	  case EEL_OJUMPGE_ABsCx:
+	  case EEL_OJUMPLE_ABsCx:
+	  case EEL_OJUMPGT_ABsCx:
+	  case EEL_OJUMPLT_ABsCx:
+		return EEL_OSIZE_ABsCx - 2;
+	  case EEL_OJUMPEQI_AsBxsCx:
+	  case EEL_OJUMPNEI_AsBxsCx:
+	  case EEL_OJUMPGEI_AsBxsCx:
+	  case EEL_OJUMPLEI_AsBxsCx:
+	  case EEL_OJUMPGTI_AsBxsCx:
+	  case EEL_OJUMPLTI_AsBxsCx:
+		return EEL_OSIZE_AsBxsCx - 2;
+	  default:
+		return -1;
+	}
+}
+
+
+/* Number of operand registers used by a VEXPR expression string */
+static int vexpr_operands(EEL_function *f, int c)
+{
+	const char *s;
+	int n = 0;
+	if(c >= f->e.nconstants ||
+			!EEL_IS_OBJREF(f->e.constants[c].classid) ||
+			(f->e.constants[c].objref.v->classid != EEL_CSTRING))
+		return -1;
+	for(s = o2EEL_string(f->e.constants[c].objref.v)->buffer; *s; ++s)
+		if((*s >= 'a') && (*s <= 'z') && (*s - 'a' + 1 > n))
+			n = *s - 'a' + 1;
+	return n;
+}
+
+
+/*
+ * Decode the register operands of the instruction of 'ri'. Only registers in
+ * the frame of the function are listed; upvalue operands refer to other
+ * frames.
+ */
+static void decode_registers(EEL_function *f, EEL_rinstruction *ri)
+{
+	unsigned char *ins = f->e.code + ri->pc;
+#define	RO(p, r)	(ri->ro[ri->nro].pos = (p),		\
+			ri->ro[ri->nro].count = 1,		\
+			ri->ro[ri->nro++].role = (r))
+#define	U	EEL_RO_USE
+#define	D	EEL_RO_DEF
+	ri->nro = 0;
+	ri->info = 0;
+	switch(eel_i_generic(ins[0]))
+	{
+	  case EEL_OILLEGAL_0:
+	  case EEL_ONOP_0:
+	  case EEL_OJUMP_sAx:
+	  case EEL_OPUSHI_sAx:
+	  case EEL_OPHTRUE_0:
+	  case EEL_OPHFALSE_0:
+	  case EEL_OPUSHNIL_0:
+	  case EEL_OPUSHC_Ax:
+	  case EEL_OPUSHC2_AxBx:
+	  case EEL_OPUSHIC_AxsBx:
+	  case EEL_OPUSHCI_AxsBx:
+	  case EEL_OPHVAR_Ax:
+	  case EEL_OPHARGS_0:
+	  case EEL_OPUSHTUP_0:
+	  case EEL_ORETURN_0:
+	  case EEL_OCLEAN_A:
+	  case EEL_OPHARGI_A:
+	  case EEL_OPHARGI2_AB:
+	  case EEL_ORETRY_0:
+	  case EEL_ORETX_0:
+		break;
+	  case EEL_OJUMPZ_AsBx:
+	  case EEL_OJUMPNZ_AsBx:
+	  case EEL_OSWITCH_ABxsCx:
+	  case EEL_OPUSH_A:
+	  case EEL_ORETURNR_A:
+	  case EEL_OTHROW_A:
+	  case EEL_ORETXR_A:
+	  case EEL_OSETVAR_ABx:
+	  case EEL_OSETARGI_AB:
+	  case EEL_OSETUVARGI_ABC:
+	  case EEL_OPHBOPI_ABsCx:
+	  case EEL_OJUMPEQI_AsBxsCx:
+	  case EEL_OJUMPNEI_AsBxsCx:
+	  case EEL_OJUMPGEI_AsBxsCx:
+	  case EEL_OJUMPLEI_AsBxsCx:
+	  case EEL_OJUMPGTI_AsBxsCx:
+	  case EEL_OJUMPLTI_AsBxsCx:
+	  case EEL_OJUMPEQC_ABxsCx:
+	  case EEL_OJUMPNEC_ABxsCx:
+	  case EEL_OJUMPGEC_ABxsCx:
+	  case EEL_OJUMPLEC_ABxsCx:
+	  case EEL_OJUMPGTC_ABxsCx:
+	  case EEL_OJUMPLTC_ABxsCx:
+		RO(1, U);
+		break;
+	  case EEL_OPUSH4_ABCD:
+		RO(4, U);
+		/* fall through */
+	  case EEL_OPUSH3_ABC:
+		RO(3, U);
+		/* fall through */
+	  case EEL_OPUSH2_AB:
+		RO(2, U);
+		RO(1, U);
+		break;
+	  case EEL_OPHBOP_ABC:
+		RO(1, U);
+		RO(3, U);
+		break;
+	  case EEL_OJUMPEQ_ABsCx:
+	  case EEL_OJUMPNE_ABsCx:
+	  case EEL_OJUMPGE_ABsCx:
+	  case EEL_OJUMPLE_ABsCx:
+	  case EEL_OJUMPGT_ABsCx:
+	  case EEL_OJUMPLT_ABsCx:
+	  case EEL_OPHADD_AB:
+	  case EEL_OPHSUB_AB:
+	  case EEL_OPHMUL_AB:
+	  case EEL_OPHDIV_AB:
+	  case EEL_OPHMOD_AB:
+	  case EEL_OPHPOWER_AB:
+		RO(1, U);
+		RO(2, U);
+		break;
+	  case EEL_OPRELOOP_ABCsDx:
+		RO(1, U | D);
+		RO(2, U | D);
+		RO(3, U | D);
+		break;
+	  case EEL_OLOOP_ABCsDx:
+		RO(1, U | D);
+		RO(2, U);
+		RO(3, U);
+		break;
+	  case EEL_OPHUVAL_AB:
+		if(!ins[2])
+			RO(1, U);
+		break;
+	  case EEL_OCALL_A:
+		RO(1, U);
+		ri->info = EEL_RI_CALL;
+		break;
+	  case EEL_OCALLR_AB:
+		RO(1, U);
+		RO(2, D);
+		ri->info = EEL_RI_CALL;
+		break;
+	  case EEL_OCCALL_ABx:
+	  case EEL_OTRY_AxBx:
+	  case EEL_OUNTRY_Ax:
+		ri->info = EEL_RI_CALL;
+		break;
+	  case EEL_OCCALLR_ABCx:
+	  case EEL_OPHCCALL_ABCx:
+		RO(2, D);
+		ri->info = EEL_RI_CALL;
+		break;
+	  case EEL_OLDI_AsBx:
+	  case EEL_OLDTRUE_A:
+	  case EEL_OLDFALSE_A:
+	  case EEL_OLDNIL_A:
+	  case EEL_OLDC_ABx:
+	  case EEL_OGETARGI_AB:
+	  case EEL_OARGC_A:
+	  case EEL_OTUPC_A:
+		RO(1, D);
+		ri->info = EEL_RI_PURE;
+		break;
+	  case EEL_OGETVAR_ABx:
+	  case EEL_OGETUVARGI_ABC:
+	  case EEL_OINITI_AsBx:
+	  case EEL_OINITNIL_A:
+	  case EEL_OINITC_ABx:
+	  case EEL_ONEW_AB:
+		RO(1, D);
+		break;
+	  case EEL_OSPEC_AB:
+		RO(2, D);
+		break;
+	  case EEL_OTSPEC_AB:
+		RO(1, U);
+		RO(2, D);
+		break;
+	  case EEL_OMOVE_AB:
+		RO(1, D);
+		RO(2, U);
+		ri->info = EEL_RI_PURE;
+		break;
+	  case EEL_OINIT_AB:
+	  case EEL_ONEG_AB:
+	  case EEL_OBNOT_AB:
+	  case EEL_ONOT_AB:
+	  case EEL_OCASTR_AB:
+	  case EEL_OCASTI_AB:
+	  case EEL_OCASTB_AB:
+	  case EEL_OTYPEOF_AB:
+	  case EEL_OSIZEOF_AB:
+	  case EEL_OWEAKREF_AB:
+	  case EEL_OCLONE_AB:
+	  case EEL_OINDGETC_ABCxDx:
+	  case EEL_OBOPS_ABCsDx:
+	  case EEL_OIPBOPS_ABCsDx:
+	  case EEL_OBOPI_ABCsDx:
+	  case EEL_OIPBOPI_ABCsDx:
+	  case EEL_OBOPC_ABCDx:
+		RO(1, D);
+		RO(2, U);
+		break;
+	  case EEL_OASSIGN_AB:
+		/*
+		 * The old value of the variable is released, but never read,
+		 * so as far as liveness is concerned, ASSIGN* just define it.
+		 */
+		RO(1, D);
+		RO(2, U);
+		break;
+	  case EEL_OASSIGNI_AsBx:
+	  case EEL_OASNNIL_A:
+	  case EEL_OASSIGNC_ABx:
+		RO(1, D);
+		break;
+	  case EEL_OGETUVAL_ABC:
+		RO(1, D);
+		if(!ins[3])
+			RO(2, U);
+		break;
+	  case EEL_OSETUVAL_ABC:
+		RO(1, U);
+		if(!ins[3])
+			RO(2, U | D);
+		break;
+	  case EEL_OINDGETI_ABC:
+	  case EEL_OGETTARGI_ABC:
+	  case EEL_OGETUVTARGI_ABCD:
+		RO(1, D);
+		RO(3, U);
+		break;
+	  case EEL_OINDSETI_ABC:
+		RO(1, U);
+		RO(3, U);
+		break;
+	  case EEL_OINDGET_ABC:
+	  case EEL_OCAST_ABC:
+	  case EEL_OADD_ABC:
+	  case EEL_OSUB_ABC:
+	  case EEL_OMUL_ABC:
+	  case EEL_ODIV_ABC:
+	  case EEL_OMOD_ABC:
+	  case EEL_OPOWER_ABC:
+		RO(1, D);
+		RO(2, U);
+		RO(3, U);
+		break;
+	  case EEL_OINDSET_ABC:
+		RO(1, U);
+		RO(2, U);
+		RO(3, U);
+		break;
+	  case EEL_OINDSETC_ABCxDx:
+		RO(1, U);
+		RO(2, U);
+		break;
+	  case EEL_OBOP_ABCD:
+	  case EEL_OIPBOP_ABCD:
+		RO(1, D);
+		RO(2, U);
+		RO(4, U);
+		break;
+	  case EEL_OVEXPR_ABCx:
+	  {
+		int n = vexpr_operands(f, EEL_O16(ins, 3));
+		if(n < 0)
+		{
+			ri->info = EEL_RI_UNKNOWN;
+			break;
+		}
+		RO(1, D);
+		RO(2, U);
+		ri->ro[1].count = n;
+		break;
+	  }
+	  default:
+		ri->info = EEL_RI_UNKNOWN;
+		break;
+	}
+#undef	D
+#undef	U
+#undef	RO
+}
+
+
+typedef struct
+{
+	EEL_coder		*cdr;
+	EEL_function		*f;
+	int			ninstructions;
+	EEL_rinstruction	*ins;
+	int			*index;		/* pc ==> instruction index */
+	EEL_regset		vars;		/* Register variables */
+	EEL_regset		pinned;		/* Registers not to rename */
+} EEL_roptimizer;
+
+
+/* Instruction index of code position 'pc', or -1 */
+static inline int ro_index(EEL_roptimizer *ro, int pc)
+{
+	if((pc < 0) || (pc >= ro->f->e.codesize))
+		return -1;
+	return ro->index[pc];
+}
+
+
+/* SWITCH jump table of the instruction at 'pc', or NULL */
+static EEL_object *ro_jumptable(EEL_roptimizer *ro, int pc)
+{
+	EEL_function *f = ro->f;
+	int c = EEL_O16(f->e.code + pc, 2);
+	if((c >= f->e.nconstants) ||
+			!EEL_IS_OBJREF(f->e.constants[c].classid) ||
+			(f->e.constants[c].objref.v->classid != EEL_CTABLE))
+		return NULL;
+	return f->e.constants[c].objref.v;
+}
+
+
+/*
+ * Calls 'cb' for each successor of instruction 'i'. Returns 0 if there is
+ * some control flow that we can't follow, otherwise 1.
+ */
+typedef void (*EEL_ro_succ_cb)(EEL_roptimizer *ro, int from, int to,
+		void *data);
+static int ro_successors(EEL_roptimizer *ro, int i, EEL_ro_succ_cb cb,
+		void *data)
+{
+	EEL_rinstruction *ri = &ro->ins[i];
+	unsigned char *ins = ro->f->e.code + ri->pc;
+	int fallthrough = 1;
+	switch(ins[0])
+	{
+	  case EEL_OILLEGAL_0:
+	  case EEL_OJUMP_sAx:
+	  case EEL_ORETURN_0:
+	  case EEL_ORETURNR_A:
+	  case EEL_OTHROW_A:
+	  case EEL_ORETRY_0:
+	  case EEL_ORETX_0:
+	  case EEL_ORETXR_A:
+		fallthrough = 0;
+		break;
+	  case EEL_OSWITCH_ABxsCx:
+	  {
+		EEL_object *jt = ro_jumptable(ro, ri->pc);
+		int j, len;
+		if(!jt)
+			return 0;
+		len = o2EEL_table(jt)->length;
+		for(j = 0; j < len; ++j)
+		{
+			EEL_value *v = &eel_table_get_item(jt, j)->value;
+			int to;
+			if(v->classid != EEL_CINTEGER)
+				return 0;
+			to = ro_index(ro, v->integer.v);
+			if(to < 0)
+				return 0;
+			cb(ro, i, to, data);
+		}
+		fallthrough = 0;
+		break;
+	  }
+	  default:
+		break;
+	}
+	if(ri->target >= 0)
+		cb(ro, i, ri->target, data);
+	if(fallthrough)
+	{
+		if(i + 1 >= ro->ninstructions)
+			return 0;
+		cb(ro, i, i + 1, data);
+	}
+	return 1;
+}
+
+
+static void ro_mark_leader(EEL_roptimizer *ro, int from, int to, void *data)
+{
+	EEL_rinstruction *ri = &ro->ins[from];
+	if((to != from + 1) || (ri->target >= 0) ||
+			(ro->f->e.code[ri->pc] == EEL_OSWITCH_ABxsCx))
+		ro->ins[to].leader = 1;
+}
+
+
+/* Decode the code of the function. Returns 0 if we can't handle it. */
+static int ro_decode(EEL_roptimizer *ro)
+{
+	EEL_function *f = ro->f;
+	int pc, i, n = 0;
+	for(pc = 0; pc < f->e.codesize; pc += eel_i_size(f->e.code[pc]))
+		++n;
+	if(pc != f->e.codesize)
+		return 0;
+	if(!n || (n != f->e.nlines))
+		return 0;
+	ro->ninstructions = n;
+	ro->ins = (EEL_rinstruction *)calloc(n, sizeof(EEL_rinstruction));
+	ro->index = (int *)malloc(f->e.codesize * sizeof(int));
+	if(!ro->ins || !ro->index)
+		return 0;
+	for(pc = 0; pc < f->e.codesize; ++pc)
+		ro->index[pc] = -1;
+	for(pc = 0, i = 0; i < n; pc += eel_i_size(f->e.code[pc]), ++i)
+	{
+		ro->ins[i].pc = pc;
+		ro->index[pc] = i;
+	}
+	rs_clear(&ro->vars);
+	rs_clear(&ro->pinned);
+	for(i = 0; i < n; ++i)
+	{
+		EEL_rinstruction *ri = &ro->ins[i];
+		unsigned char *ins = f->e.code + ri->pc;
+		int j, offs = branch_offset(ins[0]);
+		ri->target = -1;
+		if(offs >= 0)
+		{
+			int to = ri->pc + eel_i_size(ins[0]) +
+					(EEL_OS16(ins, offs));
+			ri->target = ro_index(ro, to);
+			if(ri->target < 0)
+				return 0;
+		}
+		decode_registers(f, ri);
+		if(ri->info & EEL_RI_UNKNOWN)
+			return 0;
+		switch(ins[0])
+		{
+		  case EEL_OINIT_AB:
+		  case EEL_OINITI_AsBx:
+		  case EEL_OINITNIL_A:
+		  case EEL_OINITC_ABx:
+		  case EEL_OASSIGN_AB:
+		  case EEL_OASSIGNI_AsBx:
+		  case EEL_OASNNIL_A:
+		  case EEL_OASSIGNC_ABx:
+			rs_set(&ro->vars, ins[1]);
+			break;
+		  case EEL_OPHUVAL_AB:
+		  case EEL_OGETUVAL_ABC:
+		  case EEL_OSETUVAL_ABC:
+			/* Upvalue access to our own frame; don't touch! */
+			for(j = 0; j < ri->nro; ++j)
+				rs_set(&ro->pinned, ins[ri->ro[j].pos]);
+			break;
+		}
+		for(j = 0; j < ri->nro; ++j)
+			if(ri->ro[j].count != 1)
+			{
+				int r;
+				for(r = 0; r < ri->ro[j].count; ++r)
+					rs_set(&ro->pinned,
+							ins[ri->ro[j].pos] + r);
+			}
+	}
+	for(i = 0; i < n; ++i)
+		if(!ro_successors(ro, i, ro_mark_leader, NULL))
+			return 0;
+	return 1;
+}
+
+
+static void ro_mark_reachable(EEL_roptimizer *ro, int from, int to,
+		void *data)
+{
+	if(!ro->ins[to].reachable)
+		ro->ins[to].reachable = 1;
+}
+
+
+/* Mark all instructions that can be reached from the function entry */
+static void ro_reachability(EEL_roptimizer *ro)
+{
+	int i, changed = 1;
+	ro->ins[0].reachable = 1;
+	while(changed)
+	{
+		changed = 0;
+		for(i = 0; i < ro->ninstructions; ++i)
+			if(ro->ins[i].reachable == 1)
+			{
+				ro->ins[i].reachable = 2;
+				ro_successors(ro, i, ro_mark_reachable, NULL);
+				changed = 1;
+			}
+	}
+}
+
+
+/* Registers read by instruction 'i', before it writes anything */
+static void ro_uses(EEL_roptimizer *ro, int i, EEL_regset *rs)
+{
+	EEL_rinstruction *ri = &ro->ins[i];
+	unsigned char *ins = ro->f->e.code + ri->pc;
+	int j, r;
+	for(j = 0; j < ri->nro; ++j)
+		if(ri->ro[j].role & EEL_RO_USE)
+			for(r = 0; r < ri->ro[j].count; ++r)
+				rs_set(rs, ins[ri->ro[j].pos] + r);
+	if(ri->info & EEL_RI_CALL)
+		rs_merge(rs, &ro->vars);
+}
+
+
+/* live_in(i) = uses(i) | (live_out(i) & ~defs(i)) */
+static void ro_live_in(EEL_roptimizer *ro, int i, EEL_regset *rs)
+{
+	EEL_rinstruction *ri = &ro->ins[i];
+	unsigned char *ins = ro->f->e.code + ri->pc;
+	int j;
+	*rs = ri->live;
+	if(ri->deleted)
+		return;
+	for(j = 0; j < ri->nro; ++j)
+		if(ri->ro[j].role == EEL_RO_DEF)
+			rs_reset(rs, ins[ri->ro[j].pos]);
+	ro_uses(ro, i, rs);
+}
+
+
+static void ro_merge_live(EEL_roptimizer *ro, int from, int to, void *data)
+{
+	EEL_regset in;
+	ro_live_in(ro, to, &in);
+	rs_merge((EEL_regset *)data, &in);
+}
+
+
+/* Calculate the registers live after each instruction */
+static void ro_liveness(EEL_roptimizer *ro)
+{
+	int i, changed = 1;
+	for(i = 0; i < ro->ninstructions; ++i)
+		rs_clear(&ro->ins[i].live);
+	while(changed)
+	{
+		changed = 0;
+		for(i = ro->ninstructions - 1; i >= 0; --i)
+		{
+			EEL_regset out;
+			if(!ro->ins[i].reachable)
+				continue;
+			rs_clear(&out);
+			ro_successors(ro, i, ro_merge_live, &out);
+			changed |= rs_merge(&ro->ins[i].live, &out);
+		}
+	}
+}
+
+
+/*
+ * Index of the instruction that follows 'i' in the same basic block, skipping
+ * deleted instructions, or -1
+ */
+static int ro_next(EEL_roptimizer *ro, int i)
+{
+	EEL_rinstruction *ri = &ro->ins[i];
+	if((ri->target >= 0) ||
+			(ro->f->e.code[ri->pc] == EEL_OSWITCH_ABxsCx))
+		return -1;
+	for(++i; i < ro->ninstructions; ++i)
+	{
+		if(ro->ins[i].leader)
+			return -1;
+		if(!ro->ins[i].deleted)
+			return i;
+	}
+	return -1;
+}
+
+
+/* Returns 1 if instruction 'i' reads register 'r' */
+static int ro_reads(EEL_roptimizer *ro, int i, int r)
+{
+	EEL_regset rs;
+	rs_clear(&rs);
+	ro_uses(ro, i, &rs);
+	return rs_test(&rs, r);
+}
+
+
+/* Returns 1 if instruction 'i' writes register 'r' */
+static int ro_writes(EEL_roptimizer *ro, int i, int r)
+{
+	EEL_rinstruction *ri = &ro->ins[i];
+	unsigned char *ins = ro->f->e.code + ri->pc;
+	int j;
+	for(j = 0; j < ri->nro; ++j)
+		if((ri->ro[j].role & EEL_RO_DEF) && (ins[ri->ro[j].pos] == r))
+			return 1;
+	return 0;
+}
+
+
+/* Returns 1 if register 'r' may be removed or renamed */
+static inline int ro_temporary(EEL_roptimizer *ro, int r)
+{
+	return !rs_test(&ro->vars, r) && !rs_test(&ro->pinned, r);
+}
+
+
+static void ro_delete(EEL_roptimizer *ro, int i)
+{
+	ro->ins[i].deleted = 1;
+	ro->ins[i].nro = 0;
+	ro->ins[i].info = 0;
+}
+
+
+/*
+ * Dead store elimination: Remove assignment 'i' if the variable is never read
+ * before it is assigned again, or the function returns. The old value is then
+ * released by the next assignment or the clean table instead.
+ */
+static int ro_dead_store(EEL_roptimizer *ro, int i)
+{
+	EEL_rinstruction *ri = &ro->ins[i];
+	unsigned char *ins = ro->f->e.code + ri->pc;
+	switch(ins[0])
+	{
+	  case EEL_OASSIGN_AB:
+	  case EEL_OASSIGNI_AsBx:
+	  case EEL_OASNNIL_A:
+	  case EEL_OASSIGNC_ABx:
+		break;
+	  default:
+		return 0;
+	}
+	if(rs_test(&ri->live, ins[1]) || rs_test(&ro->pinned, ins[1]))
+		return 0;
+	ro_delete(ro, i);
+	return 1;
+}
+
+
+/*
+ * Compare-and-branch opcode that branches when the comparison 'op' of 'opcode'
+ * (BOP, BOPI or BOPC) is true, or if 'inverse', when it is false. Returns -1
+ * if there is no such instruction.
+ *
+ * NOTE: NE, LT and LE are implemented as inverted EQ, GE and GT throughout,
+ *       so inverting the operator gives the exact same branch decisions.
+ */
+static int ro_cmpjump(int opcode, int op, int inverse)
+{
+	if(inverse)
+		switch(op)
+		{
+		  case EEL_OP_EQ:	op = EEL_OP_NE; break;
+		  case EEL_OP_NE:	op = EEL_OP_EQ; break;
+		  case EEL_OP_GE:	op = EEL_OP_LT; break;
+		  case EEL_OP_LT:	op = EEL_OP_GE; break;
+		  case EEL_OP_GT:	op = EEL_OP_LE; break;
+		  case EEL_OP_LE:	op = EEL_OP_GT; break;
+		  default:		return -1;
+		}
+	switch(opcode)
+	{
+	  case EEL_OBOP_ABCD:
+		switch(op)
+		{
+		  case EEL_OP_EQ:	return EEL_OJUMPEQ_ABsCx;
+		  case EEL_OP_NE:	return EEL_OJUMPNE_ABsCx;
+		  case EEL_OP_GE:	return EEL_OJUMPGE_ABsCx;
+		  case EEL_OP_LE:	return EEL_OJUMPLE_ABsCx;
+		  case EEL_OP_GT:	return EEL_OJUMPGT_ABsCx;
+		  case EEL_OP_LT:	return EEL_OJUMPLT_ABsCx;
+		}
+		break;
+	  case EEL_OBOPI_ABCsDx:
+		switch(op)
+		{
+		  case EEL_OP_EQ:	return EEL_OJUMPEQI_AsBxsCx;
+		  case EEL_OP_NE:	return EEL_OJUMPNEI_AsBxsCx;
+		  case EEL_OP_GE:	return EEL_OJUMPGEI_AsBxsCx;
+		  case EEL_OP_LE:	return EEL_OJUMPLEI_AsBxsCx;
+		  case EEL_OP_GT:	return EEL_OJUMPGTI_AsBxsCx;
+		  case EEL_OP_LT:	return EEL_OJUMPLTI_AsBxsCx;
+		}
+		break;
+	  case EEL_OBOPC_ABCDx:
+		switch(op)
+		{
+		  case EEL_OP_EQ:	return EEL_OJUMPEQC_ABxsCx;
+		  case EEL_OP_NE:	return EEL_OJUMPNEC_ABxsCx;
+		  case EEL_OP_GE:	return EEL_OJUMPGEC_ABxsCx;
+		  case EEL_OP_LE:	return EEL_OJUMPLEC_ABxsCx;
+		  case EEL_OP_GT:	return EEL_OJUMPGTC_ABxsCx;
+		  case EEL_OP_LT:	return EEL_OJUMPLTC_ABxsCx;
+		}
+		break;
+	}
+	return -1;
+}
+
+
+/*
+ * Attempt to remove or fold instruction 'i' and/or the following one, based
+ * on the liveness info. Returns the index of the last instruction involved
+ * if something was changed, otherwise -1.
+ */
+static int ro_rewrite(EEL_roptimizer *ro, int i)
+{
+	EEL_function *f = ro->f;
+	EEL_rinstruction *ri = &ro->ins[i];
+	unsigned char *i1 = f->e.code + ri->pc;
+	unsigned char *i2;
+	int j, t;
+
+	/* Only instructions with a single plain destination register */
+	if((ri->nro < 1) || (ri->ro[0].pos != 1) ||
+			(ri->ro[0].role != EEL_RO_DEF) ||
+			(ri->info & EEL_RI_CALL))
+		return -1;
+	t = i1[1];
+	if(!ro_temporary(ro, t))
+		return -1;
+
+	/* Value never used? */
+	if((ri->info & EEL_RI_PURE) && !rs_test(&ri->live, t))
+	{
+		/*
+		 *	LDI ?, R[t]		(nothing)
+		 *	(R[t] is dead)
+		 */
+		ro_delete(ro, i);
+		return i;
+	}
+
+	j = ro_next(ro, i);
+	if(j < 0)
+		return -1;
+	i2 = f->e.code + ro->ins[j].pc;
+	if(rs_test(&ro->ins[j].live, t) || ro_writes(ro, j, t))
+		return -1;
+
+	switch(i2[0])
+	{
+	  case EEL_OINIT_AB:
+	  case EEL_OASSIGN_AB:
+	  {
+		/*
+		 *	LDI x, R[t]		INITI x, R[v]
+		 *	INIT R[t], R[v]
+		 *	(R[t] is dead)
+		 */
+		int init = (i2[0] == EEL_OINIT_AB);
+		if((i2[2] != t) || (i2[1] == t))
+			return -1;
+		switch(i1[0])
+		{
+		  case EEL_OLDI_AsBx:
+			i1[0] = init ? EEL_OINITI_AsBx : EEL_OASSIGNI_AsBx;
+			break;
+		  case EEL_OLDNIL_A:
+			i1[0] = init ? EEL_OINITNIL_A : EEL_OASNNIL_A;
+			break;
+		  case EEL_OLDC_ABx:
+			i1[0] = init ? EEL_OINITC_ABx : EEL_OASSIGNC_ABx;
+			break;
+		  default:
+			return -1;
+		}
+		i1[1] = i2[1];
+		break;
+	  }
+	  case EEL_OMOVE_AB:
+		/*
+		 *	ADD R[x], R[y], R[t]	ADD R[x], R[y], R[v]
+		 *	MOVE R[t], R[v]
+		 *	(R[t] is dead)
+		 */
+		if((i2[2] != t) || !ro_temporary(ro, i2[1]) ||
+				ro_reads(ro, i, i2[1]))
+			return -1;
+		i1[1] = i2[1];
+		break;
+	  case EEL_OJUMPZ_AsBx:
+	  case EEL_OJUMPNZ_AsBx:
+	  {
+		/*
+		 *	BOP R[x] LT R[y], R[t]	JUMPGE R[x], R[y], z
+		 *	JUMPZ R[t], z
+		 *	(R[t] is dead)
+		 *
+		 * BOPI and BOPC are fused the same way. The compare-and-
+		 * branch instructions are the same size as the comparisons,
+		 * so they're rewritten in place, and ro_compact() fills in
+		 * the new branch offset.
+		 */
+		int op = ro_cmpjump(eel_i_generic(i1[0]), i1[3],
+				i2[0] == EEL_OJUMPZ_AsBx);
+		if((op < 0) || (i2[1] != t))
+			return -1;
+		i1[1] = i1[2];
+		i1[2] = i1[4];
+		if(eel_i_generic(i1[0]) != EEL_OBOP_ABCD)
+			i1[3] = i1[5];	/* 16 bit immediate or constant */
+		i1[0] = op;
+		ri->target = ro->ins[j].target;
+		break;
+	  }
+	  default:
+		if(i1[0] == EEL_ONOT_AB)
+		{
+			/*
+			 *	NOT R[s], R[t]		JUMPNZ R[s], x
+			 *	JUMPZ R[t], x
+			 *	(R[t] is dead)
+			 */
+			switch(i2[0])
+			{
+			  case EEL_OJUMPZ_AsBx:
+				i2[0] = EEL_OJUMPNZ_AsBx;
+				break;
+			  case EEL_OJUMPNZ_AsBx:
+				i2[0] = EEL_OJUMPZ_AsBx;
+				break;
+			  default:
+				return -1;
+			}
+			if(i2[1] != t)
+				return -1;
+			i2[1] = i1[2];
+			ro_delete(ro, i);
+			return j;
+		}
+		else if(i1[0] == EEL_OMOVE_AB)
+		{
+			/*
+			 *	MOVE R[s], R[t]		ADD R[s], R[y], R[x]
+			 *	ADD R[t], R[y], R[x]
+			 *	(R[t] is dead)
+			 */
+			EEL_rinstruction *rj = &ro->ins[j];
+			int s = i1[2];
+			int k, used = 0;
+			if((s == t) || ro_writes(ro, j, s))
+				return -1;
+			for(k = 0; k < rj->nro; ++k)
+			{
+				if(i2[rj->ro[k].pos] != t)
+					continue;
+				if(rj->ro[k].count != 1)
+					return -1;
+				++used;
+			}
+			if(!used)
+				return -1;
+			for(k = 0; k < rj->nro; ++k)
+				if(i2[rj->ro[k].pos] == t)
+					i2[rj->ro[k].pos] = s;
+			ro_delete(ro, i);
+			return j;
+		}
+		return -1;
+	}
+	decode_registers(f, ri);
+	ro_delete(ro, j);
+	return j;
+}
+
+
+/*
+ * Returns 1 if the result register of the instruction may be the same as one
+ * of the operands. (The compiler does this all the time with the most common
+ * instructions, so the VM handles it. We're playing safe with the rest.)
+ */
+static int ro_may_alias(int opcode)
+{
+	switch(eel_i_generic(opcode))
+	{
+	  case EEL_OINDGET_ABC:
+	  case EEL_OINDGETC_ABCxDx:
+	  case EEL_OBOP_ABCD:
+	  case EEL_OBOPS_ABCsDx:
+	  case EEL_OBOPI_ABCsDx:
+	  case EEL_OBOPC_ABCDx:
+	  case EEL_OADD_ABC:
+	  case EEL_OSUB_ABC:
+	  case EEL_OMUL_ABC:
+	  case EEL_ODIV_ABC:
+	  case EEL_OMOD_ABC:
+	  case EEL_OPOWER_ABC:
+	  case EEL_ONEG_AB:
+	  case EEL_OBNOT_AB:
+	  case EEL_ONOT_AB:
+	  case EEL_OCASTR_AB:
+	  case EEL_OCASTI_AB:
+	  case EEL_OCASTB_AB:
+	  case EEL_OCAST_ABC:
+	  case EEL_OTYPEOF_AB:
+	  case EEL_OSIZEOF_AB:
+	  case EEL_OMOVE_AB:
+		return 1;
+	  default:
+		return 0;
+	}
+}
+
+
+/*
+ * Renumber the temporary registers, so that registers with non-overlapping
+ * live ranges share numbers, and the register frame can be shrunk.
+ */
+static void ro_rename(EEL_roptimizer *ro)
+{
+	EEL_function *f = ro->f;
+	EEL_regset *interference, temps, taken, in;
+	int map[256];
+	int i, j, k, r;
+	interference = (EEL_regset *)calloc(256, sizeof(EEL_regset));
+	if(!interference)
+		return;
+
+	/* Find the temporaries, and how their live ranges overlap */
+	rs_clear(&temps);
+	rs_clear(&taken);
+	for(i = 0; i < ro->ninstructions; ++i)
+	{
+		EEL_rinstruction *ri = &ro->ins[i];
+		unsigned char *ins = f->e.code + ri->pc;
+		for(j = 0; j < ri->nro; ++j)
+			for(r = 0; r < ri->ro[j].count; ++r)
+			{
+				int rr = ins[ri->ro[j].pos] + r;
+				if(ro_temporary(ro, rr))
+					rs_set(&temps, rr);
+				else
+					rs_set(&taken, rr);
+			}
+		if(!ri->reachable || ri->deleted)
+			continue;
+		for(j = 0; j < ri->nro; ++j)
+		{
+			int d = ins[ri->ro[j].pos];
+			if(!(ri->ro[j].role & EEL_RO_DEF))
+				continue;
+			for(r = 0; r < 256; ++r)
+				if((r != d) && rs_test(&ri->live, r))
+				{
+					rs_set(&interference[d], r);
+					rs_set(&interference[r], d);
+				}
+			for(k = 0; k < ri->nro; ++k)
+			{
+				int r2 = ins[ri->ro[k].pos];
+				if(r2 == d)
+					continue;
+				if((ri->ro[k].role & EEL_RO_DEF) ||
+						!ro_may_alias(ins[0]))
+				{
+					rs_set(&interference[d], r2);
+					rs_set(&interference[r2], d);
+				}
+			}
+		}
+	}
+
+	/* Anything read before being written is left alone */
+	ro_live_in(ro, 0, &in);
+	for(r = 0; r < 256; ++r)
+		if(rs_test(&in, r) && rs_test(&temps, r))
+		{
+			rs_reset(&temps, r);
+			rs_set(&taken, r);
+		}
+
+	/* Assign the lowest registers that don't collide with anything */
+	for(r = 0; r < 256; ++r)
+	{
+		int nr;
+		map[r] = r;
+		if(!rs_test(&temps, r))
+			continue;
+		for(nr = 0; nr < r; ++nr)
+		{
+			if(rs_test(&taken, nr))
+				continue;
+			for(k = 0; k < r; ++k)
+				if(rs_test(&temps, k) && (map[k] == nr) &&
+						rs_test(&interference[r], k))
+					break;
+			if(k >= r)
+				break;
+		}
+		map[r] = nr;
+	}
+	free(interference);
+
+	for(i = 0; i < ro->ninstructions; ++i)
+	{
+		EEL_rinstruction *ri = &ro->ins[i];
+		unsigned char *ins = f->e.code + ri->pc;
+		for(j = 0; j < ri->nro; ++j)
+			if(ri->ro[j].count == 1)
+				ins[ri->ro[j].pos] = map[ins[ri->ro[j].pos]];
+	}
+}
+
+
+/*
+ * Remove deleted instructions from the code, and relocate branches, SWITCH
+ * jump tables and line number info accordingly.
+ */
+static int ro_compact(EEL_roptimizer *ro)
+{
+	EEL_function *f = ro->f;
+	int *map, i, j, pc, framesize;
+	map = (int *)malloc((f->e.codesize + 1) * sizeof(int));
+	if(!map)
+		return 0;
+
+	/* New positions */
+	for(i = 0, pc = 0; i < ro->ninstructions; ++i)
+	{
+		EEL_rinstruction *ri = &ro->ins[i];
+		map[ri->pc] = pc;
+		if(!ri->deleted)
+			pc += eel_i_size(f->e.code[ri->pc]);
+	}
+	map[f->e.codesize] = pc;
+
+	/* SWITCH jump tables are indexed by the old positions */
+	for(i = 0; i < ro->ninstructions; ++i)
+	{
+		EEL_rinstruction *ri = &ro->ins[i];
+		EEL_object *jt;
+		int len;
+		if(ri->deleted || (f->e.code[ri->pc] != EEL_OSWITCH_ABxsCx))
+			continue;
+		jt = ro_jumptable(ro, ri->pc);
+		len = o2EEL_table(jt)->length;
+		for(j = 0; j < len; ++j)
+		{
+			EEL_value *v = &eel_table_get_item(jt, j)->value;
+			v->integer.v = map[v->integer.v];
+		}
+	}
+
+	/* Move code and line info, and rewire branches */
+	framesize = 0;
+	for(i = 0, j = 0; i < ro->ninstructions; ++i)
+	{
+		EEL_rinstruction *ri = &ro->ins[i];
+		unsigned char *ins;
+		int k, size = eel_i_size(f->e.code[ri->pc]);
+		if(ri->deleted)
+			continue;
+		memmove(f->e.code + map[ri->pc], f->e.code + ri->pc, size);
+		f->e.lines[j++] = f->e.lines[i];
+		ins = f->e.code + map[ri->pc];
+		if(ri->target >= 0)
+		{
+			int offs = branch_offset(ins[0]);
+			int to = map[ro->ins[ri->target].pc] -
+					(map[ri->pc] + size);
+			ins[offs] = to & 0xff;
+			ins[offs + 1] = to >> 8;
+		}
+		for(k = 0; k < ri->nro; ++k)
+		{
+			int top = ins[ri->ro[k].pos] + ri->ro[k].count;
+			if(top > framesize)
+				framesize = top;
+		}
+	}
+	free(map);
+	f->e.codesize = pc;
+	f->e.nlines = j;
+	if(framesize < f->e.framesize)
+		f->e.framesize = framesize;
+	return 1;
+}
+
+
+void eel_optimize_function(EEL_coder *cdr)
+{
+	EEL_roptimizer ro;
+	int i, pass;
+	memset(&ro, 0, sizeof(ro));
+	ro.cdr = cdr;
+	ro.f = o2EEL_function(cdr->f);
+	if(!cdr->peephole || !ro.f->e.codesize ||
+			(ro.f->common.flags & EEL_FF_XBLOCK) ||
+			(cdr->state->context->sflags & EEL_SF_NOOPTIMIZE))
+		return;
+	if(!ro_decode(&ro))
+	{
+		free(ro.ins);
+		free(ro.index);
+		return;
+	}
+	ro_reachability(&ro);
+
+	/* Remove and fold instructions until nothing changes */
+	for(pass = 0; pass < 8; ++pass)
+	{
+		int changed = 0;
+		ro_liveness(&ro);
+		for(i = 0; i < ro.ninstructions; ++i)
+		{
+			int last;
+			if(!ro.ins[i].reachable || ro.ins[i].deleted)
+				continue;
+			if(ro_dead_store(&ro, i))
+			{
+				changed = 1;
+				continue;
+			}
+			last = ro_rewrite(&ro, i);
+			if(last >= 0)
+			{
+				i = last;
+				changed = 1;
+			}
+		}
+		if(!changed)
+			break;
+	}
+
+	ro_liveness(&ro);
+	ro_rename(&ro);
+
+#ifndef EEL_DEAD_CODE_ILLEGAL
+	/* Unreachable code */
+	for(i = 0; i < ro.ninstructions; ++i)
+		if(!ro.ins[i].reachable)
+			ro_delete(&ro, i);
+#endif
+	ro_compact(&ro);
+	free(ro.ins);
+	free(ro.index);
+	cdr->fragstart = ro.f->e.codesize;
+	cdr->fragline = ro.f->e.nlines;
+}
+
+#else /* EEL_LIVENESS_OPTIMIZER */
+
+void eel_optimize_function(EEL_coder *cdr)
+{
+}
+
+#endif /* EEL_LIVENESS_OPTIMIZER */
@@ -30,13 +30,20 @@ typedef enum EEL_optimizerflags
 {
 	/*
 	 * Disable substitutions that would eliminate register
-	 * initializations. (The optimizer isn't clever enough to analyze the
-	 * full fragment + register allocations for dependencies, so we need
-	 * to give it some hints for now.)
+	 * initializations. (The peephole optimizer doesn't know which
+	 * registers are live, so it needs some hints from the parser. Whatever
+	 * this blocks is picked up by eel_optimize_function() instead.)
 	 */
 	EEL_OPTIMIZE_KEEP_REGISTERS =		0x00000001
 } EEL_optimizerflags;
 
 void eel_optimize(EEL_coder *cdr, unsigned flags);
 
+/*
+ * Register liveness based optimization of a completed function. Removes dead
+ * and redundant instructions, and renumbers temporary registers to shrink the
+ * register frame.
+ */
+void eel_optimize_function(EEL_coder *cdr);
+
 #endif	/* EEL_EC_OPTIMIZER_H */
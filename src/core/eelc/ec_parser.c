@@ -27,6 +27,7 @@
 #include "ec_symtab.h"
 #include "ec_mlist.h"
 #include "ec_context.h"
+#include "ec_bytecode.h"
 #include "e_state.h"
 #include "e_class.h"
 #include "e_function.h"
@@ -384,7 +385,8 @@ static void forward_exports(EEL_object *from, EEL_object *to, int symcheck)
 /* Item handler for importlist */
 static void import_handler(EEL_state *es, int forward, int shared)
 {
-	EEL_object *m;
+	EEL_object *m, *in;
+	int res;
 	char *modname = strdup(es->lval.v.s.buf);
 	unsigned flags = es->context->sflags;
 	if(shared)
@@ -397,6 +399,20 @@ static void import_handler(EEL_state *es, int forward, int shared)
 		free(modname);
 		eel_cerror(es, "Couldn't import module \"%s\"!", mn);
 	}
+
+	/* Record the import, for saving precompiled modules */
+	in = eel_ps_new(es->vm, modname);
+	res = in ? eel_module_add_import(es->context->module, in, flags,
+			eel_bc_stamp(m)) : -1;
+	if(in)
+		eel_o_disown_nz(in);
+	if(res < 0)
+	{
+		free(modname);
+		eel_o_disown_nz(m);
+		eel_serror(es, "Could not record import!");
+	}
+
 	if(shared && (o2EEL_module(m)->flags & EEL_M_SHARED))
 	{
 		if(strcmp(modname, eel_module_modname(m)) != 0)
@@ -726,13 +742,34 @@ static EEL_symbol *declare_var(EEL_state *es, const char *name, EEL_varkinds kin
 }
 
 
+/*
+ * Forget the known values of all variables in scope, as far as constant
+ * propagation is concerned. This is needed wherever code may run in a
+ * different order than it is compiled in; that is, at the start of loops, and
+ * when functions that are not yet compiled, and thus have not reported their
+ * upvalue writes, may be called.
+ */
+static void forget_constants(EEL_state *es)
+{
+#ifdef EEL_CONSTANT_PROPAGATION
+	EEL_symbol *st, *s;
+	for(st = es->context->symtab; st; st = st->parent)
+		for(s = st->symbols; s; s = s->next)
+			if(EEL_SVARIABLE == s->type)
+				s->v.var.known = -1;
+#endif
+}
+
+
 /*
  * Explicitly declare variable 'var' as an upvalue for access without
  * warnings in the current function.
  */
 static EEL_symbol *declare_upvalue(EEL_state *es, EEL_symbol *var)
 {
-	EEL_symbol *s = eel_s_add(es, es->context->symtab,
+	EEL_symbol *s;
+	forget_constants(es);
+	s = eel_s_add(es, es->context->symtab,
 			o2EEL_string(var->name)->buffer, EEL_SUPVALUE);
 	if(!s)
 		eel_serror(es, "Could not create symbol for upvalue!");
@@ -1130,6 +1167,170 @@ static inline void call_indirect(EEL_state *es, EEL_manipulator *fnref,
 }
 
 
+#ifdef EEL_INLINE_FUNCTIONS
+/*
+ * Returns 1 if the arguments in 'args' map one to one to the arguments of the
+ * function, so that the call can be inlined.
+ */
+static int can_inline(EEL_mlist *args)
+{
+	int i;
+	for(i = 0; i < args->length; ++i)
+		switch(eel_ml_get(args, i)->kind)
+		{
+		  case EEL_MARGS:
+		  case EEL_MTUPARGS:
+			return 0;
+		  default:
+			break;
+		}
+	return 1;
+}
+
+
+/*
+ * Inline a call to function 's', adding the result to 'al'.
+ *
+ * There is no intermediate representation to transform here, so instead, we
+ * compile the 'return' expression of the function again, right here, in a
+ * scope where the argument names refer to the values passed by the caller.
+ * Constant arguments become named constants, so the expression is folded as
+ * far as possible, and arguments that are never read are not evaluated into
+ * registers at all, unless that could have side effects.
+ */
+static void inline_call(EEL_state *es, EEL_symbol *s, EEL_mlist *args,
+		EEL_mlist *al)
+{
+	EEL_coder *cdr = es->context->coder;
+	EEL_lval lval = es->lval;
+	int token = es->token;
+	EEL_qualifiers qualifiers = es->qualifiers;
+	EEL_lexitem ls[3];
+	EEL_symbol *scope, *a;
+	EEL_mlist *tmp, *ml;
+	EEL_manipulator *m;
+	int i, res;
+	int regs[32];
+	int nregs = 0;
+
+	/* Detach the lexer state of the call, so we can resume it later */
+	memcpy(ls, es->ls, sizeof(ls));
+	es->lval.type = ELVT_NONE;
+	for(i = 0; i < 3; ++i)
+	{
+		es->ls[i].lval.type = ELVT_NONE;
+		es->ls[i].token = TK_EOF;
+		es->ls[i].pos = -1;
+	}
+
+	/*
+	 * Set up a scope inside the function, so that names resolve the way
+	 * they did in there, but at the level of the caller. Warnings were
+	 * issued when the function was compiled, so don't repeat those.
+	 */
+	eel_context_push(es, ECTX_BLOCK | ECTX_CLONEBIO, NULL);
+	es->context->sflags |= EEL_SF_NOPRECEDENCE;
+	scope = eel_s_add(es, s, "__inline", EEL_SBODY);
+	if(!scope)
+		eel_ierror(es, "Could not create scope for inlined call!");
+	scope->uvlevel = es->context->previous->symtab->uvlevel;
+	es->context->symtab = scope;
+
+	/* Bind the arguments */
+	tmp = eel_ml_open(cdr);
+	for(a = s->symbols; a; a = a->next)
+	{
+		EEL_symbol *b;
+		int r = -1;
+		int used;
+		if((EEL_SVARIABLE != a->type) || (EVK_ARGUMENT != a->v.var.kind))
+			continue;
+		m = eel_ml_get(args, a->v.var.location);
+		used = s->inlineargs & (1 << a->v.var.location);
+		switch(m->kind)
+		{
+		  case EEL_MVARIABLE:
+			/* Check that it's initialized! */
+			r = eel_m_direct_read(m);
+			break;
+		  case EEL_MCONSTANT:
+		  case EEL_MSTATVAR:
+		  case EEL_MARGUMENT:
+		  case EEL_MOPTARG:
+			break;
+		  case EEL_MRESULT:
+		  case EEL_MREGISTER:
+			r = m->v.reg;
+			break;
+		  default:
+			/* Anything else may throw, so we have to evaluate it. */
+			used = 1;
+			break;
+		}
+		if(!used)
+			continue;
+		if(eel_m_is_known(m))
+		{
+			b = eel_s_add(es, scope, eel_o2s(a->name),
+					EEL_SCONSTANT);
+			if(!b)
+				eel_serror(es, "Could not bind inline argument!");
+			eel_m_get_known(m, &b->v.value);
+			continue;
+		}
+		if(r < 0)
+		{
+			r = eel_m_result(tmp);
+			eel_m_read(m, r);
+		}
+		b = eel_s_add(es, scope, eel_o2s(a->name), EEL_SVARIABLE);
+		if(!b)
+			eel_serror(es, "Could not bind inline argument!");
+		b->v.var.kind = EVK_STACK;
+		b->v.var.location = r;
+		if(es->context->firstel->events[r] != EEL_EYES)
+		{
+			es->context->firstel->events[r] = EEL_EYES;
+			regs[nregs++] = r;
+		}
+	}
+
+	/* Compile the expression */
+	eel_bio_seek_set(es->context->bio, s->inlinepos);
+	eel_lex(es, 0);
+	ml = eel_ml_open(cdr);
+	res = expression(es, ml, 1);
+	if((res == TK_WRONG) || (res == TK_VOID) || (ml->length != 1) ||
+			(es->token != ';'))
+		eel_ierror(es, "Inlined expression of function '%s' did not "
+				"compile!", eel_o2s(s->name));
+	m = eel_ml_get(ml, 0);
+	if(eel_m_is_constant(m))
+	{
+		EEL_value v;
+		eel_m_get_constant(m, &v);
+		eel_m_constant(al, &v);
+		eel_v_disown_nz(&v);
+	}
+	else
+		eel_m_read(m, eel_m_result(al));
+
+	/* Clean up, and resume parsing after the call */
+	eel_ml_close(ml);
+	eel_ml_close(tmp);
+	for(i = 0; i < nregs; ++i)
+		es->context->firstel->events[regs[i]] = EEL_ENO;
+	eel_s_free(es, scope);
+	eel_context_pop(es);
+	eel_lexer_invalidate(es);
+	es->lval = lval;
+	es->token = token;
+	es->qualifiers = qualifiers;
+	memcpy(es->ls, ls, sizeof(ls));
+}
+#endif
+
+
 /*
 	call:
 		  FUNCTION
@@ -1137,7 +1338,7 @@ static inline void call_indirect(EEL_state *es, EEL_manipulator *fnref,
 		| FUNCTION '(' explist ')'
 		;
  */
-static int call(EEL_state *es, EEL_mlist *al)
+static int call(EEL_state *es, EEL_mlist *al, int wantresult)
 {
 	EEL_coder *cdr = es->context->coder;
 	EEL_object *fo;
@@ -1164,11 +1365,11 @@ static int call(EEL_state *es, EEL_mlist *al)
 	printf("%d optional arguments and ", f->common.optargs);
 	printf("%d tuple arguments.\n", f->common.tupargs);
     })
-	/* Find/add a constant for that function */
+	/* A function that is only declared may write anything in scope! */
+	if(f->common.flags & EEL_FF_DECLARATION)
+		forget_constants(es);
 	fnref.classid = EEL_COBJREF;
 	fnref.objref.v = fo;
-	fnconst = eel_coder_add_constant(cdr, &fnref);
-	DBGG(printf("=== func const in C[%d]\n", fnconst);)
 	eel_lex(es, 0);
 
 	no_qualifiers(es);
@@ -1212,8 +1413,38 @@ static int call(EEL_state *es, EEL_mlist *al)
 		eel_cerror(es, "Too many arguments to function '%s'!",
 				eel_o2s(s->name));
 
+	if(es->token != ')')
+		eel_cerror(es, "Expected ')' after arguments, or ',' "
+				"followed by more arguments!");
+	eel_lex(es, 0);
+
+	/*
+	 * Unless the call is a statement of its own, we need the result,
+	 * even if it's not wanted by the caller. If the result is ignored,
+	 * we use CCALL, so the callee knows it need not provide one.
+	 */
+	if(es->token != ';')
+		wantresult = 1;
+
+#ifdef EEL_INLINE_FUNCTIONS
+	if(wantresult && s->inlinepos &&
+			(f->common.module == es->context->module) &&
+			!(es->context->sflags & EEL_SF_NOOPTIMIZE) &&
+			can_inline(args))
+	{
+		inline_call(es, s, args, al);
+		eel_ml_close(args);
+		DBGE(printf("=== end inlined call ===============================\n");)
+		return TK(SIMPLEXP);
+	}
+#endif
+
+	/* Find/add a constant for that function */
+	fnconst = eel_coder_add_constant(cdr, &fnref);
+	DBGG(printf("=== func const in C[%d]\n", fnconst);)
+
 	/* Prepare result and arguments */
-	if(f->common.results)
+	if(f->common.results && wantresult)
 		result = eel_m_result(al);
 	else
 		result = -1;
@@ -1235,11 +1466,6 @@ static int call(EEL_state *es, EEL_mlist *al)
 	/* Cleanup */
 	eel_ml_close(args);
 
-	if(es->token != ')')
-		eel_cerror(es, "Expected ')' after arguments, or ',' "
-				"followed by more arguments!");
-	eel_lex(es, 0);
-
 	DBGE(printf("=== end function call ==============================\n");)
 	if(result)
 		return TK(SIMPLEXP);
@@ -1360,6 +1586,84 @@ static void funcargs(EEL_state *es)
 		;
  */
 
+#ifdef EEL_INLINE_FUNCTIONS
+/*
+ * If the function just compiled does nothing but return an expression that
+ * only reads arguments and constants, mark it for inlining. (Anything else,
+ * such as calls, upvalues or control flow, is left to the VM.)
+ */
+static void check_inline(EEL_state *es)
+{
+	EEL_coder *cdr = es->context->coder;
+	EEL_function *f = o2EEL_function(cdr->f);
+	unsigned args = 0;
+	int pc, returned = 0;
+	if(!cdr->inlinepos || (f->common.flags & EEL_FF_UPVALUES) ||
+			f->common.optargs || f->common.tupargs ||
+			(f->common.reqargs > 32))
+		return;
+	for(pc = 0; pc < f->e.codesize; pc += eel_i_size(f->e.code[pc]))
+	{
+		unsigned char *ins = f->e.code + pc;
+		if(returned)
+			switch(ins[0])
+			{
+			  case EEL_ORETURN_0:
+			  case EEL_OILLEGAL_0:
+			  case EEL_ONOP_0:
+				continue;
+			  default:
+				return;
+			}
+		switch(eel_i_generic(ins[0]))
+		{
+		  case EEL_OGETARGI_AB:
+			args |= 1 << ins[2];
+			break;
+		  case EEL_ORETURNR_A:
+			returned = 1;
+			break;
+		  case EEL_OLDI_AsBx:
+		  case EEL_OLDTRUE_A:
+		  case EEL_OLDFALSE_A:
+		  case EEL_OLDNIL_A:
+		  case EEL_OLDC_ABx:
+		  case EEL_OMOVE_AB:
+		  case EEL_OINDGETI_ABC:
+		  case EEL_OINDGET_ABC:
+		  case EEL_OINDGETC_ABCxDx:
+		  case EEL_OBOP_ABCD:
+		  case EEL_OBOPI_ABCsDx:
+		  case EEL_OBOPC_ABCDx:
+		  case EEL_ONEG_AB:
+		  case EEL_OBNOT_AB:
+		  case EEL_ONOT_AB:
+		  case EEL_OCASTR_AB:
+		  case EEL_OCASTI_AB:
+		  case EEL_OCASTB_AB:
+		  case EEL_OCAST_ABC:
+		  case EEL_OTYPEOF_AB:
+		  case EEL_OSIZEOF_AB:
+		  case EEL_OADD_ABC:
+		  case EEL_OSUB_ABC:
+		  case EEL_OMUL_ABC:
+		  case EEL_ODIV_ABC:
+		  case EEL_OMOD_ABC:
+		  case EEL_OPOWER_ABC:
+		  case EEL_OVEXPR_ABCx:
+			break;
+		  default:
+			return;
+		}
+	}
+	if(!returned)
+		return;
+	es->context->symtab->inlinepos = cdr->inlinepos;
+	es->context->symtab->inlineargs = args;
+}
+#endif
+
+
 static void funcdef2(EEL_state *es, EEL_mlist *al, int is_func, int local)
 {
 	EEL_function decl;
@@ -1509,6 +1813,10 @@ static void funcdef2(EEL_state *es, EEL_mlist *al, int is_func, int local)
 	  default:
 		/* Leave and finalize function */
 		procreturn(es);
+		eel_optimize_function(es->context->coder);
+#ifdef EEL_INLINE_FUNCTIONS
+		check_inline(es);
+#endif
 		break;
 	}
 }
@@ -2288,7 +2596,7 @@ static int simplexp2(EEL_state *es, EEL_mlist *al, int wantresult)
 	}
 
 	/* call */
-	switch(call(es, al))
+	switch(call(es, al, wantresult))
 	{
 	  case TK_WRONG:
 		break;
@@ -3425,6 +3733,7 @@ static int whilestat(EEL_state *es)
 
 	/* Grab the loop start point! */
 	loop_start = eel_code_target(cdr);
+	forget_constants(es);
 
 	/* Expression and conditional jump */
 	expr = eel_ml_open(cdr);
@@ -3521,6 +3830,8 @@ static int dostat(EEL_state *es)
 
 	/* Grab the loop start point! */
 	loop_start = eel_code_target(cdr);
+	forget_constants(es);
+
 	/* Loop body */
 	switch(statement(es, ECTX_CONDITIONAL | ECTX_BREAKABLE |
 			ECTX_CONTINUABLE | ECTX_KEEP))
@@ -3666,6 +3977,7 @@ static int forstat(EEL_state *es)
 
 	/* Grab the loop start point! */
 	loopstart = eel_code_target(cdr);
+	forget_constants(es);
 
 	/* Loop body */
 	switch(statement(es, ECTX_CONDITIONAL | ECTX_BREAKABLE |
@@ -3838,12 +4150,22 @@ static int returnstat(EEL_state *es)
 	EEL_coder *cdr = es->context->coder;
 	EEL_function *f = o2EEL_function(cdr->f);
 	int flags = f->common.flags;
+	int inlinepos = 0;
+	int nsymbols = es->context->symtab->nsymbols;
 	if(TK_KW_RETURN != es->token)
 		return TK(WRONG);
 
 	DBGH(printf("## statement: RETURN\n");)
 	eel_lex(es, 0);
 
+	/*
+	 * A function that starts by returning an expression may be suitable
+	 * for inlining. check_inline() makes the final decision.
+	 */
+	if((es->context->type == ECTX_FUNCTION) && !f->e.codesize &&
+			!(flags & EEL_FF_XBLOCK))
+		inlinepos = eel_lex_getpos(es, 1);
+
 	/*
 	 * Initialization state MUST be certain at this
 	 * point, or the RET* instruction may blow up!
@@ -3881,6 +4203,8 @@ static int returnstat(EEL_state *es)
 			eel_codeA(cdr, EEL_ORETXR_A, r);
 		else
 			eel_codeA(cdr, EEL_ORETURNR_A, r);
+		if(es->context->symtab->nsymbols == nsymbols)
+			cdr->inlinepos = inlinepos;
 		eel_e_result(es);
 		eel_e_return(es);
 		expect(es, ';', "Expected ';' after 'return' statement!");
@@ -4404,6 +4728,7 @@ static void compile2(EEL_state *es, EEL_object *mo, EEL_sflags sflags)
 		/* Apply the name for shared import-by-name */
 		eel_s_rename(es, es->context->symtab, es->lval.v.s.buf);
 		eel_table_setss(m->exports, "__modname", es->lval.v.s.buf);
+		m->flags |= EEL_M_NAMED;
 
 		eel_lex(es, 0);
 		expect(es, ';', "Missing ';' after module declaration!");
@@ -4502,7 +4827,15 @@ void eel_compile(EEL_state *es, EEL_object *mo, EEL_sflags sflags)
 /* FIXME: 'x' might be clobbered by setjmp()/longjmp()... */
 	x = 0;
 	eel_try(es)
-		compile2(es, mo, sflags);
+	{
+		if(eel_bc_check(m->source, m->len))
+			eel_bc_load(es, mo, m->source, m->len, sflags);
+		else if(!eel_bc_cache_load(es, mo, sflags))
+		{
+			compile2(es, mo, sflags);
+			eel_bc_cache_save(es, mo, sflags);
+		}
+	}
 	eel_except
 		x = 1;
 
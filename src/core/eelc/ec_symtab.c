@@ -36,6 +36,87 @@
 EEL_DLLIST(eel_s_, EEL_symbol, symbols, lastsym, EEL_symbol, prev, next);
 
 
+/*------------------------------------------------
+	Name index
+------------------------------------------------*/
+
+static inline EEL_symbol **s_bucket(EEL_symbol *st, EEL_object *name)
+{
+	return &st->index[o2EEL_string(name)->hash & (st->indexsize - 1)];
+}
+
+
+/*
+ * (Re)build the name index of 'st', with at least one bucket per symbol. If
+ * there isn't enough memory, the table is just left unindexed.
+ */
+static void s_index_build(EEL_state *es, EEL_symbol *st)
+{
+	EEL_symbol *s;
+	int size = EEL_SYMTAB_INDEXMIN;
+	while(size < st->nsymbols)
+		size <<= 1;
+	eel_free(es->vm, st->index);
+	st->index = (EEL_symbol **)eel_malloc(es->vm,
+			size * sizeof(EEL_symbol *));
+	if(!st->index)
+	{
+		st->indexsize = 0;
+		return;
+	}
+	memset(st->index, 0, size * sizeof(EEL_symbol *));
+	st->indexsize = size;
+
+	/* Backwards, so that the bucket chains end up in list order */
+	for(s = st->lastsym; s; s = s->prev)
+		if(s->name)
+		{
+			EEL_symbol **b = s_bucket(st, s->name);
+			s->inext = *b;
+			*b = s;
+		}
+}
+
+
+/* Add 's', which must be the last symbol of 'st', to the index. */
+static void s_index_add(EEL_state *es, EEL_symbol *st, EEL_symbol *s)
+{
+	EEL_symbol **b;
+	if(!st->index)
+	{
+		if(st->nsymbols >= EEL_SYMTAB_INDEXMIN)
+			s_index_build(es, st);
+		return;
+	}
+	if(st->nsymbols > st->indexsize)
+	{
+		s_index_build(es, st);
+		return;
+	}
+	if(!s->name)
+		return;
+	b = s_bucket(st, s->name);
+	while(*b)
+		b = &(*b)->inext;
+	s->inext = NULL;
+	*b = s;
+}
+
+
+static void s_index_remove(EEL_symbol *st, EEL_symbol *s)
+{
+	EEL_symbol **b;
+	if(!st->index || !s->name)
+		return;
+	for(b = s_bucket(st, s->name); *b; b = &(*b)->inext)
+		if(*b == s)
+		{
+			*b = s->inext;
+			break;
+		}
+}
+
+
 /*------------------------------------------------
 	Symbol
 ------------------------------------------------*/
@@ -44,7 +125,11 @@ void eel_s_free(EEL_state *es, EEL_symbol *s)
 {
 	/* Unlink */
 	if(s->parent)
+	{
+		s_index_remove(s->parent, s);
+		--s->parent->nsymbols;
 		eel_s_unlink(s->parent, s);
+	}
 
 	/* Cleanup */
 	while(s->symbols)
@@ -73,6 +158,7 @@ void eel_s_free(EEL_state *es, EEL_symbol *s)
 	}
 	if(s->name)
 		eel_o_disown_nz(s->name);
+	eel_free(es->vm, s->index);
 
 	/* Destroy */
 	eel_free(es->vm, s);
@@ -81,12 +167,18 @@ void eel_s_free(EEL_state *es, EEL_symbol *s)
 
 void eel_s_rename(EEL_state *es, EEL_symbol *s, const char *name)
 {
+	if(s->parent)
+		s_index_remove(s->parent, s);
 	if(s->name)
 		eel_o_disown_nz(s->name);
 	s->name = eel_ps_new(es->vm, name);
 	if(!s->name)
 		eel_serror(es, "Could not rename symbol!"
 				" (Failed to create new EEL_string.)");
+
+	/* The symbol may not be last in the list, so reindex the lot */
+	if(s->parent && s->parent->index)
+		s_index_build(es, s->parent);
 }
 
 
@@ -108,6 +200,8 @@ EEL_symbol *eel_s_add(EEL_state *es, EEL_symbol *parent,
 	if(parent)
 	{
 		eel_s_link(parent, sym);
+		++parent->nsymbols;
+		s_index_add(es, parent, sym);
 		sym->uvlevel = parent->uvlevel;
 	}
 	if(EEL_SFUNCTION == type)
@@ -119,16 +213,20 @@ EEL_symbol *eel_s_add(EEL_state *es, EEL_symbol *parent,
 EEL_symbol *eel_s_find(EEL_state *es, EEL_symbol *table,
 		const char *name, EEL_symtypes type)
 {
-	EEL_symbol *sym = table->symbols;
+	EEL_symbol *sym;
 	EEL_object *no = eel_ps_new(es->vm, name);
 	if(!no)
 		eel_serror(es, "Could not get name object!");
-	while(sym)
+	if(table->index)
 	{
-		if((sym->type == type) && (sym->name == no))
-			break;
-		sym = sym->next;
+		for(sym = *s_bucket(table, no); sym; sym = sym->inext)
+			if((sym->type == type) && (sym->name == no))
+				break;
 	}
+	else
+		for(sym = table->symbols; sym; sym = sym->next)
+			if((sym->type == type) && (sym->name == no))
+				break;
 	eel_o_disown_nz(no);
 	return sym;
 }
@@ -146,9 +244,19 @@ void eel_finder_init(EEL_state *es, EEL_finder *f, EEL_symbol *st, int flags)
 }
 
 
+static inline int finder_match(EEL_finder *f, EEL_symbol *s)
+{
+	if(s->name != f->name)
+		return 0;
+	return !(f->flags & ESTF_TYPES) || ((1 << s->type) & f->types);
+}
+
+
 EEL_symbol *eel_finder_go(EEL_finder *f)
 {
 	EEL_symbol *hit = NULL;
+	int indexed = (f->flags & ESTF_NAME) && f->name &&
+			!(f->flags & ESTF_DOWN);
 	if(!f->symtab)
 		return NULL;
 	DBG3(printf("Searching for '%s' in '%s'...\n",
@@ -157,7 +265,22 @@ EEL_symbol *eel_finder_go(EEL_finder *f)
 			"<unnamed symbol table>");)
 	while(!hit)
 	{
-		if(f->symbol)
+		if(indexed && f->symtab->index)
+		{
+			/* Only check the symbols in the right bucket */
+			if(f->symbol)
+				f->symbol = f->symbol->inext;
+			else
+				f->symbol = *s_bucket(f->symtab, f->name);
+			while(f->symbol && !finder_match(f, f->symbol))
+				f->symbol = f->symbol->inext;
+			if(f->symbol)
+			{
+				hit = f->symbol;
+				break;
+			}
+		}
+		else if(f->symbol)
 			f->symbol = f->symbol->next;	/* Next */
 		else
 			f->symbol = f->symtab->symbols; /* First */
@@ -280,6 +403,7 @@ static int get_export(EEL_symbol *st, EEL_object *n, EEL_value *v,
 		eel_v_copy(&s->v.value, v);
 		break;
 	}
+	s_index_add(es, st, s);		/* Named after eel_s_add()! */
 	DBGX2(printf("Imported \"%s\" from module \"%s\" (\"%s\").\n",
 			eel_o2s(n), eel_module_modname(m),
 			eel_module_filename(m));)
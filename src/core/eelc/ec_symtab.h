@@ -204,6 +204,22 @@ struct EEL_symbol
 	int		uvlevel;	/* Function nesting level */
 	EEL_symbol	*symbols;	/* Linked list of children */
 	EEL_symbol	*lastsym;	/* Last symbol (for adding) */
+	int		nsymbols;	/* Number of children */
+
+	/*
+	 * Name index of children, or NULL. Bucket chains are kept in list
+	 * order, so the first match is the same as for a linear search.
+	 */
+	EEL_symbol	**index;	/* Hash buckets */
+	int		indexsize;	/* Number of buckets (power of two) */
+	EEL_symbol	*inext;		/* Next in bucket of parent index */
+
+	/*
+	 * FUNCTION: Source position of the 'return' expression of a function
+	 * that can be inlined, or 0, and a mask of the arguments it reads.
+	 */
+	int		inlinepos;
+	unsigned	inlineargs;
 	union
 	{
 		/* KEYWORD */
@@ -218,6 +234,12 @@ struct EEL_symbol
 			EEL_varkinds	kind;
 			int		location;	/* Heap/stack/... */
 			int		defindex;	/* Constant index */
+			/*
+			 * Constant propagation: 1 if 'value' is the current
+			 * value of the variable, -1 if it can't be known.
+			 */
+			int		known;
+			EEL_value	value;
 		} var;
 
 		/* CONSTANT */
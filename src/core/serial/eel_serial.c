@@ -0,0 +1,1234 @@
+/*
+---------------------------------------------------------------------------
+	eel_serial.c - EEL Serialization Module
+---------------------------------------------------------------------------
+ * Copyright 2026 David Olofson
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from the
+ * use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "eel_serial.h"
+#include "eel_io.h"
+#include "e_object.h"
+#include "e_string.h"
+#include "e_dstring.h"
+#include "e_table.h"
+#include "e_array.h"
+#include "e_vector.h"
+#include "e_util.h"
+#include "e_operate.h"
+
+typedef struct
+{
+	/* Class Type IDs */
+	int serializer_cid;
+} ES_moduledata;
+
+/*
+ * Binary format type IDs.
+ *
+ *	CHANGING THESE BREAKS OLD FILES!!!
+ *	(Adding new ones is safe in one direction, obviously.)
+ */
+typedef enum
+{
+	ES_BIN_UNKNOWN = 0,
+	ES_BIN_NIL,
+	ES_BIN_INTEGER,
+	ES_BIN_REAL,
+	ES_BIN_BOOLEANT,	/* True */
+	ES_BIN_BOOLEANF,	/* False */
+	ES_BIN_STRING,
+	ES_BIN_DSTRING,
+	ES_BIN_TABLE,
+	ES_BIN_ARRAY,
+	ES_BIN_VECTOR_D,
+	ES_BIN_VECTOR_U32,
+	ES_BIN_VECTOR_S32
+} ES_bintypes;
+
+/* Parts of a container item, for the serializer state machine */
+typedef enum
+{
+	ES_PH_BEGIN = 0,	/* Item prefix, then key or value */
+	ES_PH_VALUE,		/* (Tables) Separator, then value */
+	ES_PH_END		/* Item suffix */
+} ES_phases;
+
+/* Deserializer recursion limit */
+#define	ES_MAXDEPTH	4096
+
+
+static int es_getformat(EEL_value *v)
+{
+	const char *s = eel_v2s(v);
+	if(!s)
+		return -1;
+	if(!strcmp(s, "eel"))
+		return EEL_SFMT_EEL;
+	else if(!strcmp(s, "json"))
+		return EEL_SFMT_JSON;
+	else if(!strcmp(s, "bin"))
+		return EEL_SFMT_BIN;
+	return -1;
+}
+
+
+/*----------------------------------------------------------
+	Output
+----------------------------------------------------------*/
+
+/*
+ * Output is written straight into a dstring; either the result of
+ * serialize(), or the buffer of a memfile, at the current position.
+ */
+typedef struct
+{
+	EEL_object	*buffer;	/* (dstring) */
+	int		position;
+	int		count;		/* Bytes written so far */
+} ES_sink;
+
+static inline EEL_xno es_write(ES_sink *k, const char *s, int len)
+{
+	EEL_xno x = eel_ds_write(k->buffer, k->position, s, len);
+	if(x)
+		return x;
+	k->position += len;
+	k->count += len;
+	return 0;
+}
+
+static inline EEL_xno es_text(ES_sink *k, const char *s)
+{
+	return es_write(k, s, strlen(s));
+}
+
+static EEL_xno es_indent(ES_sink *k, int n)
+{
+	static const char tabs[] = "\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t";
+	while(n > 0)
+	{
+		int len = n < 16 ? n : 16;
+		EEL_xno x = es_write(k, tabs, len);
+		if(x)
+			return x;
+		n -= len;
+	}
+	return 0;
+}
+
+static inline EEL_xno es_integer(ES_sink *k, EEL_int32 v)
+{
+	char buf[24];
+	int len = snprintf(buf, sizeof(buf), "%d", v);
+	return es_write(k, buf, len);
+}
+
+static inline EEL_xno es_real(ES_sink *k, EEL_real v)
+{
+	char buf[64];
+	int len = snprintf(buf, sizeof(buf), EEL_REAL_FMT, v);
+	if(len >= sizeof(buf))
+		return EEL_XOVERFLOW;
+	return es_write(k, buf, len);
+}
+
+static inline EEL_xno es_u8(ES_sink *k, unsigned v)
+{
+	char c = v;
+	return es_write(k, &c, 1);
+}
+
+static inline EEL_xno es_be32(ES_sink *k, EEL_uint32 v)
+{
+	char b[4];
+	b[0] = v >> 24;
+	b[1] = v >> 16;
+	b[2] = v >> 8;
+	b[3] = v;
+	return es_write(k, b, 4);
+}
+
+static inline EEL_xno es_be64real(ES_sink *k, EEL_real v)
+{
+	union {
+		EEL_real	r;
+		unsigned char	c[sizeof(EEL_real)];
+	} cvt;
+	char b[sizeof(EEL_real)];
+	int n;
+	cvt.r = v;
+#if EEL_BYTEORDER == EEL_BIG_ENDIAN
+	for(n = 0; n < sizeof(EEL_real); ++n)
+		b[n] = cvt.c[n];
+#else
+	for(n = 0; n < sizeof(EEL_real); ++n)
+		b[n] = cvt.c[sizeof(EEL_real) - 1 - n];
+#endif
+	return es_write(k, b, sizeof(EEL_real));
+}
+
+/*
+ * Write quoted string. Escapes are the same as those of quote() in
+ * strings.eel, with or without STRINGS_JSONESCAPES.
+ */
+static EEL_xno es_quoted(ES_sink *k, const char *s, int len, int json)
+{
+	char buf[256];
+	int i, n = 0;
+	EEL_xno x;
+	buf[n++] = '"';
+	for(i = 0; i < len; ++i)
+	{
+		unsigned char c = s[i];
+		const char *e = NULL;
+		if(n > sizeof(buf) - 8)
+		{
+			if((x = es_write(k, buf, n)))
+				return x;
+			n = 0;
+		}
+		switch(c)
+		{
+		  case '\\':	e = "\\\\"; break;
+		  case '\a':	e = json ? "\\u0007" : "\\a"; break;
+		  case '\b':	e = "\\b"; break;
+		  case '\f':	e = "\\f"; break;
+		  case '\n':	e = "\\n"; break;
+		  case '\r':	e = "\\r"; break;
+		  case '\t':	e = "\\t"; break;
+		  case '\v':	e = json ? "\\u000B" : "\\v"; break;
+		  case '"':	e = "\\\""; break;
+		  case '\'':	e = json ? "'" : "\\'"; break;
+		  default:
+			if((c < 32) || (c > 126))
+				n += sprintf(buf + n, json ? "\\u%04X" :
+						"\\%03o", c);
+			else
+				buf[n++] = c;
+			continue;
+		}
+		while(*e)
+			buf[n++] = *e++;
+	}
+	buf[n++] = '"';
+	return es_write(k, buf, n);
+}
+
+
+/*----------------------------------------------------------
+	Serializer
+----------------------------------------------------------*/
+
+static EEL_xno es_push(EEL_vm *vm, EEL_serializer *s, EEL_object *o,
+		int items)
+{
+	EEL_serialframe *f;
+	if(s->depth >= s->maxdepth)
+	{
+		int n = s->maxdepth ? s->maxdepth * 2 : 16;
+		EEL_serialframe *ns = (EEL_serialframe *)eel_realloc(vm,
+				s->stack, n * sizeof(EEL_serialframe));
+		if(!ns)
+			return EEL_XMEMORY;
+		s->stack = ns;
+		s->maxdepth = n;
+	}
+	f = s->stack + s->depth++;
+	f->o = o;
+	f->items = items;
+	f->item = 0;
+	f->phase = ES_PH_BEGIN;
+	eel_o_own(o);
+	return 0;
+}
+
+static void es_pop(EEL_serializer *s)
+{
+	--s->depth;
+	eel_o_disown_nz(s->stack[s->depth].o);
+}
+
+/* Drop the stack, including any references held by it. */
+static void es_cleanup(EEL_vm *vm, EEL_serializer *s)
+{
+	while(s->depth)
+		es_pop(s);
+	eel_free(vm, s->stack);
+	s->stack = NULL;
+	s->maxdepth = 0;
+}
+
+
+/*
+ * Write a value. Scalars are written right away, whereas containers are
+ * opened and pushed onto the stack, to be handled by es_step().
+ */
+static EEL_xno es_value(EEL_vm *vm, EEL_serializer *s, ES_sink *k,
+		EEL_value *v)
+{
+	EEL_xno x;
+	EEL_classes cid = EEL_CLASS(v);
+	int bin = (s->format == EEL_SFMT_BIN);
+	int ns = (s->flags & EEL_SERIALIZE_NO_SHORTHAND);
+	switch(cid)
+	{
+	  case EEL_CNIL:
+		if(bin)
+			return es_u8(k, ES_BIN_NIL);
+		return es_text(k, s->format == EEL_SFMT_JSON ? "null" : "nil");
+	  case EEL_CINTEGER:
+		if(!bin)
+			return es_integer(k, v->integer.v);
+		if((x = es_u8(k, ES_BIN_INTEGER)))
+			return x;
+		return es_be32(k, v->integer.v);
+	  case EEL_CREAL:
+		if(!bin)
+			return es_real(k, v->real.v);
+		if((x = es_u8(k, ES_BIN_REAL)))
+			return x;
+		return es_be64real(k, v->real.v);
+	  case EEL_CBOOLEAN:
+		if(bin)
+			return es_u8(k, v->integer.v ? ES_BIN_BOOLEANT :
+					ES_BIN_BOOLEANF);
+		return es_text(k, v->integer.v ? "true" : "false");
+	  case EEL_CSTRING:
+	  case EEL_CDSTRING:
+	  {
+		const char *buf;
+		int len;
+		if(cid == EEL_CSTRING)
+		{
+			EEL_string *str = o2EEL_string(v->objref.v);
+			buf = str->buffer;
+			len = str->length;
+		}
+		else
+		{
+			EEL_dstring *ds = o2EEL_dstring(v->objref.v);
+			buf = ds->buffer;
+			len = ds->length;
+		}
+		if(!bin)
+			return es_quoted(k, buf, len,
+					s->format == EEL_SFMT_JSON);
+		if((x = es_u8(k, cid == EEL_CSTRING ? ES_BIN_STRING :
+				ES_BIN_DSTRING)))
+			return x;
+		if((x = es_be32(k, len)))
+			return x;
+		return es_write(k, buf, len);
+	  }
+	  case EEL_CTABLE:
+	  {
+		int n = o2EEL_table(v->objref.v)->length;
+		if(bin)
+		{
+			if((x = es_u8(k, ES_BIN_TABLE)) || (x = es_be32(k, n)))
+				return x;
+		}
+		else if((x = es_text(k, ns && (s->format == EEL_SFMT_EEL) ?
+				"table [\n" : "{\n")))
+			return x;
+		return es_push(vm, s, v->objref.v, n);
+	  }
+	  case EEL_CARRAY:
+	  {
+		int n = o2EEL_array(v->objref.v)->length;
+		if(bin)
+		{
+			if((x = es_u8(k, ES_BIN_ARRAY)) || (x = es_be32(k, n)))
+				return x;
+		}
+		else if((x = es_text(k, ns && (s->format == EEL_SFMT_EEL) ?
+				"array [\n" : "[\n")))
+			return x;
+		return es_push(vm, s, v->objref.v, n);
+	  }
+	  case EEL_CVECTOR_D:
+	  case EEL_CVECTOR_U32:
+	  case EEL_CVECTOR_S32:
+	  {
+		int n = o2EEL_vector(v->objref.v)->length;
+		if(s->format == EEL_SFMT_JSON)
+			break;
+		if(bin)
+		{
+			if((x = es_u8(k, cid == EEL_CVECTOR_D ? ES_BIN_VECTOR_D :
+					cid == EEL_CVECTOR_U32 ?
+					ES_BIN_VECTOR_U32 : ES_BIN_VECTOR_S32)))
+				return x;
+			if((x = es_be32(k, n)))
+				return x;
+		}
+		else if((x = es_text(k, cid == EEL_CVECTOR_D ? "vector [" :
+				cid == EEL_CVECTOR_U32 ? "vector_u32 [" :
+				"vector_s32 [")))
+			return x;
+		return es_push(vm, s, v->objref.v, n);
+	  }
+	  default:
+		break;
+	}
+	if(s->flags & EEL_SERIALIZE_DROP_UNKNOWN)
+		return 0;
+	return EEL_XWRONGTYPE;
+}
+
+
+/* Close the container at the top of the stack. */
+static EEL_xno es_close(EEL_serializer *s, ES_sink *k)
+{
+	EEL_xno x;
+	EEL_serialframe *f = s->stack + s->depth - 1;
+	if(s->format != EEL_SFMT_BIN)
+		switch(f->o->classid)
+		{
+		  case EEL_CTABLE:
+			if((x = es_indent(k, s->depth - 1)))
+				return x;
+			if((x = es_text(k, (s->flags &
+					EEL_SERIALIZE_NO_SHORTHAND) &&
+					(s->format == EEL_SFMT_EEL) ?
+					"]" : "}")))
+				return x;
+			break;
+		  case EEL_CARRAY:
+			if((x = es_indent(k, s->depth - 1)))
+				return x;
+			/* Fall through */
+		  default:
+			if((x = es_text(k, "]")))
+				return x;
+			break;
+		}
+	es_pop(s);
+	return 0;
+}
+
+
+/* Write the next part of the container at the top of the stack. */
+static EEL_xno es_step(EEL_vm *vm, EEL_serializer *s, ES_sink *k)
+{
+	EEL_xno x;
+	EEL_serialframe *f = s->stack + s->depth - 1;
+	int bin = (s->format == EEL_SFMT_BIN);
+	int last = (f->item == f->items - 1);
+	if(f->item >= f->items)
+		return es_close(s, k);
+	if(f->item >= eel_length(f->o))
+		return EEL_XHIGHINDEX;	/* Modified while serializing! */
+
+	switch(f->o->classid)
+	{
+	  case EEL_CTABLE:
+	  {
+		EEL_tableitem *ti = o2EEL_table(f->o)->items + f->item;
+		switch(f->phase)
+		{
+		  case ES_PH_BEGIN:
+			f->phase = ES_PH_VALUE;
+			if(bin)
+				return es_value(vm, s, k, &ti->key);
+			if((x = es_indent(k, s->depth)))
+				return x;
+			if(s->format == EEL_SFMT_JSON)
+			{
+				switch(EEL_CLASS(&ti->key))
+				{
+				  case EEL_CSTRING:
+				  case EEL_CDSTRING:
+					break;
+				  default:
+					/* JSON object fields are strings! */
+					return EEL_XWRONGTYPE;
+				}
+			}
+			else if((x = es_text(k, "(")))
+				return x;
+			/* NOTE: 'f' and 'ti' may be invalid after this! */
+			return es_value(vm, s, k, &ti->key);
+		  case ES_PH_VALUE:
+			f->phase = ES_PH_END;
+			if(!bin && (x = es_text(k, s->format == EEL_SFMT_JSON ?
+					": " : ", ")))
+				return x;
+			return es_value(vm, s, k, &ti->value);
+		  default:
+			if(s->format == EEL_SFMT_EEL)
+				if((x = es_text(k, ")")))
+					return x;
+			break;
+		}
+		break;
+	  }
+	  case EEL_CARRAY:
+		if(f->phase == ES_PH_BEGIN)
+		{
+			f->phase = ES_PH_END;
+			if(!bin && (x = es_indent(k, s->depth)))
+				return x;
+			return es_value(vm, s, k,
+					o2EEL_array(f->o)->values + f->item);
+		}
+		break;
+	  default:
+	  {
+		/* Vectors; one item per step */
+		EEL_vector *vec = o2EEL_vector(f->o);
+		int i = f->item++;
+		switch(f->o->classid)
+		{
+		  case EEL_CVECTOR_D:
+			if(bin)
+				return es_be64real(k, vec->buffer.d[i]);
+			x = es_real(k, vec->buffer.d[i]);
+			break;
+		  case EEL_CVECTOR_U32:
+			if(bin)
+				return es_be32(k, vec->buffer.u32[i]);
+			x = es_integer(k, (EEL_int32)vec->buffer.u32[i]);
+			break;
+		  default:
+			if(bin)
+				return es_be32(k, vec->buffer.s32[i]);
+			x = es_integer(k, vec->buffer.s32[i]);
+			break;
+		}
+		if(x)
+			return x;
+		return last ? 0 : es_text(k, ", ");
+	  }
+	}
+
+	/* End of table or array item */
+	f->phase = ES_PH_BEGIN;
+	++f->item;
+	if(bin)
+		return 0;
+	if(!last && (x = es_text(k, ",")))
+		return x;
+	return es_text(k, "\n");
+}
+
+
+/*
+ * Serialize until done, or until at least 'maxbytes' bytes have been written.
+ * (maxbytes <= 0 means "until done".) Sets s->done when done. On errors, the
+ * serializer is also marked as done, as it cannot continue anyway.
+ */
+static EEL_xno es_run(EEL_vm *vm, EEL_serializer *s, ES_sink *k, int maxbytes)
+{
+	EEL_xno x = 0;
+	if(s->done)
+		return 0;
+	if(!s->started)
+	{
+		s->started = 1;
+		x = es_value(vm, s, k, &s->root);
+	}
+	while(!x && s->depth && ((maxbytes <= 0) || (k->count < maxbytes)))
+		x = es_step(vm, s, k);
+	if(x || !s->depth)
+	{
+		s->done = 1;
+		es_cleanup(vm, s);
+	}
+	return x;
+}
+
+
+static EEL_xno es_construct(EEL_vm *vm, EEL_classes cid,
+		EEL_value *initv, int initc, EEL_value *result)
+{
+	EEL_serializer *s;
+	EEL_object *eo;
+	int format = EEL_SFMT_EEL;
+	if((initc < 1) || (initc > 3))
+		return EEL_XARGUMENTS;
+	if((initc >= 2) && ((format = es_getformat(initv + 1)) < 0))
+		return EEL_XBADVALUE;
+	if((initc >= 3) && (initv[2].classid != EEL_CINTEGER))
+		return EEL_XNEEDINTEGER;
+	eo = eel_o_alloc(vm, sizeof(EEL_serializer), cid);
+	if(!eo)
+		return EEL_XMEMORY;
+	s = o2EEL_serializer(eo);
+	memset(s, 0, sizeof(EEL_serializer));
+	eel_v_copy(&s->root, initv);
+	s->format = format;
+	if(initc >= 3)
+		s->flags = initv[2].integer.v;
+	eel_o2v(result, eo);
+	return 0;
+}
+
+
+static EEL_xno es_destruct(EEL_object *eo)
+{
+	EEL_serializer *s = o2EEL_serializer(eo);
+	es_cleanup(eo->vm, s);
+	eel_v_disown(&s->root);
+	return 0;
+}
+
+
+static EEL_xno es_getindex(EEL_object *eo, EEL_value *op1, EEL_value *op2)
+{
+	EEL_serializer *s = o2EEL_serializer(eo);
+	const char *is = eel_v2s(op1);
+	if(!is)
+		return EEL_XWRONGTYPE;
+	if(!strcmp(is, "done"))
+		eel_b2v(op2, s->done);
+	else if(!strcmp(is, "depth"))
+		eel_l2v(op2, s->depth);
+	else
+		return EEL_XWRONGINDEX;
+	return 0;
+}
+
+
+/*----------------------------------------------------------
+	Binary format reader
+----------------------------------------------------------*/
+
+typedef struct
+{
+	EEL_vm			*vm;
+	const unsigned char	*data;
+	int			len;
+	int			pos;
+	int			depth;
+	char			*sbuf;		/* JSON string buffer */
+	int			sbufsize;
+} ES_reader;
+
+static inline EEL_xno er_be32(ES_reader *r, EEL_uint32 *v)
+{
+	const unsigned char *d = r->data + r->pos;
+	if(r->pos + 4 > r->len)
+		return EEL_XEOF;
+	*v = ((EEL_uint32)d[0] << 24) | ((EEL_uint32)d[1] << 16) |
+			((EEL_uint32)d[2] << 8) | d[3];
+	r->pos += 4;
+	return 0;
+}
+
+static inline EEL_xno er_be64real(ES_reader *r, EEL_real *v)
+{
+	union {
+		EEL_real	r;
+		unsigned char	c[sizeof(EEL_real)];
+	} cvt;
+	int n;
+	if(r->pos + sizeof(EEL_real) > r->len)
+		return EEL_XEOF;
+#if EEL_BYTEORDER == EEL_BIG_ENDIAN
+	for(n = 0; n < sizeof(EEL_real); ++n)
+		cvt.c[n] = r->data[r->pos + n];
+#else
+	for(n = 0; n < sizeof(EEL_real); ++n)
+		cvt.c[sizeof(EEL_real) - 1 - n] = r->data[r->pos + n];
+#endif
+	r->pos += sizeof(EEL_real);
+	*v = cvt.r;
+	return 0;
+}
+
+/* Read an item count, and make sure it's not obviously bogus. */
+static inline EEL_xno er_count(ES_reader *r, int itemsize, int *count)
+{
+	EEL_uint32 n;
+	EEL_xno x = er_be32(r, &n);
+	if(x)
+		return x;
+	if(n > (EEL_uint32)(r->len - r->pos) / itemsize)
+		return EEL_XEOF;
+	*count = n;
+	return 0;
+}
+
+static EEL_xno er_bin_value(ES_reader *r, EEL_value *v)
+{
+	EEL_vm *vm = r->vm;
+	EEL_xno x;
+	int i, n;
+	unsigned type;
+	if(r->pos >= r->len)
+		return EEL_XEOF;
+	type = r->data[r->pos++];
+	switch(type)
+	{
+	  case ES_BIN_NIL:
+		v->classid = EEL_CNIL;
+		return 0;
+	  case ES_BIN_INTEGER:
+	  {
+		EEL_uint32 iv;
+		if((x = er_be32(r, &iv)))
+			return x;
+		eel_l2v(v, (EEL_int32)iv);
+		return 0;
+	  }
+	  case ES_BIN_REAL:
+	  {
+		EEL_real d;
+		if((x = er_be64real(r, &d)))
+			return x;
+		eel_d2v(v, d);
+		return 0;
+	  }
+	  case ES_BIN_BOOLEANT:
+	  case ES_BIN_BOOLEANF:
+		eel_b2v(v, type == ES_BIN_BOOLEANT);
+		return 0;
+	  case ES_BIN_STRING:
+	  case ES_BIN_UNKNOWN:
+	  case ES_BIN_DSTRING:
+	  {
+		EEL_object *o;
+		const char *s;
+		if((x = er_count(r, 1, &n)))
+			return x;
+		s = (const char *)r->data + r->pos;
+		if(type == ES_BIN_DSTRING)
+			o = eel_ds_nnew(vm, s, n);
+		else
+			o = eel_ps_nnew(vm, s, n);
+		if(!o)
+			return EEL_XMEMORY;
+		r->pos += n;
+		eel_o2v(v, o);
+		return 0;
+	  }
+	  case ES_BIN_TABLE:
+	  case ES_BIN_ARRAY:
+	  {
+		EEL_value cv;
+		if((x = er_count(r, 1, &n)))
+			return x;
+		if(++r->depth > ES_MAXDEPTH)
+			return EEL_XOVERFLOW;
+		if((x = eel_o_construct(vm, type == ES_BIN_TABLE ?
+				EEL_CTABLE : EEL_CARRAY, NULL, 0, &cv)))
+			return x;
+		for(i = 0; i < n; ++i)
+		{
+			EEL_value key, value;
+			if(type == ES_BIN_ARRAY)
+				eel_l2v(&key, i);
+			else if((x = er_bin_value(r, &key)))
+				break;
+			if((x = er_bin_value(r, &value)))
+			{
+				eel_v_disown(&key);
+				break;
+			}
+			x = eel_o__metamethod(cv.objref.v, EEL_MM_SETINDEX,
+					&key, &value);
+			eel_v_disown(&key);
+			eel_v_disown(&value);
+			if(x)
+				break;
+		}
+		--r->depth;
+		if(x)
+		{
+			eel_v_disown(&cv);
+			return x;
+		}
+		*v = cv;
+		return 0;
+	  }
+	  case ES_BIN_VECTOR_D:
+	  case ES_BIN_VECTOR_U32:
+	  case ES_BIN_VECTOR_S32:
+	  {
+		EEL_classes cid = type == ES_BIN_VECTOR_D ? EEL_CVECTOR_D :
+				type == ES_BIN_VECTOR_U32 ? EEL_CVECTOR_U32 :
+				EEL_CVECTOR_S32;
+		EEL_vector *vec;
+		EEL_object *o;
+		if((x = er_count(r, type == ES_BIN_VECTOR_D ?
+				sizeof(EEL_real) : 4, &n)))
+			return x;
+		if(!n)
+			return eel_o_construct(vm, cid, NULL, 0, v);
+		if(!(o = eel_cv_new_noinit(vm, cid, n)))
+			return EEL_XMEMORY;
+		vec = o2EEL_vector(o);
+		for(i = 0; i < n; ++i)
+			if(type == ES_BIN_VECTOR_D)
+				er_be64real(r, vec->buffer.d + i);
+			else
+				er_be32(r, vec->buffer.u32 + i);
+		eel_o2v(v, o);
+		return 0;
+	  }
+	}
+	return EEL_XWRONGFORMAT;
+}
+
+
+/*----------------------------------------------------------
+	JSON parser
+----------------------------------------------------------*/
+
+static inline int ej_skipws(ES_reader *r)
+{
+	while(r->pos < r->len)
+		switch(r->data[r->pos])
+		{
+		  case ' ':
+		  case '\t':
+		  case '\n':
+		  case '\r':
+			++r->pos;
+			continue;
+		  default:
+			return r->data[r->pos];
+		}
+	return -1;
+}
+
+static inline EEL_xno ej_sbuf_put(ES_reader *r, int *n, int c)
+{
+	if(*n >= r->sbufsize)
+	{
+		int ns = r->sbufsize ? r->sbufsize * 2 : 256;
+		char *nb = (char *)eel_realloc(r->vm, r->sbuf, ns);
+		if(!nb)
+			return EEL_XMEMORY;
+		r->sbuf = nb;
+		r->sbufsize = ns;
+	}
+	r->sbuf[(*n)++] = c;
+	return 0;
+}
+
+static EEL_xno ej_string(ES_reader *r, EEL_value *v)
+{
+	EEL_object *o;
+	EEL_xno x;
+	int n = 0;
+	++r->pos;	/* Skip '"' */
+	while(1)
+	{
+		int c;
+		if(r->pos >= r->len)
+			return EEL_XWRONGFORMAT;
+		c = r->data[r->pos++];
+		if(c == '"')
+			break;
+		if(c == '\\')
+		{
+			if(r->pos >= r->len)
+				return EEL_XWRONGFORMAT;
+			switch((c = r->data[r->pos++]))
+			{
+			  case 'b':	c = '\b'; break;
+			  case 'f':	c = '\f'; break;
+			  case 'n':	c = '\n'; break;
+			  case 'r':	c = '\r'; break;
+			  case 't':	c = '\t'; break;
+			  case '"':
+			  case '\\':
+			  case '/':
+				break;
+			  case 'u':
+			  {
+				int i;
+				char hex[5];
+				if(r->pos + 4 > r->len)
+					return EEL_XWRONGFORMAT;
+				for(i = 0; i < 4; ++i)
+				{
+					hex[i] = r->data[r->pos++];
+					if(!((hex[i] >= '0') && (hex[i] <= '9'))
+							&& !((hex[i] | 0x20) >= 'a' &&
+							(hex[i] | 0x20) <= 'f'))
+						return EEL_XWRONGFORMAT;
+				}
+				hex[4] = 0;
+				c = strtol(hex, NULL, 16);
+				/* Same limitation as the EEL lexer! */
+				if(c > 255)
+					return EEL_XNOTIMPLEMENTED;
+				break;
+			  }
+			  default:
+				return EEL_XWRONGFORMAT;
+			}
+		}
+		if((x = ej_sbuf_put(r, &n, c)))
+			return x;
+	}
+	if(!(o = eel_ps_nnew(r->vm, n ? r->sbuf : "", n)))
+		return EEL_XMEMORY;
+	eel_o2v(v, o);
+	return 0;
+}
+
+/*
+ * Numbers without fraction or exponent become integers if they fit, just like
+ * numeric literals in EEL code. Everything else becomes real.
+ */
+static EEL_xno ej_number(ES_reader *r, EEL_value *v)
+{
+	char buf[64];
+	int n = 0, isreal = 0;
+	double d;
+	char *end;
+	while(r->pos < r->len)
+	{
+		int c = r->data[r->pos];
+		if((c == '.') || (c == 'e') || (c == 'E'))
+			isreal = 1;
+		else if(!((c >= '0') && (c <= '9')) && (c != '-') &&
+				(c != '+'))
+			break;
+		if(n >= sizeof(buf) - 1)
+			return EEL_XWRONGFORMAT;
+		buf[n++] = c;
+		++r->pos;
+	}
+	buf[n] = 0;
+	d = strtod(buf, &end);
+	if(!n || (end != buf + n))
+		return EEL_XWRONGFORMAT;
+	if(!isreal && (d >= -2147483648.0) && (d <= 2147483647.0))
+		eel_l2v(v, (EEL_int32)d);
+	else
+		eel_d2v(v, d);
+	return 0;
+}
+
+static EEL_xno ej_literal(ES_reader *r, const char *lit)
+{
+	int len = strlen(lit);
+	if((r->pos + len > r->len) ||
+			memcmp(r->data + r->pos, lit, len))
+		return EEL_XWRONGFORMAT;
+	r->pos += len;
+	return 0;
+}
+
+static EEL_xno ej_value(ES_reader *r, EEL_value *v)
+{
+	EEL_xno x;
+	int c = ej_skipws(r);
+	switch(c)
+	{
+	  case '{':
+	  case '[':
+	  {
+		EEL_value cv;
+		int close = (c == '{') ? '}' : ']';
+		int i = 0;
+		++r->pos;
+		if(++r->depth > ES_MAXDEPTH)
+			return EEL_XOVERFLOW;
+		if((x = eel_o_construct(r->vm, c == '{' ? EEL_CTABLE :
+				EEL_CARRAY, NULL, 0, &cv)))
+			return x;
+		if(ej_skipws(r) == close)
+			++r->pos;
+		else
+			while(1)
+			{
+				EEL_value key, value;
+				if(close == ']')
+					eel_l2v(&key, i++);
+				else
+				{
+					if(ej_skipws(r) != '"')
+					{
+						x = EEL_XWRONGFORMAT;
+						break;
+					}
+					if((x = ej_string(r, &key)))
+						break;
+					if(ej_skipws(r) != ':')
+					{
+						eel_v_disown(&key);
+						x = EEL_XWRONGFORMAT;
+						break;
+					}
+					++r->pos;
+				}
+				if((x = ej_value(r, &value)))
+				{
+					eel_v_disown(&key);
+					break;
+				}
+				x = eel_o__metamethod(cv.objref.v,
+						EEL_MM_SETINDEX, &key, &value);
+				eel_v_disown(&key);
+				eel_v_disown(&value);
+				if(x)
+					break;
+				c = ej_skipws(r);
+				++r->pos;
+				if(c == close)
+					break;
+				if(c != ',')
+				{
+					x = EEL_XWRONGFORMAT;
+					break;
+				}
+			}
+		--r->depth;
+		if(x)
+		{
+			eel_v_disown(&cv);
+			return x;
+		}
+		*v = cv;
+		return 0;
+	  }
+	  case '"':
+		return ej_string(r, v);
+	  case 't':
+		if((x = ej_literal(r, "true")))
+			return x;
+		eel_b2v(v, 1);
+		return 0;
+	  case 'f':
+		if((x = ej_literal(r, "false")))
+			return x;
+		eel_b2v(v, 0);
+		return 0;
+	  case 'n':
+		if((x = ej_literal(r, "null")))
+			return x;
+		v->classid = EEL_CNIL;
+		return 0;
+	  case -1:
+		return EEL_XEOF;
+	  default:
+		return ej_number(r, v);
+	}
+}
+
+
+/*----------------------------------------------------------
+	Module functions
+----------------------------------------------------------*/
+
+/*
+ * Get the dstring and position to write to from a dstring or memfile.
+ * Returns 0 if 'v' is neither.
+ */
+static int es_getsink(EEL_vm *vm, EEL_value *v, ES_sink *k)
+{
+	k->count = 0;
+	switch(EEL_CLASS(v))
+	{
+	  case EEL_CDSTRING:
+		k->buffer = v->objref.v;
+		k->position = o2EEL_dstring(k->buffer)->length;
+		return 1;
+	  case EEL_CSTRING:
+	  case EEL_CNIL:
+	  case EEL_CREAL:
+	  case EEL_CINTEGER:
+	  case EEL_CBOOLEAN:
+		return 0;
+	  default:
+		/*
+		 * 'memfile' belongs to the io module, so we go by the name it
+		 * is registered under. (See eel_export_class().)
+		 */
+		if(strcmp(eel_typename(vm, EEL_CLASS(v)), "io.memfile"))
+			return 0;
+		k->buffer = o2EEL_memfile(v->objref.v)->buffer;
+		k->position = o2EEL_memfile(v->objref.v)->position;
+		return k->buffer != NULL;
+	}
+}
+
+
+/* __serialize(value, format, flags) */
+static EEL_xno es_serialize(EEL_vm *vm)
+{
+	EEL_value *args = vm->heap + vm->argv;
+	EEL_serializer s;
+	ES_sink k;
+	EEL_xno x;
+	memset(&s, 0, sizeof(s));
+	s.root = args[0];
+	if((s.format = es_getformat(args + 1)) < 0)
+		return EEL_XBADVALUE;
+	if(args[2].classid != EEL_CINTEGER)
+		return EEL_XNEEDINTEGER;
+	s.flags = args[2].integer.v;
+	if(!(k.buffer = eel_ds_nnew(vm, "", 0)))
+		return EEL_XMEMORY;
+	k.position = k.count = 0;
+	if((x = es_run(vm, &s, &k, 0)))
+	{
+		eel_o_disown_nz(k.buffer);
+		return x;
+	}
+	eel_o2v(vm->heap + vm->resv, k.buffer);
+	return 0;
+}
+
+
+/* __serialize_chunk(serializer, buffer, maxbytes) */
+static EEL_xno es_serialize_chunk(EEL_vm *vm)
+{
+	ES_moduledata *md = (ES_moduledata *)eel_get_current_moduledata(vm);
+	EEL_value *args = vm->heap + vm->argv;
+	EEL_serializer *s;
+	ES_sink k;
+	EEL_xno x;
+	if(EEL_CLASS(args) != md->serializer_cid)
+		return EEL_XWRONGTYPE;
+	s = o2EEL_serializer(args->objref.v);
+	if(!es_getsink(vm, args + 1, &k))
+		return EEL_XWRONGTYPE;
+	x = es_run(vm, s, &k, eel_v2l(args + 2));
+	if(EEL_CLASS(args + 1) != EEL_CDSTRING)
+		o2EEL_memfile(args[1].objref.v)->position = k.position;
+	if(x)
+		return x;
+	eel_b2v(vm->heap + vm->resv, s->done);
+	return 0;
+}
+
+
+/* __deserialize(buffer, format) */
+static EEL_xno es_deserialize(EEL_vm *vm)
+{
+	EEL_value *args = vm->heap + vm->argv;
+	EEL_value *memfile = NULL;
+	ES_reader r;
+	EEL_xno x;
+	int format;
+	memset(&r, 0, sizeof(r));
+	r.vm = vm;
+	switch(EEL_CLASS(args))
+	{
+	  case EEL_CSTRING:
+		r.data = (const unsigned char *)o2EEL_string(
+				args->objref.v)->buffer;
+		r.len = o2EEL_string(args->objref.v)->length;
+		break;
+	  case EEL_CDSTRING:
+		r.data = (const unsigned char *)o2EEL_dstring(
+				args->objref.v)->buffer;
+		r.len = o2EEL_dstring(args->objref.v)->length;
+		break;
+	  default:
+	  {
+		ES_sink k;
+		EEL_dstring *ds;
+		if(!es_getsink(vm, args, &k))
+			return EEL_XWRONGTYPE;
+		ds = o2EEL_dstring(k.buffer);
+		r.data = (const unsigned char *)ds->buffer;
+		r.len = ds->length;
+		r.pos = k.position;
+		memfile = args;
+		break;
+	  }
+	}
+	switch((format = es_getformat(args + 1)))
+	{
+	  case EEL_SFMT_JSON:
+		x = ej_value(&r, vm->heap + vm->resv);
+		if(!x && (ej_skipws(&r) >= 0) && !memfile)
+		{
+			eel_v_disown(vm->heap + vm->resv);
+			x = EEL_XWRONGFORMAT;
+		}
+		eel_free(vm, r.sbuf);
+		break;
+	  case EEL_SFMT_BIN:
+		x = er_bin_value(&r, vm->heap + vm->resv);
+		break;
+	  default:
+		/* "eel" is compiled by serialize.eel */
+		return EEL_XBADVALUE;
+	}
+	if(x)
+		return x;
+	if(memfile)
+		o2EEL_memfile(memfile->objref.v)->position = r.pos;
+	return 0;
+}
+
+
+/*----------------------------------------------------------
+	Unloading
+----------------------------------------------------------*/
+static EEL_xno es_unload(EEL_object *m, int closing)
+{
+	if(closing)
+	{
+		eel_free(m->vm, eel_get_moduledata(m));
+		return 0;
+	}
+	else
+		return EEL_XREFUSE;
+}
+
+
+/*----------------------------------------------------------
+	Initialization
+----------------------------------------------------------*/
+
+EEL_xno eel_serial_init(EEL_vm *vm)
+{
+	EEL_object *m;
+	EEL_object *c;
+	ES_moduledata *md = (ES_moduledata *)eel_malloc(vm,
+			sizeof(ES_moduledata));
+	if(!md)
+		return EEL_XMEMORY;
+
+	m = eel_create_module(vm, "serial", es_unload, md);
+	if(!m)
+	{
+		eel_free(vm, md);
+		return EEL_XMODULEINIT;
+	}
+
+	/* Types */
+	c = eel_export_class(m, "serializer", -1, es_construct, es_destruct,
+			NULL);
+	eel_set_metamethod(c, EEL_MM_GETINDEX, es_getindex);
+	md->serializer_cid = eel_class_cid(c);
+
+	/* Functions */
+	eel_export_cfunction(m, 1, "__serialize", 3, 0, 0, es_serialize);
+	eel_export_cfunction(m, 1, "__serialize_chunk", 3, 0, 0,
+			es_serialize_chunk);
+	eel_export_cfunction(m, 1, "__deserialize", 2, 0, 0, es_deserialize);
+
+	SETNAME(m, "EEL Built-in Serialization Module");
+	eel_disown(m);
+	return 0;
+}
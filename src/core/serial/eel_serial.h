@@ -0,0 +1,87 @@
+/*
+---------------------------------------------------------------------------
+	eel_serial.h - EEL Serialization Module
+---------------------------------------------------------------------------
+ * Copyright 2026 David Olofson
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from the
+ * use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#ifndef	EEL_SERIAL_H
+#define	EEL_SERIAL_H
+
+#include "EEL.h"
+#include "EEL_types.h"
+
+/*
+ * Flags (Same values as the SERIALIZE_* constants in serialize.eel!)
+ */
+typedef enum
+{
+	EEL_SERIALIZE_DROP_UNKNOWN =	0x00000001,
+	EEL_SERIALIZE_NO_SHORTHAND =	0x00000002
+} EEL_serializeflags;
+
+/*
+ * Formats
+ */
+typedef enum
+{
+	EEL_SFMT_EEL = 0,	/* EEL source code */
+	EEL_SFMT_JSON,		/* JSON */
+	EEL_SFMT_BIN		/* Big endian binary format */
+} EEL_serialformats;
+
+/*
+ * Stack entry for a container being serialized
+ */
+typedef struct
+{
+	EEL_object	*o;		/* Container (owned) */
+	int		items;		/* Item count when opened */
+	int		item;		/* Current item */
+	int		phase;		/* Current part of item (ES_phases) */
+} EEL_serialframe;
+
+/*
+ * serializer
+ *	Serializes a value in steps, so that huge structures can be written
+ *	in chunks. Containers are traversed using an explicit stack, so
+ *	nesting depth is not limited by the C stack either.
+ *
+ *	NOTE: The value must not be modified until serialization is done!
+ */
+typedef struct
+{
+	EEL_value	root;		/* Value to serialize */
+	int		format;		/* EEL_serialformats */
+	int		flags;		/* EEL_serializeflags */
+	int		started;
+	int		done;
+	int		depth;		/* Number of open containers */
+	int		maxdepth;	/* Size of 'stack' */
+	EEL_serialframe	*stack;
+} EEL_serializer;
+EEL_MAKE_CAST(EEL_serializer)
+
+/*
+ * Register module 'serial', containing 'serializer' and the native
+ * serialize()/deserialize() back-ends used by serialize.eel.
+ */
+EEL_xno eel_serial_init(EEL_vm *vm);
+
+#endif	/* EEL_SERIAL_H */
@@ -0,0 +1,346 @@
+/*
+---------------------------------------------------------------------------
+	eel_threads.c - EEL Green Threads Module
+---------------------------------------------------------------------------
+ * Copyright 2026 David Olofson
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from the
+ * use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include <string.h>
+#include <limits.h>
+#include "eel_threads.h"
+#include "e_object.h"
+#include "e_function.h"
+
+/* Scheduler state; also the module data of 'threads' */
+struct EEL_threads
+{
+	EEL_vm		*vm;		/* VM the threads run in */
+	int		thread_cid;	/* Class Type ID */
+	EEL_object	**queue;	/* Threads that are not done (owned) */
+	int		nqueue;		/* Number of queue entries in use */
+	int		maxqueue;	/* Size of 'queue' */
+	int		ready;		/* Number of READY threads */
+	int		depth;		/* Scheduler recursion depth */
+	int		timeslice;	/* Time slice, in VM instructions */
+	EEL_thread	*current;	/* Innermost thread being run */
+};
+typedef struct EEL_threads EEL_threads;
+
+
+/*----------------------------------------------------------
+	Scheduling
+----------------------------------------------------------*/
+
+/* Wrap up a thread that has returned or died, and remove it from the queue. */
+static void eth_finish(EEL_vm *vm, EEL_threads *th, int i)
+{
+	EEL_object *to = th->queue[i];
+	EEL_thread *t = o2EEL_thread(to);
+	t->state = EEL_THREAD_DONE;
+	eel_vm_context_close(vm, &t->ctx);
+	eel_o_disown_nz(t->f);
+	t->f = NULL;
+	th->queue[i] = NULL;
+	eel_o_disown_nz(to);
+}
+
+
+/*
+ * Run queue entry 'i' for one time slice. Returns EEL_XCOUNTER if the budget
+ * ran out, otherwise 0.
+ */
+static EEL_xno eth_run(EEL_vm *vm, EEL_threads *th, int i)
+{
+	EEL_thread *t = o2EEL_thread(th->queue[i]);
+	EEL_xno x;
+	t->state = EEL_THREAD_RUNNING;
+	--th->ready;
+	th->current = t;
+	eel_vm_swap(vm, &t->ctx);
+	eel_vm_slice(vm, th->timeslice);
+	x = eel_run(vm);
+	eel_vm_swap(vm, &t->ctx);
+	switch(x)
+	{
+	  case EEL_XOK:
+	  case EEL_XYIELD:
+	  case EEL_XCOUNTER:
+		t->state = EEL_THREAD_READY;
+		++th->ready;
+		return x == EEL_XCOUNTER ? x : 0;
+	  case EEL_XEND:
+		eel_v_move(&t->result, t->ctx.heap);
+		break;
+	  default:
+		t->x = x;
+		break;
+	}
+	eth_finish(vm, th, i);
+	return 0;
+}
+
+
+void eel_threads_schedule(EEL_vm *vm)
+{
+	EEL_threads *th = VMP->threads;
+	EEL_thread *current = th->current;
+	int slice = VMP->slice > 0 ? VMP->slice : 0;
+	int i, j;
+	++th->depth;
+	for(i = 0; i < th->nqueue; ++i)
+		if(th->queue[i] && (o2EEL_thread(th->queue[i])->state ==
+				EEL_THREAD_READY) && eth_run(vm, th, i))
+			break;
+	--th->depth;
+	th->current = current;
+	eel_vm_slice(vm, slice);
+
+	/* Drop finished threads, unless an outer scheduler is iterating */
+	if(th->depth)
+		return;
+	for(i = j = 0; i < th->nqueue; ++i)
+		if(th->queue[i])
+			th->queue[j++] = th->queue[i];
+	th->nqueue = j;
+}
+
+
+int eel_threads_slice_end(EEL_vm *vm)
+{
+	EEL_threads *th = VMP->threads;
+	eel_vm_slice(vm, th->timeslice);
+	return th->current || th->ready;
+}
+
+
+/*----------------------------------------------------------
+	thread class
+----------------------------------------------------------*/
+
+/* Threads are created through spawn() only. */
+static EEL_xno eth_construct(EEL_vm *vm, EEL_classes cid,
+		EEL_value *initv, int initc, EEL_value *result)
+{
+	return EEL_XBADCONTEXT;
+}
+
+
+static EEL_xno eth_destruct(EEL_object *eo)
+{
+	EEL_thread *t = o2EEL_thread(eo);
+	eel_vm_context_close(eo->vm, &t->ctx);
+	if(t->f)
+		eel_o_disown_nz(t->f);
+	eel_v_disown(&t->result);
+	return 0;
+}
+
+
+/*----------------------------------------------------------
+	Functions
+----------------------------------------------------------*/
+
+/* spawn(function f, ...) */
+static EEL_xno eth_spawn(EEL_vm *vm)
+{
+	EEL_value *args = vm->heap + vm->argv;
+	EEL_threads *th = VMP->threads;
+	EEL_object *to;
+	EEL_thread *t;
+	EEL_xno x;
+	if(!th)
+		return EEL_XBADCONTEXT;
+	if(EEL_CLASS(args) != EEL_CFUNCTION)
+		return EEL_XNEEDCALLABLE;
+	if(th->nqueue >= th->maxqueue)
+	{
+		int n = th->maxqueue ? th->maxqueue * 2 : 16;
+		EEL_object **q = (EEL_object **)eel_realloc(vm, th->queue,
+				n * sizeof(EEL_object *));
+		if(!q)
+			return EEL_XMEMORY;
+		th->queue = q;
+		th->maxqueue = n;
+	}
+	if(!(to = eel_o_alloc(vm, sizeof(EEL_thread), th->thread_cid)))
+		return EEL_XMEMORY;
+	t = o2EEL_thread(to);
+	memset(t, 0, sizeof(EEL_thread));
+	t->result.classid = EEL_CNIL;
+	t->f = args->objref.v;
+	eel_o_own(t->f);
+	if((x = eel_vm_context_open(vm, &t->ctx, EEL_THREAD_HEAP, t->f,
+			args + 1, vm->argc - 1)))
+	{
+		eel_o_disown_nz(to);
+		return x;
+	}
+	eel_o2v(vm->heap + vm->resv, to);
+	if(o2EEL_function(t->f)->common.flags & EEL_FF_CFUNC)
+	{
+		/* Already done! */
+		t->state = EEL_THREAD_DONE;
+		eel_v_move(&t->result, t->ctx.heap);
+		eel_vm_context_close(vm, &t->ctx);
+		eel_o_disown_nz(t->f);
+		t->f = NULL;
+		return 0;
+	}
+	eel_o_own(to);
+	th->queue[th->nqueue++] = to;
+	++th->ready;
+	if(VMP->slice > th->timeslice)
+		eel_vm_slice(vm, th->timeslice);
+	return 0;
+}
+
+
+/* yield() */
+static EEL_xno eth_yield(EEL_vm *vm)
+{
+	EEL_threads *th = VMP->threads;
+	if(!th || (!th->current && !th->ready))
+		return 0;
+	return EEL_XYIELD;
+}
+
+
+static EEL_thread *eth_getthread(EEL_vm *vm, EEL_value *v)
+{
+	EEL_threads *th = VMP->threads;
+	if(!th || (EEL_CLASS(v) != th->thread_cid))
+		return NULL;
+	return o2EEL_thread(v->objref.v);
+}
+
+
+/* join(thread t) */
+static EEL_xno eth_join(EEL_vm *vm)
+{
+	EEL_thread *t = eth_getthread(vm, vm->heap + vm->argv);
+	if(!t)
+		return EEL_XWRONGTYPE;
+
+	/* We can't suspend in here, so the budget has to wait */
+	eel_vm_hold_budget(vm);
+	while(t->state == EEL_THREAD_READY)
+		eel_threads_schedule(vm);
+	eel_vm_release_budget(vm);
+	if(t->state == EEL_THREAD_RUNNING)
+		return EEL_XBADCONTEXT;		/* Waiting for ourselves! */
+	if(t->x)
+		return t->x;
+	eel_v_copy(vm->heap + vm->resv, &t->result);
+	return 0;
+}
+
+
+/* finished(thread t) */
+static EEL_xno eth_finished(EEL_vm *vm)
+{
+	EEL_thread *t = eth_getthread(vm, vm->heap + vm->argv);
+	if(!t)
+		return EEL_XWRONGTYPE;
+	eel_b2v(vm->heap + vm->resv, t->state == EEL_THREAD_DONE);
+	return 0;
+}
+
+
+/* timeslice([instructions]) */
+static EEL_xno eth_timeslice(EEL_vm *vm)
+{
+	EEL_value *args = vm->heap + vm->argv;
+	EEL_threads *th = VMP->threads;
+	if(!th)
+		return EEL_XBADCONTEXT;
+	if(vm->argc >= 1)
+	{
+		if(eel_v2l(args) < 1)
+			return EEL_XLOWVALUE;
+		th->timeslice = eel_v2l(args);
+		if(VMP->slice > th->timeslice)
+			eel_vm_slice(vm, th->timeslice);
+	}
+	eel_l2v(vm->heap + vm->resv, th->timeslice);
+	return 0;
+}
+
+
+/*----------------------------------------------------------
+	Unloading
+----------------------------------------------------------*/
+static EEL_xno eth_unload(EEL_object *m, int closing)
+{
+	EEL_threads *th = (EEL_threads *)eel_get_moduledata(m);
+	EEL_vm *vm = th->vm;
+	int i;
+	if(!closing)
+		return EEL_XREFUSE;
+
+	/* Kill any threads that never finished */
+	for(i = 0; i < th->nqueue; ++i)
+		if(th->queue[i])
+			eth_finish(vm, th, i);
+	VMP->threads = NULL;
+	eel_vm_slice(vm, INT_MAX);
+	eel_free(vm, th->queue);
+	eel_free(vm, th);
+	return 0;
+}
+
+
+/*----------------------------------------------------------
+	Initialization
+----------------------------------------------------------*/
+
+EEL_xno eel_threads_init(EEL_vm *vm)
+{
+	EEL_object *m;
+	EEL_object *c;
+	EEL_threads *th = (EEL_threads *)eel_malloc(vm, sizeof(EEL_threads));
+	if(!th)
+		return EEL_XMEMORY;
+	memset(th, 0, sizeof(EEL_threads));
+	th->vm = vm;
+	th->timeslice = EEL_THREAD_SLICE;
+
+	m = eel_create_module(vm, "threads", eth_unload, th);
+	if(!m)
+	{
+		eel_free(vm, th);
+		return EEL_XMODULEINIT;
+	}
+
+	/* Types */
+	c = eel_export_class(m, "thread", -1, eth_construct, eth_destruct,
+			NULL);
+	th->thread_cid = eel_class_cid(c);
+
+	/* Functions */
+	eel_export_cfunction(m, 1, "spawn", 1, 0, 1, eth_spawn);
+	eel_export_cfunction(m, 0, "yield", 0, 0, 0, eth_yield);
+	eel_export_cfunction(m, 1, "join", 1, 0, 0, eth_join);
+	eel_export_cfunction(m, 1, "finished", 1, 0, 0, eth_finished);
+	eel_export_cfunction(m, 1, "timeslice", 0, 1, 0, eth_timeslice);
+
+	VMP->threads = th;
+	SETNAME(m, "EEL Built-in Green Threads Module");
+	eel_disown(m);
+	return 0;
+}
@@ -0,0 +1,83 @@
+/*
+---------------------------------------------------------------------------
+	eel_threads.h - EEL Green Threads Module
+---------------------------------------------------------------------------
+ * Copyright 2026 David Olofson
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from the
+ * use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/*
+   Green threads
+   -------------
+	A thread is an execution context (heap, registers and exception)
+	of its own, that is swapped into the VM while the thread runs.
+	Threads share everything else with the VM that spawned them;
+	modules, the string pool, memory pools and so on.
+	   Threads are scheduled cooperatively, round-robin, whenever the
+	running code calls yield(), join() or anything else that waits,
+	and whenever a time slice of EEL_THREAD_SLICE VM instructions is
+	used up. Threads are only ever run from within the scheduler, so
+	the main context gets control back between every round.
+	   A thread that is on the C stack (it called back into the
+	scheduler somehow) is RUNNING, and is not rescheduled until that
+	returns.
+ */
+
+#ifndef	EEL_THREADS_H
+#define	EEL_THREADS_H
+
+#include "EEL.h"
+#include "EEL_types.h"
+#include "e_vm.h"
+
+typedef enum
+{
+	EEL_THREAD_READY = 0,	/* Waiting to run */
+	EEL_THREAD_RUNNING,	/* Swapped in, or on the C stack */
+	EEL_THREAD_DONE		/* Returned, or died from an exception */
+} EEL_threadstates;
+
+/*
+ * thread
+ */
+typedef struct
+{
+	EEL_vmcontext	ctx;		/* Execution context */
+	EEL_object	*f;		/* Thread function (owned until done) */
+	EEL_value	result;		/* Return value, once done */
+	EEL_xno		x;		/* Exception that killed the thread */
+	int		state;		/* EEL_threadstates */
+} EEL_thread;
+EEL_MAKE_CAST(EEL_thread)
+
+/*
+ * Run each thread that is ready for one time slice. Called by the VM when the
+ * current time slice is up, and by anything that waits for threads.
+ */
+void eel_threads_schedule(EEL_vm *vm);
+
+/*
+ * Called by the VM when the current time slice is used up. Starts a new slice,
+ * and returns 1 if the running code should yield to other threads.
+ */
+int eel_threads_slice_end(EEL_vm *vm);
+
+/* Register module 'threads'. */
+EEL_xno eel_threads_init(EEL_vm *vm);
+
+#endif	/* EEL_THREADS_H */
@@ -27,10 +27,26 @@
 #include <string.h>
 #include "eel_physics.h"
 #include "EEL_object.h"
+#include "SDL_thread.h"
 
 /* FIXME: We shouldn't have any business in here, really. */
 #include "e_vector.h"
 
+/* Worker thread pool, shared by all spaces */
+typedef struct
+{
+	SDL_Thread	*threads[EPH_MAXTHREADS];
+	unsigned	nthreads;
+	SDL_sem		*go;		/* One post per worker to wake */
+	SDL_sem		*done;		/* One post per worker finished */
+	int		quit;
+
+	/* Current job */
+	EPH_space	*space;
+	void		(*run)(EPH_space *space, unsigned part);
+	SDL_atomic_t	next;		/* Next part to process */
+} EPH_pool;
+
 typedef struct
 {
 	/* Class type IDs */
@@ -48,6 +64,8 @@ typedef struct
 	EEL_value	ca;
 
 	uint32_t	rngstate;	/* Global RNG state */
+
+	EPH_pool	pool;
 } EPH_moduledata;
 
 /*FIXME: Can't get moduledata from within constructors... */
@@ -70,6 +88,509 @@ static inline int bit_index(unsigned x)
 	return bitpos[(EEL_uint32)(x * 0x077CB531U) >> 27];
 }
 
+
+/*----------------------------------------------------------
+	Body state storage
+----------------------------------------------------------*/
+
+static EPH_bodydata *bd_open(void)
+{
+	return (EPH_bodydata *)calloc(1, sizeof(EPH_bodydata));
+}
+
+static void bd_close(EPH_bodydata *bd)
+{
+	free(bd->bodies);
+	free(bd->v[0]);
+	free(bd);
+}
+
+/* Point the vectors of the body in 'slot' to the arrays */
+static inline void bd_point(EPH_bodydata *bd, unsigned slot)
+{
+	EPH_body *b = bd->bodies[slot];
+	unsigned off = slot * EPH_DIMS;
+	b->slot = slot;
+	b->i = bd->v[EPH_VI] + off;
+	b->o = bd->v[EPH_VO] + off;
+	b->c = bd->v[EPH_VC] + off;
+	b->v = bd->v[EPH_VV] + off;
+	b->f = bd->v[EPH_VF] + off;
+	b->rf = bd->v[EPH_VRF] + off;
+	b->u = bd->v[EPH_VU] + off;
+	b->cd = bd->v[EPH_VCD] + off;
+	b->m1 = bd->v[EPH_VM1] + off;
+}
+
+static int bd_grow(EPH_bodydata *bd)
+{
+	unsigned i;
+	unsigned ns = bd->size ? bd->size * 2 : 64;
+	EPH_f *block;
+	EPH_body **nb = (EPH_body **)realloc(bd->bodies,
+			ns * sizeof(EPH_body *));
+	if(!nb)
+		return -1;
+	bd->bodies = nb;
+	block = (EPH_f *)malloc(ns * EPH_DIMS * EPH_NVECTORS * sizeof(EPH_f));
+	if(!block)
+		return -1;
+	for(i = 0; i < EPH_NVECTORS; ++i)
+		if(bd->used)
+			memcpy(block + i * ns * EPH_DIMS, bd->v[i],
+					bd->used * EPH_DIMS * sizeof(EPH_f));
+	free(bd->v[0]);
+	for(i = 0; i < EPH_NVECTORS; ++i)
+		bd->v[i] = block + i * ns * EPH_DIMS;
+	bd->size = ns;
+	for(i = 0; i < bd->used; ++i)
+		bd_point(bd, i);
+	return 0;
+}
+
+/* Move the body in slot 'from' to the unused slot 'to' */
+static void bd_move(EPH_bodydata *bd, unsigned from, unsigned to)
+{
+	unsigned i;
+	for(i = 0; i < EPH_NVECTORS; ++i)
+		memcpy(bd->v[i] + to * EPH_DIMS, bd->v[i] + from * EPH_DIMS,
+				EPH_DIMS * sizeof(EPH_f));
+	bd->bodies[to] = bd->bodies[from];
+	bd_point(bd, to);
+}
+
+static void bd_swap(EPH_bodydata *bd, unsigned a, unsigned b)
+{
+	unsigned i, j;
+	EPH_body *tb;
+	if(a == b)
+		return;
+	for(i = 0; i < EPH_NVECTORS; ++i)
+		for(j = 0; j < EPH_DIMS; ++j)
+		{
+			EPH_f t = bd->v[i][a * EPH_DIMS + j];
+			bd->v[i][a * EPH_DIMS + j] = bd->v[i][b * EPH_DIMS + j];
+			bd->v[i][b * EPH_DIMS + j] = t;
+		}
+	tb = bd->bodies[a];
+	bd->bodies[a] = bd->bodies[b];
+	bd->bodies[b] = tb;
+	bd_point(bd, a);
+	bd_point(bd, b);
+}
+
+/* Allocate a zeroed slot for a new, live body. */
+static int bd_alloc(EPH_bodydata *bd, EPH_body *body)
+{
+	unsigned i;
+	if(bd->used >= bd->size)
+		if(bd_grow(bd))
+			return -1;
+	/* Shift the other partitions up one slot, by moving their heads */
+	if(bd->linked != bd->used)
+		bd_move(bd, bd->linked, bd->used);
+	if(bd->live != bd->linked)
+		bd_move(bd, bd->live, bd->linked);
+	++bd->used;
+	++bd->linked;
+	for(i = 0; i < EPH_NVECTORS; ++i)
+		memset(bd->v[i] + bd->live * EPH_DIMS, 0,
+				EPH_DIMS * sizeof(EPH_f));
+	bd->bodies[bd->live] = body;
+	body->data = bd;
+	bd_point(bd, bd->live++);
+	return 0;
+}
+
+/* Move a live body to the killed partition */
+static void bd_kill(EPH_body *body)
+{
+	EPH_bodydata *bd = body->data;
+	if(!bd || body->slot >= bd->live)
+		return;
+	bd_swap(bd, body->slot, --bd->live);
+}
+
+/* Move a body to the unlinked partition */
+static void bd_unlink(EPH_body *body)
+{
+	EPH_bodydata *bd = body->data;
+	if(!bd)
+		return;
+	if(body->slot < bd->live)
+		bd_swap(bd, body->slot, --bd->live);
+	if(body->slot < bd->linked)
+		bd_swap(bd, body->slot, --bd->linked);
+}
+
+/* Release the slot of a body that is being destroyed */
+static void bd_free(EPH_body *body)
+{
+	EPH_bodydata *bd = body->data;
+	if(!bd)
+		return;
+	bd_unlink(body);
+	if(body->slot != bd->used - 1)
+		bd_move(bd, bd->used - 1, body->slot);
+	--bd->used;
+	body->data = NULL;
+	if(bd->orphaned && !bd->used)
+		bd_close(bd);
+}
+
+
+/*----------------------------------------------------------
+	Broad phase grid
+----------------------------------------------------------*/
+
+static inline unsigned grid_hash(EPH_grid *g, int x, int y)
+{
+	return ((unsigned)x * 73856093U ^ (unsigned)y * 19349663U) &
+			(g->nbuckets - 1);
+}
+
+/* Free all grid memory, leaving only the configuration. */
+static void grid_free(EPH_grid *g)
+{
+	unsigned i;
+	for(i = 0; i < g->nbuckets; ++i)
+		free(g->buckets[i].entries);
+	free(g->buckets);
+	free(g->large);
+	free(g->cand);
+	free(g->view);
+	g->buckets = NULL;
+	g->nbuckets = g->entries = 0;
+	g->large = NULL;
+	g->nlarge = g->largesize = 0;
+	g->cand = NULL;
+	g->candsize = 0;
+	g->view = NULL;
+	g->nview = g->viewsize = 0;
+	g->viewvalid = 0;
+	++g->stamp;
+}
+
+/*
+ * Drop the broad phase, falling back to brute force tests. We do this if we
+ * run out of memory, so that the grid never has to fail any operations.
+ */
+static void grid_disable(EPH_space *space)
+{
+	EPH_body *b;
+	printf("WARNING: Out of memory! Physics broad phase disabled.\n");
+	for(b = space->first; b; b = b->next)
+		b->gridmode = EPH_GOUT;
+	grid_free(&space->grid);
+	space->grid.cellsize = space->grid.scale = 0.0f;
+}
+
+static int grid_rehash(EPH_grid *g, unsigned nbuckets)
+{
+	unsigned i, j;
+	EPH_gridbucket *ob = g->buckets;
+	unsigned onb = g->nbuckets;
+	g->buckets = (EPH_gridbucket *)calloc(nbuckets, sizeof(EPH_gridbucket));
+	if(!g->buckets)
+	{
+		g->buckets = ob;
+		return -1;
+	}
+	g->nbuckets = nbuckets;
+	for(i = 0; i < onb; ++i)
+	{
+		for(j = 0; j < ob[i].n; ++j)
+		{
+			EPH_gridentry *e = ob[i].entries + j;
+			EPH_gridbucket *b = g->buckets + grid_hash(g, e->x, e->y);
+			if(b->n >= b->size)
+			{
+				unsigned ns = b->size ? b->size * 2 : 4;
+				EPH_gridentry *ne = (EPH_gridentry *)realloc(
+						b->entries,
+						ns * sizeof(EPH_gridentry));
+				if(!ne)
+					return -1;
+				b->entries = ne;
+				b->size = ns;
+			}
+			b->entries[b->n++] = *e;
+		}
+		free(ob[i].entries);
+	}
+	free(ob);
+	return 0;
+}
+
+static int grid_add(EPH_grid *g, int x, int y, EPH_body *body)
+{
+	EPH_gridbucket *b;
+	EPH_gridentry *e;
+	if(g->entries >= g->nbuckets)
+		if(grid_rehash(g, g->nbuckets ? g->nbuckets * 2 :
+				EPH_GRID_MINBUCKETS))
+			return -1;
+	b = g->buckets + grid_hash(g, x, y);
+	if(b->n >= b->size)
+	{
+		unsigned ns = b->size ? b->size * 2 : 4;
+		EPH_gridentry *ne = (EPH_gridentry *)realloc(b->entries,
+				ns * sizeof(EPH_gridentry));
+		if(!ne)
+			return -1;
+		b->entries = ne;
+		b->size = ns;
+	}
+	e = b->entries + b->n++;
+	e->x = x;
+	e->y = y;
+	e->body = body;
+	++g->entries;
+	return 0;
+}
+
+static void grid_del(EPH_grid *g, int x, int y, EPH_body *body)
+{
+	unsigned i;
+	EPH_gridbucket *b = g->buckets + grid_hash(g, x, y);
+	for(i = 0; i < b->n; ++i)
+		if(b->entries[i].body == body && b->entries[i].x == x &&
+				b->entries[i].y == y)
+		{
+			b->entries[i] = b->entries[--b->n];
+			--g->entries;
+			return;
+		}
+}
+
+static void grid_remove(EPH_space *space, EPH_body *body)
+{
+	EPH_grid *g = &space->grid;
+	int x, y;
+	switch(body->gridmode)
+	{
+	  case EPH_GOUT:
+		return;
+	  case EPH_GCELLS:
+		for(y = body->gy0; y <= body->gy1; ++y)
+			for(x = body->gx0; x <= body->gx1; ++x)
+				grid_del(g, x, y, body);
+		break;
+	  case EPH_GLARGE:
+		g->large[body->gridindex] = g->large[--g->nlarge];
+		g->large[body->gridindex]->gridindex = body->gridindex;
+		break;
+	}
+	body->gridmode = EPH_GOUT;
+	++g->stamp;
+}
+
+/*
+ * Bring the grid up to date with the position, display position and radius of
+ * 'body'. This is a no-op unless the body has moved into a different set of
+ * cells.
+ */
+static void grid_update(EPH_body *body)
+{
+	EPH_space *space = body->space;
+	EPH_grid *g;
+	EPH_f r, x0, y0, x1, y1;
+	int gx0, gy0, gx1, gy1, x, y;
+	if(!space || !space->grid.cellsize || body->killed)
+		return;
+	g = &space->grid;
+
+	/* Padded slightly, as the view tests are partly single precision. */
+	r = fabs(body->r) * EPH_CULLSCALE * 1.001f;
+	x0 = (body->c[EPH_X] < body->i[EPH_X] ? body->c[EPH_X] :
+			body->i[EPH_X]) - r;
+	y0 = (body->c[EPH_Y] < body->i[EPH_Y] ? body->c[EPH_Y] :
+			body->i[EPH_Y]) - r;
+	x1 = (body->c[EPH_X] > body->i[EPH_X] ? body->c[EPH_X] :
+			body->i[EPH_X]) + r;
+	y1 = (body->c[EPH_Y] > body->i[EPH_Y] ? body->c[EPH_Y] :
+			body->i[EPH_Y]) + r;
+	x0 *= g->scale;
+	y0 *= g->scale;
+	x1 *= g->scale;
+	y1 *= g->scale;
+
+	/* NOTE: This also sends NaNs and infinities to the 'large' list! */
+	if(!(x0 >= -EPH_GRID_MAXCOORD && y0 >= -EPH_GRID_MAXCOORD &&
+			x1 <= EPH_GRID_MAXCOORD && y1 <= EPH_GRID_MAXCOORD))
+		gx0 = gy0 = 0, gx1 = gy1 = EPH_GRID_MAXCELLS;
+	else
+	{
+		gx0 = floor(x0);
+		gy0 = floor(y0);
+		gx1 = floor(x1);
+		gy1 = floor(y1);
+	}
+	if(gx1 - gx0 >= EPH_GRID_MAXCELLS || gy1 - gy0 >= EPH_GRID_MAXCELLS ||
+			(gx1 - gx0 + 1) * (gy1 - gy0 + 1) > EPH_GRID_MAXCELLS)
+	{
+		if(body->gridmode == EPH_GLARGE)
+			return;
+		grid_remove(space, body);
+		if(g->nlarge >= g->largesize)
+		{
+			unsigned ns = g->largesize ? g->largesize * 2 : 16;
+			EPH_body **nl = (EPH_body **)realloc(g->large,
+					ns * sizeof(EPH_body *));
+			if(!nl)
+			{
+				grid_disable(space);
+				return;
+			}
+			g->large = nl;
+			g->largesize = ns;
+		}
+		body->gridindex = g->nlarge;
+		g->large[g->nlarge++] = body;
+		body->gridmode = EPH_GLARGE;
+		++g->stamp;
+		return;
+	}
+	if(body->gridmode == EPH_GCELLS && gx0 == body->gx0 &&
+			gy0 == body->gy0 && gx1 == body->gx1 &&
+			gy1 == body->gy1)
+		return;
+	grid_remove(space, body);
+	for(y = gy0; y <= gy1; ++y)
+		for(x = gx0; x <= gx1; ++x)
+			if(grid_add(g, x, y, body))
+			{
+				grid_disable(space);
+				return;
+			}
+	body->gx0 = gx0;
+	body->gy0 = gy0;
+	body->gx1 = gx1;
+	body->gy1 = gy1;
+	body->gridmode = EPH_GCELLS;
+	++g->stamp;
+}
+
+/* Change the grid cell size, rebuilding the grid. 0 disables the grid. */
+static void grid_setsize(EPH_space *space, double cellsize)
+{
+	EPH_body *b;
+	EPH_grid *g = &space->grid;
+	for(b = space->first; b; b = b->next)
+		b->gridmode = EPH_GOUT;
+	grid_free(g);
+	if(cellsize > 0.0f && isfinite(cellsize))
+	{
+		g->cellsize = cellsize;
+		g->scale = 1.0f / cellsize;
+	}
+	else
+		g->cellsize = g->scale = 0.0f;
+	for(b = space->first; b; b = b->next)
+		grid_update(b);
+}
+
+static int bodyserial_cmp(const void *a, const void *b)
+{
+	const EPH_body *ba = *(const EPH_body **)a;
+	const EPH_body *bb = *(const EPH_body **)b;
+	if(ba->serial != bb->serial)
+		return ba->serial < bb->serial ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Make sure the 'view' list of the grid holds all bodies that may be in the
+ * specified view rectangle, sorted in body list order. Returns 0 if the grid
+ * cannot be used for this, in which case the caller should scan the body list.
+ */
+static int grid_view(EPH_space *space, float xmin, float ymin,
+		float xmax, float ymax)
+{
+	EPH_grid *g = &space->grid;
+	EPH_f x0, y0, x1, y1;
+	int gx0, gy0, gx1, gy1, x, y;
+	unsigned i, j;
+	if(!g->cellsize)
+		return 0;
+	x0 = xmin * g->scale;
+	y0 = ymin * g->scale;
+	x1 = xmax * g->scale;
+	y1 = ymax * g->scale;
+	if(!(x0 >= -EPH_GRID_MAXCOORD && y0 >= -EPH_GRID_MAXCOORD &&
+			x1 <= EPH_GRID_MAXCOORD && y1 <= EPH_GRID_MAXCOORD))
+		return 0;
+	gx0 = floor(x0);
+	gy0 = floor(y0);
+	gx1 = floor(x1);
+	gy1 = floor(y1);
+
+	/* Scanning more cells than there are bodies doesn't pay off! */
+	if((double)(gx1 - gx0 + 1) * (gy1 - gy0 + 1) > space->active)
+		return 0;
+
+	if(g->viewvalid && g->viewstamp == g->stamp && gx0 == g->vx0 &&
+			gy0 == g->vy0 && gx1 == g->vx1 && gy1 == g->vy1)
+		return 1;
+
+	g->viewvalid = 0;
+	g->nview = 0;
+	for(y = gy0; g->nbuckets && y <= gy1; ++y)
+		for(x = gx0; x <= gx1; ++x)
+		{
+			EPH_gridbucket *b = g->buckets + grid_hash(g, x, y);
+			for(i = 0; i < b->n; ++i)
+			{
+				if(b->entries[i].x != x || b->entries[i].y != y)
+					continue;
+				if(g->nview >= g->viewsize)
+				{
+					unsigned ns = g->viewsize ?
+							g->viewsize * 2 : 64;
+					EPH_body **nv = (EPH_body **)realloc(
+							g->view, ns *
+							sizeof(EPH_body *));
+					if(!nv)
+						return 0;
+					g->view = nv;
+					g->viewsize = ns;
+				}
+				g->view[g->nview++] = b->entries[i].body;
+			}
+		}
+	if(g->nview + g->nlarge > g->viewsize)
+	{
+		unsigned ns = g->nview + g->nlarge;
+		EPH_body **nv = (EPH_body **)realloc(g->view,
+				ns * sizeof(EPH_body *));
+		if(!nv)
+			return 0;
+		g->view = nv;
+		g->viewsize = ns;
+	}
+	for(i = 0; i < g->nlarge; ++i)
+		g->view[g->nview++] = g->large[i];
+
+	/* Sort, and remove duplicates from bodies covering multiple cells */
+	if(g->nview)
+	{
+		qsort(g->view, g->nview, sizeof(EPH_body *), bodyserial_cmp);
+		for(i = j = 1; i < g->nview; ++i)
+			if(g->view[i] != g->view[j - 1])
+				g->view[j++] = g->view[i];
+		g->nview = j;
+	}
+
+	g->viewvalid = 1;
+	g->viewstamp = g->stamp;
+	g->vx0 = gx0;
+	g->vy0 = gy0;
+	g->vx1 = gx1;
+	g->vy1 = gy1;
+	return 1;
+}
+
+
 static inline EEL_xno kill_body(EPH_body *body, int warndead)
 {
 	if(body->killed)
@@ -88,8 +609,10 @@ FIXME: Might be something to look into...
 	{
 		--body->space->active;
 		body->space->clean_constraints = 1;
+		grid_remove(body->space, body);
 	}
 	body->killed = 1;
+	bd_kill(body);
 	if(body->methods[EPH_CLEANUP])
 	{
 		EEL_object *bo = EPH_body2o(body);
@@ -100,6 +623,127 @@ FIXME: Might be something to look into...
 }
 
 
+/*----------------------------------------------------------
+	Worker threads
+----------------------------------------------------------*/
+
+/* Process parts of the current job until there are none left */
+static void pool_work(EPH_pool *p)
+{
+	unsigned parts = p->space->work.parts;
+	while(1)
+	{
+		unsigned part = SDL_AtomicAdd(&p->next, 1);
+		if(part >= parts)
+			return;
+		p->run(p->space, part);
+	}
+}
+
+static int pool_worker(void *data)
+{
+	EPH_pool *p = (EPH_pool *)data;
+	while(1)
+	{
+		SDL_SemWait(p->go);
+		if(p->quit)
+			return 0;
+		pool_work(p);
+		SDL_SemPost(p->done);
+	}
+}
+
+/* Make sure there are at least 'n' worker threads */
+static EEL_xno pool_grow(unsigned n)
+{
+	EPH_pool *p = &eph_md.pool;
+	if(p->nthreads >= n)
+		return 0;
+	if(!p->go && !(p->go = SDL_CreateSemaphore(0)))
+		return EEL_XTHREADCREATE;
+	if(!p->done && !(p->done = SDL_CreateSemaphore(0)))
+		return EEL_XTHREADCREATE;
+	while(p->nthreads < n)
+	{
+		SDL_Thread *t = SDL_CreateThread(pool_worker, "physics-worker",
+				p);
+		if(!t)
+			return EEL_XTHREADCREATE;
+		p->threads[p->nthreads++] = t;
+	}
+	return 0;
+}
+
+static void pool_close(void)
+{
+	EPH_pool *p = &eph_md.pool;
+	unsigned i;
+	p->quit = 1;
+	for(i = 0; i < p->nthreads; ++i)
+		SDL_SemPost(p->go);
+	for(i = 0; i < p->nthreads; ++i)
+		SDL_WaitThread(p->threads[i], NULL);
+	if(p->go)
+		SDL_DestroySemaphore(p->go);
+	if(p->done)
+		SDL_DestroySemaphore(p->done);
+	memset(p, 0, sizeof(EPH_pool));
+}
+
+/*
+ * Run 'run' for parts [0, space->threads) of a job, and wait for all of them
+ * to finish. Parts may run in any order, on any thread, so they must not
+ * write to the same state.
+ */
+static void pool_run(EPH_space *space, void (*run)(EPH_space *, unsigned))
+{
+	EPH_pool *p = &eph_md.pool;
+	unsigned i, helpers;
+	space->work.parts = space->threads;
+	helpers = space->threads - 1;
+	if(helpers > p->nthreads)
+		helpers = p->nthreads;
+	p->space = space;
+	p->run = run;
+	SDL_AtomicSet(&p->next, 0);
+	for(i = 0; i < helpers; ++i)
+		SDL_SemPost(p->go);
+	pool_work(p);
+	for(i = 0; i < helpers; ++i)
+		SDL_SemWait(p->done);
+}
+
+/* Range [*start, *end) of 'n' items for part 'part' of the current job */
+static inline void part_range(EPH_space *space, unsigned n, unsigned part,
+		unsigned *start, unsigned *end)
+{
+	unsigned parts = space->work.parts;
+	*start = (uint64_t)n * part / parts;
+	*end = (uint64_t)n * (part + 1) / parts;
+}
+
+static EEL_xno set_threads(EPH_space *space, long n)
+{
+	EEL_xno x;
+	if(n < 0)
+		return EEL_XLOWVALUE;
+	if(n > EPH_MAXTHREADS)
+		return EEL_XHIGHVALUE;
+	if((n > 1) && (x = pool_grow(n - 1)))
+		return x;
+	space->threads = n;
+	return 0;
+}
+
+static void work_free(EPH_work *w)
+{
+	free(w->zresults);
+	free(w->zhits);
+	free(w->cresults);
+	memset(w, 0, sizeof(EPH_work));
+}
+
+
 /*----------------------------------------------------------
 	space class
 ----------------------------------------------------------*/
@@ -120,11 +764,18 @@ static EEL_xno space_construct(EEL_vm *vm, EEL_classes cid,
 	if(xno)
 		return xno;
 	space->table = eel_v2o(&v);
+	if(!(space->data = bd_open()))
+	{
+		eel_disown(eo);
+		return EEL_XMEMORY;
+	}
 	space->vxmin = space->vymin = -1e10f;
 	space->vxmax = space->vymax = 1e10f;
 	space->integration = EPH_VERLET;
 	space->outputmode = EPH_SEMIEXTRA;
 	space->rngstate = EPH_DEFAULTRNGSEED;
+	space->grid.cellsize = EPH_DEFAULTGRIDSIZE;
+	space->grid.scale = 1.0f / EPH_DEFAULTGRIDSIZE;
 	zmap = &space->zmap;
 	zmap->w = zmap->h = 10;
 	zmap->data = calloc(zmap->w, zmap->h);
@@ -153,10 +804,21 @@ static EEL_xno space_destruct(EEL_object *eo)
 	{
 		EPH_body *nb = body->next;
 		eph_UnlinkBody(space, body);
+		bd_unlink(body);
 		kill_body(body, 0);
 		eel_disown(EPH_body2o(body));
 		body = nb;
 	}
+	grid_free(&space->grid);
+	work_free(&space->work);
+	if(space->data)
+	{
+		/* Bodies still referenced keep the storage around! */
+		space->data->orphaned = 1;
+		if(!space->data->used)
+			bd_close(space->data);
+		space->data = NULL;
+	}
 	eel_disown(space->table);
 	space->table = NULL;
 	return 0;
@@ -215,6 +877,10 @@ static EEL_xno space_getindex(EEL_object *eo, EEL_value *op1, EEL_value *op2)
 			eel_d2v(op2, space->overlap_correct_z);	return 0;
 
 	  case EPH_SRNGSEED:	eel_l2v(op2, space->rngstate);	return 0;
+
+	  case EPH_SGRIDSIZE:	eel_d2v(op2, space->grid.cellsize);return 0;
+
+	  case EPH_STHREADS:	eel_l2v(op2, space->threads);	return 0;
 	}
 	return EEL_XWRONGINDEX;
 }
@@ -265,6 +931,10 @@ static EEL_xno space_setindex(EEL_object *eo, EEL_value *op1, EEL_value *op2)
 			space->overlap_correct_z = eel_v2d(op2); return 0;
 
 	  case EPH_SRNGSEED:	space->rngstate = eel_v2l(op2);	return 0;
+
+	  case EPH_SGRIDSIZE:	grid_setsize(space, eel_v2d(op2));return 0;
+
+	  case EPH_STHREADS:	return set_threads(space, eel_v2l(op2));
 	}
 	return EEL_XWRONGINDEX;
 }
@@ -429,20 +1099,15 @@ static EEL_xno eph_testlinez(EEL_vm *vm)
 	body class
 ----------------------------------------------------------*/
 
-static inline void advance(EPH_body *body)
+/*
+ * Velocity after one frame. The state vectors are integrated one value at a
+ * time, so we do the same for all dimensions.
+ */
+static inline EPH_f new_velocity(EPH_f v, EPH_f f, EPH_f rf, EPH_f m1,
+		EPH_f u, EPH_f cd)
 {
-	int i;
-	EPH_f tmp[EPH_DIMS];
-	EPH_f a[EPH_DIMS];
-	if(body->killed)
-		return;
-
-	/* Shift coordinates for interpolation */
-	memcpy(body->o, body->c, sizeof(body->o));
-
 	/* Apply forces to acceleration */
-	for(i = 0; i < EPH_DIMS; ++i)
-		a[i] = (body->f[i] + body->rf[i]) * body->m1[i];
+	EPH_f a = (f + rf) * m1;
 
 	/*
 	 * Apply frictional forces to acceleration
@@ -450,78 +1115,133 @@ static inline void advance(EPH_body *body)
 	 *	We assume that friction changes linearly with
 	 *	mass, so mass is ignored here!
 	 */
-	for(i = 0; i < EPH_DIMS; ++i)
-		a[i] -= body->v[i] * body->u[i];
+	a -= v * u;
 
 	/* Apply drag forces to acceleration */
-	for(i = 0; i < EPH_DIMS; ++i)
-		a[i] -= body->v[i] * fabs(body->v[i]) * body->cd[i];
-
-	/* Backup velocities */
-	if(body->space->integration == EPH_VERLET)
-		memcpy(tmp, body->v, sizeof(tmp));
+	a -= v * fabs(v) * cd;
 
 	/* Apply acceleration to velocity */
-	for(i = 0; i < EPH_DIMS; ++i)
-	{
-		body->v[i] += a[i];
-		if(body->v[i] > EPH_MAX_VELOCITY)
-			body->v[i] = EPH_MAX_VELOCITY;
-		else if(body->v[i] < -EPH_MAX_VELOCITY)
-			body->v[i] = -EPH_MAX_VELOCITY;
-	}
+	v += a;
+	if(v > EPH_MAX_VELOCITY)
+		v = EPH_MAX_VELOCITY;
+	else if(v < -EPH_MAX_VELOCITY)
+		v = -EPH_MAX_VELOCITY;
+	return v;
+}
+
+/*
+ * Integrate the state vector values [start, end). This is all live bodies in
+ * a space for Advance(space), and the EPH_DIMS values of the body for
+ * Advance(body).
+ */
+static void integrate(EPH_bodydata *bd, EPH_integmodes mode,
+		unsigned start, unsigned end)
+{
+	unsigned k;
+	EPH_f *o = bd->v[EPH_VO];
+	EPH_f *c = bd->v[EPH_VC];
+	EPH_f *v = bd->v[EPH_VV];
+	EPH_f *f = bd->v[EPH_VF];
+	EPH_f *rf = bd->v[EPH_VRF];
+	EPH_f *u = bd->v[EPH_VU];
+	EPH_f *cd = bd->v[EPH_VCD];
+	EPH_f *m1 = bd->v[EPH_VM1];
+	if(start >= end)
+		return;
 
-	/* Apply velocity to position */
-	if(body->space->integration == EPH_VERLET)
-		for(i = 0; i < EPH_DIMS; ++i)
-			body->c[i] += (body->v[i] + tmp[i]) * 0.5f;
+	/*
+	 * Shift coordinates for interpolation, and apply velocity to position
+	 */
+	if(mode == EPH_VERLET)
+		for(k = start; k < end; ++k)
+		{
+			EPH_f v0 = v[k];
+			EPH_f v1 = new_velocity(v0, f[k], rf[k], m1[k], u[k],
+					cd[k]);
+			v[k] = v1;
+			o[k] = c[k];
+			c[k] += (v1 + v0) * 0.5f;
+		}
 	else
-		for(i = 0; i < EPH_DIMS; ++i)
-			body->c[i] += body->v[i];
+		for(k = start; k < end; ++k)
+		{
+			EPH_f v1 = new_velocity(v[k], f[k], rf[k], m1[k],
+					u[k], cd[k]);
+			v[k] = v1;
+			o[k] = c[k];
+			c[k] += v1;
+		}
 
 #ifdef CONSTRAINTS_NEED_IMPULSEFORCES
 	/* EPH_IMPULSEFORCES ==> forces reset after being applied once */
-	if(body->flags & EPH_IMPULSEFORCES)
+	for(k = start / EPH_DIMS; k < end / EPH_DIMS; ++k)
+		if(bd->bodies[k]->flags & EPH_IMPULSEFORCES)
+			memset(f + k * EPH_DIMS, 0, EPH_DIMS * sizeof(EPH_f));
+#else
+	memset(f + start, 0, (end - start) * sizeof(EPH_f));
 #endif
-		for(i = 0; i < EPH_DIMS; ++i)
-			body->f[i] = 0.0f;
 
 	/* Response forces are always impulses here */
-	for(i = 0; i < EPH_DIMS; ++i)
-		body->rf[i] = 0.0f;
+	memset(rf + start, 0, (end - start) * sizeof(EPH_f));
 }
 
 
-static inline void om_latest(EPH_body *body)
+/* Worker job: Integrate part of the live bodies of a space */
+static void advance_part(EPH_space *space, unsigned part)
 {
-	memcpy(body->i, body->c, sizeof(body->i));
+	unsigned start, end;
+	part_range(space, space->data->live, part, &start, &end);
+	integrate(space->data, space->integration, start * EPH_DIMS,
+			end * EPH_DIMS);
 }
 
 
-static inline void om_tween(EPH_body *body, float weight)
-{
-	int i;
-	float w1 = 1.0f - weight;
-	for(i = 0; i < EPH_DIMS; ++i)
-		body->i[i] = body->o[i] * w1 + body->c[i] * weight;
-}
-
-
-static inline void om_extrapolate(EPH_body *body, float weight)
+static inline void advance(EPH_body *body)
 {
-	int i;
-	for(i = 0; i < EPH_DIMS; ++i)
-		body->i[i] = body->c[i] + body->v[i] * weight;
+	if(body->killed)
+		return;
+	integrate(body->data, body->space->integration,
+			body->slot * EPH_DIMS, (body->slot + 1) * EPH_DIMS);
+	grid_update(body);
 }
 
 
-static inline void om_semiextra(EPH_body *body, float weight)
+/*
+ * Calculate display positions for state vector values [start, end).
+ *
+ * NOTE: 'weight' is single precision, as it has always been.
+ */
+static void tween(EPH_bodydata *bd, EPH_outputmodes mode, float weight,
+		unsigned start, unsigned end)
 {
-	int i;
+	unsigned k;
 	float w1 = 1.0f - weight;
-	for(i = 0; i < EPH_DIMS; ++i)
-		body->i[i] = (body->c[i] + body->v[i] * weight +
-				body->o[i] * w1 + body->c[i] * weight) * .5f;
+	EPH_f *i = bd->v[EPH_VI];
+	EPH_f *o = bd->v[EPH_VO];
+	EPH_f *c = bd->v[EPH_VC];
+	EPH_f *v = bd->v[EPH_VV];
+	if(start >= end)
+		return;
+	switch(mode)
+	{
+	  case EPH_LATEST:
+	  default:
+		memcpy(i + start, c + start, (end - start) * sizeof(EPH_f));
+		break;
+	  case EPH_TWEEN:
+		for(k = start; k < end; ++k)
+			i[k] = o[k] * w1 + c[k] * weight;
+		break;
+	  case EPH_EXTRAPOLATE:
+		for(k = start; k < end; ++k)
+			i[k] = c[k] + v[k] * weight;
+		break;
+	  case EPH_SEMIEXTRA:
+		for(k = start; k < end; ++k)
+			i[k] = (c[k] + v[k] * weight +
+					o[k] * w1 + c[k] * weight) * .5f;
+		break;
+	}
 }
 
 
@@ -539,33 +1259,34 @@ static EEL_xno eph_advance(EEL_vm *vm)
 	else if(EEL_CLASS(arg) == eph_md.space_cid)
 	{
 		EPH_space *space = o2EPH_space(arg->objref.v);
-		EPH_body *body;
+		EPH_bodydata *bd = space->data;
+		unsigned k;
+		if(space->threads > 1)
+			pool_run(space, advance_part);
+		else
+			integrate(bd, space->integration, 0,
+					bd->live * EPH_DIMS);
+		if(space->grid.cellsize)
+			for(k = 0; k < bd->live; ++k)
+				grid_update(bd->bodies[k]);
 #if EPH_DOMAIN_CHECKS == 1
-		for(body = space->first; body; body = body->next)
+		for(k = 0; k < bd->linked * EPH_DIMS; ++k)
 		{
-			int i;
-			advance(body);
-			for(i = 0; i < EPH_DIMS; ++i)
+			if(!isfinite(bd->v[EPH_VV][k]))
 			{
-				if(!isfinite(body->v[i]))
-				{
-					printf("eph_advance(): DOMAIN ERROR: "
-							"v%c = %f\n", 'x' + i,
-							body->v[i]);
-					return EEL_XDOMAIN;
-				}
-				if(!isfinite(body->c[i]))
-				{
-					printf("eph_advance(): DOMAIN ERROR: "
-							"c%c = %f\n", 'x' + i,
-							body->c[i]);
-					return EEL_XDOMAIN;
-				}
+				printf("eph_advance(): DOMAIN ERROR: "
+						"v%c = %f\n", 'x' + k % EPH_DIMS,
+						bd->v[EPH_VV][k]);
+				return EEL_XDOMAIN;
+			}
+			if(!isfinite(bd->v[EPH_VC][k]))
+			{
+				printf("eph_advance(): DOMAIN ERROR: "
+						"c%c = %f\n", 'x' + k % EPH_DIMS,
+						bd->v[EPH_VC][k]);
+				return EEL_XDOMAIN;
 			}
 		}
-#else
-		for(body = space->first; body; body = body->next)
-			advance(body);
 #endif
 		return 0;
 	}
@@ -586,7 +1307,9 @@ static EEL_xno eph_tween(EEL_vm *vm)
 	if(EEL_CLASS(args) == eph_md.body_cid)
 	{
 		EPH_body *body = o2EPH_body(args->objref.v);
-		tween(body, w);
+		tween(body->data, body->space->outputmode, w,
+				body->slot * EPH_DIMS,
+				(body->slot + 1) * EPH_DIMS);
 		return 0;
 	}
 	else
@@ -594,27 +1317,13 @@ static EEL_xno eph_tween(EEL_vm *vm)
 	if(EEL_CLASS(args) == eph_md.space_cid)
 	{
 		EPH_space *space = o2EPH_space(args->objref.v);
-		EPH_body *body;
-		switch(space->outputmode)
-		{
-		  case EPH_LATEST:
-		  default:
-			for(body = space->first; body; body = body->next)
-				om_latest(body);
-			break;
-		  case EPH_TWEEN:
-			for(body = space->first; body; body = body->next)
-				om_tween(body, w);
-			break;
-		  case EPH_EXTRAPOLATE:
-			for(body = space->first; body; body = body->next)
-				om_extrapolate(body, w);
-			break;
-		  case EPH_SEMIEXTRA:
-			for(body = space->first; body; body = body->next)
-				om_semiextra(body, w);
-			break;
-		}
+		EPH_bodydata *bd = space->data;
+		unsigned k;
+		/* All bodies in the list; killed or not */
+		tween(bd, space->outputmode, w, 0, bd->linked * EPH_DIMS);
+		if(space->grid.cellsize)
+			for(k = 0; k < bd->live; ++k)
+				grid_update(bd->bodies[k]);
 		return 0;
 	}
 	else
@@ -755,43 +1464,156 @@ static inline EEL_xno check_z_collisions(EEL_vm *vm, EPH_space *space,
 	return 0;
 }
 
+/* CollideZ() for one body */
+static inline EEL_xno collidez_body(EEL_vm *vm, EPH_space *space, EPH_body *b,
+		unsigned mask)
+{
+	EPH_zmap *m = &space->zmap;
+	if(!(b->group & mask) && b->methods[EPH_HITZ])
+	{
+		EEL_xno x;
+		/*
+		 * Hack for keeping things from falling forever with
+		 * "noclip"; we pretend we're off-map all the time...
+		 */
+		if(b->z > m->off)
+			return 0;
+		x = eel_callf(vm, b->methods[EPH_HITZ], "orrr", EPH_body2o(b),
+				(EEL_real)b->c[EPH_X], (EEL_real)b->c[EPH_Y],
+				(EEL_real)m->off);
+		if(x)
+			return x;
+		if(b->killed)
+			return 0;
+	}
+	return check_z_collisions(vm, space, b, m);
+}
+
+/*
+ * check_z_collisions() for the worker threads, for bodies without HitZ() or
+ * Impact() methods.
+ */
+static inline void check_z_contacts(EPH_body *b, EPH_zmap *m)
+{
+	float xa = b->c[EPH_X] * m->scale;
+	float ya = b->c[EPH_Y] * m->scale;
+	float r = b->r * m->scale;
+	float scale_inv = 1.0f / m->scale;
+	int i;
+	float da;
+	int points = ceil(r * 2.0f * M_PI / EPH_ZTEST_DENSITY);
+	if(points < 4)
+		points = 4;
+	da = 2.0f * M_PI / points;
+	for(i = 0; i < points; ++i)
+	{
+		float a = i * da;
+		float x = xa + r * cos(a);
+		float y = ya + r * sin(a);
+		float mz = eph_getzi_raw(m, x, m->h - y);
+		if(b->z > mz)
+			continue;
+		apply_z_response(NULL, b, m, x * scale_inv, y * scale_inv, mz);
+	}
+}
+
+/*
+ * Worker job: Z collision tests and responses for part of the live bodies.
+ *
+ * HitZ() and Impact() may change the body between contacts, or other bodies,
+ * so bodies with either method are left to collidez_body() on the VM thread,
+ * where the responses and callbacks are interleaved exactly as with N = 0.
+ */
+static void collidez_part(EPH_space *space, unsigned part)
+{
+	EPH_work *w = &space->work;
+	EPH_bodydata *bd = space->data;
+	unsigned k, start, end;
+	part_range(space, bd->live, part, &start, &end);
+	for(k = start; k < end; ++k)
+	{
+		EPH_body *b = bd->bodies[k];
+		EPH_zresult *zr = &w->zresults[k];
+		zr->body = NULL;
+		if(!b->methods[EPH_HITZ] & !(b->flags & EPH_ZRESPONSE))
+			continue;
+		if(b->methods[EPH_HITZ] || b->methods[EPH_IMPACT])
+			zr->body = b;
+		else
+			check_z_contacts(b, &space->zmap);
+	}
+}
+
+/* eph_collidez() on the worker pool, with deferred callbacks */
+static EEL_xno collidez_threaded(EEL_vm *vm, EPH_space *space, unsigned mask)
+{
+	EPH_work *w = &space->work;
+	EPH_bodydata *bd = space->data;
+	EPH_body *b;
+	EEL_xno x = 0;
+	unsigned i, n;
+	if(w->zsize < bd->live)
+	{
+		unsigned size = bd->live + bd->live / 2;
+		EPH_zresult *zr = realloc(w->zresults,
+				size * sizeof(EPH_zresult));
+		if(!zr)
+			return EEL_XMEMORY;
+		w->zresults = zr;
+		if(!(zr = realloc(w->zhits, size * sizeof(EPH_zresult))))
+			return EEL_XMEMORY;
+		w->zhits = zr;
+		w->zsize = size;
+	}
+	pool_run(space, collidez_part);
+
+	/*
+	 * Collect the bodies to call back in list order, as callbacks may
+	 * reorder the slots. Hold on to them, as callbacks may also free them!
+	 */
+	n = 0;
+	for(b = space->first; b; b = b->next)
+	{
+		EPH_zresult *zr;
+		if(b->killed)
+			continue;
+		zr = &w->zresults[b->slot];
+		if(!zr->body)
+			continue;
+		eel_own(EPH_body2o(b));
+		w->zhits[n++] = *zr;
+	}
+
+	w->busy = 1;
+	for(i = 0; i < n; ++i)
+	{
+		b = w->zhits[i].body;
+		if(!x && !b->killed)
+			x = collidez_body(vm, space, b, mask);
+		eel_disown(EPH_body2o(b));
+	}
+	w->busy = 0;
+	return x;
+}
+
 static EEL_xno eph_collidez(EEL_vm *vm)
 {
 	EPH_space *space;
 	EPH_body *b;
 	EEL_value *args = vm->heap + vm->argv;
 	unsigned mask = eel_v2l(args + 1);
-	EPH_zmap *m;
 	if(EEL_CLASS(args) != eph_md.space_cid)
 		return EEL_XWRONGTYPE;
 	space = o2EPH_space(args->objref.v);
-	m = &space->zmap;
+	if(space->threads && !space->work.busy)
+		return collidez_threaded(vm, space, mask);
 	for(b = space->first; b; b = b->next)
 	{
 		EEL_xno x;
 		if(b->killed || (!b->methods[EPH_HITZ] &
 				!(b->flags & EPH_ZRESPONSE)))
 			continue;
-		if(!(b->group & mask) && b->methods[EPH_HITZ])
-		{
-			/*
-			 * Hack for keeping things from falling forever with
-			 * "noclip"; we pretend we're off-map all the time...
-			 */
-			if(b->z > m->off)
-				continue;
-			x = eel_callf(vm, b->methods[EPH_HITZ],
-					"orrr", EPH_body2o(b),
-					(EEL_real)b->c[EPH_X],
-					(EEL_real)b->c[EPH_Y],
-					(EEL_real)m->off);
-			if(x)
-				return x;
-			if(b->killed)
-				continue;
-		}
-		x = check_z_collisions(vm, space, b, m);
-		if(x)
+		if((x = collidez_body(vm, space, b, mask)))
 			return x;
 	}
 	return 0;
@@ -908,6 +1730,120 @@ static inline EEL_xno check_collision(EEL_vm *vm, EPH_body *b1, EPH_body *b2)
 }
 
 
+/*
+ * Fill the candidate buffer with the bodies that share a cell with 'b1', or
+ * are in the 'large' list, and come after 'after' in the body list, sorted
+ * in list order. Returns the number of candidates, or -1 if we run out of
+ * memory.
+ */
+static int grid_candidates(EPH_grid *g, EPH_body *b1, EPH_body *after)
+{
+	unsigned i, j, n = 0;
+	int x, y;
+	for(y = b1->gy0; g->nbuckets && y <= b1->gy1; ++y)
+		for(x = b1->gx0; x <= b1->gx1; ++x)
+		{
+			EPH_gridbucket *b = g->buckets + grid_hash(g, x, y);
+			for(i = 0; i < b->n; ++i)
+			{
+				EPH_gridentry *e = b->entries + i;
+				if(e->x != x || e->y != y ||
+						e->body->serial <= after->serial)
+					continue;
+				if(n >= g->candsize)
+				{
+					unsigned ns = g->candsize ?
+							g->candsize * 2 : 64;
+					EPH_body **nc = (EPH_body **)realloc(
+							g->cand, ns *
+							sizeof(EPH_body *));
+					if(!nc)
+						return -1;
+					g->cand = nc;
+					g->candsize = ns;
+				}
+				g->cand[n++] = e->body;
+			}
+		}
+	if(n + g->nlarge > g->candsize)
+	{
+		unsigned ns = n + g->nlarge;
+		EPH_body **nc = (EPH_body **)realloc(g->cand,
+				ns * sizeof(EPH_body *));
+		if(!nc)
+			return -1;
+		g->cand = nc;
+		g->candsize = ns;
+	}
+	for(i = 0; i < g->nlarge; ++i)
+		if(g->large[i]->serial > after->serial)
+			g->cand[n++] = g->large[i];
+
+	/* Sort, and remove duplicates from bodies covering multiple cells */
+	if(n)
+	{
+		qsort(g->cand, n, sizeof(EPH_body *), bodyserial_cmp);
+		for(i = j = 1; i < n; ++i)
+			if(g->cand[i] != g->cand[j - 1])
+				g->cand[j++] = g->cand[i];
+		n = j;
+	}
+	return n;
+}
+
+/*
+ * Test 'b1' against the bodies after it in the body list, in list order, as
+ * the brute force loops would, but only against bodies that share a grid cell
+ * with it. Callbacks may create, move or kill bodies, or change masks, so we
+ * check the masks as we go, and gather the candidates again, after the last
+ * body tested, whenever the grid has changed. Large bodies are tested against
+ * everything after them, as are all bodies if we run out of memory.
+ */
+static EEL_xno collide_grid(EEL_vm *vm, EPH_space *space, EPH_body *b1)
+{
+	EPH_grid *g = &space->grid;
+	EPH_body *b2 = b1;
+	EEL_xno x = 0;
+	while(!b1->killed && g->cellsize && b1->gridmode == EPH_GCELLS)
+	{
+		unsigned stamp = g->stamp;
+		int i, n = grid_candidates(g, b1, b2);
+		EPH_body **cand = g->cand;
+		unsigned candsize = g->candsize;
+		if(n < 0)
+			break;
+
+		/* Hold on to the buffer, in case a callback calls Collide()! */
+		g->cand = NULL;
+		g->candsize = 0;
+		for(i = 0; i < n; ++i)
+		{
+			b2 = cand[i];
+			if(!(b2->group & b1->hitmask ||
+					b1->group & b2->hitmask))
+				continue;
+			if((x = check_collision(vm, b1, b2)))
+				break;
+			if(g->stamp != stamp)
+				break;
+		}
+		free(g->cand);
+		g->cand = cand;
+		g->candsize = candsize;
+		if(x || (i >= n))
+			return x;
+	}
+
+	/* Large body, or out of memory */
+	if(b1->killed)
+		return 0;
+	for(b2 = b2->next; b2; b2 = b2->next)
+		if(b2->group & b1->hitmask || b1->group & b2->hitmask)
+			if((x = check_collision(vm, b1, b2)))
+				return x;
+	return 0;
+}
+
 static EEL_xno eph_collide(EEL_vm *vm)
 {
 	EPH_space *space;
@@ -916,6 +1852,16 @@ static EEL_xno eph_collide(EEL_vm *vm)
 	if(EEL_CLASS(args) != eph_md.space_cid)
 		return EEL_XWRONGTYPE;
 	space = o2EPH_space(args->objref.v);
+	if(space->grid.cellsize)
+	{
+		for(b1 = space->first; b1; b1 = b1->next)
+		{
+			EEL_xno x = collide_grid(vm, space, b1);
+			if(x)
+				return x;
+		}
+		return 0;
+	}
 	for(b1 = space->first; b1; b1 = b1->next)
 		for(b2 = b1->next; b2; b2 = b2->next)
 			if(b2->group & b1->hitmask || b1->group & b2->hitmask)
@@ -1064,6 +2010,7 @@ static EEL_xno eph_clean(EEL_vm *vm)
 		if(b->killed)
 		{
 			eph_UnlinkBody(space, b);
+			bd_unlink(b);
 			eel_disown(EPH_body2o(b));
 //printf("### deleted body %p\n", b);
 		}
@@ -1101,6 +2048,11 @@ static EEL_xno body_construct(EEL_vm *vm, EEL_classes cid,
 	}
 	space = o2EPH_space(initv->objref.v);
 	body->space = space;
+	if(bd_alloc(space->data, body))
+	{
+		eel_o_free(eo);
+		return EEL_XMEMORY;
+	}
 	switch(initc)
 	{
 	  case 7:
@@ -1112,6 +2064,7 @@ static EEL_xno body_construct(EEL_vm *vm, EEL_classes cid,
 			 * Future versions will require that a body is a member
 			 * of exactly one group!
 			 */
+			bd_free(body);
 			eel_o_free(eo);
 			return EEL_XBADVALUE;
 		}
@@ -1136,11 +2089,13 @@ static EEL_xno body_construct(EEL_vm *vm, EEL_classes cid,
 				eel_v2d(initv + 1);
 		break;
 	  default:
+		bd_free(body);
 		eel_o_free(eo);
 		return EEL_XARGUMENTS;
 	}
 	if(mass <= 0.0f || inertia <= 0.0f)
 	{
+		bd_free(body);
 		eel_o_free(eo);
 		return EEL_XARGUMENTS;
 	}
@@ -1152,12 +2107,14 @@ static EEL_xno body_construct(EEL_vm *vm, EEL_classes cid,
 	xno = eel_o_construct(vm, EEL_CTABLE, NULL, 0, &v);
 	if(xno)
 	{
-		eel_disown(eo);
+		bd_free(body);
+		eel_o_free(eo);
 		return xno;
 	}
 	body->table = eel_v2o(&v);
 	eph_LinkBody(space, body);
 	++space->active;
+	grid_update(body);
 	eel_own(eo);	/* Owned by space! */
 	eel_o2v(result, eo);
 //printf("created body %p\n", body);
@@ -1177,6 +2134,7 @@ static EEL_xno body_destruct(EEL_object *eo)
 		kill_body(body, 0);
 		eph_UnlinkBody(body->space, body);
 	}
+	bd_free(body);
 	for(i = 0; i < EPH_NBODYMETHODS; ++i)
 		if(body->methods[i])
 			eel_disown(body->methods[i]);
@@ -1288,6 +2246,8 @@ static EEL_xno body_setindex(EEL_object *eo, EEL_value *op1, EEL_value *op2)
 	{
 		EPH_f *f = body_get_vector(body, v.integer.v);
 		f[ind] = eel_v2d(op2);
+		if(f == body->c || f == body->i)
+			grid_update(body);
 #if EPH_DOMAIN_CHECKS == 1
 		if(!isfinite(f[ind]))
 		{
@@ -1318,7 +2278,10 @@ static EEL_xno body_setindex(EEL_object *eo, EEL_value *op1, EEL_value *op2)
 	  case EPH_BHITMASK:	body->hitmask = eel_v2l(op2);	return 0;
 	  case EPH_BSHADOWR:	body->shadowr = eel_v2d(op2);	return 0;
 	  case EPH_BZ:		body->z = eel_v2d(op2);		return 0;
-	  case EPH_BR:		body->r = eel_v2d(op2);		return 0;
+	  case EPH_BR:
+		body->r = eel_v2d(op2);
+		grid_update(body);
+		return 0;
 	  case EPH_BE:		body->e = eel_v2d(op2);		return 0;
 	  case EPH_BM:
 	  {
@@ -1585,7 +2548,8 @@ static EEL_xno constraint_setindex(EEL_object *eo, EEL_value *op1, EEL_value *op
 }
 
 
-static inline float apply_damped_spring(EPH_constraint *c)
+/* Calculate the force of damped spring 'c' */
+static inline void damped_spring_force(EPH_constraint *c, EPH_springforce *sf)
 {
 	EPH_spring *s = &c->p.spring;
 	EPH_body *a = c->a;
@@ -1612,7 +2576,12 @@ static inline float apply_damped_spring(EPH_constraint *c)
 	ny = rbyw - rayw;
 	d = sqrt(nx*nx + ny*ny);
 	if(!d)
-		return 0.0f;	/* No direction of forces in the x/y plane! */
+	{
+		/* No direction of forces in the x/y plane! */
+		sf->valid = 0;
+		sf->f = 0.0f;
+		return;
+	}
 
 	/* Normalize the spring direction vector */
 	nx /= d;
@@ -1634,15 +2603,114 @@ static inline float apply_damped_spring(EPH_constraint *c)
 	/* Damping force (A bit dangerous with strong damping...) */
 	f += pdv * s->kd;
 
-	/* Limit and apply total force! */
+	/* Limit total force! */
 	maxf = 1.0f / (a->m1[EPH_X] < b->m1[EPH_X] ? a->m1[EPH_X] : b->m1[EPH_X]);
 	if(f < -maxf)
 		f = -maxf;
 	else if(f > maxf)
 		f = maxf;
-	eph_ForceAtV(a, rax, ray, nx * f, ny * f);
-	eph_ForceAtV(b, rbx, rby, -nx * f, -ny * f);
-	return f;
+	sf->valid = 1;
+	sf->rax = rax;
+	sf->ray = ray;
+	sf->rbx = rbx;
+	sf->rby = rby;
+	sf->nx = nx;
+	sf->ny = ny;
+	sf->f = f;
+}
+
+/* Apply the force of damped spring 'c'. Returns the force. */
+static inline float apply_damped_spring(EPH_constraint *c, EPH_springforce *sf)
+{
+	if(!sf->valid)
+		return 0.0f;
+	eph_ForceAtV(c->a, sf->rax, sf->ray, sf->nx * sf->f, sf->ny * sf->f);
+	eph_ForceAtV(c->b, sf->rbx, sf->rby, -sf->nx * sf->f, -sf->ny * sf->f);
+	return sf->f;
+}
+
+/* Check force 'f' of constraint 'c', and call Broken() if it's too strong */
+static inline EEL_xno check_constraint(EEL_vm *vm, EPH_constraint *c, float f)
+{
+	if(c->maxforce && (fabs(f) > c->maxforce) && c->broken_cb)
+		return eel_callf(vm, c->broken_cb, "o", EPH_constraint2o(c));
+	return 0;
+}
+
+/* Worker job: Calculate forces for part of the live constraints */
+static void constraints_part(EPH_space *space, unsigned part)
+{
+	EPH_work *w = &space->work;
+	unsigned k, start, end;
+	part_range(space, w->nc, part, &start, &end);
+	for(k = start; k < end; ++k)
+		damped_spring_force(w->cresults[k].constraint,
+				&w->cresults[k].sf);
+}
+
+/* eph_applyconstraints() on the worker pool, with deferred callbacks */
+static EEL_xno applyconstraints_threaded(EEL_vm *vm, EPH_space *space)
+{
+	EPH_work *w = &space->work;
+	EPH_constraint *c = space->firstc;
+	EEL_xno x = 0;
+	unsigned i;
+
+	/*
+	 * Collect the live constraints in list order. Hold on to them, as
+	 * Broken() callbacks may free them!
+	 */
+	w->nc = 0;
+	while(c)
+	{
+		EPH_constraint *cnext = c->next;
+		if(!eph_ConstraintIsAlive(c))
+		{
+			eph_UnlinkConstraint(space, c);
+			--space->constraints;
+			c = cnext;
+			continue;
+		}
+		if(w->nc >= w->csize)
+		{
+			unsigned size = w->csize ? w->csize * 2 : 64;
+			EPH_cresult *cr = realloc(w->cresults,
+					size * sizeof(EPH_cresult));
+			if(!cr)
+			{
+				x = EEL_XMEMORY;
+				break;
+			}
+			w->cresults = cr;
+			w->csize = size;
+		}
+		eel_own(EPH_constraint2o(c));
+		w->cresults[w->nc++].constraint = c;
+		c = cnext;
+	}
+
+	if(!x)
+		pool_run(space, constraints_part);
+
+	/* Apply forces and make callbacks in list order */
+	w->busy = 1;
+	for(i = 0; i < w->nc; ++i)
+	{
+		c = w->cresults[i].constraint;
+		if(x || !c->a)
+			;	/* Error, or unlinked by a callback */
+		else if(!eph_ConstraintIsAlive(c))
+		{
+			eph_UnlinkConstraint(space, c);
+			--space->constraints;
+		}
+		else
+			x = check_constraint(vm, c, apply_damped_spring(c,
+					&w->cresults[i].sf));
+		eel_disown(EPH_constraint2o(c));
+	}
+	w->busy = 0;
+	return x;
 }
 
 static EEL_xno eph_applyconstraints(EEL_vm *vm)
@@ -1653,11 +2721,14 @@ static EEL_xno eph_applyconstraints(EEL_vm *vm)
 	if(EEL_CLASS(args) != eph_md.space_cid)
 		return EEL_XWRONGTYPE;
 	space = o2EPH_space(eel_v2o(args));
-	c = space->firstc;
 	space->clean_constraints = 0;	/* No need for eph_clean() to do it now! */
+	if(space->threads && !space->work.busy)
+		return applyconstraints_threaded(vm, space);
+	c = space->firstc;
 	while(c)
 	{
-		float f;
+		EEL_xno x;
+		EPH_springforce sf;
 		EPH_constraint *cnext = c->next;
 		if(!eph_ConstraintIsAlive(c))
 		{
@@ -1666,18 +2737,9 @@ static EEL_xno eph_applyconstraints(EEL_vm *vm)
 			c = cnext;
 			continue;
 		}
-		f = apply_damped_spring(c);
-		if(c->maxforce && (fabs(f) > c->maxforce))
-		{
-			
-			if(c->broken_cb)
-			{
-				EEL_xno x = eel_callf(vm, c->broken_cb,
-						"o", EPH_constraint2o(c));
-				if(x)
-					return x;
-			}
-		}
+		damped_spring_force(c, &sf);
+		if((x = check_constraint(vm, c, apply_damped_spring(c, &sf))))
+			return x;
 		c = cnext;
 	}
 	return 0;
@@ -1921,6 +2983,16 @@ static EEL_xno eph_direction(EEL_vm *vm)
 }
 
 
+static inline int body_in_view(EPH_body *b, float xmin, float ymin,
+		float xmax, float ymax)
+{
+	float r = b->r * EPH_CULLSCALE;
+	return !(b->i[EPH_X] - r > xmax ||
+			b->i[EPH_X] + r < xmin ||
+			b->i[EPH_Y] - r > ymax ||
+			b->i[EPH_Y] + r < ymin);
+}
+
 static inline EEL_xno find_body(EEL_vm *vm, EPH_space *space, EPH_body *b,
 		unsigned mask, unsigned testflags)
 {
@@ -1940,17 +3012,40 @@ static inline EEL_xno find_body(EEL_vm *vm, EPH_space *space, EPH_body *b,
 	}
 	else
 		xmin = ymin = xmax = ymax = 0;	/* Warning eliminator */
+	if(test_view_in && grid_view(space, xmin, ymin, xmax, ymax))
+	{
+		/* Continue from 'b' in the sorted in-view candidate list */
+		EPH_grid *g = &space->grid;
+		unsigned lo = 0, hi = g->nview;
+		while(lo < hi)
+		{
+			unsigned mid = (lo + hi) >> 1;
+			if(g->view[mid]->serial < b->serial)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		for( ; lo < g->nview; ++lo)
+		{
+			EPH_body *vb = g->view[lo];
+			if(vb->killed || !(vb->group & mask) ||
+					!body_in_view(vb, xmin, ymin,
+					xmax, ymax))
+				continue;
+			eel_own(EPH_body2o(vb));
+			eel_o2v(vm->heap + vm->resv, EPH_body2o(vb));
+			return 0;
+		}
+		eel_nil2v(vm->heap + vm->resv);
+		return 0;
+	}
 	for( ; b; b = b->next)
 	{
 		if(b->killed || !(b->group & mask))
 			continue;
 		if(test_view)
 		{
-			float r = b->r * EPH_CULLSCALE;
-			if(b->i[EPH_X] - r > xmax ||
-					b->i[EPH_X] + r < xmin ||
-					b->i[EPH_Y] - r > ymax ||
-					b->i[EPH_Y] + r < ymin)
+			if(!body_in_view(b, xmin, ymin, xmax, ymax))
 			{
 				if(test_view_in)
 					continue;
@@ -1991,6 +3086,60 @@ static EEL_xno eph_findnext(EEL_vm *vm)
 	return find_body(vm, b->space, b, mask, testflags);
 }
 
+static inline int body_at(EPH_body *b, EPH_f x, EPH_f y, unsigned mask)
+{
+	EPH_f dx, dy;
+	if(b->killed || !(b->group & mask))
+		return 0;
+	dx = b->c[EPH_X] - x;
+	dy = b->c[EPH_Y] - y;
+	if(dx*dx + dy*dy > b->r*b->r)
+		return 0;
+	return 1;
+}
+
+/*
+ * Find the first body in list order at (x, y) via the grid. Returns 0 if the
+ * grid cannot be used, or 1 with the result, if any, in '*found'.
+ */
+static inline int findat_grid(EPH_space *space, EPH_f x, EPH_f y,
+		unsigned mask, EPH_body **found)
+{
+	EPH_grid *g = &space->grid;
+	EPH_body *best = NULL;
+	EPH_f gx = x * g->scale;
+	EPH_f gy = y * g->scale;
+	unsigned i;
+	if(!g->cellsize || !(gx >= -EPH_GRID_MAXCOORD &&
+			gy >= -EPH_GRID_MAXCOORD && gx <= EPH_GRID_MAXCOORD &&
+			gy <= EPH_GRID_MAXCOORD))
+		return 0;
+	if(g->nbuckets)
+	{
+		int cx = floor(gx);
+		int cy = floor(gy);
+		EPH_gridbucket *gb = g->buckets + grid_hash(g, cx, cy);
+		for(i = 0; i < gb->n; ++i)
+		{
+			EPH_body *b = gb->entries[i].body;
+			if(gb->entries[i].x != cx || gb->entries[i].y != cy)
+				continue;
+			if((!best || b->serial < best->serial) &&
+					body_at(b, x, y, mask))
+				best = b;
+		}
+	}
+	for(i = 0; i < g->nlarge; ++i)
+	{
+		EPH_body *b = g->large[i];
+		if((!best || b->serial < best->serial) &&
+				body_at(b, x, y, mask))
+			best = b;
+	}
+	*found = best;
+	return 1;
+}
+
 static EEL_xno eph_findat(EEL_vm *vm)
 {
 	EEL_value *args = vm->heap + vm->argv;
@@ -2004,20 +3153,17 @@ static EEL_xno eph_findat(EEL_vm *vm)
 	space = o2EPH_space(args->objref.v);
 	if(vm->argc >= 4)
 		mask = eel_v2l(args + 3);
-	for(b = space->first; b; b = b->next)
+	if(!findat_grid(space, x, y, mask, &b))
+		for(b = space->first; b; b = b->next)
+			if(body_at(b, x, y, mask))
+				break;
+	if(!b)
 	{
-		EPH_f dx, dy;
-		if(b->killed || !(b->group & mask))
-			continue;
-		dx = b->c[EPH_X] - x;
-		dy = b->c[EPH_Y] - y;
-		if(dx*dx + dy*dy > b->r*b->r)
-			continue;
-		eel_own(EPH_body2o(b));
-		eel_o2v(vm->heap + vm->resv, EPH_body2o(b));
+		eel_nil2v(vm->heap + vm->resv);
 		return 0;
 	}
-	eel_nil2v(vm->heap + vm->resv);
+	eel_own(EPH_body2o(b));
+	eel_o2v(vm->heap + vm->resv, EPH_body2o(b));
 	return 0;
 }
 
@@ -2142,6 +3288,10 @@ static const EEL_lconstexp eph_spacefields[] =
 
 	{"rngseed",		EPH_SRNGSEED		},
 
+	{"gridsize",		EPH_SGRIDSIZE		},
+
+	{"threads",		EPH_STHREADS		},
+
 	{NULL, 0}
 };
 
@@ -2210,6 +3360,7 @@ static EEL_xno eph_unload(EEL_object *m, int closing)
 {
 	if(closing)
 	{
+		pool_close();
 		if(eph_md.spacefields)
 			eel_disown(eph_md.spacefields);
 		if(eph_md.bodyfields)
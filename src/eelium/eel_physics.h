@@ -118,6 +118,7 @@ typedef enum
 
 typedef double EPH_f;
 typedef struct EPH_zmap EPH_zmap;
+typedef struct EPH_bodydata EPH_bodydata;
 typedef struct EPH_space EPH_space;
 typedef struct EPH_body EPH_body;
 typedef struct EPH_constraint EPH_constraint;
@@ -246,6 +247,190 @@ static inline float eph_getzi_raw(EPH_zmap *m, float x, float y)
 }
 
 
+/*----------------------------------------------------------
+	Body state storage
+----------------------------------------------------------*/
+
+/*
+ * The state and parameter vectors of all bodies in a space are kept in one
+ * array per vector, EPH_DIMS values per body, so that integration and output
+ * interpolation can run as flat loops over all values. Bodies hold their slot
+ * index, and pointers into the arrays, which are updated whenever a body is
+ * moved to another slot, or the arrays are reallocated.
+ *
+ * The slots are partitioned so that the bodies in the space body list that
+ * are not killed are in [0, live), killed bodies still in the list are in
+ * [live, linked), and bodies that have been removed from the list, but are
+ * still referenced, are in [linked, used).
+ *
+ * The storage is allocated separately from the space, as bodies may outlive
+ * it. It is freed when both the space and the last body are gone.
+ */
+
+typedef enum
+{
+	EPH_VI = 0,
+	EPH_VO,
+	EPH_VC,
+	EPH_VV,
+	EPH_VF,
+	EPH_VRF,
+	EPH_VU,
+	EPH_VCD,
+	EPH_VM1,
+	EPH_NVECTORS
+} EPH_vectors;
+
+struct EPH_bodydata
+{
+	unsigned	size;		/* Allocated slots */
+	unsigned	live, linked, used;	/* Partitions; see above */
+	int		orphaned;	/* Space is gone */
+	EPH_body	**bodies;	/* Body in each slot */
+	EPH_f		*v[EPH_NVECTORS];	/* [slot * EPH_DIMS + dim] */
+};
+
+
+/*----------------------------------------------------------
+	Broad phase
+----------------------------------------------------------*/
+
+/*
+ * Uniform grid (spatial hash) over body bounding boxes, used for culling in
+ * Collide(), FindAt() and in-view FindFirst()/FindNext(). Each live body is
+ * entered into every cell overlapped by the bounding box of its bounding
+ * circles (scaled by EPH_CULLSCALE) at both the current and the display
+ * position. The grid is updated incrementally whenever any of these change.
+ */
+
+/* Default grid cell size (WU). 0 disables the broad phase. */
+#define	EPH_DEFAULTGRIDSIZE	64
+
+/*
+ * Bodies covering more than this many cells, or beyond EPH_GRID_MAXCOORD, are
+ * kept in a separate list, and are tested against everything.
+ */
+#define	EPH_GRID_MAXCELLS	16
+#define	EPH_GRID_MAXCOORD	(1 << 28)
+
+/* Initial number of hash buckets. (Must be a power of two!) */
+#define	EPH_GRID_MINBUCKETS	256
+
+typedef enum
+{
+	EPH_GOUT = 0,		/* Not in the grid (dead, or no grid) */
+	EPH_GCELLS,		/* In cells gx0..gx1, gy0..gy1 */
+	EPH_GLARGE		/* In the 'large' list, at 'gridindex' */
+} EPH_gridmodes;
+
+typedef struct EPH_gridentry
+{
+	int		x, y;		/* Cell coordinates */
+	EPH_body	*body;
+} EPH_gridentry;
+
+typedef struct EPH_gridbucket
+{
+	EPH_gridentry	*entries;
+	unsigned	n, size;
+} EPH_gridbucket;
+
+typedef struct EPH_grid
+{
+	double		cellsize;	/* Cell size (WU); 0 if disabled */
+	double		scale;		/* 1 / cellsize */
+
+	/* Cell entries, hashed on cell coordinates */
+	EPH_gridbucket	*buckets;
+	unsigned	nbuckets;	/* Power of two, or 0 */
+	unsigned	entries;	/* Total number of cell entries */
+
+	/* Bodies that are too large, or too far out for the cells */
+	EPH_body	**large;
+	unsigned	nlarge, largesize;
+
+	/* Bumped whenever the contents of the grid change */
+	unsigned	stamp;
+
+	/* Collide() candidate buffer */
+	EPH_body	**cand;
+	unsigned	candsize;
+
+	/* In-view candidates for FindFirst()/FindNext(), sorted */
+	EPH_body	**view;
+	unsigned	nview, viewsize;
+	int		viewvalid;	/* 1 if 'view' is valid for... */
+	unsigned	viewstamp;	/* ...this 'stamp' and... */
+	int		vx0, vy0, vx1, vy1;	/* ...this cell rectangle */
+} EPH_grid;
+
+
+/*----------------------------------------------------------
+	Worker threads
+----------------------------------------------------------*/
+
+/*
+ * With the space field 'threads' set to N > 0, Advance(space), CollideZ()
+ * and ApplyConstraints() split their work into N parts, which are processed
+ * by a worker pool shared by all spaces, and by the calling thread.
+ *
+ * Parts never write to the same state, and anything that needs combining is
+ * combined in list order on the calling thread, so the results do not depend
+ * on N, or on which thread did what. Callbacks are never made from the
+ * workers. CollideZ() leaves bodies with HitZ() or Impact() methods to the VM
+ * thread, where they are handled in list order, interleaved with the
+ * callbacks, exactly as with N = 0. Broken() calls are deferred until all
+ * parts of ApplyConstraints() are done, and then made on the VM thread, in
+ * the same order as with N = 0.
+ *
+ * The results are bit-identical to N = 0, as long as callbacks only change
+ * the body or constraint they are called for (and the space RNG, which is
+ * only ever used on the VM thread), or other bodies that are handled on the
+ * VM thread as well. A callback that kills, moves or otherwise changes some
+ * other body may otherwise find that the workers have already handled it,
+ * where N = 0 would have handled it after the callback.
+ */
+#define	EPH_MAXTHREADS		64
+
+/* CollideZ() results for one body */
+typedef struct EPH_zresult
+{
+	EPH_body	*body;		/* Left to the VM thread, or NULL */
+} EPH_zresult;
+
+/* Damped spring force, as calculated by ApplyConstraints() */
+typedef struct EPH_springforce
+{
+	int		valid;		/* 0 if there is no force direction */
+	EPH_f		rax, ray;	/* Rotated anchors */
+	EPH_f		rbx, rby;
+	EPH_f		nx, ny;		/* Normalized spring direction */
+	EPH_f		f;		/* Force (limited) */
+} EPH_springforce;
+
+typedef struct EPH_cresult
+{
+	EPH_constraint	*constraint;
+	EPH_springforce	sf;
+} EPH_cresult;
+
+/* Per-space work buffers */
+typedef struct EPH_work
+{
+	unsigned	parts;		/* Parts of the current job */
+	int		busy;		/* Dispatching deferred callbacks */
+
+	/* CollideZ() */
+	EPH_zresult	*zresults;	/* Indexed by body slot */
+	EPH_zresult	*zhits;		/* Bodies left to the VM thread, in order */
+	unsigned	zsize;
+
+	/* ApplyConstraints() */
+	EPH_cresult	*cresults;	/* Live constraints, in list order */
+	unsigned	nc, csize;
+} EPH_work;
+
+
 /*----------------------------------------------------------
 	Space
 ----------------------------------------------------------*/
@@ -295,6 +480,17 @@ struct EPH_space
 
 	/* Random numbers */
 	uint32_t	rngstate;	/* Local RNG state */
+
+	/* Body state vectors */
+	EPH_bodydata	*data;
+
+	/* Broad phase */
+	EPH_grid	grid;
+	uint64_t	serial;		/* Last body serial number issued */
+
+	/* Worker threads */
+	int		threads;	/* Parts to split work into; 0 ==> off */
+	EPH_work	work;
 };
 EEL_MAKE_CAST(EPH_space)
 typedef enum
@@ -325,7 +521,11 @@ typedef enum
 	EPH_SIMPACT_DAMAGE_Z,
 	EPH_SOVERLAP_CORRECT_Z,
 
-	EPH_SRNGSEED
+	EPH_SRNGSEED,
+
+	EPH_SGRIDSIZE,
+
+	EPH_STHREADS
 } EPH_spacefields;
 
 
@@ -355,20 +555,24 @@ struct EPH_body
 
 	EEL_object	*table;		/* Table for non-core members */
 
+	/* Slot in the state vector arrays of the space */
+	EPH_bodydata	*data;
+	unsigned	slot;
+
 	/* Interpolation/"tweening" */
-	EPH_f	i[EPH_DIMS];		/* Display position and heading */
-	EPH_f	o[EPH_DIMS];		/* Previous c*, for interpolation */
+	EPH_f	*i;			/* Display position and heading */
+	EPH_f	*o;			/* Previous c*, for interpolation */
 
 	/* Physics vectors */
-	EPH_f	c[EPH_DIMS];		/* Current position and heading */
-	EPH_f	v[EPH_DIMS];		/* Velocity */
-	EPH_f	f[EPH_DIMS];		/* External forces */
-	EPH_f	rf[EPH_DIMS];		/* Collision response forces */
+	EPH_f	*c;			/* Current position and heading */
+	EPH_f	*v;			/* Velocity */
+	EPH_f	*f;			/* External forces */
+	EPH_f	*rf;			/* Collision response forces */
 
 	/* Physics parameters */
-	EPH_f	u[EPH_DIMS];		/* Friction coefficients */
-	EPH_f	cd[EPH_DIMS];		/* Drag coefficients */
-	EPH_f	m1[EPH_DIMS];		/* Inverse mass and inertia */
+	EPH_f	*u;			/* Friction coefficients */
+	EPH_f	*cd;			/* Drag coefficients */
+	EPH_f	*m1;			/* Inverse mass and inertia */
 
 	/* Collision detection */
 	EPH_f		z;		/* Body Z level, for Z map collisions */
@@ -383,6 +587,12 @@ struct EPH_body
 	// Various flags
 	unsigned	flags;
 	int		killed;		/* Marked for destruction! */
+
+	/* Broad phase */
+	uint64_t	serial;		/* Increasing in body list order */
+	EPH_gridmodes	gridmode;
+	unsigned	gridindex;	/* Index in 'large' list */
+	int		gx0, gy0, gx1, gy1;	/* Grid cells covered */
 };
 EEL_MAKE_CAST(EPH_body)
 
@@ -420,6 +630,7 @@ typedef enum
 static inline void eph_LinkBody(EPH_space *s, EPH_body *b)
 {
 	EPH_LINK(s, b, first, last)
+	b->serial = ++s->serial;
 }
 
 static inline void eph_UnlinkBody(EPH_space *s, EPH_body *b)
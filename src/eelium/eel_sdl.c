@@ -25,6 +25,7 @@
 #include <sched.h>
 #endif
 
+#include <stdlib.h>
 #include <string.h>
 #include "eel_sdl.h"
 #include "eel_net.h"
@@ -2631,7 +2632,16 @@ static EEL_xno esdl_GetKeyName(EEL_vm *vm)
 static void audio_callback(void *userdata, Uint8 *stream, int len)
 {
 	int samples_out = len / 4;
-	int samples_in = sfifo_used(&esdl_md.audiofifo) / 4;
+	int samples_in;
+	if(esdl_md.audio_render)
+	{
+		/* Pull mode */
+		esdl_md.audio_render((Sint16 *)stream, samples_out,
+				esdl_md.audio_renderdata);
+		esdl_md.audio_pos += samples_out;
+		return;
+	}
+	samples_in = sfifo_used(&esdl_md.audiofifo) / 4;
 	if(samples_in > samples_out)
 		samples_in = samples_out;
 	sfifo_read(&esdl_md.audiofifo, stream, samples_in * 4);
@@ -2641,6 +2651,17 @@ static void audio_callback(void *userdata, Uint8 *stream, int len)
 }
 
 
+void eel_sdl_set_audio_render(ESDL_audiorender_cb render, void *userdata)
+{
+	if(esdl_md.audio_open)
+		SDL_LockAudio();
+	esdl_md.audio_render = render;
+	esdl_md.audio_renderdata = userdata;
+	if(esdl_md.audio_open)
+		SDL_UnlockAudio();
+}
+
+
 /* procedure OpenAudio(samplerate, buffersize, fifosize); */
 static EEL_xno esdl_OpenAudio(EEL_vm *vm)
 {
@@ -2650,6 +2671,11 @@ static EEL_xno esdl_OpenAudio(EEL_vm *vm)
 		return EEL_XDEVICEOPENED;
 	if(sfifo_init(&esdl_md.audiofifo, eel_v2l(args + 2) * 4) < 0)
 		return EEL_XDEVICEOPEN;
+	if(!(esdl_md.audiobuf = malloc(esdl_md.audiofifo.size)))
+	{
+		sfifo_close(&esdl_md.audiofifo);
+		return EEL_XMEMORY;
+	}
 	aspec.freq = eel_v2l(args);
 	aspec.format = AUDIO_S16SYS;
 	aspec.channels = 2;
@@ -2657,6 +2683,8 @@ static EEL_xno esdl_OpenAudio(EEL_vm *vm)
 	aspec.callback = audio_callback;
 	if(SDL_OpenAudio(&aspec, NULL) < 0)
 	{
+		free(esdl_md.audiobuf);
+		esdl_md.audiobuf = NULL;
 		sfifo_close(&esdl_md.audiofifo);
 		return EEL_XDEVICEOPEN;
 	}
@@ -2673,6 +2701,8 @@ static void audio_close(void)
 		return;
 	SDL_CloseAudio();
 	sfifo_close(&esdl_md.audiofifo);
+	free(esdl_md.audiobuf);
+	esdl_md.audiobuf = NULL;
 	esdl_md.audio_open = 0;
 }
 
@@ -2684,20 +2714,23 @@ static EEL_xno esdl_CloseAudio(EEL_vm *vm)
 }
 
 
+static inline Sint16 real2sample(double s)
+{
+	s *= 32768.0f;
+	if(s < -32768.0f)
+		return -32768;
+	else if(s > 32767.0f)
+		return 32767;
+	else
+		return (Sint16)s;
+}
+
 static inline Sint16 get_sample(EEL_value *v)
 {
 	if(v->classid == EEL_CINTEGER)
 		return v->integer.v >> 16;
 	else
-	{
-		double s = eel_v2d(v) * 32768.0f;
-		if(s < -32768.0f)
-			return -32768;
-		else if(s > 32767.0f)
-			return 32767;
-		else
-			return (Sint16)s;
-	}
+		return real2sample(eel_v2d(v));
 }
 
 static EEL_xno esdl_PlayAudio(EEL_vm *vm)
@@ -2759,6 +2792,90 @@ static EEL_xno esdl_PlayAudio(EEL_vm *vm)
 }
 
 
+/*
+ * function PlayAudioBlock(samples)[channels];
+ *
+ * Write a block of samples to the audio FIFO. 'samples' is a vector_s16 (full
+ * scale 16 bit samples), or a vector_f or vector_d (full scale +/-1.0), holding
+ * mono samples (channels = 1; the default), or interleaved stereo frames
+ * (channels = 2). Writes as many frames as there is space for, and returns the
+ * number of frames written.
+ */
+static EEL_xno esdl_PlayAudioBlock(EEL_vm *vm)
+{
+	EEL_value *args = vm->heap + vm->argv;
+	EEL_object *o;
+	Sint16 *buf = esdl_md.audiobuf;
+	int channels, frames, space, i;
+	void *data;
+	if(!esdl_md.audio_open)
+		return EEL_XDEVICECLOSED;
+	ESDL_OPTARG_INTEGER(1, channels, 1);
+	if(channels < 1)
+		return EEL_XLOWVALUE;
+	else if(channels > 2)
+		return EEL_XHIGHVALUE;
+	switch(EEL_CLASS(args))
+	{
+	  case EEL_CVECTOR_S16:
+	  case EEL_CVECTOR_F:
+	  case EEL_CVECTOR_D:
+		break;
+	  default:
+		return EEL_XWRONGTYPE;
+	}
+	o = eel_v2o(args);
+	frames = eel_length(o) / channels;
+	space = sfifo_space(&esdl_md.audiofifo) / 4;
+	if(frames > space)
+		frames = space;
+	eel_l2v(vm->heap + vm->resv, frames);
+	if(!frames)
+		return 0;
+	if(!(data = eel_rawdata(o)))
+		return EEL_XCANTREAD;
+	switch(EEL_CLASS(args))
+	{
+	  case EEL_CVECTOR_S16:
+	  {
+		Sint16 *d = (Sint16 *)data;
+		if(channels == 2)
+			buf = d;	/* Already in the output format! */
+		else
+			for(i = 0; i < frames; ++i)
+				buf[i * 2] = buf[i * 2 + 1] = d[i];
+		break;
+	  }
+	  case EEL_CVECTOR_F:
+	  {
+		float *d = (float *)data;
+		if(channels == 2)
+			for(i = 0; i < frames * 2; ++i)
+				buf[i] = real2sample(d[i]);
+		else
+			for(i = 0; i < frames; ++i)
+				buf[i * 2] = buf[i * 2 + 1] =
+						real2sample(d[i]);
+		break;
+	  }
+	  default:	/* EEL_CVECTOR_D */
+	  {
+		double *d = (double *)data;
+		if(channels == 2)
+			for(i = 0; i < frames * 2; ++i)
+				buf[i] = real2sample(d[i]);
+		else
+			for(i = 0; i < frames; ++i)
+				buf[i * 2] = buf[i * 2 + 1] =
+						real2sample(d[i]);
+		break;
+	  }
+	}
+	sfifo_write(&esdl_md.audiofifo, buf, frames * 4);
+	return 0;
+}
+
+
 static EEL_xno esdl_AudioPosition(EEL_vm *vm)
 {
 	if(!esdl_md.audio_open)
@@ -3407,6 +3524,8 @@ EEL_xno eel_sdl_init(EEL_vm *vm)
 	eel_export_cfunction(m, 0, "OpenAudio", 3, 0, 0, esdl_OpenAudio);
 	eel_export_cfunction(m, 0, "CloseAudio", 0, 0, 0, esdl_CloseAudio);
 	eel_export_cfunction(m, 0, "PlayAudio", 1, 1, 0, esdl_PlayAudio);
+	eel_export_cfunction(m, 1, "PlayAudioBlock", 1, 1, 0,
+			esdl_PlayAudioBlock);
 	eel_export_cfunction(m, 1, "AudioPosition", 0, 0, 0, esdl_AudioPosition);
 	eel_export_cfunction(m, 1, "AudioBuffer", 0, 0, 0, esdl_AudioBuffer);
 	eel_export_cfunction(m, 1, "AudioSpace", 0, 0, 0, esdl_AudioSpace);
@@ -213,6 +213,13 @@ struct ESDL_joystick
 EEL_MAKE_CAST(ESDL_joystick)
 
 
+/*
+ * Audio render hook for pull mode audio output. 'buffer' is to be filled with
+ * 'frames' interleaved stereo sample frames.
+ */
+typedef void (*ESDL_audiorender_cb)(Sint16 *buffer, int frames,
+		void *userdata);
+
 /* Module instance data */
 typedef struct
 {
@@ -233,10 +240,25 @@ typedef struct
 	int		audio_open;
 	int		audio_pos;
 	sfifo_t		audiofifo;
+	Sint16		*audiobuf;	/* PlayAudioBlock() conversion buffer */
+	ESDL_audiorender_cb audio_render;
+	void		*audio_renderdata;
 } ESDL_moduledata;
 
 extern ESDL_moduledata esdl_md;
 
 EEL_xno eel_sdl_init(EEL_vm *vm);
 
+/*
+ * Switch audio output to pull mode. The SDL audio callback will call 'render'
+ * to fill each output buffer, instead of draining the FIFO that PlayAudio() and
+ * PlayAudioBlock() write to. 'render' runs in the SDL audio thread, so it must
+ * be real time safe: no EEL calls, no memory management, no blocking locks or
+ * I/O. Pass NULL to switch back to the FIFO.
+ *
+ * The hook can be installed before or after OpenAudio(), and stays installed
+ * until removed, or until the module is unloaded.
+ */
+void eel_sdl_set_audio_render(ESDL_audiorender_cb render, void *userdata);
+
 #endif /* EELIUM_SDL_H */
@@ -644,6 +644,18 @@ static EEL_xno ezs_setpixel(EEL_vm *vm)
 }
 
 
+/*----------------------------------------------------------
+	Worker threads
+----------------------------------------------------------*/
+
+static EEL_xno ezs_setthreads(EEL_vm *vm)
+{
+	if(zs_SetThreads(zsmd.state, eel_v2l(vm->heap + vm->argv)) < 0)
+		return EEL_XTHREADCREATE;
+	return 0;
+}
+
+
 /*----------------------------------------------------------
 	Pseudo-random number generator
 ----------------------------------------------------------*/
@@ -1389,6 +1401,9 @@ EEL_xno eel_zeespace_init(EEL_vm *vm)
 	eel_export_cfunction(m, 1, "GetPixelClamp", 3, 1, 0, ezs_getpixelclamp);
 	eel_export_cfunction(m, 0, "SetPixel", 4, 0, 0, ezs_setpixel);
 
+	/* Worker threads */
+	eel_export_cfunction(m, 0, "SetThreads", 1, 0, 0, ezs_setthreads);
+
 	/* Pseudo-random number generator */
 	eel_export_cfunction(m, 0, "RndReset", 1, 0, 0, ezs_rndreset);
 	eel_export_cfunction(m, 1, "RndGet", 1, 0, 0, ezs_rndget);
@@ -124,7 +124,10 @@ static int zs_StatePrepare(ZS_State *st, int w)
 	st->scratch = (ZS_Pixel *)malloc(sizeof(ZS_Pixel) * w * 2);
 	st->pipebuf = (ZS_Pixel *)malloc(sizeof(ZS_Pixel) * w);
 	if(!st->scratch || !st->pipebuf)
+	{
+		st->bufw = 0;
 		return -1;
+	}
 	st->bufw = w;
 	return 0;
 }
@@ -149,6 +152,7 @@ void zs_Close(ZS_State *state)
 {
 	if(--state->refcount <= 0)
 	{
+		zs_SetThreads(state, 0);
 		free(state->scratch);
 		free(state->pipebuf);
 		free(state);
@@ -156,6 +160,170 @@ void zs_Close(ZS_State *state)
 }
 
 
+/*---------------------------------------------------------------
+	Worker threads
+-----------------------------------------------------------------
+ * Jobs are split into 'parts' contiguous bands of equal size, and
+ * band N is always rendered using part State N, regardless of which
+ * thread picks it up. The calling thread works on bands as well.
+ */
+
+/* Render the band [first, last) using State 'st' */
+typedef void (*ZS_JobCb)(ZS_State *st, int first, int last, void *data);
+
+struct ZS_Jobs
+{
+	int		nthreads;	/* Worker threads (excluding caller) */
+	SDL_Thread	*threads[ZS_MAXTHREADS];
+	ZS_State	*states[ZS_MAXTHREADS];	/* One per part */
+	SDL_sem		*go;		/* One post per worker per job */
+	SDL_sem		*done;		/* One post per worker per job */
+	SDL_atomic_t	next;		/* Next part to render */
+	int		quit;
+
+	/* Current job */
+	ZS_JobCb	cb;
+	void		*data;
+	int		first, last;
+	int		parts;
+};
+
+
+static void zs_JobWork(ZS_Jobs *j)
+{
+	int part;
+	while((part = SDL_AtomicAdd(&j->next, 1)) < j->parts)
+	{
+		int n = j->last - j->first;
+		int first = j->first + (int)((int64_t)n * part / j->parts);
+		int last = j->first + (int)((int64_t)n * (part + 1) / j->parts);
+		j->cb(j->states[part], first, last, j->data);
+	}
+}
+
+
+static int zs_Worker(void *data)
+{
+	ZS_Jobs *j = (ZS_Jobs *)data;
+	while(1)
+	{
+		SDL_SemWait(j->go);
+		if(j->quit)
+			break;
+		zs_JobWork(j);
+		SDL_SemPost(j->done);
+	}
+	return 0;
+}
+
+
+int zs_SetThreads(ZS_State *state, int threads)
+{
+	ZS_Jobs *j = state->jobs;
+	int i;
+	if(threads > ZS_MAXTHREADS)
+		threads = ZS_MAXTHREADS;
+	if(j)
+	{
+		if(threads == j->nthreads + 1)
+			return 0;
+		j->quit = 1;
+		for(i = 0; i < j->nthreads; ++i)
+			SDL_SemPost(j->go);
+		for(i = 0; i < j->nthreads; ++i)
+			SDL_WaitThread(j->threads[i], NULL);
+		for(i = 0; i < ZS_MAXTHREADS; ++i)
+			if(j->states[i])
+				zs_Close(j->states[i]);
+		if(j->go)
+			SDL_DestroySemaphore(j->go);
+		if(j->done)
+			SDL_DestroySemaphore(j->done);
+		free(j);
+		state->jobs = NULL;
+	}
+	if(threads <= 1)
+		return 0;
+
+	j = (ZS_Jobs *)calloc(1, sizeof(ZS_Jobs));
+	if(!j)
+		return -1;
+	state->jobs = j;
+	j->go = SDL_CreateSemaphore(0);
+	j->done = SDL_CreateSemaphore(0);
+	if(!j->go || !j->done)
+	{
+		zs_SetThreads(state, 0);
+		return -1;
+	}
+	for(i = 0; i < threads; ++i)
+		if(!(j->states[i] = zs_Open()))
+		{
+			zs_SetThreads(state, 0);
+			return -1;
+		}
+	for(i = 0; i < threads - 1; ++i)
+	{
+		j->threads[i] = SDL_CreateThread(zs_Worker, "ZeeSpace", j);
+		if(!j->threads[i])
+		{
+			zs_SetThreads(state, 0);
+			return -1;
+		}
+		++j->nthreads;
+	}
+	return 0;
+}
+
+
+/*
+ * Run 'cb' over the range [first, last), split into one band per thread,
+ * with State scratch buffers prepared for spans of 'bufw' pixels. Falls
+ * back to rendering the whole range with 'state' if there is no worker
+ * pool, or if the part States cannot be prepared.
+ */
+static void zs_RunJob(ZS_State *state, int first, int last, int bufw,
+		ZS_JobCb cb, void *data)
+{
+	ZS_Jobs *j = state->jobs;
+	int i, parts;
+	if(last <= first)
+		return;
+	parts = j ? j->nthreads + 1 : 1;
+	if(parts > last - first)
+		parts = last - first;
+	for(i = 0; (i < parts) && (parts > 1); ++i)
+	{
+		ZS_State *ps = j->states[i];
+		if(zs_StatePrepare(ps, bufw) < 0)
+		{
+			parts = 1;
+			break;
+		}
+		/* Repeatable random number stream for each band */
+		ps->rnd1 = state->rnd1 + i * 2654435761U;
+		ps->rnd2 = state->rnd2 + i;
+		ps->rbal = state->rbal;
+	}
+	if(parts <= 1)
+	{
+		cb(state, first, last, data);
+		return;
+	}
+	j->cb = cb;
+	j->data = data;
+	j->first = first;
+	j->last = last;
+	j->parts = parts;
+	SDL_AtomicSet(&j->next, 0);
+	for(i = 0; i < parts - 1; ++i)
+		SDL_SemPost(j->go);
+	zs_JobWork(j);
+	for(i = 0; i < parts - 1; ++i)
+		SDL_SemWait(j->done);
+}
+
+
 /*---------------------------------------------------------------
 	Surface/Window/Region management
 ---------------------------------------------------------------*/
@@ -445,32 +613,27 @@ void zs_WaterZ(ZS_Surface *s, ZS_Rect *r, ZS_Pixel *p, int factor)
 }
 
 
-void zs_Fog(ZS_Surface *s, ZS_Rect *r, ZS_Pixel *p, int visibility)
+typedef struct ZS_FogJob
 {
-	ZS_Rect cr;
-	int xmin, ymin, x, y, xmax, ymax;
-	int blur = visibility > 0 ? 65536 / visibility : 65536;
-	if(!r)
-	{
-		r = &cr;
-		cr.x = cr.y = 0;
-		cr.w = s->w;
-		cr.h = s->h;
-	}
-	else if(!zs_Clip(r, s->w, s->h))
-		return;
-	xmin = r->x;
-	ymin = r->y;
-	xmax = r->x + r->w;
-	ymax = r->y + r->h;
+	ZS_Surface	*s;
+	ZS_Pixel	*p;
+	int		xmin, xmax;
+	int		blur;
+} ZS_FogJob;
+
+static void fog_band(ZS_State *st, int ymin, int ymax, void *data)
+{
+	ZS_FogJob *fj = (ZS_FogJob *)data;
+	ZS_Pixel *p = fj->p;
+	int x, y;
 	for(y = ymin; y < ymax; ++y)
 	{
-		ZS_Pixel *lp = zs_Pixel(s, 0, y);
-		for(x = xmin; x < xmax; ++x)
+		ZS_Pixel *lp = zs_Pixel(fj->s, 0, y);
+		for(x = fj->xmin; x < fj->xmax; ++x)
 			if(p->z >= lp[x].z)
 			{
 				int b1, b2;
-				b1 = p->a + ((int)(p->z - lp[x].z) * blur >> 16);
+				b1 = p->a + ((int)(p->z - lp[x].z) * fj->blur >> 16);
 				if(b1 > 256)
 					b1 = 256;
 				b2 = 256 - b1;
@@ -482,6 +645,27 @@ void zs_Fog(ZS_Surface *s, ZS_Rect *r, ZS_Pixel *p, int visibility)
 	}
 }
 
+void zs_Fog(ZS_Surface *s, ZS_Rect *r, ZS_Pixel *p, int visibility)
+{
+	ZS_Rect cr;
+	ZS_FogJob fj;
+	if(!r)
+	{
+		r = &cr;
+		cr.x = cr.y = 0;
+		cr.w = s->w;
+		cr.h = s->h;
+	}
+	else if(!zs_Clip(r, s->w, s->h))
+		return;
+	fj.s = s;
+	fj.p = p;
+	fj.xmin = r->x;
+	fj.xmax = r->x + r->w;
+	fj.blur = visibility > 0 ? 65536 / visibility : 65536;
+	zs_RunJob(s->state, r->y, r->y + r->h, 0, fog_band, &fj);
+}
+
 
 void zs_Block(ZS_Pipe *pipe, ZS_Surface *s,
 		float x, float y, float w, float h, ZS_Pixel *px)
@@ -508,14 +692,51 @@ void zs_Block(ZS_Pipe *pipe, ZS_Surface *s,
 }
 
 
+typedef struct ZS_BlitJob
+{
+	ZS_Pipe		*pipe;
+	ZS_Surface	*src, *dst;
+	int		sx, sy;		/* Source top-left corner */
+	int		xmin, ymin;	/* Destination top-left corner */
+	int		sw;		/* Span width */
+} ZS_BlitJob;
+
+static void blit_band(ZS_State *st, int ymin, int ymax, void *data)
+{
+	ZS_BlitJob *bj = (ZS_BlitJob *)data;
+	ZS_Pipe pp, *pipe = bj->pipe;
+	ZS_Pixel *scratch = st->scratch;
+	int iy;
+	if(st != bj->src->state)
+	{
+		/* Private copy of the pipe, using the buffers of 'st' */
+		pp = *pipe;
+		pp.state = st;
+		pipe = &pp;
+	}
+	for(iy = ymin; iy < ymax; ++iy)
+	{
+		ZS_Pixel *spx = zs_Pixel(bj->src, bj->sx, bj->sy + iy - bj->ymin);
+		memcpy(scratch, spx, sizeof(ZS_Pixel) * bj->sw);
+		zs_PipeRun(pipe, 0, scratch, zs_Pixel(bj->dst, bj->xmin, iy),
+				bj->sw);
+	}
+}
+
+static inline ZS_Surface *zs_Root(ZS_Surface *s)
+{
+	while(s->parent)
+		s = s->parent;
+	return s;
+}
+
 void zs_Blit(ZS_Pipe *pipe, ZS_Surface *src, ZS_Rect *srcr,
 		ZS_Surface *dst, float x, float y)
 {
-	int iy;
 	int xmin = x - src->xo;
 	int ymin = y - src->yo;
 	int xmax, ymax;
-	ZS_Pixel *scratch = src->state->scratch;
+	ZS_BlitJob bj;
 	ZS_Rect sr;
 	
 	/* Obtain and clip source rect. Note that this may nudge xmin/ymin! */
@@ -564,14 +785,20 @@ printf("  dest: %dx%d\n", dst->w, dst->h);
 	if((sr.w <= 0) || (sr.h <= 0) || (xmax <= xmin))
 		return;		/* Nothing left to blit! */
 
-	for(iy = ymin; iy < ymax; ++iy)
-	{
-		int sw = xmax - xmin;
-		ZS_Pixel *spx = zs_Pixel(src, sr.x, sr.y + iy - ymin);
-//printf("  %d (%d - %d)\n", sw, xmax, xmin);
-		memcpy(scratch, spx, sizeof(ZS_Pixel) * sw);
-		zs_PipeRun(pipe, 0, scratch, zs_Pixel(dst, xmin, iy), sw);
-	}
+	bj.pipe = pipe;
+	bj.src = src;
+	bj.dst = dst;
+	bj.sx = sr.x;
+	bj.sy = sr.y;
+	bj.xmin = xmin;
+	bj.ymin = ymin;
+	bj.sw = xmax - xmin;
+
+	/* Rows may feed each other when blitting within the same pixels */
+	if(zs_Root(src) == zs_Root(dst))
+		blit_band(src->state, ymin, ymax, &bj);
+	else
+		zs_RunJob(src->state, ymin, ymax, bj.sw, blit_band, &bj);
 }
 
 
@@ -890,59 +1117,80 @@ static inline void vline(SDL_Surface *s, ZS_Pixel *p, int x, int y, int y2,
 	}
 }
 
-void zs_3D2SDL(ZS_Surface *from, SDL_Surface *to, float pitch)
+typedef struct ZS_3DJob
+{
+	ZS_Surface	*from;
+	SDL_Surface	*to;
+	unsigned	tilt, scale;
+	int		ro, go, bo;
+} ZS_3DJob;
+
+/* Columns are rendered independently, so the bands are vertical here */
+static void render3d_band(ZS_State *st, int xmin, int xmax, void *data)
 {
+	ZS_3DJob *tj = (ZS_3DJob *)data;
+	ZS_Surface *from = tj->from;
+	SDL_Surface *to = tj->to;
 	ZS_Pixel sky;
 	ZS_Pixel *p;
-	float a = pitch * 2 * M_PI / 360;
-	unsigned tilt, scale, ty;
-#ifdef SDL_LITTLE_ENDIAN
-	int ro = 3 - to->format->Rshift / 8;
-	int go = 3 - to->format->Gshift / 8;
-	int bo = 3 - to->format->Bshift / 8;
-#else
-	int ro = to->format->Rshift / 8;
-	int go = to->format->Gshift / 8;
-	int bo = to->format->Bshift / 8;
-#endif
-	int *buf = (int *)from->state->scratch;
-	int x, y, xmin, xmax, ymaxf;
-	xmin = to->clip_rect.x;
-	xmax = xmin + to->clip_rect.w;
-	if(xmax > from->w)
-		xmax = from->w;
-	xmax -= 1;
+	unsigned ty;
+	int *buf = (int *)st->scratch;
+	int x, y, ymaxf;
 	y = from->h - 1;
 	ymaxf = y << 8;
-	for(x = 0; x <= xmax; ++x)
-		buf[x] = ymaxf + 256;
-	tilt = sin(a) * 65536;
-	scale = cos(a) * 65536;
+	for(x = xmin; x < xmax; ++x)
+		buf[x - xmin] = ymaxf + 256;
 	ty = 0;
-	SDL_LockSurface(to);
 	for( ; y >= 0; --y)
 	{
 		p = zs_Pixel(from, 0, y);
-		for(x = xmin; x <= xmax; ++x)
+		for(x = xmin; x < xmax; ++x)
 		{
-			int sz = p[x].z * scale >> 8;
+			int *b = &buf[x - xmin];
+			int sz = p[x].z * tj->scale >> 8;
 			int tz = ymaxf - ((ty + sz) >> 8);
-			if(tz < buf[x])
+			if(tz < *b)
 			{
 				if(tz < 0)
 					tz = 0;
-				vline(to, &p[x], x, tz, buf[x], ro, go, bo);
-				buf[x] = tz;
+				vline(to, &p[x], x, tz, *b, tj->ro, tj->go, tj->bo);
+				*b = tz;
 			}
 		}
-		ty += tilt;
+		ty += tj->tilt;
 	}
 	sky.r = 64;
 	sky.g = 64;
 	sky.b = 96;
 	sky.a = 255;
-	for(x = xmin; x <= xmax; ++x)
-		vline(to, &sky, x, 0, buf[x], ro, go, bo);
+	for(x = xmin; x < xmax; ++x)
+		vline(to, &sky, x, 0, buf[x - xmin], tj->ro, tj->go, tj->bo);
+}
+
+void zs_3D2SDL(ZS_Surface *from, SDL_Surface *to, float pitch)
+{
+	ZS_3DJob tj;
+	float a = pitch * 2 * M_PI / 360;
+	int xmin, xmax;
+#ifdef SDL_LITTLE_ENDIAN
+	tj.ro = 3 - to->format->Rshift / 8;
+	tj.go = 3 - to->format->Gshift / 8;
+	tj.bo = 3 - to->format->Bshift / 8;
+#else
+	tj.ro = to->format->Rshift / 8;
+	tj.go = to->format->Gshift / 8;
+	tj.bo = to->format->Bshift / 8;
+#endif
+	tj.from = from;
+	tj.to = to;
+	xmin = to->clip_rect.x;
+	xmax = xmin + to->clip_rect.w;
+	if(xmax > from->w)
+		xmax = from->w;
+	tj.tilt = sin(a) * 65536;
+	tj.scale = cos(a) * 65536;
+	SDL_LockSurface(to);
+	zs_RunJob(from->state, xmin, xmax, xmax - xmin, render3d_band, &tj);
 	SDL_UnlockSurface(to);
 }
 
@@ -1136,29 +1384,48 @@ static inline void do_ray(ZS_Surface *s, int startx, int starty, int zstep,
 	}
 }
 
-void zs_SimpleShadow(ZS_Surface *s, float altitude, float scale,
-		float depth, float hardness)
+typedef struct ZS_ShadowJob
 {
-	int xmin, ymin, x, y, xmax, ymax, zstep;
-	int hard = 256 * hardness;
-	int d = 256 * depth;
-	if(altitude >= 90)
-		return;
-	zstep = -tan(altitude * 2 * M_PI / 360) * 256 * scale;
-	xmin = 0;
-	ymin = 0;
-	xmax = s->w;
-	ymax = s->h;
-	for(y = ymin; y < ymax; ++y)
-		do_ray(s, xmin, y, zstep, d, hard);
-	for(x = ymin + 1; x < xmax; ++x)
-		do_ray(s, x, ymin, zstep, d, hard);
-	/* 2x2 filter */
-	for(y = ymin + 1; y < ymax; ++y)
+	ZS_Surface	*s;
+	int		zstep, depth, hardness;
+} ZS_ShadowJob;
+
+/* Rays [first, last); first down the left edge, then along the top edge */
+static void shadow_rays(ZS_State *st, int first, int last, void *data)
+{
+	ZS_ShadowJob *sj = (ZS_ShadowJob *)data;
+	int h = sj->s->h;
+	int r;
+	for(r = first; r < last; ++r)
+		if(r < h)
+			do_ray(sj->s, 0, r, sj->zstep, sj->depth, sj->hardness);
+		else
+			do_ray(sj->s, r - h + 1, 0, sj->zstep, sj->depth,
+					sj->hardness);
+}
+
+/*
+ * The 2x2 filter is done in place, so the last row of each band must
+ * be read from a copy, as the next band will be writing to it.
+ */
+static void shadow_snapshot(ZS_State *st, int ymin, int ymax, void *data)
+{
+	ZS_ShadowJob *sj = (ZS_ShadowJob *)data;
+	memcpy(st->scratch, zs_Pixel(sj->s, 0, ymax),
+			sizeof(ZS_Pixel) * sj->s->w);
+}
+
+/* Filter into rows [ymin, ymax) */
+static void shadow_filter(ZS_State *st, int ymin, int ymax, void *data)
+{
+	ZS_ShadowJob *sj = (ZS_ShadowJob *)data;
+	int x, y;
+	int xmax = sj->s->w;
+	for(y = ymin + 1; y <= ymax; ++y)
 	{
-		ZS_Pixel *pm1 = zs_Pixel(s, xmin, y - 1);
-		ZS_Pixel *p = zs_Pixel(s, xmin, y);
-		for(x = xmin + 1; x < xmax; ++x)
+		ZS_Pixel *pm1 = zs_Pixel(sj->s, 0, y - 1);
+		ZS_Pixel *p = y < ymax ? zs_Pixel(sj->s, 0, y) : st->scratch;
+		for(x = 1; x < xmax; ++x)
 		{
 			int i = p[x].i;
 			i += pm1[x - 1].i;
@@ -1170,28 +1437,44 @@ void zs_SimpleShadow(ZS_Surface *s, float altitude, float scale,
 	}
 }
 
+void zs_SimpleShadow(ZS_Surface *s, float altitude, float scale,
+		float depth, float hardness)
+{
+	ZS_ShadowJob sj;
+	if(altitude >= 90)
+		return;
+	sj.s = s;
+	sj.zstep = -tan(altitude * 2 * M_PI / 360) * 256 * scale;
+	sj.depth = 256 * depth;
+	sj.hardness = 256 * hardness;
+	zs_RunJob(s->state, 0, s->h + s->w - 1, 0, shadow_rays, &sj);
+	zs_RunJob(s->state, 0, s->h - 1, s->w, shadow_snapshot, &sj);
+	zs_RunJob(s->state, 0, s->h - 1, s->w, shadow_filter, &sj);
+}
+
 
 /*---------------------------------------------------------------
 	Bump Mapping
 ---------------------------------------------------------------*/
-void zs_BumpMap(ZS_Surface *s, float altitude, float scale, float depth)
+typedef struct ZS_BumpJob
 {
-	int x, y, xmax, ymax, abias;
-	float scalei = 1.0f / scale;
-//int scalei = 256 / scale;
-	int d = 256 * depth;
-	if(altitude < 1)
-		altitude = 1;
-	abias = tan((90 - altitude) * 2 * M_PI / 360) * 256 * scale;
-	xmax = s->w - 2;
-	ymax = s->h - 2;
-	for(y = 0; y <= ymax; ++y)
+	ZS_Surface	*s;
+	int		xmax, abias, d;
+	float		scalei;
+} ZS_BumpJob;
+
+/* Z is read only, and rows only write their own I; bands are independent */
+static void bump_band(ZS_State *st, int ymin, int ymax, void *data)
+{
+	ZS_BumpJob *bj = (ZS_BumpJob *)data;
+	int x, y;
+	for(y = ymin; y < ymax; ++y)
 	{
-		ZS_Pixel *p = zs_Pixel(s, 0, y);
-		int pitch = s->pitch;
+		ZS_Pixel *p = zs_Pixel(bj->s, 0, y);
+		int pitch = bj->s->pitch;
 		int z00 = p[0].z;
 		int z10 = p[pitch].z;
-		for(x = 0; x <= xmax; ++x)
+		for(x = 0; x <= bj->xmax; ++x)
 		{
 			float face, face2;
 //			int face, face2;
@@ -1199,17 +1482,17 @@ void zs_BumpMap(ZS_Surface *s, float altitude, float scale, float depth)
 			int z01 = p[x + 1].z;
 			int z11 = p[x + pitch + 1].z;
 #if 1
-			face2 = fabs(z01 - z10) * scalei;
-			face = fabs(z11 - z00 - abias) * scalei;
+			face2 = fabs(z01 - z10) * bj->scalei;
+			face = fabs(z11 - z00 - bj->abias) * bj->scalei;
 			iface = (int)(sqrtf(face*face + face2*face2) * .5f);
 #else
-			face2 = labs(z01 - z10) * scalei;
-			face = labs(z11 - z00 - abias) * scalei;
+			face2 = labs(z01 - z10) * bj->scalei;
+			face = labs(z11 - z00 - bj->abias) * bj->scalei;
 			iface = (face + face2) >> 10;
 #endif
 			if(iface > 384)
 				iface = 384;
-			iface = (128 - iface) * d >> 8;
+			iface = (128 - iface) * bj->d >> 8;
 			iface = p[x].i * iface >> 8;
 			iface = p[x].i + iface;
 			if(iface < 0)
@@ -1224,6 +1507,20 @@ void zs_BumpMap(ZS_Surface *s, float altitude, float scale, float depth)
 	}
 }
 
+void zs_BumpMap(ZS_Surface *s, float altitude, float scale, float depth)
+{
+	ZS_BumpJob bj;
+	bj.s = s;
+	bj.scalei = 1.0f / scale;
+//int scalei = 256 / scale;
+	bj.d = 256 * depth;
+	if(altitude < 1)
+		altitude = 1;
+	bj.abias = tan((90 - altitude) * 2 * M_PI / 360) * 256 * scale;
+	bj.xmax = s->w - 2;
+	zs_RunJob(s->state, 0, s->h - 1, 0, bump_band, &bj);
+}
+
 
 /*---------------------------------------------------------------
 	Inter-channel operations
@@ -1603,24 +1900,35 @@ static void perlin_run_bicubic_hi(int *scratch, unsigned w,
 }
 #endif
 
-void zs_PerlinTerrainZ(ZS_Surface *s, float base,
-		float u, float v, float du, float dv,
-		int namplitudes, float *amplitudes, int flags)
+typedef struct ZS_PerlinJob
 {
-	int *scratch = (int *)s->state->scratch;
-	int x, y, w, h;
-	int ibase = (int)(base * 256);
-//FIXME: Scale factor accuracy isn't all that great when zooming in close...
-//FIXME: Since we want to use factors in the "several hundreds" for large scale
-//FIXME: landscapes, we'll need to deal with this somehow. Tiled rendering...?
-	unsigned iu0 = (unsigned)(u * 65536.0f + .5f);
-	unsigned iv0 = (unsigned)(v * 65536.0f + .5f);
-	int idu = (int)(du * 65536.0f + .5f);
-	int idv = (int)(dv * 65536.0f + .5f);
+	ZS_Surface	*s;
+	int		ibase;
+	unsigned	iu0, iv0;
+	int		idu, idv;
+	int		namplitudes;
+	float		*amplitudes;
+	int		flags;
+} ZS_PerlinJob;
+
+static void perlin_band(ZS_State *st, int ymin, int ymax, void *data)
+{
+	ZS_PerlinJob *pj = (ZS_PerlinJob *)data;
+	ZS_Surface *s = pj->s;
+	int *scratch = (int *)st->scratch;
+	int x, y, w;
+	int ibase = pj->ibase;
+	int idu = pj->idu;
+	int idv = pj->idv;
+	int namplitudes = pj->namplitudes;
+	float *amplitudes = pj->amplitudes;
+	int flags = pj->flags;
+	/* Start point of the first span of the band */
+	unsigned iu0 = pj->iu0 - (unsigned)ymin * idv;
+	unsigned iv0 = pj->iv0 + (unsigned)ymin * idu;
 	w = s->w;
-	h = s->h;
 //printf("width: %d\n", s->w);
-	for(y = 0; y < h; ++y)	/* for each scanline */
+	for(y = ymin; y < ymax; ++y)	/* for each scanline */
 //y = 0;
 	{
 		ZS_Pixel *p = zs_Pixel(s, 0, y);
@@ -1809,6 +2117,26 @@ void zs_PerlinTerrainZ(ZS_Surface *s, float base,
 //		100.0f * nc.usecount / (nc.setcount + nc.usecount));
 }
 
+void zs_PerlinTerrainZ(ZS_Surface *s, float base,
+		float u, float v, float du, float dv,
+		int namplitudes, float *amplitudes, int flags)
+{
+	ZS_PerlinJob pj;
+	pj.s = s;
+	pj.ibase = (int)(base * 256);
+//FIXME: Scale factor accuracy isn't all that great when zooming in close...
+//FIXME: Since we want to use factors in the "several hundreds" for large scale
+//FIXME: landscapes, we'll need to deal with this somehow. Tiled rendering...?
+	pj.iu0 = (unsigned)(u * 65536.0f + .5f);
+	pj.iv0 = (unsigned)(v * 65536.0f + .5f);
+	pj.idu = (int)(du * 65536.0f + .5f);
+	pj.idv = (int)(dv * 65536.0f + .5f);
+	pj.namplitudes = namplitudes;
+	pj.amplitudes = amplitudes;
+	pj.flags = flags;
+	zs_RunJob(s->state, 0, s->h, s->w, perlin_band, &pj);
+}
+
 
 /*---------------------------------------------------------------
 	Region based rendering
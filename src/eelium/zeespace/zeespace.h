@@ -40,6 +40,14 @@
  * multiple threads may be working in the same surface at the same
  * time. (Quite literally so on SMP and multicore systems!) Just make
  * sure they're not doing it in the same area of the surface...!
+ *
+ * A State can also be given a pool of worker threads through
+ * zs_SetThreads(). Operations on Surfaces of that State are then
+ * split into bands that are rendered in parallel, each band with
+ * a private State of its own. The band layout depends only on the
+ * operation and the number of threads, and bands never depend on
+ * each other, so the results are identical to single threaded
+ * rendering.
  */
 
 /*
@@ -100,6 +108,17 @@ struct ZS_Surface
 ZS_State *zs_Open(void);
 void zs_Close(ZS_State *state);
 
+/* Maximum number of threads per State, including the calling thread */
+#define	ZS_MAXTHREADS	64
+
+/*
+ * Use 'threads' threads (including the calling thread) for rendering
+ * operations on Surfaces of 'state'. 0 or 1 disables the worker pool.
+ * Returns 0, or -1 if the worker threads could not be started, in
+ * which case the State is left single threaded.
+ */
+int zs_SetThreads(ZS_State *state, int threads);
+
 
 /*---------------------------------------------------------------
 	Low level tools
@@ -41,6 +41,7 @@ typedef struct ZS_Surface ZS_Surface;
 typedef struct ZS_Pipe ZS_Pipe;
 typedef struct ZS_Region ZS_Region;
 typedef struct ZS_Span ZS_Span;
+typedef struct ZS_Jobs ZS_Jobs;
 
 
 /* Single RGBAIZ pixel */
@@ -68,6 +69,7 @@ typedef struct ZS_State
 	ZS_Pixel	*pipebuf;	/* Intermediate pipeline buffer (one pixel row) */
 	int		refcount;
 	unsigned	rnd1, rnd2, rbal;
+	ZS_Jobs		*jobs;		/* Worker pool, or NULL if single threaded */
 } ZS_State;
 
 #endif /* ZS_TYPES_H */
@@ -98,6 +98,7 @@ static void usage(const char *exename)
 			exename);
 	fprintf(stderr, "| Switches:  -c        Compile only; don't run\n");
 	fprintf(stderr, "|            -e        Fail on compiler warnings\n");
+	fprintf(stderr, "|            -n        Disable inlining and optimization passes\n");
 #if 0
 	fprintf(stderr, "|            -o <file> Write binary to \"file\"\n");
 #endif
@@ -212,6 +213,9 @@ int main(int argc, const char *argv[])
 			  case 'e':
 				flags |= EEL_SF_WERROR;
 				break;
+			  case 'n':
+				flags |= EEL_SF_NOOPTIMIZE;
+				break;
 			  case 'l':
 				flags |= EEL_SF_LIST;
 				break;
@@ -10,9 +10,14 @@
 #include <stdio.h>
 #include "EEL.h"
 
+/* Instruction budget per burst */
+#define	BUDGET	10000
+
 int main(int argc, const char *argv[])
 {
 	EEL_object *m;
+	EEL_xno x;
+	int bursts = 1;
 	EEL_vm *vm = eel_open(argc, argv);
 	if(!vm)
 	{
@@ -25,7 +30,17 @@ int main(int argc, const char *argv[])
 		fprintf(stderr, "Could not load script!\n");
 		return 1;
 	}
-	eel_callnf(vm, m, "main", "*");
+
+	/* Run in bursts of limited length, as a real time host would */
+	eel_set_budget(vm, BUDGET);
+	x = eel_callnf(vm, m, "main", "*");
+	while(x == EEL_XCOUNTER)
+	{
+		++bursts;
+		eel_set_budget(vm, BUDGET);
+		x = eel_resume(vm);
+	}
+	printf("Ran %d bursts of %d VM instructions.\n", bursts, BUDGET);
 	eel_disown(m);
 	eel_close(vm);
 	return 0;